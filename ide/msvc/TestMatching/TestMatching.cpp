@@ -23,10 +23,906 @@
 #include <fstream>
 #include <iostream>
 #include <sstream>
+#include <ContainsMatcher.hpp>
 #include <Document.hpp>
 #include <Node.hpp>
 #include <Parser.hpp>
+#include <Regex.hpp>
+#include <SelectorLiteral.hpp>
+#include <SelectorSet.hpp>
 #include <Serializer.hpp>
+#include <StringKernels.hpp>
+#include <TextSelector.hpp>
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <thread>
+
+/// <summary>
+/// Parses every test document once, then has a number of threads concurrently run every test
+/// selector against the shared documents, many times over. Every thread compares what it gets
+/// from Find(...) and Each(...) against the results gathered serially beforehand, and touches the
+/// text and attributes of every match along the way. Build GQ and this test with
+/// "-fsanitize=thread" (GQ_SANITIZE_THREAD in CMake) to have ThreadSanitizer verify that
+/// concurrent querying of a shared document is free of data races.
+/// </summary>
+/// <param name="selectors">
+/// The test selector strings.
+/// </param>
+/// <param name="htmlSamples">
+/// The test html, where each entry is the document for the selector at the same index.
+/// </param>
+/// <returns>
+/// True if every concurrent query returned exactly the serial results, false otherwise.
+/// </returns>
+bool RunConcurrentQueryStressTest(const std::vector<std::string>& selectors, const std::vector<std::string>& htmlSamples)
+{
+	const size_t numThreads = 8;
+	const size_t numIterations = 25;
+
+	gq::Parser parser;
+
+	std::vector< std::unique_ptr<gq::Document> > documents;
+	std::vector<gq::SharedSelector> compiledSelectors;
+	std::vector< std::vector<const gq::Node*> > expectedResults;
+
+	for (size_t i = 0; i < selectors.size(); ++i)
+	{
+		auto document = gq::Document::Create();
+		document->Parse(htmlSamples[i]);
+
+		gq::SharedSelector selector = nullptr;
+
+		try
+		{
+			selector = parser.CreateSelector(selectors[i]);
+		}
+		catch (std::runtime_error&)
+		{
+			// Already reported by the serial tests.
+		}
+
+		std::vector<const gq::Node*> expected;
+
+		if (selector != nullptr)
+		{
+			auto result = document->Find(selector);
+
+			for (size_t ri = 0; ri < result.GetNodeCount(); ++ri)
+			{
+				expected.push_back(result.GetNodeAt(ri));
+			}
+		}
+
+		documents.emplace_back(std::move(document));
+		compiledSelectors.push_back(selector);
+		expectedResults.push_back(std::move(expected));
+	}
+
+	std::atomic<size_t> mismatches{ 0 };
+
+	auto worker = [&](const size_t threadIndex)
+	{
+		for (size_t iteration = 0; iteration < numIterations; ++iteration)
+		{
+			for (size_t n = 0; n < selectors.size(); ++n)
+			{
+				// Every thread starts at a different test, so that different selectors are
+				// running against the same document at the same time.
+				auto i = (n + threadIndex) % selectors.size();
+
+				if (compiledSelectors[i] == nullptr)
+				{
+					continue;
+				}
+
+				const gq::Document* document = documents[i].get();
+
+				auto result = (iteration % 2 == 0) ? document->Find(compiledSelectors[i]) : document->Find(selectors[i]);
+
+				bool identical = result.GetNodeCount() == expectedResults[i].size();
+
+				for (size_t ri = 0; identical && ri < result.GetNodeCount(); ++ri)
+				{
+					identical = result.GetNodeAt(ri) == expectedResults[i][ri];
+				}
+
+				size_t eachCount = 0;
+				size_t textSize = 0;
+
+				document->Each(compiledSelectors[i],
+					[&eachCount, &textSize](const gq::Node* node)->void
+				{
+					++eachCount;
+					textSize += node->GetText().size();
+					textSize += node->GetAttributeValue(u8"class").size();
+				});
+
+				if (!identical || eachCount != expectedResults[i].size())
+				{
+					++mismatches;
+				}
+			}
+		}
+	};
+
+	std::vector<std::thread> threads;
+
+	for (size_t t = 0; t < numThreads; ++t)
+	{
+		threads.emplace_back(worker, t);
+	}
+
+	for (auto& thread : threads)
+	{
+		thread.join();
+	}
+
+	std::cout << u8"Concurrent query stress test ran " << selectors.size() << u8" selectors " << numIterations << u8" times on each of " << numThreads << u8" threads with " << mismatches << u8" mismatched results." << std::endl;
+
+	return mismatches == 0;
+}
+
+/// <summary>
+/// Checks that selectors compiled from literals with GQ_SELECTOR find exactly the same nodes as
+/// the same selectors compiled at runtime, through both Find(...) and Each(...). Malformed literals
+/// can't be tested here, since they fail the build.
+/// </summary>
+/// <returns>
+/// True if every literal matched exactly what its runtime equivalent matched, false otherwise.
+/// </returns>
+bool RunSelectorLiteralTest()
+{
+	std::string html(u8"<!DOCTYPE html><html><head><title>Selector Literals</title></head><body><div class=\"a b\" id=\"main\"><p>one</p><p lang=\"en-US\">two</p><a href=\"x.html\">three</a></div><ul><li></li><li>four</li><li>five</li></ul></body></html>");
+
+	auto document = gq::Document::Create();
+	document->Parse(html);
+
+	gq::Parser parser;
+
+	std::vector< std::pair<std::string, gq::SharedSelector> > literals =
+	{
+		{ u8"div.a.b > p", GQ_SELECTOR(u8"div.a.b > p") },
+		{ u8"#main [href$='.html'], li:empty", GQ_SELECTOR(u8"#main [href$='.html'], li:empty") },
+		{ u8"p[lang|=en] + a", GQ_SELECTOR(u8"p[lang|=en] + a") },
+		{ u8"li:nth-child(2n+1):not(:empty)", GQ_SELECTOR(u8"li:nth-child(2n+1):not(:empty)") },
+		{ u8"div:haschild(a) ~ ul li:contains(\"f\")", GQ_SELECTOR(u8"div:haschild(a) ~ ul li:contains(\"f\")") },
+		{ u8"body *", GQ_SELECTOR(u8"body *") },
+		{ u8"p[lang|=\"EN\" i] + a[href*='.HTML'i]", GQ_SELECTOR(u8"p[lang|=\"EN\" i] + a[href*='.HTML'i]") }
+	};
+
+	size_t mismatches = 0;
+
+	for (const auto& literal : literals)
+	{
+		auto expected = document->Find(parser.CreateSelector(literal.first));
+		auto result = document->Find(literal.second);
+
+		bool identical = result.GetNodeCount() == expected.GetNodeCount() && literal.second->GetOriginalSelectorString() == literal.first;
+
+		for (size_t ri = 0; identical && ri < result.GetNodeCount(); ++ri)
+		{
+			identical = result.GetNodeAt(ri) == expected.GetNodeAt(ri);
+		}
+
+		size_t eachCount = 0;
+
+		document->Each(literal.second,
+			[&eachCount](const gq::Node* node)->void
+		{
+			++eachCount;
+		});
+
+		if (!identical || eachCount != expected.GetNodeCount())
+		{
+			std::cout << u8"Selector literal " << literal.first << u8" matched different nodes than the same selector compiled at runtime." << std::endl;
+			++mismatches;
+		}
+	}
+
+	std::cout << u8"Selector literal test compared " << literals.size() << u8" literals with " << mismatches << u8" mismatched results." << std::endl;
+
+	return mismatches == 0;
+}
+
+/// <summary>
+/// Checks the regular expression engine behind :matches(...) and :matchesOwn(...) directly
+/// against patterns with known outcomes, covering anchors, character classes, counted
+/// repetition and word boundaries, along with patterns that must be rejected. Every pattern is
+/// also searched for with the text fed in two pieces, split between every pair of characters,
+/// which must not change the outcome.
+/// </summary>
+/// <returns>
+/// True if every pattern gave its known outcome, false otherwise.
+/// </returns>
+bool RunRegexTest()
+{
+	struct RegexCase
+	{
+		const char* pattern;
+		const char* text;
+		bool expected;
+	};
+
+	const std::vector<RegexCase> cases =
+	{
+		// Anchors.
+		{ u8"^abc", u8"abcd", true },
+		{ u8"^abc", u8"xabc", false },
+		{ u8"abc$", u8"xabc", true },
+		{ u8"abc$", u8"abcx", false },
+		{ u8"^$", u8"", true },
+		{ u8"^$", u8"a", false },
+		{ u8"^a|b$", u8"cb", true },
+		{ u8"a^b", u8"a^b", false },
+		{ u8"^(?:a|b)+$", u8"abba", true },
+		{ u8"^(?:a|b)+$", u8"abca", false },
+
+		// Character classes.
+		{ u8"[a-c]+x", u8"zzbcax", true },
+		{ u8"[^a-c]", u8"abc", false },
+		{ u8"[^a-c]", u8"abcd", true },
+		{ u8"\\d{3}", u8"ab12c", false },
+		{ u8"\\d{3}", u8"a123", true },
+		{ u8"\\D", u8"123", false },
+		{ u8"\\w+@\\w+", u8"me@host", true },
+		{ u8"\\W", u8"abc_1", false },
+		{ u8"\\s", u8"a\tb", true },
+		{ u8"\\S", u8" \t\n", false },
+		{ u8"[\\d.]+", u8"v1.2", true },
+		{ u8"[-a]", u8"-", true },
+		{ u8"[a-]", u8"-", true },
+		{ u8"[\\]]", u8"]", true },
+		{ u8"^[\\w-]+$", u8"a-b_c", true },
+		{ u8".", u8"\n", false },
+		{ u8"^.$", u8"\u00E9", true },
+
+		// Counted repetition.
+		{ u8"^a{3}$", u8"aaa", true },
+		{ u8"^a{3}$", u8"aaaa", false },
+		{ u8"^a{2,}$", u8"a", false },
+		{ u8"^a{2,}$", u8"aaaaa", true },
+		{ u8"^a{2,3}$", u8"aaaa", false },
+		{ u8"^a{2,3}$", u8"aa", true },
+		{ u8"^(?:ab){2}$", u8"abab", true },
+		{ u8"^(?:ab){2}$", u8"ababab", false },
+		{ u8"^(?:a{2}){2}$", u8"aaaa", true },
+		{ u8"^(?:a{2}){2}$", u8"aaa", false },
+		{ u8"a{0}b", u8"b", true },
+		{ u8"^x{1,2}?y", u8"xxy", true },
+		{ u8"^a{3}?$", u8"aaa", true },
+
+		// Word boundaries.
+		{ u8"\\bcat\\b", u8"the cat sat", true },
+		{ u8"\\bcat\\b", u8"concat", false },
+		{ u8"\\bcat\\b", u8"cats", false },
+		{ u8"\\Bcat", u8"concat", true },
+		{ u8"\\Bcat", u8"cat", false },
+		{ u8"\\b", u8"", false },
+		{ u8"\\B", u8"", true },
+		{ u8"^\\b", u8"a", true },
+		{ u8"\\b$", u8"a ", false },
+		{ u8"\\b$", u8"a", true },
+		{ u8"\\b\\w+\\b", u8"--", false },
+
+		// Alternatives that share a prefix.
+		{ u8"(a|ab)(c|bcd)(d*)", u8"abcd", true }
+	};
+
+	// Features that need backtracking, and malformed patterns.
+	const std::vector<const char*> rejected =
+	{
+		u8"(a)\\1", u8"a(?=b)", u8"a(?!b)", u8"(?<=a)b", u8"(", u8"[a", u8"a{2,1}", u8"*a"
+	};
+
+	size_t failures = 0;
+
+	for (const auto& regexCase : cases)
+	{
+		auto expression = gq::Regex::Get(regexCase.pattern);
+
+		if (expression == nullptr)
+		{
+			std::cout << u8"Regex " << regexCase.pattern << u8" failed to compile." << std::endl;
+			++failures;
+			continue;
+		}
+
+		const boost::string_ref text(regexCase.text);
+
+		bool correct = expression->Search(text) == regexCase.expected;
+
+		for (size_t split = 0; correct && split <= text.size(); ++split)
+		{
+			// Pieces of text always hold whole characters, so never split a UTF-8 sequence.
+			if (split < text.size() && (static_cast<unsigned char>(text[split]) & 0xC0) == 0x80)
+			{
+				continue;
+			}
+
+			gq::Regex::Searcher searcher(*expression);
+			searcher.Feed(text.substr(0, split));
+			searcher.Feed(text.substr(split));
+
+			correct = searcher.Finish() == regexCase.expected;
+		}
+
+		if (!correct)
+		{
+			std::cout << u8"Regex " << regexCase.pattern << u8" searched in \"" << regexCase.text << u8"\" did not give " << (regexCase.expected ? u8"a match." : u8"no match.") << std::endl;
+			++failures;
+		}
+	}
+
+	for (const auto& pattern : rejected)
+	{
+		if (gq::Regex::Get(pattern) != nullptr)
+		{
+			std::cout << u8"Regex " << pattern << u8" compiled, but should have been rejected." << std::endl;
+			++failures;
+		}
+	}
+
+	std::cout << u8"Regex test checked " << cases.size() + rejected.size() << u8" patterns with " << failures << u8" failures." << std::endl;
+
+	return failures == 0;
+}
+
+/// <summary>
+/// Checks the ContainsMatcher directly with needles that overlap one another, share prefixes and
+/// suffixes, repeat within each other and cross element boundaries. Within an open scope, every
+/// needle is looked up against every element of a document, and must be found exactly where
+/// searching the text of the element for it alone finds it.
+/// </summary>
+/// <returns>
+/// True if every lookup agreed with searching the text directly, false otherwise.
+/// </returns>
+bool RunContainsMatcherTest()
+{
+	std::string html(u8"<!DOCTYPE html><html><head><title>ushers</title></head><body><div><p>she sells his hers</p><p>abcab<b>c</b>abca</p><span><b>a</b>b</span></div><ul><li>aaa</li><li>aa<i>a</i></li><li>he</li><li></li></ul><p>hishe<em>rs</em></p></body></html>");
+
+	auto document = gq::Document::Create();
+	document->Parse(html);
+
+	const std::vector<std::string> needles =
+	{
+		u8"he", u8"she", u8"his", u8"hers", u8"ushers", u8"sells h",
+		u8"cab", u8"abcab", u8"bca", u8"abcabcabca",
+		u8"a", u8"aa", u8"aaa", u8"aaaa", u8"ab", u8"hishers", u8"xyz"
+	};
+
+	std::vector<gq::SharedSelector> selectors;
+
+	for (const auto& needle : needles)
+	{
+		selectors.push_back(std::make_shared<gq::TextSelector>(gq::TextSelector::SelectorOperator::Contains, needle));
+		selectors.push_back(std::make_shared<gq::TextSelector>(gq::TextSelector::SelectorOperator::ContainsOwn, needle));
+	}
+
+	gq::ContainsMatcher matcher(selectors);
+
+	size_t failures = 0;
+
+	if (matcher.GetPatternCount() != needles.size())
+	{
+		std::cout << u8"ContainsMatcher reported " << matcher.GetPatternCount() << u8" distinct needles, expected " << needles.size() << u8"." << std::endl;
+		++failures;
+	}
+
+	auto elements = document->Find(u8"*");
+
+	size_t lookups = 0;
+
+	{
+		gq::ContainsMatcher::Scope scope(matcher, *document);
+
+		for (size_t ei = 0; ei < elements.GetNodeCount(); ++ei)
+		{
+			const auto element = elements.GetNodeAt(ei);
+			const auto text = element->GetText();
+			const auto ownText = element->GetOwnText();
+
+			for (size_t si = 0; si < selectors.size(); ++si)
+			{
+				const auto& needle = needles[si / 2];
+				const bool own = (si % 2) != 0;
+				const bool expected = (own ? ownText : text).find(needle) != std::string::npos;
+
+				bool found = false;
+				++lookups;
+
+				if (!gq::ContainsMatcher::Lookup(static_cast<const gq::TextSelector*>(selectors[si].get()), element, own, found) || found != expected)
+				{
+					std::cout << u8"ContainsMatcher " << (own ? u8"own " : u8"") << u8"lookup of \"" << needle << u8"\" in <" << element->GetTagName() << u8"> did not give " << (expected ? u8"a match." : u8"no match.") << std::endl;
+					++failures;
+				}
+			}
+		}
+	}
+
+	std::cout << u8"ContainsMatcher test checked " << lookups << u8" lookups with " << failures << u8" failures." << std::endl;
+
+	return failures == 0;
+}
+
+/// <summary>
+/// Checks the string kernels directly with needles of 15, 16, 31, 32 and 33 bytes, either side of
+/// the widths the vectorized kernels compare at once, sitting at the very end of haystacks of
+/// every length up to 70 bytes longer than the needle. Near misses that differ from the needle
+/// only in the middle are placed earlier in each haystack. Every search and comparison must give
+/// exactly what the standard library gives.
+/// </summary>
+/// <returns>
+/// True if every search and comparison agreed with the standard library, false otherwise.
+/// </returns>
+bool RunStringKernelsTest()
+{
+	const auto toLower = [](std::string value)->std::string
+	{
+		std::transform(value.begin(), value.end(), value.begin(), [](char c) { return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c; });
+		return value;
+	};
+
+	const auto flipCase = [](std::string value)->std::string
+	{
+		std::transform(value.begin(), value.end(), value.begin(), [](char c) { return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : (c >= 'a' && c <= 'z' ? static_cast<char>(c - 'a' + 'A') : c); });
+		return value;
+	};
+
+	const std::vector<size_t> needleSizes = { 15, 16, 31, 32, 33 };
+
+	size_t checks = 0;
+	size_t failures = 0;
+
+	for (const auto needleSize : needleSizes)
+	{
+		std::string needle;
+
+		for (size_t i = 0; i < needleSize; ++i)
+		{
+			needle.push_back(static_cast<char>((i % 2 == 0 ? 'A' : 'a') + (i * 7) % 26));
+		}
+
+		std::string nearMiss(needle);
+		nearMiss[needleSize / 2] = '-';
+
+		for (size_t haystackSize = needleSize; haystackSize <= needleSize + 70; ++haystackSize)
+		{
+			std::string haystack(haystackSize - needleSize, '.');
+
+			for (size_t position = 0; position + needleSize <= haystack.size(); position += needleSize / 2 + 3)
+			{
+				haystack.replace(position, needleSize, nearMiss);
+			}
+
+			const std::vector<std::string> haystacks =
+			{
+				haystack + needle,
+				haystack + needle.substr(0, needleSize - 1) + u8"-",
+				u8"-" + haystack + needle.substr(0, needleSize - 1)
+			};
+
+			for (const auto& candidate : haystacks)
+			{
+				const auto expected = candidate.find(needle);
+				const auto expectedIgnoreCase = toLower(candidate).find(toLower(needle));
+				const auto found = gq::StringKernels::Find(candidate, needle);
+				const auto foundIgnoreCase = gq::StringKernels::FindIgnoreCase(flipCase(candidate), needle);
+
+				checks += 2;
+
+				if (found != expected || foundIgnoreCase != expectedIgnoreCase)
+				{
+					std::cout << u8"String kernels found a " << needleSize << u8" byte needle in a " << candidate.size() << u8" byte haystack at " << found << u8" and " << foundIgnoreCase << u8" ignoring case, expected " << expected << u8"." << std::endl;
+					++failures;
+				}
+			}
+		}
+
+		std::string firstDiffers(needle);
+		firstDiffers.front() = '-';
+
+		std::string lastDiffers(needle);
+		lastDiffers.back() = '-';
+
+		const bool correct =
+			gq::StringKernels::Equals(needle, needle) &&
+			!gq::StringKernels::Equals(needle, flipCase(needle)) &&
+			!gq::StringKernels::Equals(needle, firstDiffers) &&
+			!gq::StringKernels::Equals(needle, lastDiffers) &&
+			gq::StringKernels::EqualsIgnoreCase(needle, flipCase(needle)) &&
+			!gq::StringKernels::EqualsIgnoreCase(needle, flipCase(firstDiffers)) &&
+			!gq::StringKernels::EqualsIgnoreCase(needle, flipCase(lastDiffers));
+
+		checks += 7;
+
+		if (!correct)
+		{
+			std::cout << u8"String kernels compared " << needleSize << u8" byte strings incorrectly." << std::endl;
+			++failures;
+		}
+	}
+
+	std::cout << u8"String kernels test checked " << checks << u8" searches and comparisons using " << gq::StringKernels::GetImplementationName() << u8" with " << failures << u8" failures." << std::endl;
+
+	return failures == 0;
+}
+
+/// <summary>
+/// Checks that a mutation collection whose nodes are added and removed over and over, with
+/// actions declared on them each time, serializes exactly as a fresh collection holding only the
+/// actions of the last round does. This covers the compaction of the actions of removed nodes,
+/// and keeping the ancestors of the nodes only while source passthrough is enabled.
+/// </summary>
+/// <returns>
+/// True if every serialization matched that of the fresh collection, false otherwise.
+/// </returns>
+bool RunMutationChurnTest()
+{
+	std::string html(u8"<!DOCTYPE html><html><head><title>Churn</title></head><body><div id=\"a\"><p>one</p><p class=\"x\">two</p></div><ul><li>three</li><li>four</li></ul></body></html>");
+
+	auto document = gq::Document::Create();
+	document->Parse(html);
+
+	auto nodes = document->Find(u8"p, li");
+
+	const size_t rounds = 500;
+
+	gq::NodeMutationCollection churned;
+
+	for (size_t round = 0; round < rounds; ++round)
+	{
+		const auto value = std::to_string(round);
+
+		for (size_t ni = 0; ni < nodes.GetNodeCount(); ++ni)
+		{
+			if (round > 0 && (round + ni) % 3 == 0)
+			{
+				churned.Remove(nodes.GetNodeAt(ni));
+			}
+
+			churned.SetAttribute(nodes.GetNodeAt(ni), u8"data-round", value);
+			churned.InsertBefore(nodes.GetNodeAt(ni), u8"<!-- " + value + u8" -->");
+		}
+
+		// Passthrough is switched on and off along the way, so the ancestors have to be rebuilt.
+		churned.SetSourcePassthrough(round % 7 == 0);
+	}
+
+	// The collection the churned one must now be equivalent to holds, for each node, the actions
+	// declared since it was last removed.
+	gq::NodeMutationCollection fresh;
+
+	for (size_t ni = 0; ni < nodes.GetNodeCount(); ++ni)
+	{
+		size_t first = 0;
+
+		for (size_t round = 1; round < rounds; ++round)
+		{
+			if ((round + ni) % 3 == 0)
+			{
+				first = round;
+			}
+		}
+
+		for (size_t round = first; round < rounds; ++round)
+		{
+			fresh.SetAttribute(nodes.GetNodeAt(ni), u8"data-round", std::to_string(round));
+			fresh.InsertBefore(nodes.GetNodeAt(ni), u8"<!-- " + std::to_string(round) + u8" -->");
+		}
+	}
+
+	size_t failures = 0;
+
+	for (const bool passthrough : { false, true })
+	{
+		churned.SetSourcePassthrough(passthrough);
+		fresh.SetSourcePassthrough(passthrough);
+
+		const auto expected = gq::Serializer::Serialize(document.get(), &fresh);
+
+		if (gq::Serializer::Serialize(document.get(), &churned) != expected)
+		{
+			std::cout << u8"Churned mutation collection serialized differently than a fresh one" << (passthrough ? u8" with source passthrough." : u8".") << std::endl;
+			++failures;
+		}
+
+		churned.Freeze();
+
+		if (gq::Serializer::Serialize(document.get(), &churned) != expected)
+		{
+			std::cout << u8"Frozen churned mutation collection serialized differently than a fresh one" << (passthrough ? u8" with source passthrough." : u8".") << std::endl;
+			++failures;
+		}
+	}
+
+	std::cout << u8"Mutation churn test checked " << rounds << u8" rounds with " << failures << u8" failures." << std::endl;
+
+	return failures == 0;
+}
+
+/// <summary>
+/// Parses the document of every test and finds the matches of its selector within it, then hands
+/// both to the supplied check. Tests whose selector fails to compile are skipped, since they are
+/// already reported by the selector tests.
+/// </summary>
+/// <param name="testName">
+/// The name of the test, to report failed checks under.
+/// </param>
+/// <param name="selectors">
+/// The test selector strings.
+/// </param>
+/// <param name="htmlSamples">
+/// The test html, where each entry is the document for the selector at the same index.
+/// </param>
+/// <param name="check">
+/// The check to run on each document and the matches of its selector. Returns false if the
+/// check failed.
+/// </param>
+/// <returns>
+/// The number of documents the check failed on.
+/// </returns>
+size_t CountFailedTestDocuments(const char* testName, const std::vector<std::string>& selectors, const std::vector<std::string>& htmlSamples, const std::function<bool(const gq::Document*, const gq::Selection&)>& check)
+{
+	gq::Parser parser;
+
+	size_t failures = 0;
+
+	for (size_t i = 0; i < selectors.size(); ++i)
+	{
+		gq::SharedSelector selector = nullptr;
+
+		try
+		{
+			selector = parser.CreateSelector(selectors[i]);
+		}
+		catch (std::runtime_error&)
+		{
+			// Already reported by the selector tests.
+			continue;
+		}
+
+		auto document = gq::Document::Create();
+		document->Parse(htmlSamples[i]);
+
+		if (!check(document.get(), document->Find(selector)))
+		{
+			std::cout << testName << u8" failed on the document of test selector " << selectors[i] << u8"." << std::endl;
+			++failures;
+		}
+	}
+
+	std::cout << testName << u8" checked " << selectors.size() << u8" documents with " << failures << u8" failures." << std::endl;
+
+	return failures;
+}
+
+/// <summary>
+/// Fills the supplied collections so that serializing with either leaves out the supplied
+/// matches, removing them with a callback in the first and declaring them removed in the second.
+/// </summary>
+/// <param name="matches">
+/// The nodes to remove.
+/// </param>
+/// <param name="removals">
+/// The collection to remove the nodes from with a callback.
+/// </param>
+/// <param name="declaredRemovals">
+/// The collection to declare the nodes removed in.
+/// </param>
+void CollectRemovals(const gq::Selection& matches, gq::NodeMutationCollection& removals, gq::NodeMutationCollection& declaredRemovals)
+{
+	removals.SetOnTagStart([](const GumboTag tagType) { return false; });
+
+	for (size_t ri = 0; ri < matches.GetNodeCount(); ++ri)
+	{
+		removals.Add(matches.GetNodeAt(ri));
+		declaredRemovals.RemoveElement(matches.GetNodeAt(ri));
+	}
+}
+
+/// <summary>
+/// Checks that serializing every test document to a sink produces exactly the same HTML as
+/// serializing it to a string, no matter how the sink receives it, and that serializing into a
+/// string that is reused replaces whatever it held.
+/// </summary>
+/// <param name="selectors">
+/// The test selector strings.
+/// </param>
+/// <param name="htmlSamples">
+/// The test html, where each entry is the document for the selector at the same index.
+/// </param>
+/// <returns>
+/// True if every sink received exactly the same HTML, false otherwise.
+/// </returns>
+bool RunOutputSinkTest(const std::vector<std::string>& selectors, const std::vector<std::string>& htmlSamples)
+{
+	return CountFailedTestDocuments(u8"Output sink test", selectors, htmlSamples, [](const gq::Document* document, const gq::Selection& matches) -> bool
+	{
+		const auto expected = document->GetOuterHtml();
+
+		std::ostringstream streamedHtml;
+		gq::StreamOutputSink streamSink(streamedHtml);
+		gq::Serializer::Serialize(document, streamSink);
+
+		std::string callbackHtml;
+		gq::CallbackOutputSink callbackSink([&callbackHtml](boost::string_ref data) { callbackHtml.append(data.data(), data.size()); }, 7);
+		gq::Serializer::Serialize(document, callbackSink);
+
+		gq::SpanOutputSink spanSink(1);
+		gq::Serializer::Serialize(document, spanSink);
+
+		std::string gatheredHtml;
+
+		for (const auto& span : spanSink.GetSpans())
+		{
+			gatheredHtml.append(span.data(), span.size());
+		}
+
+		if (streamedHtml.str() != expected || callbackHtml != expected || gatheredHtml != expected || spanSink.GetSize() != expected.size())
+		{
+			return false;
+		}
+
+		gq::Serializer::Serialize(document, gatheredHtml);
+
+		return gatheredHtml == expected;
+	}) == 0;
+}
+
+/// <summary>
+/// Checks that declaring the matches of every test selector removed produces exactly the same
+/// HTML as removing them with a callback.
+/// </summary>
+/// <param name="selectors">
+/// The test selector strings.
+/// </param>
+/// <param name="htmlSamples">
+/// The test html, where each entry is the document for the selector at the same index.
+/// </param>
+/// <returns>
+/// True if the declared removals always matched the callback, false otherwise.
+/// </returns>
+bool RunDeclaredMutationTest(const std::vector<std::string>& selectors, const std::vector<std::string>& htmlSamples)
+{
+	return CountFailedTestDocuments(u8"Declared mutation test", selectors, htmlSamples, [](const gq::Document* document, const gq::Selection& matches) -> bool
+	{
+		gq::NodeMutationCollection removals;
+		gq::NodeMutationCollection declaredRemovals;
+		CollectRemovals(matches, removals, declaredRemovals);
+
+		return gq::Serializer::Serialize(document, &declaredRemovals) == gq::Serializer::Serialize(document, &removals);
+	}) == 0;
+}
+
+/// <summary>
+/// Checks that removing the matches of every test selector while copying the rest of the
+/// document from its source leaves the same elements behind as removing them during ordinary
+/// serialization, and that a span sink gathers exactly the same HTML.
+/// </summary>
+/// <param name="selectors">
+/// The test selector strings.
+/// </param>
+/// <param name="htmlSamples">
+/// The test html, where each entry is the document for the selector at the same index.
+/// </param>
+/// <returns>
+/// True if copying from the source always left the same elements behind, false otherwise.
+/// </returns>
+bool RunSourcePassthroughTest(const std::vector<std::string>& selectors, const std::vector<std::string>& htmlSamples)
+{
+	return CountFailedTestDocuments(u8"Source passthrough test", selectors, htmlSamples, [](const gq::Document* document, const gq::Selection& matches) -> bool
+	{
+		gq::NodeMutationCollection removals;
+		gq::NodeMutationCollection declaredRemovals;
+		CollectRemovals(matches, removals, declaredRemovals);
+
+		const auto removedHtml = gq::Serializer::Serialize(document, &removals);
+
+		removals.SetSourcePassthrough(true);
+
+		const auto passthroughHtml = gq::Serializer::Serialize(document, &removals);
+
+		gq::SpanOutputSink spanSink(1);
+		gq::Serializer::Serialize(document, spanSink, &removals);
+
+		std::string gatheredHtml;
+
+		for (const auto& span : spanSink.GetSpans())
+		{
+			gatheredHtml.append(span.data(), span.size());
+		}
+
+		if (removedHtml.empty() != passthroughHtml.empty() || gatheredHtml != passthroughHtml || spanSink.GetSize() != passthroughHtml.size())
+		{
+			return false;
+		}
+
+		if (removedHtml.empty())
+		{
+			return true;
+		}
+
+		auto removedDocument = gq::Document::Create();
+		removedDocument->Parse(removedHtml);
+
+		auto passthroughDocument = gq::Document::Create();
+		passthroughDocument->Parse(passthroughHtml);
+
+		return passthroughDocument->Find(u8"*").GetNodeCount() == removedDocument->Find(u8"*").GetNodeCount();
+	}) == 0;
+}
+
+/// <summary>
+/// Checks that walking frozen collections in document order, with and without source
+/// passthrough, serializes exactly as the same collections do before they're frozen.
+/// </summary>
+/// <param name="selectors">
+/// The test selector strings.
+/// </param>
+/// <param name="htmlSamples">
+/// The test html, where each entry is the document for the selector at the same index.
+/// </param>
+/// <returns>
+/// True if freezing never changed the output, false otherwise.
+/// </returns>
+bool RunFrozenMutationTest(const std::vector<std::string>& selectors, const std::vector<std::string>& htmlSamples)
+{
+	return CountFailedTestDocuments(u8"Frozen mutation test", selectors, htmlSamples, [](const gq::Document* document, const gq::Selection& matches) -> bool
+	{
+		gq::NodeMutationCollection removals;
+		gq::NodeMutationCollection declaredRemovals;
+		CollectRemovals(matches, removals, declaredRemovals);
+
+		const auto removedHtml = gq::Serializer::Serialize(document, &removals);
+		const auto declaredHtml = gq::Serializer::Serialize(document, &declaredRemovals);
+
+		removals.SetSourcePassthrough(true);
+
+		const auto passthroughHtml = gq::Serializer::Serialize(document, &removals);
+
+		removals.Freeze();
+		declaredRemovals.Freeze();
+
+		bool identical = gq::Serializer::Serialize(document, &removals) == passthroughHtml && gq::Serializer::Serialize(document, &declaredRemovals) == declaredHtml;
+
+		removals.SetSourcePassthrough(false);
+
+		return identical && gq::Serializer::Serialize(document, &removals) == removedHtml;
+	}) == 0;
+}
+
+/// <summary>
+/// Checks that serializing every test document in parallel, split as finely as possible,
+/// produces exactly the same HTML as serializing it serially, with no mutations, with removals
+/// by callback and by declaration, and with source passthrough.
+/// </summary>
+/// <param name="selectors">
+/// The test selector strings.
+/// </param>
+/// <param name="htmlSamples">
+/// The test html, where each entry is the document for the selector at the same index.
+/// </param>
+/// <returns>
+/// True if serializing in parallel never changed the output, false otherwise.
+/// </returns>
+bool RunParallelSerializeTest(const std::vector<std::string>& selectors, const std::vector<std::string>& htmlSamples)
+{
+	return CountFailedTestDocuments(u8"Parallel serialize test", selectors, htmlSamples, [](const gq::Document* document, const gq::Selection& matches) -> bool
+	{
+		gq::NodeMutationCollection removals;
+		gq::NodeMutationCollection declaredRemovals;
+		CollectRemovals(matches, removals, declaredRemovals);
+
+		bool identical = gq::Serializer::SerializeParallel(document, nullptr, 1, 4) == gq::Serializer::Serialize(document) &&
+			gq::Serializer::SerializeParallel(document, &removals, 1, 4) == gq::Serializer::Serialize(document, &removals) &&
+			gq::Serializer::SerializeParallel(document, &declaredRemovals, 1, 4) == gq::Serializer::Serialize(document, &declaredRemovals);
+
+		removals.SetSourcePassthrough(true);
+
+		return identical && gq::Serializer::SerializeParallel(document, &removals, 1, 4) == gq::Serializer::Serialize(document, &removals);
+	}) == 0;
+}
 
 /// <summary>
 /// The purpose of this test is to load the "matchingtest.data" data file and run the tests laid out
@@ -124,6 +1020,62 @@ int main()
 
 	gq::Parser parser;
 
+	// Every test is also run with a selector that has been written out to the binary format and
+	// read back in, which must match exactly the same nodes as the freshly compiled selector, and
+	// keep the domains of its rule.
+	std::vector<gq::SharedSelector> reloadedSelectors(testSelectors.size());
+
+	// Every test selector is also compiled twice into a set which is then deduplicated. Both
+	// copies must be merged into one, and the set must report exactly the same nodes for each as
+	// the compiled selector finds.
+	gq::SelectorSet canonicalSet;
+	std::vector<size_t> canonicalRuleIndices(testSelectors.size(), std::numeric_limits<size_t>::max());
+
+	{
+		gq::SelectorSet originalSet;
+
+		for (size_t i = 0; i < testSelectors.size(); ++i)
+		{
+			try
+			{
+				originalSet.Add(i, parser.CreateSelector(testSelectors[i], true), std::to_string(i) + u8".example.com,~ads.example.com");
+
+				canonicalRuleIndices[i] = canonicalSet.GetRuleCount();
+				canonicalSet.Add(i, parser.CreateSelector(testSelectors[i]));
+				canonicalSet.Add(i, parser.CreateSelector(testSelectors[i]));
+			}
+			catch (std::exception&)
+			{
+				// Reported when the test itself runs.
+			}
+		}
+
+		std::string binary;
+		originalSet.SaveBinary(binary);
+
+		std::vector<gq::SelectorSet::Diagnostic> diagnostics;
+		auto reloadedSet = gq::SelectorSet::LoadBinary(binary, diagnostics);
+
+		for (auto& diagnostic : diagnostics)
+		{
+			std::cout << u8"Failed to reload precompiled selectors: " << diagnostic.GetMessage() << std::endl;
+		}
+
+		for (size_t i = 0; i < reloadedSet.GetRuleCount(); ++i)
+		{
+			const auto& rule = reloadedSet.GetRuleAt(i);
+
+			if (rule.GetDomains() == std::to_string(rule.GetId()) + u8".example.com,~ads.example.com")
+			{
+				reloadedSelectors[rule.GetId()] = rule.GetSelector();
+			}
+		}
+	}
+
+	canonicalSet.Deduplicate();
+
+	std::cout << u8"Deduplicated " << canonicalSet.GetRuleCount() << u8" rules into " << canonicalSet.GetDistinctSelectorCount() << u8" distinct selectors." << std::endl;
+
 	if (testNumbers.size() == testSelectors.size() && testExpectedMatches.size() == testNumbers.size() && testHtmlSamples.size() == testExpectedMatches.size())
 	{
 
@@ -158,6 +1110,92 @@ int main()
 				auto result = document->Find(selector);				
 				std::cout << u8"Original Selector String: " << selector->GetOriginalSelectorString() << std::endl << std::endl;
 
+				// Force parallel matching regardless of candidate count. The results must be
+				// exactly the same as the serial results, in the same order.
+				auto parallelResult = document->FindParallel(selector, 0, 4);
+
+				bool parallelResultsIdentical = parallelResult.GetNodeCount() == result.GetNodeCount();
+
+				for (size_t ri = 0; parallelResultsIdentical && ri < result.GetNodeCount(); ++ri)
+				{
+					parallelResultsIdentical = parallelResult.GetNodeAt(ri) == result.GetNodeAt(ri);
+				}
+
+				if (!parallelResultsIdentical)
+				{
+					std::cout << u8"Test Number " << testNumbers[i] << u8" failed using selector " << testSelectors[i] << u8" because parallel matching returned different results than serial matching." << std::endl << std::endl;
+					++testsFailed;
+					continue;
+				}
+
+				bool reloadedResultsIdentical = reloadedSelectors[i] != nullptr && reloadedSelectors[i]->GetOriginalSelectorString() == selector->GetOriginalSelectorString();
+
+				if (reloadedResultsIdentical)
+				{
+					auto reloadedResult = document->Find(reloadedSelectors[i]);
+
+					reloadedResultsIdentical = reloadedResult.GetNodeCount() == result.GetNodeCount();
+
+					for (size_t ri = 0; reloadedResultsIdentical && ri < result.GetNodeCount(); ++ri)
+					{
+						reloadedResultsIdentical = reloadedResult.GetNodeAt(ri) == result.GetNodeAt(ri);
+					}
+				}
+
+				if (!reloadedResultsIdentical)
+				{
+					std::cout << u8"Test Number " << testNumbers[i] << u8" failed using selector " << testSelectors[i] << u8" because the selector reloaded from the binary format returned different results than the compiled selector." << std::endl << std::endl;
+					++testsFailed;
+					continue;
+				}
+
+				bool canonicalResultsIdentical = canonicalRuleIndices[i] != std::numeric_limits<size_t>::max() &&
+					canonicalSet.GetRuleAt(canonicalRuleIndices[i]).GetSelector() == canonicalSet.GetRuleAt(canonicalRuleIndices[i] + 1).GetSelector();
+
+				if (canonicalResultsIdentical)
+				{
+					auto canonicalResult = canonicalSet.Find(*document);
+
+					for (size_t copy = 0; canonicalResultsIdentical && copy < 2; ++copy)
+					{
+						const auto& copyResult = canonicalResult.GetSelectionAt(canonicalRuleIndices[i] + copy);
+
+						canonicalResultsIdentical = copyResult.GetNodeCount() == result.GetNodeCount();
+
+						for (size_t ri = 0; canonicalResultsIdentical && ri < result.GetNodeCount(); ++ri)
+						{
+							canonicalResultsIdentical = copyResult.GetNodeAt(ri) == result.GetNodeAt(ri);
+						}
+					}
+				}
+
+				if (!canonicalResultsIdentical)
+				{
+					std::cout << u8"Test Number " << testNumbers[i] << u8" failed using selector " << testSelectors[i] << u8" because the deduplicated selector set returned different results than the compiled selector." << std::endl << std::endl;
+					++testsFailed;
+					continue;
+				}
+
+				// The same document parsed with a text index must give the same nodes as well.
+				auto indexedDocument = gq::Document::Create();
+				indexedDocument->Parse(testHtmlSamples[i], true);
+
+				auto indexedResult = indexedDocument->Find(selector);
+
+				bool indexedResultsIdentical = indexedResult.GetNodeCount() == result.GetNodeCount();
+
+				for (size_t ri = 0; indexedResultsIdentical && ri < result.GetNodeCount(); ++ri)
+				{
+					indexedResultsIdentical = indexedResult.GetNodeAt(ri)->GetUniqueId() == result.GetNodeAt(ri)->GetUniqueId();
+				}
+
+				if (!indexedResultsIdentical)
+				{
+					std::cout << u8"Test Number " << testNumbers[i] << u8" failed using selector " << testSelectors[i] << u8" because the document parsed with a text index returned different results." << std::endl << std::endl;
+					++testsFailed;
+					continue;
+				}
+
 				if (result.GetNodeCount() != testExpectedMatches[i].second)
 				{
 					std::cout << u8"Test Number " << testNumbers[i] << u8" failed using selector " << testSelectors[i] << u8" because " << testExpectedMatches[i].second << u8" matches were expected, received " << result.GetNodeCount() << std::endl << std::endl;
@@ -224,6 +1262,105 @@ int main()
 		return -1;
 	}
 
+	if (RunConcurrentQueryStressTest(testSelectors, testHtmlSamples))
+	{
+		++testsPassed;
+	}
+	else
+	{
+		++testsFailed;
+	}
+
+	if (RunSelectorLiteralTest())
+	{
+		++testsPassed;
+	}
+	else
+	{
+		++testsFailed;
+	}
+
+	if (RunRegexTest())
+	{
+		++testsPassed;
+	}
+	else
+	{
+		++testsFailed;
+	}
+
+	if (RunContainsMatcherTest())
+	{
+		++testsPassed;
+	}
+	else
+	{
+		++testsFailed;
+	}
+
+	if (RunStringKernelsTest())
+	{
+		++testsPassed;
+	}
+	else
+	{
+		++testsFailed;
+	}
+
+	if (RunMutationChurnTest())
+	{
+		++testsPassed;
+	}
+	else
+	{
+		++testsFailed;
+	}
+
+	if (RunOutputSinkTest(testSelectors, testHtmlSamples))
+	{
+		++testsPassed;
+	}
+	else
+	{
+		++testsFailed;
+	}
+
+	if (RunDeclaredMutationTest(testSelectors, testHtmlSamples))
+	{
+		++testsPassed;
+	}
+	else
+	{
+		++testsFailed;
+	}
+
+	if (RunSourcePassthroughTest(testSelectors, testHtmlSamples))
+	{
+		++testsPassed;
+	}
+	else
+	{
+		++testsFailed;
+	}
+
+	if (RunFrozenMutationTest(testSelectors, testHtmlSamples))
+	{
+		++testsPassed;
+	}
+	else
+	{
+		++testsFailed;
+	}
+
+	if (RunParallelSerializeTest(testSelectors, testHtmlSamples))
+	{
+		++testsPassed;
+	}
+	else
+	{
+		++testsFailed;
+	}
+
 	std::cout << testsPassed << u8" Tests Passed and " << testsFailed << u8" Tests Failed." << std::endl;
 
     return 0;
@@ -28,6 +28,7 @@
 #include <Document.hpp>
 #include <Node.hpp>
 #include <Parser.hpp>
+#include <SelectorSet.hpp>
 #include <NodeMutationCollection.hpp>
 #include <Serializer.hpp>
 
@@ -166,6 +167,63 @@ int main()
 
 	std::cout << "Processed at a rate of " << (parsingBenchTime.count() / (selectors.size() * parseCount)) << u8" milliseconds per selector or " << ((selectors.size() * parseCount) / parsingBenchTime.count()) << u8" selectors per millisecond." << std::endl;
 
+	// _______________________________________________________________________________________________ //
+	// _______________________________________________________________________________________________ //
+
+	// Wrap the same selectors up as EasyList element hiding rules, with a comment and a network
+	// rule mixed in, and compile them in bulk. Every selector must come back, in order, with no
+	// diagnostics.
+	std::string ruleList(u8"[Adblock Plus 2.0]\n! Comment\n||example.com^$third-party\n");
+
+	for (size_t i = 0; i < selectors.size(); ++i)
+	{
+		ruleList.append(i % 2 == 0 ? u8"##" : u8"example.com,~foo.example.com##");
+		ruleList.append(selectors[i]);
+		ruleList.append(u8"\n");
+	}
+
+	std::cout << u8"Benchmarking bulk rule list compilation." << std::endl;
+
+	std::vector<gq::SelectorSet::Diagnostic> diagnostics;
+	gq::SelectorSet compiledSet;
+
+	auto bulkBenchStart = std::chrono::high_resolution_clock::now();
+
+	for (size_t t = 0; t < parseCount; ++t)
+	{
+		diagnostics.clear();
+		compiledSet = gq::SelectorSet::CompileRuleList(ruleList, diagnostics);
+	}
+
+	auto bulkBenchEnd = std::chrono::high_resolution_clock::now();
+
+	std::chrono::duration<double, std::milli> bulkBenchTime = bulkBenchEnd - bulkBenchStart;
+
+	for (auto& diagnostic : diagnostics)
+	{
+		std::cout << u8"Bulk compilation failed on line " << diagnostic.GetLineNumber() << u8": " << diagnostic.GetMessage() << std::endl;
+	}
+
+	if (diagnostics.size() > 0 || compiledSet.GetRuleCount() != selectors.size())
+	{
+		std::cout << u8"Bulk compilation produced " << compiledSet.GetRuleCount() << u8" of " << selectors.size() << u8" selectors." << std::endl;
+		return -1;
+	}
+
+	for (size_t i = 0; i < compiledSet.GetRuleCount(); ++i)
+	{
+		// Three leading lines, and line numbers start at one.
+		if (compiledSet.GetRuleAt(i).GetId() != i + 4)
+		{
+			std::cout << u8"Bulk compilation reported rule " << i << u8" on line " << compiledSet.GetRuleAt(i).GetId() << u8" rather than line " << (i + 4) << u8"." << std::endl;
+			return -1;
+		}
+	}
+
+	std::cout << "Time taken to bulk compile " << (selectors.size() * parseCount) << u8" selectors: " << bulkBenchTime.count() << " ms." << std::endl;
+
+	std::cout << "Processed at a rate of " << ((selectors.size() * parseCount) / bulkBenchTime.count()) << u8" selectors per millisecond." << std::endl;
+
 	// _______________________________________________________________________________________________ //
 	// _______________________________________________________________________________________________ //
 	
@@ -27,20 +27,20 @@
 * THE SOFTWARE.
 */
 
-#include <cstring>
 #include "AttributeSelector.hpp"
 #include <boost/algorithm/string.hpp>
 #include "Node.hpp"
 #include "Util.hpp"
 #include "SpecialTraits.hpp"
+#include "StringKernels.hpp"
+#include "CharClass.hpp"
 #include <iterator>
 
 namespace gq
 {
 	AttributeSelector::AttributeSelector(boost::string_ref key) :
 		m_operator(SelectorOperator::Exists),
-		m_attributeNameString(key.to_string()),
-		m_attributeNameRef(m_attributeNameString)
+		m_attributeNameRef(InternString(key))
 	{
 		if (m_attributeNameRef.size() == 0)
 		{
@@ -54,16 +54,31 @@ namespace gq
 		#endif
 
 		// Add attribute key as a match trait for EXISTS, specifying any ("*") as the value. 
-		AddMatchTrait(m_attributeNameRef, SpecialTraits::GetAnyValue());		
+		AddMatchTrait(m_attributeNameRef, SpecialTraits::GetAnyValue());
+		SetHasExactMatchTraits(true);
 	}
 
-	AttributeSelector::AttributeSelector(SelectorOperator op, boost::string_ref key, boost::string_ref value) :
+	AttributeSelector::AttributeSelector(SelectorOperator op, boost::string_ref key, boost::string_ref value, const bool caseInsensitive) :
 		m_operator(op),
-		m_attributeNameString(key.to_string()),
-		m_attributeNameRef(m_attributeNameString),
-		m_attributeValueString(value.to_string()),
-		m_attributeValueRef(m_attributeValueString)
+		m_attributeNameRef(InternString(key)),
+		m_caseInsensitive(caseInsensitive)
 	{
+		if (m_caseInsensitive)
+		{
+			std::string folded(value.begin(), value.end());
+
+			for (auto& c : folded)
+			{
+				c = CharClass::ToLower(c);
+			}
+
+			m_attributeValueRef = InternString(folded);
+		}
+		else
+		{
+			m_attributeValueRef = InternString(value);
+		}
+
 		if (m_attributeNameRef.size() == 0)
 		{
 			throw std::runtime_error(u8"In AttributeSelector::AttributeSelector(SelectorOperator, boost::string_ref, const bool) - Supplied attribute identifier has zero length.");
@@ -91,9 +106,31 @@ namespace gq
 		switch (m_operator)
 		{
 			case SelectorOperator::ValueEquals:
+			{
+				AddMatchTrait(m_attributeNameRef, m_attributeValueRef);
+
+				if (m_caseInsensitive)
+				{
+					// Values holding upper case letters are indexed in lower case under a key
+					// of their own, while all other values already are their lower case form.
+					AddMatchTrait(InternString(SpecialTraits::GetFoldedValueKey(m_attributeNameRef)), m_attributeValueRef);
+				}
+			}
+			break;
+
 			case SelectorOperator::ValueContainsElementInWhitespaceSeparatedList:
 			{
+				// Attribute values are indexed both whole and split on spaces, which is exactly
+				// what this operator matches against, so the trait is exact. The same goes for
+				// the lower case forms, when matching without regard to case.
 				AddMatchTrait(m_attributeNameRef, m_attributeValueRef);
+
+				if (m_caseInsensitive)
+				{
+					AddMatchTrait(InternString(SpecialTraits::GetFoldedValueKey(m_attributeNameRef)), m_attributeValueRef);
+				}
+
+				SetHasExactMatchTraits(true);
 			}
 			break;
 
@@ -137,7 +174,9 @@ namespace gq
 				}
 
 				// Just do a search
-				auto searchResult = attributeValue.find(m_attributeValueRef);
+				auto searchResult = m_caseInsensitive ?
+					StringKernels::FindIgnoreCase(attributeValue, m_attributeValueRef) :
+					StringKernels::Find(attributeValue, m_attributeValueRef);
 
 				// Simply return whether or not we got any matches.
 				if (searchResult != boost::string_ref::npos)
@@ -151,33 +190,14 @@ namespace gq
 			{
 				auto attributeValue = node->GetAttributeValue(m_attributeNameRef);
 
-				auto oneSize = attributeValue.size();
-				auto twoSize = m_attributeValueRef.size();
-
-				if (oneSize == 0 || oneSize != twoSize)
+				if (attributeValue.size() == 0)
 				{
 					return nullptr;
 				}
 
-				if (oneSize >= 4)
+				if (MatchesValue(attributeValue))
 				{
-					if ((attributeValue[0] == m_attributeValueRef[0]) &&
-						(attributeValue[1] == m_attributeValueRef[1]) &&
-						(attributeValue[oneSize - 1] == m_attributeValueRef[oneSize - 1]) &&
-						(attributeValue[oneSize - 2] == m_attributeValueRef[oneSize - 2]))
-					{
-						if (std::memcmp(attributeValue.begin(), m_attributeValueRef.begin(), oneSize) == 0)
-						{
-							return MatchResult(node);
-						}
-					}
-				}
-				else
-				{
-					if (std::memcmp(attributeValue.begin(), m_attributeValueRef.begin(), oneSize) == 0)
-					{
-						return MatchResult(node);
-					}
+					return MatchResult(node);
 				}
 
 				return nullptr;
@@ -197,30 +217,9 @@ namespace gq
 
 				auto sub = attributeValue.substr(0, subSize);
 
-				subSize = sub.size();
-
-				if (subSize == m_attributeValueRef.size())
+				if (MatchesValue(sub))
 				{
-					if (subSize >= 4)
-					{
-						if ((sub[0] == m_attributeValueRef[0]) &&
-							(sub[1] == m_attributeValueRef[1]) &&
-							(sub[subSize - 1] == m_attributeValueRef[subSize - 1]) &&
-							(sub[subSize - 2] == m_attributeValueRef[subSize - 2]))
-						{
-							if (std::memcmp(sub.begin(), m_attributeValueRef.begin(), subSize) == 0)
-							{
-								return MatchResult(node);
-							}
-						}
-					}
-					else
-					{
-						if (std::memcmp(sub.begin(), m_attributeValueRef.begin(), subSize) == 0)
-						{
-							return MatchResult(node);
-						}
-					}
+					return MatchResult(node);
 				}
 
 				return nullptr;
@@ -242,30 +241,9 @@ namespace gq
 				// Test equality of same-length substring taken from the end.
 				boost::string_ref sub = attributeValue.substr((attributeValue.size() - subSize));
 
-				subSize = sub.size();
-
-				if (subSize == m_attributeValueRef.size())
+				if (MatchesValue(sub))
 				{
-					if (subSize >= 4)
-					{
-						if ((sub[0] == m_attributeValueRef[0]) &&
-							(sub[1] == m_attributeValueRef[1]) &&
-							(sub[subSize - 1] == m_attributeValueRef[subSize - 1]) &&
-							(sub[subSize - 2] == m_attributeValueRef[subSize - 2]))
-						{
-							if (std::memcmp(sub.begin(), m_attributeValueRef.begin(), subSize) == 0)
-							{
-								return MatchResult(node);
-							}
-						}
-					}
-					else
-					{
-						if (std::memcmp(sub.begin(), m_attributeValueRef.begin(), subSize) == 0)
-						{
-							return MatchResult(node);
-						}
-					}
+					return MatchResult(node);
 				}
 
 				return nullptr;
@@ -289,29 +267,11 @@ namespace gq
 					// selector type. If they do not match, the only other possible type of match
 					// this operator can make is the match the selector value PLUS whitespace, in
 					// which case this isn't possible (being the two strings equal length), so
-					// letting boost::iequals return false or true is the right answer either way.
+					// letting the comparison return false or true is the right answer either way.
 
-					auto oneSize = attributeValue.size();
-
-					if (oneSize >= 4)
+					if (MatchesValue(attributeValue))
 					{
-						if ((attributeValue[0] == m_attributeValueRef[0]) && 
-							(attributeValue[1] == m_attributeValueRef[1]) &&
-							(attributeValue[oneSize - 1] == m_attributeValueRef[oneSize - 1]) &&
-							(attributeValue[oneSize - 2] == m_attributeValueRef[oneSize - 2]))
-						{
-							if (std::memcmp(attributeValue.begin(), m_attributeValueRef.begin(), oneSize) == 0)
-							{
-								return MatchResult(node);
-							}
-						}
-					}
-					else
-					{
-						if (std::memcmp(attributeValue.begin(), m_attributeValueRef.begin(), oneSize) == 0)
-						{
-							return MatchResult(node);
-						}
+						return MatchResult(node);
 					}
 
 					return nullptr;
@@ -334,30 +294,9 @@ namespace gq
 					{
 						auto sub = attributeValue.substr(0, firstSpace);
 
-						auto subSize = sub.size();
-
-						if (subSize == m_attributeValueRef.size())
+						if (MatchesValue(sub))
 						{
-							if (subSize >= 4)
-							{
-								if ((sub[0] == m_attributeValueRef[0]) &&
-									(sub[1] == m_attributeValueRef[1]) &&
-									(sub[subSize - 1] == m_attributeValueRef[subSize - 1]) &&
-									(sub[subSize - 2] == m_attributeValueRef[subSize - 2]))
-								{
-									if (std::memcmp(sub.begin(), m_attributeValueRef.begin(), subSize) == 0)
-									{
-										return MatchResult(node);
-									}
-								}
-							}
-							else
-							{
-								if (std::memcmp(sub.begin(), m_attributeValueRef.begin(), subSize) == 0)
-								{
-									return MatchResult(node);
-								}
-							}
+							return MatchResult(node);
 						}						
 					}
 
@@ -365,6 +304,12 @@ namespace gq
 					firstSpace = attributeValue.find(' ');
 				}
 
+				// Whatever follows the last space is the final entry in the list.
+				if (MatchesValue(attributeValue))
+				{
+					return MatchResult(node);
+				}
+
 				return nullptr;
 			}
 			break;
@@ -386,29 +331,11 @@ namespace gq
 					// selector type. If they do not match, the only other possible type of match
 					// this operator can make is the match the selector value PLUS a dash, in which
 					// case this isn't possible (being the two strings equal length), so letting
-					// boost::iequals return false or true is the right answer either way.
-
-					auto oneSize = attributeValue.size();
+					// the comparison return false or true is the right answer either way.
 
-					if (oneSize >= 4)
-					{
-						if ((attributeValue[0] == m_attributeValueRef[0]) &&
-							(attributeValue[1] == m_attributeValueRef[1]) &&
-							(attributeValue[oneSize - 1] == m_attributeValueRef[oneSize - 1]) &&
-							(attributeValue[oneSize - 2] == m_attributeValueRef[oneSize - 2]))
-						{
-							if (std::memcmp(attributeValue.begin(), m_attributeValueRef.begin(), oneSize) == 0)
-							{
-								return MatchResult(node);
-							}
-						}
-					}
-					else
+					if (MatchesValue(attributeValue))
 					{
-						if (std::memcmp(attributeValue.begin(), m_attributeValueRef.begin(), oneSize) == 0)
-						{
-							return MatchResult(node);
-						}
+						return MatchResult(node);
 					}
 
 					return nullptr;
@@ -437,30 +364,9 @@ namespace gq
 
 				sub = attributeValue.substr(0, m_attributeValueRef.size());
 
-				auto subSize = sub.size();
-
-				if (subSize == m_attributeValueRef.size())
+				if (MatchesValue(sub))
 				{
-					if (subSize >= 4)
-					{
-						if ((sub[0] == m_attributeValueRef[0]) &&
-							(sub[1] == m_attributeValueRef[1]) &&
-							(sub[subSize - 1] == m_attributeValueRef[subSize - 1]) &&
-							(sub[subSize - 2] == m_attributeValueRef[subSize - 2]))
-						{
-							if (std::memcmp(sub.begin(), m_attributeValueRef.begin(), subSize) == 0)
-							{
-								return MatchResult(node);
-							}
-						}
-					}
-					else
-					{
-						if (std::memcmp(sub.begin(), m_attributeValueRef.begin(), subSize) == 0)
-						{
-							return MatchResult(node);
-						}
-					}
+					return MatchResult(node);
 				}		
 
 				return nullptr;
@@ -471,4 +377,19 @@ namespace gq
 		return nullptr;
 	}
 
+	const bool AttributeSelector::IsCaseInsensitive() const
+	{
+		return m_caseInsensitive;
+	}
+
+	const bool AttributeSelector::MatchesValue(boost::string_ref attributeValue) const
+	{
+		if (m_caseInsensitive)
+		{
+			return StringKernels::EqualsIgnoreCase(attributeValue, m_attributeValueRef);
+		}
+
+		return StringKernels::Equals(attributeValue, m_attributeValueRef);
+	}
+
 } /* namespace gq */
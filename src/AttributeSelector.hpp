@@ -42,6 +42,12 @@ namespace gq
 	class AttributeSelector final : public Selector
 	{
 
+		// So that compiled selectors can be written to and read back from the binary format.
+		friend class SelectorCodec;
+
+		// So that equivalent compiled selectors can be recognized and merged.
+		friend class SelectorCanonicalizer;
+
 	public:
 
 		/// <summary>
@@ -117,7 +123,11 @@ namespace gq
 		/// <param name="value">
 		/// The attribute value to match. 
 		/// </param>
-		AttributeSelector(SelectorOperator op, boost::string_ref key, boost::string_ref value);
+		/// <param name="caseInsensitive">
+		/// Whether or not ASCII letters in the value are matched without regard to case, as with
+		/// the "i" flag in [key=value i].
+		/// </param>
+		AttributeSelector(SelectorOperator op, boost::string_ref key, boost::string_ref value, const bool caseInsensitive = false);
 
 		/// <summary>
 		/// Default destructor.
@@ -136,8 +146,28 @@ namespace gq
 		/// </returns>
 		virtual const MatchResult Match(const Node* node) const;		
 
+		/// <summary>
+		/// Gets whether or not ASCII letters in the value are matched without regard to case.
+		/// </summary>
+		/// <returns>
+		/// True if the value is matched without regard to case, false otherwise.
+		/// </returns>
+		const bool IsCaseInsensitive() const;
+
 	private:
 
+		/// <summary>
+		/// Compares an attribute value, or part of one, to the value of this selector, with or
+		/// without regard to case as configured.
+		/// </summary>
+		/// <param name="attributeValue">
+		/// The attribute value, or part of it, to compare.
+		/// </param>
+		/// <returns>
+		/// True if the supplied value equals the value of this selector, false otherwise.
+		/// </returns>
+		const bool MatchesValue(boost::string_ref attributeValue) const;
+
 		/// <summary>
 		/// Defines how the matching in this selector will work. Based on the option, the attribute
 		/// name and value to be matched will be matched in different ways. See comments in the
@@ -146,24 +176,20 @@ namespace gq
 		SelectorOperator m_operator;
 
 		/// <summary>
-		/// The name of the attribute to search for.
-		/// </summary>
-		std::string m_attributeNameString;
-
-		/// <summary>
-		/// A string_ref wrapper for m_attributeName.
+		/// The name of the attribute to search for, stored in the arena of this selector.
 		/// </summary>
 		boost::string_ref m_attributeNameRef;
 
 		/// <summary>
-		/// The attribute value to match.
+		/// The attribute value to match, stored in the arena of this selector. When matching
+		/// without regard to case, this holds the ASCII lower case form of the value.
 		/// </summary>
-		std::string m_attributeValueString;
+		boost::string_ref m_attributeValueRef;
 
 		/// <summary>
-		/// A string_ref wrapper for m_attributeValueRef.
+		/// Whether or not ASCII letters in the value are matched without regard to case.
 		/// </summary>
-		boost::string_ref m_attributeValueRef;
+		bool m_caseInsensitive = false;
 
 	};
 
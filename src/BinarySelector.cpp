@@ -29,10 +29,24 @@
 
 #include "BinarySelector.hpp"
 #include "Node.hpp"
+#include "SpecialTraits.hpp"
 
 namespace gq
 {
 
+	thread_local BinarySelector::SiblingMatchScope* BinarySelector::SiblingMatchScope::s_current = nullptr;
+
+	BinarySelector::SiblingMatchScope::SiblingMatchScope() :
+		m_previous(s_current)
+	{
+		s_current = this;
+	}
+
+	BinarySelector::SiblingMatchScope::~SiblingMatchScope()
+	{
+		s_current = m_previous;
+	}
+
 	BinarySelector::BinarySelector(SelectorOperator op, SharedSelector left, SharedSelector right) :
 		m_leftHandSide(std::move(left)), m_rightHandSide(std::move(right)), m_operator(op)
 	{
@@ -66,47 +80,49 @@ namespace gq
 		{
 			case SelectorOperator::Sibling:
 			case SelectorOperator::Adjacent:
-			{
-				// We match the left hand side first, so lets take on its traits alone.
-				auto& lhst = m_leftHandSide->GetMatchTraits();
-
-				for (auto& tp : lhst)
-				{
-					AddMatchTrait(tp.first, tp.second);
-				}
-			}
-			break;
-
 			case SelectorOperator::Descendant:
 			case SelectorOperator::Child:
 			{
-				// We match the right hand side first, so lets take on its traits alone.
-				auto& rhst = m_rightHandSide->GetMatchTraits();
-
-				for (auto& tp : rhst)
-				{
-					AddMatchTrait(tp.first, tp.second);
-				}
+				// We match the right hand side first, so lets take on its traits alone. The same
+				// goes for exclusions, since the right hand side is what must match the node.
+				AddMatchTraits(m_rightHandSide->GetMatchTraits());
+				AddExclusionTraits(m_rightHandSide->GetExclusionTraits());
 			}
 			break;
 
-			case SelectorOperator::Union:
 			case SelectorOperator::Intersection:
 			{
-				// Both traits need to match the same object, so we'll take on both traits. In the
-				// case of union, either can match, so again, take on both.
 				auto& lhst = m_leftHandSide->GetMatchTraits();
 				auto& rhst = m_rightHandSide->GetMatchTraits();
-				
-				for (auto& tp : lhst)
+
+				// Both sides must match the same object, so the candidates of either side alone
+				// are sufficient. When one side can only offer every element in scope, as dummy
+				// and :not(...) selectors do, we take on the traits of the other side alone.
+				// Otherwise we take on both, as we can't know ahead of time which is smaller.
+				bool lhsIsAny = IsAnyElementTraits(lhst) && rhst.size() > 0;
+				bool rhsIsAny = IsAnyElementTraits(rhst) && lhst.size() > 0;
+
+				if (!lhsIsAny || rhsIsAny)
 				{
-					AddMatchTrait(tp.first, tp.second);
+					AddMatchTraits(lhst);
 				}
 
-				for (auto& tp : rhst)
+				if (!rhsIsAny || lhsIsAny)
 				{
-					AddMatchTrait(tp.first, tp.second);
+					AddMatchTraits(rhst);
 				}
+
+				// A node that either side can never match can never match the intersection.
+				AddExclusionTraits(m_leftHandSide->GetExclusionTraits());
+				AddExclusionTraits(m_rightHandSide->GetExclusionTraits());
+			}
+			break;
+
+			case SelectorOperator::Union:
+			{
+				// Either side can match, so take on both traits.
+				AddMatchTraits(m_leftHandSide->GetMatchTraits());
+				AddMatchTraits(m_rightHandSide->GetMatchTraits());
 			}
 			break;
 		}
@@ -226,14 +242,7 @@ namespace gq
 
 				if (node->GetIndexWithinParent() == 0)
 				{
-					// Adjacent right hand side must immediately follow the left hand side element.
-					return nullptr;
-				}
-
-				// Can't possibly have an adjacent sibling match without two children.
-				if (parent->GetNumChildren() < 2)
-				{
-					// If there is only 1 child, then we cannot possibly match adjacent nodes.
+					// The first child has no preceding siblings for the left hand side to match.
 					return nullptr;
 				}
 
@@ -244,21 +253,11 @@ namespace gq
 					return nullptr;
 				}
 
-				auto numChildren = parent->GetNumChildren();
-				
-				for (size_t i = 0; i < numChildren; ++i)
+				// Only siblings that precede the node can satisfy the left hand side, so all we
+				// need to know is whether or not the first left hand match comes before us.
+				if (GetFirstLeftHandMatchIndex(parent, node->GetIndexWithinParent()) < node->GetIndexWithinParent())
 				{
-					if (i == node->GetIndexWithinParent())
-					{
-						continue;
-					}
-
-					auto sibling = parent->GetChildAt(i);
-
-					if (m_leftHandSide->Match(sibling))
-					{
-						return rhsResult;
-					}
+					return rhsResult;
 				}
 
 				return nullptr;
@@ -288,4 +287,52 @@ namespace gq
 		return nullptr;
 	}
 
+	const bool BinarySelector::IsAnyElementTraits(const TraitCollection& traits)
+	{
+		return traits.size() == 1 && traits[0].first == SpecialTraits::GetTagKey() && traits[0].second == SpecialTraits::GetAnyValue();
+	}
+
+	const size_t BinarySelector::GetFirstLeftHandMatchIndex(const Node* parent, const size_t limit) const
+	{
+		auto* scope = SiblingMatchScope::s_current;
+
+		if (scope == nullptr)
+		{
+			// Nothing to cache into, so just scan the preceding siblings.
+			for (size_t i = 0; i < limit; ++i)
+			{
+				if (m_leftHandSide->Match(parent->GetChildAt(i)))
+				{
+					return i;
+				}
+			}
+
+			return limit;
+		}
+
+		auto key = SiblingMatchScope::CacheKey(this, parent);
+		auto cached = scope->m_firstMatchIndices.find(key);
+
+		if (cached != scope->m_firstMatchIndices.end())
+		{
+			return cached->second;
+		}
+
+		auto numChildren = parent->GetNumChildren();
+		size_t firstMatchIndex = numChildren;
+
+		for (size_t i = 0; i < numChildren; ++i)
+		{
+			if (m_leftHandSide->Match(parent->GetChildAt(i)))
+			{
+				firstMatchIndex = i;
+				break;
+			}
+		}
+
+		scope->m_firstMatchIndices.insert({ key, firstMatchIndex });
+
+		return firstMatchIndex;
+	}
+
 } /* namespace gq */
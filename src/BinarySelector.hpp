@@ -29,6 +29,8 @@
 #pragma once
 
 #include "Selector.hpp"
+#include <unordered_map>
+#include <boost/functional/hash.hpp>
 
 namespace gq
 {
@@ -40,6 +42,15 @@ namespace gq
 	class BinarySelector final : public Selector
 	{
 
+		// So that compiled selectors can be written to and read back from the binary format.
+		friend class SelectorCodec;
+
+		// So that equivalent compiled selectors can be recognized and merged.
+		friend class SelectorCanonicalizer;
+
+		// So that the text selectors within can be found.
+		friend class ContainsMatcher;
+
 	public:
 
 		enum class SelectorOperator
@@ -87,16 +98,71 @@ namespace gq
 			Adjacent,
 
 			/// <summary>
-			/// Requires that the left hand side and the right hand side both match nodes that have
-			/// the same parent. Unlike the adjacent selector, the two matched nodes can be adjacent
-			/// to one another, or they may not be. So long as they both share the same parent, it
-			/// is a match. If a match is found for both sides and the matched nodes share the same
-			/// parent, then the sibling selector will declare a match. If one or more sides do not
-			/// match, then the sibling selector declares no match.
+			/// Requires that the left hand side match a node that precedes the node matched by the
+			/// right hand side, both sharing the same parent. Unlike the adjacent selector, the two
+			/// matched nodes can be adjacent to one another, or they may not be. So long as the
+			/// left hand side matches any preceding sibling of the node matched by the right hand
+			/// side, the sibling selector will declare a match. Siblings that follow the right
+			/// hand side node are never considered.
 			/// </summary>
 			Sibling
 		};
 
+		/// <summary>
+		/// While an instance of this class is alive on a thread, every sibling selector evaluated
+		/// on that same thread records, per parent node, the index of the first child that its
+		/// left hand side matched. This means that all of the children of a parent are only ever
+		/// tested against the left hand side once, after which every candidate sibling is
+		/// resolved in constant time by comparing its own index against the recorded one.
+		/// <para>&#160;</para>
+		/// Node::Find(...) and Node::Each(...) open a scope for the duration of their search, so
+		/// the cached indices can never outlive the document they were computed against. Scopes
+		/// nest, and each nested scope starts out with an empty cache. Outside of any scope,
+		/// sibling selectors fall back to scanning the preceding siblings of the candidate.
+		/// </summary>
+		class SiblingMatchScope
+		{
+
+			friend class BinarySelector;
+
+		public:
+
+			/// <summary>
+			/// Opens a new scope on the calling thread. 
+			/// </summary>
+			SiblingMatchScope();
+
+			/// <summary>
+			/// Closes this scope, restoring whatever scope was previously open on the calling
+			/// thread, if any.
+			/// </summary>
+			~SiblingMatchScope();
+
+			SiblingMatchScope(const SiblingMatchScope&) = delete;
+			SiblingMatchScope& operator=(const SiblingMatchScope&) = delete;
+
+		private:
+
+			typedef std::pair<const BinarySelector*, const Node*> CacheKey;
+
+			/// <summary>
+			/// The scope that was open on this thread when this scope was opened. 
+			/// </summary>
+			SiblingMatchScope* m_previous;
+
+			/// <summary>
+			/// Maps a sibling selector and a parent node to the index of the first child of that
+			/// parent which is matched by the left hand side of the selector. If no child matched,
+			/// the stored index is equal to the number of children of the parent.
+			/// </summary>
+			std::unordered_map<CacheKey, size_t, boost::hash<CacheKey> > m_firstMatchIndices;
+
+			/// <summary>
+			/// The scope presently open on the calling thread. Will be nullptr if there is none.
+			/// </summary>
+			static thread_local SiblingMatchScope* s_current;
+		};
+
 		/// <summary>
 		/// Constructs a binary selector with a left hand and right hand side, the two selectors
 		/// linked to one another by the supplied operator. For example, if the operator is
@@ -152,6 +218,36 @@ namespace gq
 		/// match is determined.
 		/// </summary>
 		SelectorOperator m_operator;
+
+		/// <summary>
+		/// Gets the index of the first child of the supplied parent that is matched by the left
+		/// hand side of this selector. If none of the children are matched, the number of
+		/// children of the parent is returned.
+		/// </summary>
+		/// <param name="parent">
+		/// The parent whose children should be tested against the left hand side. 
+		/// </param>
+		/// <param name="limit">
+		/// The index at which searching can stop, when the result is not going to be cached. If
+		/// the result of the search will be cached, this value is ignored and all children are
+		/// searched.
+		/// </param>
+		/// <returns>
+		/// The index of the first child matched by the left hand side.
+		/// </returns>
+		const size_t GetFirstLeftHandMatchIndex(const Node* parent, const size_t limit) const;
+
+		/// <summary>
+		/// Determines if the supplied traits consist solely of the trait that finds every element
+		/// in scope, as is the case with dummy and :not(...) selectors.
+		/// </summary>
+		/// <param name="traits">
+		/// The match traits to inspect.
+		/// </param>
+		/// <returns>
+		/// True if the supplied traits will yield every element in scope, false otherwise.
+		/// </returns>
+		static const bool IsAnyElementTraits(const TraitCollection& traits);
 	};
 
 } /* namespace gq */
@@ -0,0 +1,279 @@
+/*
+* Copyright (c) 2015 Jesse Nicholson
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <utility>
+#include <boost/utility/string_ref.hpp>
+
+namespace gq
+{
+
+	/// <summary>
+	/// CharClass provides locale independent character classification and ASCII case folding for
+	/// the selector parser. Every query is a single lookup into a 256 entry table which is built at
+	/// compile time, so classifying a character costs no more than an array access and there is no
+	/// std::locale to construct, copy or consult. Per the CSS syntax specification, every byte at or
+	/// above 0x80 is treated as a name character, which lets UTF-8 encoded identifiers through
+	/// intact.
+	/// </summary>
+	class CharClass
+	{
+
+		// So that selector literals can be classified while they are validated at compile time.
+		friend class SelectorLiteral;
+
+	public:
+
+		/// <summary>
+		/// Checks if the supplied character may begin a CSS identifier.
+		/// </summary>
+		/// <param name="c">
+		/// The character to classify.
+		/// </param>
+		/// <returns>
+		/// True if the supplied character may begin an identifier, false otherwise.
+		/// </returns>
+		static bool IsNameStart(const char c)
+		{
+			return (Table[static_cast<unsigned char>(c)] & NameStart) != 0;
+		}
+
+		/// <summary>
+		/// Checks if the supplied character may appear within a CSS identifier.
+		/// </summary>
+		/// <param name="c">
+		/// The character to classify.
+		/// </param>
+		/// <returns>
+		/// True if the supplied character may appear within an identifier, false otherwise.
+		/// </returns>
+		static bool IsNameChar(const char c)
+		{
+			return (Table[static_cast<unsigned char>(c)] & NameChar) != 0;
+		}
+
+		/// <summary>
+		/// Checks if the supplied character is an ASCII letter.
+		/// </summary>
+		/// <param name="c">
+		/// The character to classify.
+		/// </param>
+		/// <returns>
+		/// True if the supplied character is an ASCII letter, false otherwise.
+		/// </returns>
+		static bool IsAlpha(const char c)
+		{
+			return (Table[static_cast<unsigned char>(c)] & Alpha) != 0;
+		}
+
+		/// <summary>
+		/// Checks if the supplied character is a decimal digit.
+		/// </summary>
+		/// <param name="c">
+		/// The character to classify.
+		/// </param>
+		/// <returns>
+		/// True if the supplied character is a decimal digit, false otherwise.
+		/// </returns>
+		static bool IsDigit(const char c)
+		{
+			return (Table[static_cast<unsigned char>(c)] & Digit) != 0;
+		}
+
+		/// <summary>
+		/// Checks if the supplied character is a hexadecimal digit.
+		/// </summary>
+		/// <param name="c">
+		/// The character to classify.
+		/// </param>
+		/// <returns>
+		/// True if the supplied character is a hexadecimal digit, false otherwise.
+		/// </returns>
+		static bool IsHexDigit(const char c)
+		{
+			return (Table[static_cast<unsigned char>(c)] & HexDigit) != 0;
+		}
+
+		/// <summary>
+		/// Checks if the supplied character is whitespace. This is the same set of characters as
+		/// std::isspace in the "C" locale.
+		/// </summary>
+		/// <param name="c">
+		/// The character to classify.
+		/// </param>
+		/// <returns>
+		/// True if the supplied character is whitespace, false otherwise.
+		/// </returns>
+		static bool IsWhitespace(const char c)
+		{
+			return (Table[static_cast<unsigned char>(c)] & Whitespace) != 0;
+		}
+
+		/// <summary>
+		/// Checks if the supplied character is a CSS selector combinator.
+		/// </summary>
+		/// <param name="c">
+		/// The character to classify.
+		/// </param>
+		/// <returns>
+		/// True if the supplied character is a combinator, false otherwise.
+		/// </returns>
+		static bool IsCombinator(const char c)
+		{
+			return (Table[static_cast<unsigned char>(c)] & Combinator) != 0;
+		}
+
+		/// <summary>
+		/// Check if the supplied character is a "special" character in CSS selectors. Not
+		/// necessarily a complete list. This is used to determine if certain escaped characters
+		/// found in identifiers are valid escaped characters, aka special characters escaped that
+		/// are commonly found in selector identifiers. For example, ":" can appear in divs.
+		/// </summary>
+		/// <param name="c">
+		/// The character to classify.
+		/// </param>
+		/// <returns>
+		/// True if the supplied character is special, false otherwise.
+		/// </returns>
+		static bool IsSpecial(const char c)
+		{
+			return (Table[static_cast<unsigned char>(c)] & Special) != 0;
+		}
+
+		/// <summary>
+		/// Folds the supplied character to ASCII lower case. All other characters are returned
+		/// unmodified.
+		/// </summary>
+		/// <param name="c">
+		/// The character to fold.
+		/// </param>
+		/// <returns>
+		/// The lower case equivalent of the supplied character.
+		/// </returns>
+		static char ToLower(const char c)
+		{
+			return static_cast<char>(LowerTable[static_cast<unsigned char>(c)]);
+		}
+
+		/// <summary>
+		/// Compares the supplied string against a string that is already in lower case, folding
+		/// the supplied string to ASCII lower case as it is compared. No copies are made.
+		/// </summary>
+		/// <param name="str">
+		/// The string to compare, in any case.
+		/// </param>
+		/// <param name="lowerCase">
+		/// The lower case string to compare against.
+		/// </param>
+		/// <returns>
+		/// True if the strings are equal when ignoring ASCII case, false otherwise.
+		/// </returns>
+		static bool EqualsLowerCase(boost::string_ref str, boost::string_ref lowerCase)
+		{
+			if (str.size() != lowerCase.size())
+			{
+				return false;
+			}
+
+			for (size_t i = 0; i < str.size(); ++i)
+			{
+				if (ToLower(str[i]) != lowerCase[i])
+				{
+					return false;
+				}
+			}
+
+			return true;
+		}
+
+	private:
+
+		/// <summary>
+		/// Bit flags stored in the classification table.
+		/// </summary>
+		enum Flags : uint8_t
+		{
+			NameStart = 1 << 0,
+			NameChar = 1 << 1,
+			Alpha = 1 << 2,
+			Digit = 1 << 3,
+			HexDigit = 1 << 4,
+			Whitespace = 1 << 5,
+			Combinator = 1 << 6,
+			Special = 1 << 7
+		};
+
+		/// <summary>
+		/// Computes the classification flags for a single character. This is only ever evaluated
+		/// at compile time, when building ::Table.
+		/// </summary>
+		static constexpr uint8_t Classify(const unsigned int c)
+		{
+			return static_cast<uint8_t>(
+				(((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')) ? (Alpha | NameStart | NameChar) : 0) |
+				((c == '_' || c >= 0x80) ? (NameStart | NameChar) : 0) |
+				(c == '-' ? NameChar : 0) |
+				((c >= '0' && c <= '9') ? (Digit | HexDigit | NameChar) : 0) |
+				(((c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F')) ? HexDigit : 0) |
+				((c == ' ' || (c >= '\t' && c <= '\r')) ? Whitespace : 0) |
+				((c == ' ' || c == '~' || c == '>' || c == '+') ? Combinator : 0) |
+				((c == ' ' || c == '~' || c == '>' || c == '+' || c == ':' || c == '|' || c == '*' || c == ';' || c == '&' || c == ',') ? Special : 0)
+				);
+		}
+
+		/// <summary>
+		/// Computes the ASCII lower case equivalent of a single character. This is only ever
+		/// evaluated at compile time, when building ::LowerTable.
+		/// </summary>
+		static constexpr uint8_t Lower(const unsigned int c)
+		{
+			return static_cast<uint8_t>((c >= 'A' && c <= 'Z') ? (c + ('a' - 'A')) : c);
+		}
+
+		template<size_t... I>
+		static constexpr std::array<uint8_t, 256> BuildTable(std::index_sequence<I...>)
+		{
+			return std::array<uint8_t, 256>{ { Classify(I)... } };
+		}
+
+		template<size_t... I>
+		static constexpr std::array<uint8_t, 256> BuildLowerTable(std::index_sequence<I...>)
+		{
+			return std::array<uint8_t, 256>{ { Lower(I)... } };
+		}
+
+		/// <summary>
+		/// Classification flags for every possible byte value.
+		/// </summary>
+		static const std::array<uint8_t, 256> Table;
+
+		/// <summary>
+		/// ASCII lower case equivalents for every possible byte value.
+		/// </summary>
+		static const std::array<uint8_t, 256> LowerTable;
+
+	};
+
+} /* namespace gq */
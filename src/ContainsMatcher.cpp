@@ -0,0 +1,342 @@
+/*
+* Copyright (c) 2015 Jesse Nicholson
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+
+#include "ContainsMatcher.hpp"
+#include "BinarySelector.hpp"
+#include "Node.hpp"
+#include "TextSelector.hpp"
+#include "UnarySelector.hpp"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+namespace gq
+{
+
+	thread_local ContainsMatcher::Scope* ContainsMatcher::Scope::s_current = nullptr;
+
+	const uint32_t ContainsMatcher::None = std::numeric_limits<uint32_t>::max();
+
+	ContainsMatcher::Scope::Scope(const ContainsMatcher& matcher, const Node& root) :
+		m_matcher(matcher), m_previous(s_current), m_wordCount((matcher.m_patternLengths.size() + 63) / 64)
+	{
+		s_current = this;
+
+		if (root.m_node == nullptr || root.m_node->type != GUMBO_NODE_ELEMENT || m_wordCount == 0)
+		{
+			return;
+		}
+
+		// An element that is still open, along with where its text began within the text of
+		// the root, and the automaton state over the text of its direct children alone.
+		struct OpenElement
+		{
+			const GumboNode* node;
+			unsigned int nextChild;
+			size_t index;
+			size_t textStart;
+			uint32_t ownState;
+		};
+
+		std::vector<OpenElement> open;
+		open.push_back({ root.m_node, 0, AddElement(root.m_node), 0, 0 });
+
+		size_t offset = 0;
+		uint32_t state = 0;
+
+		// The tree is walked without recursion, in the same order that Util::NodeText(...)
+		// writes text, so the text of every element is one contiguous run of the text of the
+		// root. A needle is recorded against the innermost open element that its whole run falls
+		// within, and passed up to each parent as its children close.
+		while (open.size() > 0)
+		{
+			auto& top = open.back();
+			const GumboVector* children = &top.node->v.element.children;
+
+			if (top.nextChild >= children->length)
+			{
+				if (open.size() > 1)
+				{
+					const uint64_t* from = &m_found[top.index * 2 * m_wordCount];
+					uint64_t* to = &m_found[open[open.size() - 2].index * 2 * m_wordCount];
+
+					for (size_t i = 0; i < m_wordCount; ++i)
+					{
+						to[i] |= from[i];
+					}
+				}
+
+				open.pop_back();
+				continue;
+			}
+
+			const GumboNode* child = static_cast<const GumboNode*>(children->data[top.nextChild++]);
+
+			if (child->type == GUMBO_NODE_ELEMENT)
+			{
+				const size_t index = AddElement(child);
+				open.push_back({ child, 0, index, offset, 0 });
+				continue;
+			}
+
+			if (child->type != GUMBO_NODE_TEXT)
+			{
+				continue;
+			}
+
+			const char* text = child->v.text.text;
+			const size_t length = std::strlen(text);
+			const size_t ownOffset = top.index * 2 * m_wordCount + m_wordCount;
+
+			for (size_t i = 0; i < length; ++i)
+			{
+				const unsigned char c = static_cast<unsigned char>(text[i]);
+
+				state = matcher.Next(state, c);
+				top.ownState = matcher.Next(top.ownState, c);
+				++offset;
+
+				for (uint32_t output = matcher.m_patternAt[state] != None ? state : matcher.m_outputLinks[state]; output != None; output = matcher.m_outputLinks[output])
+				{
+					const uint32_t pattern = matcher.m_patternAt[output];
+					const size_t patternStart = offset - matcher.m_patternLengths[pattern];
+
+					auto innermost = std::upper_bound(open.begin(), open.end(), patternStart, [](const size_t start, const OpenElement& element)
+					{
+						return start < element.textStart;
+					});
+
+					SetFound((innermost - 1)->index * 2 * m_wordCount, pattern);
+				}
+
+				for (uint32_t output = matcher.m_patternAt[top.ownState] != None ? top.ownState : matcher.m_outputLinks[top.ownState]; output != None; output = matcher.m_outputLinks[output])
+				{
+					SetFound(ownOffset, matcher.m_patternAt[output]);
+				}
+			}
+		}
+	}
+
+	ContainsMatcher::Scope::~Scope()
+	{
+		s_current = m_previous;
+	}
+
+	const size_t ContainsMatcher::Scope::AddElement(const GumboNode* element)
+	{
+		const size_t index = m_elementIndices.size();
+		m_elementIndices.emplace(element, index);
+		m_found.resize(m_found.size() + (2 * m_wordCount), 0);
+		return index;
+	}
+
+	void ContainsMatcher::Scope::SetFound(const size_t bitsetOffset, const uint32_t pattern)
+	{
+		m_found[bitsetOffset + (pattern / 64)] |= static_cast<uint64_t>(1) << (pattern % 64);
+	}
+
+	ContainsMatcher::ContainsMatcher(const std::vector<SharedSelector>& selectors) :
+		m_classCount(1)
+	{
+		std::unordered_set<const Selector*> visited;
+		std::unordered_map<std::string, uint32_t> patternIds;
+		std::vector<std::string> patterns;
+
+		for (const auto& selector : selectors)
+		{
+			AddNeedles(selector.get(), visited, patternIds, patterns);
+		}
+
+		Build(patterns);
+	}
+
+	ContainsMatcher::~ContainsMatcher()
+	{
+
+	}
+
+	const size_t ContainsMatcher::GetPatternCount() const
+	{
+		return m_patternLengths.size();
+	}
+
+	const bool ContainsMatcher::Lookup(const TextSelector* selector, const Node* node, const bool own, bool& found)
+	{
+		const Scope* scope = Scope::s_current;
+
+		if (scope == nullptr)
+		{
+			return false;
+		}
+
+		auto pattern = scope->m_matcher.m_patternIds.find(selector);
+
+		if (pattern == scope->m_matcher.m_patternIds.end())
+		{
+			return false;
+		}
+
+		auto element = scope->m_elementIndices.find(node->m_node);
+
+		if (element == scope->m_elementIndices.end())
+		{
+			return false;
+		}
+
+		const size_t word = (element->second * 2 * scope->m_wordCount) + (own ? scope->m_wordCount : 0) + (pattern->second / 64);
+
+		found = (scope->m_found[word] & (static_cast<uint64_t>(1) << (pattern->second % 64))) != 0;
+
+		return true;
+	}
+
+	void ContainsMatcher::AddNeedles(const Selector* selector, std::unordered_set<const Selector*>& visited, std::unordered_map<std::string, uint32_t>& patternIds, std::vector<std::string>& patterns)
+	{
+		// Compiled selectors share sub-trees, which only need to be looked at once.
+		if (selector == nullptr || !visited.insert(selector).second)
+		{
+			return;
+		}
+
+		if (auto binary = dynamic_cast<const BinarySelector*>(selector))
+		{
+			AddNeedles(binary->m_leftHandSide.get(), visited, patternIds, patterns);
+			AddNeedles(binary->m_rightHandSide.get(), visited, patternIds, patterns);
+		}
+		else if (auto unary = dynamic_cast<const UnarySelector*>(selector))
+		{
+			AddNeedles(unary->m_selector.get(), visited, patternIds, patterns);
+		}
+		else if (auto text = dynamic_cast<const TextSelector*>(selector))
+		{
+			if (text->m_operator != TextSelector::SelectorOperator::Contains && text->m_operator != TextSelector::SelectorOperator::ContainsOwn)
+			{
+				return;
+			}
+
+			auto inserted = patternIds.emplace(text->m_textToMatchStrRef.to_string(), static_cast<uint32_t>(patterns.size()));
+
+			if (inserted.second)
+			{
+				patterns.push_back(inserted.first->first);
+			}
+
+			m_patternIds.emplace(text, inserted.first->second);
+		}
+	}
+
+	void ContainsMatcher::Build(const std::vector<std::string>& patterns)
+	{
+		std::fill(std::begin(m_byteClasses), std::end(m_byteClasses), static_cast<uint16_t>(0));
+
+		for (const auto& pattern : patterns)
+		{
+			for (const char c : pattern)
+			{
+				auto& byteClass = m_byteClasses[static_cast<unsigned char>(c)];
+
+				if (byteClass == 0)
+				{
+					byteClass = static_cast<uint16_t>(m_classCount++);
+				}
+			}
+		}
+
+		// Build the trie over the needles, with every missing transition marked.
+		m_transitions.assign(m_classCount, None);
+		m_patternAt.assign(1, None);
+
+		for (size_t i = 0; i < patterns.size(); ++i)
+		{
+			uint32_t state = 0;
+
+			for (const char c : patterns[i])
+			{
+				const size_t slot = (state * m_classCount) + m_byteClasses[static_cast<unsigned char>(c)];
+
+				if (m_transitions[slot] == None)
+				{
+					m_transitions[slot] = static_cast<uint32_t>(m_patternAt.size());
+					m_transitions.resize(m_transitions.size() + m_classCount, None);
+					m_patternAt.push_back(None);
+				}
+
+				state = m_transitions[slot];
+			}
+
+			m_patternAt[state] = static_cast<uint32_t>(i);
+			m_patternLengths.push_back(patterns[i].size());
+		}
+
+		// Fill in the failure transitions breadth first, so the failure state of every state is
+		// complete before the state itself is reached. Missing transitions out of the root lead
+		// back to the root.
+		std::vector<uint32_t> failures(m_patternAt.size(), 0);
+		m_outputLinks.assign(m_patternAt.size(), None);
+
+		std::vector<uint32_t> queue;
+		queue.reserve(m_patternAt.size());
+
+		for (size_t c = 0; c < m_classCount; ++c)
+		{
+			if (m_transitions[c] == None)
+			{
+				m_transitions[c] = 0;
+			}
+			else
+			{
+				queue.push_back(m_transitions[c]);
+			}
+		}
+
+		for (size_t next = 0; next < queue.size(); ++next)
+		{
+			const uint32_t state = queue[next];
+			const uint32_t failure = failures[state];
+
+			m_outputLinks[state] = m_patternAt[failure] != None ? failure : m_outputLinks[failure];
+
+			for (size_t c = 0; c < m_classCount; ++c)
+			{
+				uint32_t& target = m_transitions[(state * m_classCount) + c];
+				const uint32_t failureTarget = m_transitions[(failure * m_classCount) + c];
+
+				if (target == None)
+				{
+					target = failureTarget;
+				}
+				else
+				{
+					failures[target] = failureTarget;
+					queue.push_back(target);
+				}
+			}
+		}
+	}
+
+	const uint32_t ContainsMatcher::Next(const uint32_t state, const unsigned char c) const
+	{
+		return m_transitions[(state * m_classCount) + m_byteClasses[c]];
+	}
+
+} /* namespace gq */
@@ -0,0 +1,244 @@
+/*
+* Copyright (c) 2015 Jesse Nicholson
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+
+#pragma once
+
+#include "Selector.hpp"
+#include <gumbo.h>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace gq
+{
+
+	class Node;
+	class TextSelector;
+
+	/// <summary>
+	/// The ContainsMatcher finds the needles of every :contains(...) and :containsOwn(...)
+	/// selector within a group of selectors in a single pass over the text of a document, using
+	/// an Aho-Corasick automaton built over all of the needles at once. Without it, each text
+	/// selector searches the text of every node it is tried against on its own, so the cost of
+	/// text matching grows with the number of rules rather than the size of the text.
+	/// <para>&#160;</para>
+	/// The matcher itself only holds the automaton, and is immutable once built. The needles
+	/// found within each element of a document are recorded by a Scope, which is opened on the
+	/// calling thread for the duration of a search. While a scope is open, the text selectors
+	/// the matcher was built from answer from the scope rather than searching the text.
+	/// </summary>
+	class ContainsMatcher
+	{
+
+	public:
+
+		/// <summary>
+		/// The Scope records which needles are found in the text of each element within the
+		/// supplied root, and in the text of the direct children of each such element. The scope
+		/// is open on the calling thread for as long as it lives.
+		/// </summary>
+		class Scope
+		{
+
+			friend class ContainsMatcher;
+
+		public:
+
+			/// <summary>
+			/// Scans the text of the supplied root once and opens a new scope on the calling
+			/// thread.
+			/// </summary>
+			/// <param name="matcher">
+			/// The matcher to scan with. It must outlive the scope.
+			/// </param>
+			/// <param name="root">
+			/// The node whose text, and the text of all of its descendants, is to be scanned.
+			/// </param>
+			Scope(const ContainsMatcher& matcher, const Node& root);
+
+			/// <summary>
+			/// Closes this scope, restoring whatever scope was previously open on the calling
+			/// thread, if any.
+			/// </summary>
+			~Scope();
+
+			Scope(const Scope&) = delete;
+			Scope& operator=(const Scope&) = delete;
+
+		private:
+
+			/// <summary>
+			/// The matcher this scope was scanned with.
+			/// </summary>
+			const ContainsMatcher& m_matcher;
+
+			/// <summary>
+			/// The scope that was open on this thread when this scope was opened.
+			/// </summary>
+			Scope* m_previous;
+
+			/// <summary>
+			/// The number of 64 bit words needed to hold one bit for each needle.
+			/// </summary>
+			size_t m_wordCount;
+
+			/// <summary>
+			/// The index of each scanned element within ::m_found.
+			/// </summary>
+			std::unordered_map<const GumboNode*, size_t> m_elementIndices;
+
+			/// <summary>
+			/// Two bitsets for each scanned element, indexed by needle. The first holds the needles
+			/// found within the text of the element and all of its descendants, the second those
+			/// found within the text of its direct children.
+			/// </summary>
+			std::vector<uint64_t> m_found;
+
+			/// <summary>
+			/// Gets the index of the supplied element within ::m_found, adding the element first.
+			/// </summary>
+			const size_t AddElement(const GumboNode* element);
+
+			/// <summary>
+			/// Sets the bit for the supplied needle within the bitset at the supplied offset.
+			/// </summary>
+			void SetFound(const size_t bitsetOffset, const uint32_t pattern);
+
+			/// <summary>
+			/// The scope presently open on the calling thread. Will be nullptr if there is none.
+			/// </summary>
+			static thread_local Scope* s_current;
+
+		};
+
+		/// <summary>
+		/// Builds a matcher over the needles of every :contains(...) and :containsOwn(...)
+		/// selector found anywhere within the supplied selectors.
+		/// </summary>
+		/// <param name="selectors">
+		/// The selectors to gather needles from. 
+		/// </param>
+		ContainsMatcher(const std::vector<SharedSelector>& selectors);
+
+		/// <summary>
+		/// Default destructor.
+		/// </summary>
+		~ContainsMatcher();
+
+		/// <summary>
+		/// Gets the number of distinct needles the matcher searches for.
+		/// </summary>
+		/// <returns>
+		/// The number of distinct needles.
+		/// </returns>
+		const size_t GetPatternCount() const;
+
+		/// <summary>
+		/// Looks up whether the needle of the supplied text selector was found in the text of the
+		/// supplied node, within the scope open on the calling thread.
+		/// </summary>
+		/// <param name="selector">
+		/// The text selector asking. 
+		/// </param>
+		/// <param name="node">
+		/// The node being matched against. 
+		/// </param>
+		/// <param name="own">
+		/// True to look up the text of the direct children of the node only, false to look up the
+		/// text of the node and all of its descendants.
+		/// </param>
+		/// <param name="found">
+		/// Receives whether or not the needle was found, if the lookup succeeds.
+		/// </param>
+		/// <returns>
+		/// True if the open scope holds the answer, false if there is no open scope, or the scope
+		/// didn't scan the node or doesn't know the selector. The selector must search the text
+		/// itself in that case.
+		/// </returns>
+		static const bool Lookup(const TextSelector* selector, const Node* node, const bool own, bool& found);
+
+	private:
+
+		/// <summary>
+		/// Marks the absence of a state or a needle.
+		/// </summary>
+		static const uint32_t None;
+
+		/// <summary>
+		/// The needle of each text selector the matcher was built from.
+		/// </summary>
+		std::unordered_map<const TextSelector*, uint32_t> m_patternIds;
+
+		/// <summary>
+		/// The length of each needle, in bytes.
+		/// </summary>
+		std::vector<size_t> m_patternLengths;
+
+		/// <summary>
+		/// Maps each byte to the class of bytes it belongs to. Bytes that appear in no needle all
+		/// share class zero, which keeps the transition table narrow.
+		/// </summary>
+		uint16_t m_byteClasses[256];
+
+		/// <summary>
+		/// The number of distinct byte classes.
+		/// </summary>
+		size_t m_classCount;
+
+		/// <summary>
+		/// The complete transition table, one row of ::m_classCount entries per state. State zero
+		/// is the root.
+		/// </summary>
+		std::vector<uint32_t> m_transitions;
+
+		/// <summary>
+		/// The needle that ends at each state, or ::None.
+		/// </summary>
+		std::vector<uint32_t> m_patternAt;
+
+		/// <summary>
+		/// The nearest state, along the failure links of each state, at which a needle ends, or
+		/// ::None.
+		/// </summary>
+		std::vector<uint32_t> m_outputLinks;
+
+		/// <summary>
+		/// Adds the needles of the supplied selector and everything within it.
+		/// </summary>
+		void AddNeedles(const Selector* selector, std::unordered_set<const Selector*>& visited, std::unordered_map<std::string, uint32_t>& patternIds, std::vector<std::string>& patterns);
+
+		/// <summary>
+		/// Builds the automaton over the supplied needles.
+		/// </summary>
+		void Build(const std::vector<std::string>& patterns);
+
+		/// <summary>
+		/// Advances the supplied state over the supplied byte.
+		/// </summary>
+		const uint32_t Next(const uint32_t state, const unsigned char c) const;
+
+	};
+
+} /* namespace gq */
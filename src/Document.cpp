@@ -77,13 +77,13 @@ namespace gq
 		}
 	}
 
-	void Document::Parse(const std::string& source)
+	void Document::Parse(const std::string& source, const bool indexText)
 	{
 		// No attempting to parse empty strings.
 		#ifndef NDEBUG
-			assert(source.length() > 0 && (source.find_first_not_of(u8" \t\r\n") != std::string::npos) && u8"In Document::Parse(const std::string&) - Empty or whitespace string supplied.");
+			assert(source.length() > 0 && (source.find_first_not_of(u8" \t\r\n") != std::string::npos) && u8"In Document::Parse(const std::string&, const bool) - Empty or whitespace string supplied.");
 		#else
-			if (source.length() == 0) { throw std::runtime_error(u8"In Document::Parse(const std::string&) - Empty string supplied."); }
+			if (source.length() == 0) { throw std::runtime_error(u8"In Document::Parse(const std::string&, const bool) - Empty string supplied."); }
 		#endif
 
 		if (m_gumboOutput != nullptr)
@@ -96,7 +96,7 @@ namespace gq
 		// Check if we got coal in our stocking.
 		if (m_gumboOutput == nullptr)
 		{
-			throw std::runtime_error(u8"In Document::Parse(const std::string&) - Failed to allocate GumboOutput.");
+			throw std::runtime_error(u8"In Document::Parse(const std::string&, const bool) - Failed to allocate GumboOutput.");
 		}
 
 		// Check if we got absolutely nothing in our stocking. If we didn't then, santa isn't real.
@@ -104,7 +104,7 @@ namespace gq
 			|| m_gumboOutput->root->v.element.children.length == 0 
 			|| static_cast<GumboNode*>(m_gumboOutput->root->v.element.children.data[0])->v.element.children.length == 0)
 		{
-			throw std::runtime_error(u8"In Document::Parse(const std::string&) - Failed to generate any HTML nodes from parsing process. The supplied string is most likely invalid HTML.");
+			throw std::runtime_error(u8"In Document::Parse(const std::string&, const bool) - Failed to generate any HTML nodes from parsing process. The supplied string is most likely invalid HTML.");
 		}
 
 		m_node = m_gumboOutput->root;
@@ -113,6 +113,12 @@ namespace gq
 
 		// Must call init to build out and index and children children.
 		Init();
+
+		if (indexText)
+		{
+			m_treeMap.BeginTextIndex();
+			BuildTextIndex(true);
+		}
 	}
 
 	void Document::Init()
@@ -126,9 +132,12 @@ namespace gq
 		// changing the design to having Document subclass Node. XXX TODO find a more elegant
 		// way to clean this up.
 		m_rootTreeMap = &m_treeMap;
+		m_indexWithinDocument = m_treeMap.NextNodeIndex();
 
 		BuildAttributes();
 		BuildChildren();
+
+		m_treeMap.EndSubtree(m_indexWithinDocument);
 	}
 
 } /* namespace gq */
@@ -42,6 +42,18 @@ namespace gq
 	/// <summary>
 	/// The Document serves as a lightweight wrapper around a GumboOutput* object, providing
 	/// methods for querying the parsed HTML with selectors.
+	/// <para>&#160;</para>
+	/// Once ::Parse(...) has returned, the document and every node within it are immutable, and
+	/// every const member of Document and Node may be called concurrently from any number of
+	/// threads without external synchronization. This includes Find(...), FindParallel(...),
+	/// Each(...), GetText(), GetOwnText(), attribute access, traversal and serialization. None of
+	/// these methods compute or cache state within the document. State that is cached for the
+	/// duration of a single query is kept per thread. Compiled selectors are likewise immutable
+	/// and may be shared by all threads. Callbacks supplied to Each(...) are invoked on the thread
+	/// that called Each(...).
+	/// <para>&#160;</para>
+	/// ::Parse(...) and destruction are the only mutating operations, and must not overlap with
+	/// any other use of the document.
 	/// </summary>
 	class Document : public Node
 	{
@@ -63,7 +75,13 @@ namespace gq
 		/// <param name="source">
 		/// A UTF-8 encoded string of a valid HTML. 
 		/// </param>
-		void Parse(const std::string& source);		
+		/// <param name="indexText">
+		/// Whether or not to also build an index of the text content of the document. The index
+		/// lets :contains selectors dismiss nodes whose text cannot hold the sought string
+		/// without building that text, at the cost of some extra time and memory spent while
+		/// parsing. Documents that are queried with :contains many times benefit the most.
+		/// </param>
+		void Parse(const std::string& source, const bool indexText = false);		
 
 	private:		
 
@@ -31,9 +31,13 @@
 #include "Util.hpp"
 #include "Selection.hpp"
 #include "Parser.hpp"
+#include "SelectorCache.hpp"
 #include "TreeMap.hpp"
 #include "SpecialTraits.hpp"
 #include "Serializer.hpp"
+#include "BinarySelector.hpp"
+#include <algorithm>
+#include <thread>
 
 namespace gq
 {
@@ -50,10 +54,13 @@ namespace gq
 		#endif	
 
 		newNode->m_rootTreeMap = map;
+		newNode->m_indexWithinDocument = map->NextNodeIndex();
 
 		newNode->BuildAttributes();
 		newNode->BuildChildren();
 
+		map->EndSubtree(newNode->m_indexWithinDocument);
+
 		return newNode;
 	}
 
@@ -90,6 +97,11 @@ namespace gq
 		return m_indexWithinParent;
 	}
 
+	const size_t Node::GetIndexWithinDocument() const
+	{
+		return m_indexWithinDocument;
+	}
+
 	const size_t Node::GetNumChildren() const
 	{
 		return m_children.size();
@@ -274,9 +286,7 @@ namespace gq
 
 	const Selection Node::Find(const std::string& selectorString) const
 	{
-		Parser parser;
-
-		auto selector = parser.CreateSelector(selectorString);
+		auto selector = SelectorCache::GetShared().Get(selectorString);
 
 		return Find(selector);
 	}
@@ -294,6 +304,13 @@ namespace gq
 		
 		const auto& traits = selector->GetMatchTraits();
 
+		// Lets sibling selectors remember per-parent results for the duration of this search.
+		BinarySelector::SiblingMatchScope siblingScope;
+
+		// Nodes that the selector can never match, such as those matched by the inner selector of
+		// a :not(...), are subtracted from the candidates before any matching is attempted.
+		auto excluded = BuildExclusionSet(selector);
+
 		// The collected map ensure that we don't store duplicate matches. Any time a match is made,
 		// it's pushed to the collected map.
 		FastAttributeMap collected;
@@ -356,6 +373,11 @@ namespace gq
 					// duplicates, rather than eliminate duplicates first and then attempt a match.
 					const Node* pNode = (*fromTrait)[i];
 
+					if (excluded.size() > 0 && excluded[pNode->m_indexWithinDocument])
+					{
+						continue;
+					}
+
 					auto matchTest = selector->Match(pNode);
 					if (matchTest)
 					{
@@ -380,11 +402,127 @@ namespace gq
 		return Selection(matchResults);
 	}
 
-	void Node::Each(const std::string& selectorString, std::function<void(const Node* node)> func) const
+	const size_t Node::DefaultParallelFindThreshold = 4096;
+
+	const Selection Node::FindParallel(const SharedSelector& selector, const size_t serialThreshold, const size_t maxThreads) const
 	{
-		Parser parser;
+		#ifndef NDEBUG
+			#ifdef GQ_VERBOSE_DEBUG_NFO
+				std::cout << u8"Node::FindParallel(const SharedSelector&, const size_t, const size_t)" << std::endl;
+			#endif
+		#endif
+
+		const auto& traits = selector->GetMatchTraits();
+
+		// Count the candidates of every trait before copying any of them, since they're only
+		// copied when the matching is actually split across threads.
+		std::vector< const std::vector< const Node* >* > postingLists;
+		postingLists.reserve(traits.size());
+		size_t candidateCount = 0;
+
+		for (auto traitsIt = traits.begin(); traitsIt != traits.end(); ++traitsIt)
+		{
+			if (traitsIt->first.size() == 0)
+			{
+				continue;
+			}
+
+			const std::vector< const Node* >* fromTrait = nullptr;
+
+			if (traitsIt->second.size() == 0)
+			{
+				fromTrait = m_rootTreeMap->Get(GetUniqueId(), traitsIt->first);
+			}
+			else
+			{
+				fromTrait = m_rootTreeMap->Get(GetUniqueId(), traitsIt->first, traitsIt->second);
+			}
 
-		auto selector = parser.CreateSelector(selectorString);
+			if (fromTrait != nullptr)
+			{
+				postingLists.push_back(fromTrait);
+				candidateCount += fromTrait->size();
+			}
+		}
+
+		size_t numThreads = maxThreads > 0 ? maxThreads : static_cast<size_t>(std::thread::hardware_concurrency());
+		numThreads = std::min(numThreads, candidateCount);
+
+		// With a threshold of zero, there may also be too few candidates to share.
+		if (candidateCount < serialThreshold || numThreads < 2)
+		{
+			return Find(selector);
+		}
+
+		// Gather every candidate from every trait, in the same order that ::Find(...) would visit
+		// them, so that merging the per-thread results in order yields the same result.
+		std::vector<const Node*> candidates;
+		candidates.reserve(candidateCount);
+
+		for (const auto* postingList : postingLists)
+		{
+			candidates.insert(candidates.end(), postingList->begin(), postingList->end());
+		}
+
+		auto excluded = BuildExclusionSet(selector);
+
+		// Each thread matches one contiguous range of the candidates into its own buffer. Each
+		// thread also needs its own sibling scope, since scopes are per thread.
+		auto rangeSize = candidates.size() / numThreads;
+		std::vector< std::vector<const Node*> > rangeResults(numThreads);
+
+		Util::ForEachRange(numThreads, [&selector, &candidates, &excluded, &rangeResults, rangeSize, numThreads](const size_t range) -> void
+		{
+			BinarySelector::SiblingMatchScope siblingScope;
+
+			auto begin = range * rangeSize;
+			auto end = (range + 1 == numThreads) ? candidates.size() : begin + rangeSize;
+
+			for (size_t i = begin; i < end; ++i)
+			{
+				const Node* pNode = candidates[i];
+
+				if (excluded.size() > 0 && excluded[pNode->m_indexWithinDocument])
+				{
+					continue;
+				}
+
+				auto matchTest = selector->Match(pNode);
+				if (matchTest)
+				{
+					rangeResults[range].push_back(matchTest.GetResult());
+				}
+			}
+		});
+
+		// Merge in range order, keeping only the first occurrence of any node.
+		std::vector<bool> collected(m_rootTreeMap->GetNodeCount(), false);
+		std::vector<const Node*> matchResults;
+
+		for (auto& range : rangeResults)
+		{
+			for (auto* matchedNode : range)
+			{
+				if (!collected[matchedNode->m_indexWithinDocument])
+				{
+					collected[matchedNode->m_indexWithinDocument] = true;
+					matchResults.push_back(matchedNode);
+				}
+			}
+		}
+
+		#ifndef NDEBUG
+			#ifdef GQ_VERBOSE_DEBUG_NFO
+				std::cout << u8"Returning " << matchResults.size() << u8" matches for selector " << selector->GetOriginalSelectorString() << u8" matched on " << numThreads << u8" threads." << std::endl;
+			#endif
+		#endif
+
+		return Selection(matchResults);
+	}
+
+	void Node::Each(const std::string& selectorString, std::function<void(const Node* node)> func) const
+	{
+		auto selector = SelectorCache::GetShared().Get(selectorString);
 
 		Each(selector, func);
 	}
@@ -393,6 +531,13 @@ namespace gq
 	{
 		const auto& traits = selector->GetMatchTraits();
 
+		// Lets sibling selectors remember per-parent results for the duration of this search.
+		BinarySelector::SiblingMatchScope siblingScope;
+
+		// Nodes that the selector can never match, such as those matched by the inner selector of
+		// a :not(...), are subtracted from the candidates before any matching is attempted.
+		auto excluded = BuildExclusionSet(selector);
+
 		// The collected map ensures that we don't store duplicate matches. Any time a match is
 		// made, it's pushed to the collected map.
 		FastAttributeMap collected;
@@ -450,6 +595,11 @@ namespace gq
 					// duplicates, rather than eliminate duplicates first and then attempt a match.
 					auto* pNode = (*fromTrait)[i];
 
+					if (excluded.size() > 0 && excluded[pNode->m_indexWithinDocument])
+					{
+						continue;
+					}
+
 					auto matchTest = selector->Match(pNode);
 					if (matchTest)
 					{
@@ -466,6 +616,49 @@ namespace gq
 		}
 	}
 
+	std::vector<bool> Node::BuildExclusionSet(const SharedSelector& selector) const
+	{
+		std::vector<bool> excluded;
+
+		const auto& exclusionTraits = selector->GetExclusionTraits();
+
+		for (auto traitsIt = exclusionTraits.begin(); traitsIt != exclusionTraits.end(); ++traitsIt)
+		{
+			if (traitsIt->first.size() == 0)
+			{
+				continue;
+			}
+
+			const std::vector< const Node* >* fromTrait = nullptr;
+
+			if (traitsIt->second.size() == 0)
+			{
+				fromTrait = m_rootTreeMap->Get(GetUniqueId(), traitsIt->first);
+			}
+			else
+			{
+				fromTrait = m_rootTreeMap->Get(GetUniqueId(), traitsIt->first, traitsIt->second);
+			}
+
+			if (fromTrait == nullptr)
+			{
+				continue;
+			}
+
+			if (excluded.size() == 0)
+			{
+				excluded.resize(m_rootTreeMap->GetNodeCount(), false);
+			}
+
+			for (auto* excludedNode : *fromTrait)
+			{
+				excluded[excludedNode->m_indexWithinDocument] = true;
+			}
+		}
+
+		return excluded;
+	}
+
 	const boost::string_ref Node::GetUniqueId() const
 	{
 		return boost::string_ref(m_nodeUniqueId);
@@ -511,6 +704,56 @@ namespace gq
 		}
 	}
 
+	void Node::BuildTextIndex(const bool indexed)
+	{
+		const auto start = m_rootTreeMap->GetIndexedTextLength();
+
+		// Template content is never part of the text of an element, so the template itself has
+		// empty text and everything within it is left out of the index.
+		const bool childrenIndexed = indexed && m_node->type == GUMBO_NODE_ELEMENT;
+
+		const GumboVector* children = &m_node->v.element.children;
+		size_t childNodeIndex = 0;
+
+		for (unsigned int i = 0; i < children->length; ++i)
+		{
+			const GumboNode* child = static_cast<GumboNode*>(children->data[i]);
+
+			switch (child->type)
+			{
+				case GUMBO_NODE_TEXT:
+				{
+					if (childrenIndexed)
+					{
+						m_rootTreeMap->AppendIndexedText(child->v.text.text);
+					}
+				}
+				break;
+
+				case GUMBO_NODE_ELEMENT:
+				case GUMBO_NODE_TEMPLATE:
+				{
+					// Children are built from exactly these node types, in order.
+					m_children[childNodeIndex++]->BuildTextIndex(childrenIndexed);
+				}
+				break;
+
+				default:
+				break;
+			}
+		}
+
+		if (indexed)
+		{
+			m_rootTreeMap->SetIndexedTextRange(m_indexWithinDocument, start, m_rootTreeMap->GetIndexedTextLength());
+		}
+	}
+
+	const bool Node::MayContainText(boost::string_ref text) const
+	{
+		return m_rootTreeMap == nullptr || m_rootTreeMap->MayContainText(m_indexWithinDocument, text);
+	}
+
 	void Node::BuildAttributes()
 	{
 
@@ -561,6 +804,7 @@ namespace gq
 				m_attributes.insert({ attribName, attribValue });
 
 				treeAttribMap.insert({ attribName, attribValue });
+				m_rootTreeMap->AddFoldedValue(treeAttribMap, attribName, attribValue);
 
 				// Split the attribute values up and store them individually
 				auto anySplittablePos = attribValue.find(' ');
@@ -575,6 +819,7 @@ namespace gq
 							splitOnce = true;
 							auto singleValue = attribValue.substr(0, anySplittablePos);
 							treeAttribMap.insert({ attribName, singleValue });
+							m_rootTreeMap->AddFoldedValue(treeAttribMap, attribName, singleValue);
 						}
 
 						attribValue = attribValue.substr(anySplittablePos + 1);
@@ -583,6 +828,7 @@ namespace gq
 					if (splitOnce && attribValue.size() > 0)
 					{
 						treeAttribMap.insert({ attribName, attribValue });
+						m_rootTreeMap->AddFoldedValue(treeAttribMap, attribName, attribValue);
 					}
 				}
 			}
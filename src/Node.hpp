@@ -70,6 +70,8 @@ namespace gq
 		friend class Util;
 		friend class Serializer;
 		friend class NodeMutationCollection;
+		friend class ContainsMatcher;
+		friend class TextSelector;
 
 	public:	
 
@@ -98,6 +100,16 @@ namespace gq
 		/// </returns>
 		const size_t GetIndexWithinParent() const;
 
+		/// <summary>
+		/// Gets the index of this node within the entire document, in document order. The root
+		/// node has an index of zero, and every node has an index greater than that of any node
+		/// which precedes it in the document.
+		/// </summary>
+		/// <returns>
+		/// The index within the document.
+		/// </returns>
+		const size_t GetIndexWithinDocument() const;
+
 		/// <summary>
 		/// Gets the number of children this node has.
 		/// </summary>
@@ -251,10 +263,11 @@ namespace gq
 		/// when supplied with invalid selectors. As such, be prepared to handle exceptions when
 		/// using this method.
 		/// <para>&#160;</para>
-		/// Note also that it is recommended to use the Parser directly to compile selectors
-		/// first, saving the returned SharedSelector objects. This is much more efficient if the
-		/// selector is used more than once. Methods that accept raw selector strings will compile
-		/// and discard selectors after use.
+		/// Compiled selectors are kept in the bounded SelectorCache returned by
+		/// SelectorCache::GetShared(), so repeating the same selector string only compiles it
+		/// once, for so long as it isn't evicted. Compiling selectors with the Parser directly and
+		/// saving the returned SharedSelector objects is still the most efficient option when the
+		/// set of selectors is known ahead of time.
 		/// </summary>
 		/// <param name="selectorString">
 		/// The selector string to query against the node and its descendants with. 
@@ -278,6 +291,39 @@ namespace gq
 		/// </returns>
 		const Selection Find(const SharedSelector& selector) const;
 
+		/// <summary>
+		/// The default minimum number of candidates that must be gathered for a selector before
+		/// ::FindParallel(...) will spread matching across multiple threads.
+		/// </summary>
+		static const size_t DefaultParallelFindThreshold;
+
+		/// <summary>
+		/// Run a selector against the node and its descendants and return any and all nodes that
+		/// were matched by the supplied compiled selector, matching the candidates in parallel.
+		/// The candidates gathered through the traits of the selector are split into contiguous
+		/// ranges, each range is matched on its own thread into its own result buffer, and the
+		/// buffers are then merged in order with duplicates removed. The result is identical to
+		/// that of ::Find(const SharedSelector&), including the order of the matched nodes.
+		/// <para>&#160;</para>
+		/// When fewer candidates than the supplied threshold are gathered, the cost of starting
+		/// threads outweighs the benefit, so matching is done serially on the calling thread.
+		/// </summary>
+		/// <param name="selector">
+		/// The precompiled selector object to query against the node and its descendants with. 
+		/// </param>
+		/// <param name="serialThreshold">
+		/// The minimum number of candidates required before matching is done in parallel. 
+		/// </param>
+		/// <param name="maxThreads">
+		/// The maximum number of threads to match with. When zero, the number of hardware threads
+		/// available is used.
+		/// </param>
+		/// <returns>
+		/// A collection of nodes that were matched by the supplied selector. If no matches were
+		/// found, the collection will be empty.
+		/// </returns>
+		const Selection FindParallel(const SharedSelector& selector, const size_t serialThreshold = DefaultParallelFindThreshold, const size_t maxThreads = 0) const;
+
 		/// <summary>
 		/// Runs a selector against the node and its descendants, and for each match found, invokes
 		/// the supplied function with the matched node as the sole argument. This allows for the
@@ -288,10 +334,11 @@ namespace gq
 		/// Parser::Parse(...) method, which will throw when supplied with invalid selectors. As
 		/// such, be prepared to handle exceptions when using this method.
 		/// <para>&#160;</para>
-		/// Note also that it is recommended to use the Parser directly to compile selectors
-		/// first, saving the returned SharedSelector objects. This is much more efficient if the
-		/// selector is used more than once. Methods that accept raw selector strings will compile
-		/// and discard selectors after use.
+		/// Compiled selectors are kept in the bounded SelectorCache returned by
+		/// SelectorCache::GetShared(), so repeating the same selector string only compiles it
+		/// once, for so long as it isn't evicted. Compiling selectors with the Parser directly and
+		/// saving the returned SharedSelector objects is still the most efficient option when the
+		/// set of selectors is known ahead of time.
 		/// </summary>
 		/// <param name="selectorString">
 		/// The selector string to query against the node and its descendants with. 
@@ -399,6 +446,13 @@ namespace gq
 		/// </summary>
 		size_t m_indexWithinParent;
 
+		/// <summary>
+		/// The position of this node within the whole document, in document order. Handed out by
+		/// the TreeMap as nodes are built. Used for building dense per-document bitsets over
+		/// nodes.
+		/// </summary>
+		size_t m_indexWithinDocument = 0;
+
 		/// <summary>
 		/// A unique ID for the node composed of its position within parent, and its parent's position
 		/// within their parents all the way back to the root. If we were using integers for this, it
@@ -537,6 +591,17 @@ namespace gq
 		/// </summary>
 		void BuildAttributes();
 
+		/// <summary>
+		/// Appends the text of this node and its descendants to the text index held by the
+		/// TreeMap, in the same order that Util::NodeText(...) concatenates it, and records the
+		/// range of the indexed text that belongs to each node. Nodes within a template are not
+		/// part of the text of any ancestor, so they are left unindexed.
+		/// </summary>
+		/// <param name="indexed">
+		/// Whether or not the text of this node is part of the indexed text.
+		/// </param>
+		void BuildTextIndex(const bool indexed);
+
 		/// <summary>
 		/// Object composition is getting a little ugly at this point. Document holds the single
 		/// TreeMap in a unique_ptr as a private member, but Document was changed to inherit
@@ -554,6 +619,33 @@ namespace gq
 
 	private:
 
+			/// <summary>
+			/// Marks every node within the scope of this node that is found through the exclusion
+			/// traits of the supplied selector. The returned bitset is indexed by
+			/// Node::GetIndexWithinDocument(), and will be empty if the selector has no exclusion
+			/// traits.
+			/// </summary>
+			/// <param name="selector">
+			/// The selector whose exclusion traits should be collected.
+			/// </param>
+			/// <returns>
+			/// A bitset where every excluded node has its bit set.
+			/// </returns>
+			std::vector<bool> BuildExclusionSet(const SharedSelector& selector) const;
+
+			/// <summary>
+			/// Checks the text index of the document, if one was built, to determine whether the
+			/// text of this node could contain the supplied string. A return value of false is
+			/// definite.
+			/// </summary>
+			/// <param name="text">
+			/// The string to look for.
+			/// </param>
+			/// <returns>
+			/// False if the text of this node cannot contain the supplied string, true otherwise.
+			/// </returns>
+			const bool MayContainText(boost::string_ref text) const;
+
 			Node(const Node&) = delete;
 			Node& operator=(const Node&) = delete;
 
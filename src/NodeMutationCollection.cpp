@@ -22,15 +22,28 @@
 
 #include "NodeMutationCollection.hpp"
 #include "Node.hpp"
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
 
 namespace gq
 {
 
+	constexpr uint32_t NodeMutationCollection::NoAction;
+
 	void NodeMutationCollection::Add(const Node* node)
 	{
 		if (node != nullptr)
 		{
-			m_rawNodes.insert(node->m_node);
+			if (m_rawNodes.emplace(node->m_node, node).second)
+			{
+				Thaw();
+
+				if (m_sourcePassthrough)
+				{
+					AddAncestors(node->m_node);
+				}
+			}
 		}
 	}
 
@@ -38,7 +51,39 @@ namespace gq
 	{
 		if (node != nullptr)
 		{
-			return m_rawNodes.erase(node->m_node) == 1;
+			if (m_rawNodes.erase(node->m_node) == 0)
+			{
+				return false;
+			}
+
+			Thaw();
+
+			// Declared actions go along with the node. Their entries in the action table are
+			// left unreferenced until there are enough of them to be worth compacting away.
+			auto chain = m_actionChains.find(node->m_node);
+
+			if (chain != m_actionChains.end())
+			{
+				for (uint32_t i = chain->second.first; i != NoAction; i = m_actions[i].next)
+				{
+					++m_unreferencedActions;
+					m_unreferencedActionBytes += m_actions[i].nameSize + m_actions[i].valueSize;
+				}
+
+				m_actionChains.erase(chain);
+
+				if (m_unreferencedActions * 2 > m_actions.size() || m_unreferencedActionBytes * 2 > m_actionStrings.size())
+				{
+					CompactActions();
+				}
+			}
+
+			if (m_sourcePassthrough)
+			{
+				RemoveAncestors(node->m_node);
+			}
+
+			return true;
 		}
 
 		return false;
@@ -51,6 +96,11 @@ namespace gq
 		return res != m_rawNodes.end();
 	}
 
+	const bool NodeMutationCollection::ContainsWithin(const GumboNode* rawNode) const
+	{
+		return Contains(rawNode) || m_rawNodeAncestors.find(rawNode) != m_rawNodeAncestors.end();
+	}
+
 	void NodeMutationCollection::SetOnTagStart(OnTagCallback callback)
 	{
 		m_onTagStart = callback;
@@ -66,6 +116,263 @@ namespace gq
 		m_onTagContent = callback;
 	}
 
+	void NodeMutationCollection::SetSourcePassthrough(const bool enabled)
+	{
+		if (enabled == m_sourcePassthrough)
+		{
+			return;
+		}
+
+		m_sourcePassthrough = enabled;
+
+		// The ancestors are only ever looked up for source passthrough, so they're only kept
+		// while it's enabled.
+		m_rawNodeAncestors.clear();
+
+		if (enabled)
+		{
+			for (const auto& rawNode : m_rawNodes)
+			{
+				AddAncestors(rawNode.first);
+			}
+		}
+	}
+
+	const bool NodeMutationCollection::GetSourcePassthrough() const
+	{
+		return m_sourcePassthrough;
+	}
+
+	void NodeMutationCollection::RemoveElement(const Node* node)
+	{
+		AddAction(node, ActionType::RemoveElement, boost::string_ref(), boost::string_ref());
+	}
+
+	void NodeMutationCollection::RemoveAttribute(const Node* node, boost::string_ref attributeName)
+	{
+		AddAction(node, ActionType::RemoveAttribute, attributeName, boost::string_ref());
+	}
+
+	void NodeMutationCollection::SetAttribute(const Node* node, boost::string_ref attributeName, boost::string_ref attributeValue)
+	{
+		AddAction(node, ActionType::SetAttribute, attributeName, attributeValue);
+	}
+
+	void NodeMutationCollection::ReplaceContent(const Node* node, boost::string_ref html)
+	{
+		AddAction(node, ActionType::ReplaceContent, boost::string_ref(), html);
+	}
+
+	void NodeMutationCollection::InsertBefore(const Node* node, boost::string_ref html)
+	{
+		AddAction(node, ActionType::InsertBefore, boost::string_ref(), html);
+	}
+
+	void NodeMutationCollection::InsertAfter(const Node* node, boost::string_ref html)
+	{
+		AddAction(node, ActionType::InsertAfter, boost::string_ref(), html);
+	}
+
+	void NodeMutationCollection::AddAction(const Node* node, const ActionType type, boost::string_ref name, boost::string_ref value)
+	{
+		if (node == nullptr)
+		{
+			return;
+		}
+
+		const bool fits = m_actions.size() < NoAction && m_actionStrings.size() + name.size() + value.size() < NoAction;
+
+		#ifndef NDEBUG
+			assert(fits && u8"In NodeMutationCollection::AddAction(const Node*, const ActionType, boost::string_ref, boost::string_ref) - The action table is full.");
+		#else
+			if (!fits) { throw std::runtime_error(u8"In NodeMutationCollection::AddAction(const Node*, const ActionType, boost::string_ref, boost::string_ref) - The action table is full."); }
+		#endif
+
+		Add(node);
+		Thaw();
+
+		Action action;
+		action.type = type;
+		action.next = NoAction;
+		action.nameOffset = static_cast<uint32_t>(m_actionStrings.size());
+		action.nameSize = static_cast<uint32_t>(name.size());
+		m_actionStrings.append(name.data(), name.size());
+		action.valueOffset = static_cast<uint32_t>(m_actionStrings.size());
+		action.valueSize = static_cast<uint32_t>(value.size());
+		m_actionStrings.append(value.data(), value.size());
+
+		const uint32_t index = static_cast<uint32_t>(m_actions.size());
+		m_actions.push_back(action);
+
+		auto chain = m_actionChains.find(node->m_node);
+
+		if (chain == m_actionChains.end())
+		{
+			m_actionChains.emplace(node->m_node, std::make_pair(index, index));
+		}
+		else
+		{
+			m_actions[chain->second.second].next = index;
+			chain->second.second = index;
+		}
+	}
+
+	const uint32_t NodeMutationCollection::GetFirstAction(const GumboNode* rawNode) const
+	{
+		if (m_actionChains.empty())
+		{
+			return NoAction;
+		}
+
+		auto chain = m_actionChains.find(rawNode);
+
+		return chain != m_actionChains.end() ? chain->second.first : NoAction;
+	}
+
+	boost::string_ref NodeMutationCollection::GetActionName(const Action& action) const
+	{
+		return boost::string_ref(m_actionStrings.data() + action.nameOffset, action.nameSize);
+	}
+
+	boost::string_ref NodeMutationCollection::GetActionValue(const Action& action) const
+	{
+		return boost::string_ref(m_actionStrings.data() + action.valueOffset, action.valueSize);
+	}
+
+	void NodeMutationCollection::AddAncestors(const GumboNode* rawNode)
+	{
+		for (const GumboNode* ancestor = rawNode->parent; ancestor != nullptr; ancestor = ancestor->parent)
+		{
+			++m_rawNodeAncestors[ancestor];
+		}
+	}
+
+	void NodeMutationCollection::RemoveAncestors(const GumboNode* rawNode)
+	{
+		for (const GumboNode* ancestor = rawNode->parent; ancestor != nullptr; ancestor = ancestor->parent)
+		{
+			auto res = m_rawNodeAncestors.find(ancestor);
+
+			if (res != m_rawNodeAncestors.end() && --res->second == 0)
+			{
+				m_rawNodeAncestors.erase(res);
+			}
+		}
+	}
+
+	void NodeMutationCollection::CompactActions()
+	{
+		std::vector<Action> actions;
+		actions.reserve(m_actions.size() - m_unreferencedActions);
+
+		std::string actionStrings;
+		actionStrings.reserve(m_actionStrings.size() - m_unreferencedActionBytes);
+
+		for (auto& chain : m_actionChains)
+		{
+			uint32_t previous = NoAction;
+
+			for (uint32_t i = chain.second.first; i != NoAction; i = m_actions[i].next)
+			{
+				Action action = m_actions[i];
+				action.next = NoAction;
+
+				const uint32_t nameOffset = static_cast<uint32_t>(actionStrings.size());
+				actionStrings.append(m_actionStrings.data() + action.nameOffset, action.nameSize);
+				action.nameOffset = nameOffset;
+
+				const uint32_t valueOffset = static_cast<uint32_t>(actionStrings.size());
+				actionStrings.append(m_actionStrings.data() + action.valueOffset, action.valueSize);
+				action.valueOffset = valueOffset;
+
+				const uint32_t index = static_cast<uint32_t>(actions.size());
+				actions.push_back(action);
+
+				if (previous == NoAction)
+				{
+					chain.second.first = index;
+				}
+				else
+				{
+					actions[previous].next = index;
+				}
+
+				previous = index;
+			}
+
+			chain.second.second = previous;
+		}
+
+		m_actions = std::move(actions);
+		m_actionStrings = std::move(actionStrings);
+		m_unreferencedActions = 0;
+		m_unreferencedActionBytes = 0;
+	}
+
+	void NodeMutationCollection::Freeze()
+	{
+		Thaw();
+
+		// The table is about to be walked by every serialization, so it's worth dropping the
+		// actions of removed nodes from it first.
+		if (m_unreferencedActions > 0)
+		{
+			CompactActions();
+		}
+
+		m_frozenNodes.reserve(m_rawNodes.size());
+
+		for (const auto& rawNode : m_rawNodes)
+		{
+			const Node* node = rawNode.second;
+
+			if (m_frozenTreeMap == nullptr)
+			{
+				m_frozenTreeMap = node->m_rootTreeMap;
+			}
+
+			const bool sameDocument = node->m_rootTreeMap == m_frozenTreeMap;
+
+			#ifndef NDEBUG
+				assert(sameDocument && u8"In NodeMutationCollection::Freeze() - The collection holds nodes from more than one document.");
+			#else
+				if (!sameDocument) { Thaw(); throw std::runtime_error(u8"In NodeMutationCollection::Freeze() - The collection holds nodes from more than one document."); }
+			#endif
+
+			m_frozenNodes.push_back({ node->m_indexWithinDocument, rawNode.first, GetFirstAction(rawNode.first) });
+		}
+
+		std::sort(m_frozenNodes.begin(), m_frozenNodes.end(), [](const FrozenNode& a, const FrozenNode& b)
+		{
+			return a.index < b.index;
+		});
+
+		if (!m_frozenNodes.empty())
+		{
+			m_frozenDocument = m_frozenNodes.front().node;
+
+			while (m_frozenDocument->parent != nullptr)
+			{
+				m_frozenDocument = m_frozenDocument->parent;
+			}
+		}
+
+		m_frozen = true;
+	}
+
+	const bool NodeMutationCollection::IsFrozen() const
+	{
+		return m_frozen;
+	}
+
+	void NodeMutationCollection::Thaw()
+	{
+		m_frozen = false;
+		m_frozenNodes.clear();
+		m_frozenTreeMap = nullptr;
+		m_frozenDocument = nullptr;
+	}
+
 	size_t NodeMutationCollection::Size() const
 	{
 		return m_rawNodes.size();
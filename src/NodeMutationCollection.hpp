@@ -23,16 +23,20 @@
 #pragma once
 
 #include <unordered_set>
+#include <unordered_map>
 #include <functional>
 #include <boost/utility/string_ref.hpp>
 #include <gumbo.h>
 #include <memory>
 #include <string>
+#include <vector>
+#include <cstdint>
 
 namespace gq
 {
 
 	class Node;
+	class TreeMap;
 
 	/// <summary>
 	/// The purpose of the NodeMutationCollection class is to provide a safe way for users to modify
@@ -40,7 +44,7 @@ namespace gq
 	/// pointers in the collection or the lifetime of the objects in the collection. Once again, the
 	/// user only must simply keep Document alive and any naked pointers received by the user during
 	/// its lifetime should be safe and valid, as they are managed internally this way. This
-	/// collection internally uses an unordered_set, and as such sort of has built in duplicate
+	/// collection internally uses an unordered_map, and as such sort of has built in duplicate
 	/// filtering, but that's not the intended use and this behavior should not be relied upon.
 	/// <para>&#160;</para>
 	/// Gumbo Parser does not provide any way to mutate a parsed document. The first thought to
@@ -77,6 +81,12 @@ namespace gq
 	/// this next node I'm going to process something the user wants to modify?", and if that's
 	/// true, Serializer will invoke the callback(s) also supplied by the user to ask the user's
 	/// logic to perform serialization for that node, rather than by itself.
+	/// <para>&#160;</para>
+	/// Common changes, such as removing an element or an attribute, or inserting HTML next to an
+	/// element, don't need callbacks at all. They can be declared per node with methods like
+	/// ::RemoveElement(...) and ::SetAttribute(...), and the Serializer then applies them itself,
+	/// straight from a compact table of actions held in this collection. Declared actions take
+	/// precedence over callbacks, which still apply to everything the actions leave alone.
 	/// </summary>
 	class NodeMutationCollection
 	{		
@@ -172,7 +182,139 @@ namespace gq
 		/// user has added to this collection.
 		/// </param>
 		void SetOnTagContent(OnTagContentCallback callback);
+
+		/// <summary>
+		/// Sets whether or not the Serializer should copy the original source of every part of
+		/// the document that this collection leaves untouched, instead of building it again from
+		/// the parsed document. When enabled, any element that neither is nor contains a node in
+		/// this collection is written by copying its original bytes from the parsed HTML, and
+		/// the tags surrounding nodes in this collection are copied the same way. Only the nodes
+		/// in this collection are serialized as usual. Serializing a large document with a few
+		/// mutations then costs little more than copying the source.
+		/// <para>&#160;</para>
+		/// The output differs from ordinary serialization, in that it reproduces the source
+		/// exactly as it was written, rather than a normalized form of it. Parts of the document
+		/// that don't correspond to a contiguous, well formed span of the source, such as
+		/// elements that were implied or closed implicitly, or that the parser moved about, are
+		/// still serialized as usual. As with all serialization, the HTML string the document was
+		/// parsed from must still be alive. This is disabled by default.
+		/// </summary>
+		/// <param name="enabled">
+		/// True if untouched parts of the document should be copied from the source, false
+		/// otherwise.
+		/// </param>
+		void SetSourcePassthrough(const bool enabled);
+
+		/// <summary>
+		/// Gets whether or not the Serializer copies untouched parts of the document from the
+		/// source. See ::SetSourcePassthrough(const bool).
+		/// </summary>
+		/// <returns>
+		/// True if untouched parts of the document are copied from the source, false otherwise.
+		/// </returns>
+		const bool GetSourcePassthrough() const;
+
+		/// <summary>
+		/// Declares that the supplied node, and all of its descendants, are to be left out of
+		/// the serialized output. HTML inserted before or after the node is still written. The
+		/// node is added to the collection if it isn't already present.
+		/// </summary>
+		/// <param name="node">
+		/// The node to remove.
+		/// </param>
+		void RemoveElement(const Node* node);
+
+		/// <summary>
+		/// Declares that the named attribute is to be left out when the supplied node is
+		/// serialized. The name is matched case insensitively. The node is added to the
+		/// collection if it isn't already present.
+		/// </summary>
+		/// <param name="node">
+		/// The node to remove the attribute from.
+		/// </param>
+		/// <param name="attributeName">
+		/// The name of the attribute to remove.
+		/// </param>
+		void RemoveAttribute(const Node* node, boost::string_ref attributeName);
+
+		/// <summary>
+		/// Declares that the named attribute is to have the supplied value when the supplied node
+		/// is serialized. If the node has no such attribute, it is added after all others. The
+		/// value is written in double quotes, with any quotes and ampersands within it escaped.
+		/// The name is matched case insensitively. Where several actions are declared for the
+		/// same attribute, the last one wins. The node is added to the collection if it isn't
+		/// already present.
+		/// </summary>
+		/// <param name="node">
+		/// The node to set the attribute on.
+		/// </param>
+		/// <param name="attributeName">
+		/// The name of the attribute to set.
+		/// </param>
+		/// <param name="attributeValue">
+		/// The unescaped value of the attribute.
+		/// </param>
+		void SetAttribute(const Node* node, boost::string_ref attributeName, boost::string_ref attributeValue);
+
+		/// <summary>
+		/// Declares that the contents of the supplied node are to be replaced entirely by the
+		/// supplied HTML when the node is serialized. The HTML is written as-is. Where several
+		/// replacements are declared for the same node, the last one wins. The node is added to
+		/// the collection if it isn't already present.
+		/// </summary>
+		/// <param name="node">
+		/// The node whose contents to replace.
+		/// </param>
+		/// <param name="html">
+		/// The HTML to write in place of the contents of the node.
+		/// </param>
+		void ReplaceContent(const Node* node, boost::string_ref html);
+
+		/// <summary>
+		/// Declares that the supplied HTML is to be written as-is immediately before the supplied
+		/// node. HTML inserted before the same node more than once is written in the order it
+		/// was inserted. The node is added to the collection if it isn't already present.
+		/// </summary>
+		/// <param name="node">
+		/// The node to insert the HTML before.
+		/// </param>
+		/// <param name="html">
+		/// The HTML to insert.
+		/// </param>
+		void InsertBefore(const Node* node, boost::string_ref html);
+
+		/// <summary>
+		/// Declares that the supplied HTML is to be written as-is immediately after the supplied
+		/// node. HTML inserted after the same node more than once is written in the order it was
+		/// inserted. The node is added to the collection if it isn't already present.
+		/// </summary>
+		/// <param name="node">
+		/// The node to insert the HTML after.
+		/// </param>
+		/// <param name="html">
+		/// The HTML to insert.
+		/// </param>
+		void InsertAfter(const Node* node, boost::string_ref html);
 		
+		/// <summary>
+		/// Freezes the collection into a table of its nodes sorted in document order. The
+		/// Serializer then walks the table alongside the document as it goes, rather than looking
+		/// up every element it comes across, and can tell whether a subtree holds any node in the
+		/// collection by comparing indices. Freeze the collection once it's complete and before
+		/// serializing, when serialization speed matters. Every node in the collection must belong
+		/// to the same document. Adding, removing or declaring actions on nodes afterwards thaws
+		/// the collection, until it's frozen again.
+		/// </summary>
+		void Freeze();
+
+		/// <summary>
+		/// Checks whether the collection is frozen. See ::Freeze().
+		/// </summary>
+		/// <returns>
+		/// True if the collection is frozen, false otherwise.
+		/// </returns>
+		const bool IsFrozen() const;
+
 		/// <summary>
 		/// Gets the number of elements in the collection.
 		/// </summary>
@@ -194,11 +336,218 @@ namespace gq
 		/// </returns>
 		const bool Contains(const GumboNode* rawNode) const;
 
+		/// <summary>
+		/// Checks if the following GumboNode*, or any of its descendants, is a part of this
+		/// collection.
+		/// </summary>
+		/// <param name="rawNode">
+		/// The GumboNode* to search within.
+		/// </param>
+		/// <returns>
+		/// True if the node or any of its descendants is part of this collection, false
+		/// otherwise.
+		/// </returns>
+		const bool ContainsWithin(const GumboNode* rawNode) const;
+
+		/// <summary>
+		/// The kinds of declared actions.
+		/// </summary>
+		enum class ActionType : uint8_t
+		{
+			RemoveElement,
+			RemoveAttribute,
+			SetAttribute,
+			ReplaceContent,
+			InsertBefore,
+			InsertAfter
+		};
+
+		/// <summary>
+		/// A declared action on a node. The actions of a node are chained together in the order
+		/// they were declared. Strings are kept as offsets into m_actionStrings.
+		/// </summary>
+		struct Action
+		{
+			ActionType type;
+			uint32_t next;
+			uint32_t nameOffset;
+			uint32_t nameSize;
+			uint32_t valueOffset;
+			uint32_t valueSize;
+		};
+
+		/// <summary>
+		/// Marks the end of a chain of actions.
+		/// </summary>
+		static constexpr uint32_t NoAction = UINT32_MAX;
+
+		/// <summary>
+		/// Declares an action on the supplied node, adding the node to the collection.
+		/// </summary>
+		/// <param name="node">
+		/// The node to declare the action on.
+		/// </param>
+		/// <param name="type">
+		/// The kind of action.
+		/// </param>
+		/// <param name="name">
+		/// The attribute name the action applies to, if any.
+		/// </param>
+		/// <param name="value">
+		/// The attribute value or HTML of the action, if any.
+		/// </param>
+		void AddAction(const Node* node, const ActionType type, boost::string_ref name, boost::string_ref value);
+
+		/// <summary>
+		/// Counts the supplied node towards each of its ancestors in m_rawNodeAncestors.
+		/// </summary>
+		/// <param name="rawNode">
+		/// The GumboNode* whose ancestors to count it towards.
+		/// </param>
+		void AddAncestors(const GumboNode* rawNode);
+
+		/// <summary>
+		/// Stops counting the supplied node towards each of its ancestors in m_rawNodeAncestors,
+		/// dropping any ancestor that no longer has a node counted towards it.
+		/// </summary>
+		/// <param name="rawNode">
+		/// The GumboNode* whose ancestors to stop counting it towards.
+		/// </param>
+		void RemoveAncestors(const GumboNode* rawNode);
+
+		/// <summary>
+		/// Rebuilds m_actions and m_actionStrings with only the actions of nodes still in the
+		/// collection, dropping those left unreferenced by ::Remove(...).
+		/// </summary>
+		void CompactActions();
+
+		/// <summary>
+		/// A node in a frozen collection.
+		/// </summary>
+		struct FrozenNode
+		{
+			/// <summary>
+			/// The index of the node within its document.
+			/// </summary>
+			size_t index;
+
+			/// <summary>
+			/// The node.
+			/// </summary>
+			const GumboNode* node;
+
+			/// <summary>
+			/// The index of the first action declared on the node, or NoAction.
+			/// </summary>
+			uint32_t firstAction;
+		};
+
+		/// <summary>
+		/// Discards the frozen table, if any.
+		/// </summary>
+		void Thaw();
+
+		/// <summary>
+		/// Gets the index of the first action declared on the supplied node.
+		/// </summary>
+		/// <param name="rawNode">
+		/// The GumboNode* to get the actions of.
+		/// </param>
+		/// <returns>
+		/// The index of the first action within m_actions, or NoAction if none were declared.
+		/// </returns>
+		const uint32_t GetFirstAction(const GumboNode* rawNode) const;
+
+		/// <summary>
+		/// Gets the attribute name of the supplied action.
+		/// </summary>
+		/// <param name="action">
+		/// The action to get the attribute name of.
+		/// </param>
+		/// <returns>
+		/// The attribute name of the action.
+		/// </returns>
+		boost::string_ref GetActionName(const Action& action) const;
+
+		/// <summary>
+		/// Gets the attribute value or HTML of the supplied action.
+		/// </summary>
+		/// <param name="action">
+		/// The action to get the value of.
+		/// </param>
+		/// <returns>
+		/// The attribute value or HTML of the action.
+		/// </returns>
+		boost::string_ref GetActionValue(const Action& action) const;
+
 		/// <summary>
 		/// Collection of GumboNode* objects extracted from the Node::m_node private member when
-		/// Node objects are added to this collection.
+		/// Node objects are added to this collection, each with the Node it was extracted from.
+		/// </summary>
+		std::unordered_map<const GumboNode*, const Node*> m_rawNodes;
+
+		/// <summary>
+		/// Every ancestor of the nodes in m_rawNodes, each with the number of nodes in m_rawNodes
+		/// that it is an ancestor of. Kept up to date by ::Add(...) and ::Remove(...) while
+		/// source passthrough is enabled, so that the Serializer can tell whether a subtree is
+		/// untouched without searching it. Empty while source passthrough is disabled, since
+		/// nothing else looks it up.
+		/// </summary>
+		std::unordered_map<const GumboNode*, size_t> m_rawNodeAncestors;
+
+		/// <summary>
+		/// Whether or not untouched parts of the document are copied from the source during
+		/// serialization.
+		/// </summary>
+		bool m_sourcePassthrough = false;
+
+		/// <summary>
+		/// Every declared action, for all nodes.
+		/// </summary>
+		std::vector<Action> m_actions;
+
+		/// <summary>
+		/// The first and last action declared on each node with declared actions, as indices
+		/// within m_actions.
+		/// </summary>
+		std::unordered_map<const GumboNode*, std::pair<uint32_t, uint32_t>> m_actionChains;
+
+		/// <summary>
+		/// The strings of all declared actions, one after another.
+		/// </summary>
+		std::string m_actionStrings;
+
+		/// <summary>
+		/// The number of actions in m_actions that belong to removed nodes.
+		/// </summary>
+		size_t m_unreferencedActions = 0;
+
+		/// <summary>
+		/// The number of bytes in m_actionStrings that belong to the actions of removed nodes.
+		/// </summary>
+		size_t m_unreferencedActionBytes = 0;
+
+		/// <summary>
+		/// Whether or not the collection is frozen.
+		/// </summary>
+		bool m_frozen = false;
+
+		/// <summary>
+		/// The nodes of a frozen collection, in document order.
+		/// </summary>
+		std::vector<FrozenNode> m_frozenNodes;
+
+		/// <summary>
+		/// The map of the document that the nodes of a frozen collection belong to, or nullptr if
+		/// the collection is empty.
+		/// </summary>
+		const TreeMap* m_frozenTreeMap = nullptr;
+
+		/// <summary>
+		/// The document node that the nodes of a frozen collection belong to, or nullptr if the
+		/// collection is empty.
 		/// </summary>
-		std::unordered_set<const GumboNode*> m_rawNodes;
+		const GumboNode* m_frozenDocument = nullptr;
 
 		/// <summary>
 		/// User defined callback for when serialization of a node found in this collection begins.
@@ -0,0 +1,208 @@
+/*
+* Copyright (c) 2015 Jesse Nicholson
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+
+#include "OutputSink.hpp"
+#include <stdexcept>
+
+namespace gq
+{
+
+	OutputSink::~OutputSink()
+	{
+
+	}
+
+	void OutputSink::WriteReferenced(boost::string_ref data)
+	{
+		Write(data);
+	}
+
+	void OutputSink::Flush()
+	{
+
+	}
+
+	StringOutputSink::StringOutputSink(std::string& output) :
+		m_output(output)
+	{
+
+	}
+
+	StringOutputSink::~StringOutputSink()
+	{
+
+	}
+
+	void StringOutputSink::Write(boost::string_ref data)
+	{
+		m_output.append(data.data(), data.size());
+	}
+
+	StreamOutputSink::StreamOutputSink(std::ostream& stream) :
+		m_stream(stream)
+	{
+
+	}
+
+	StreamOutputSink::~StreamOutputSink()
+	{
+
+	}
+
+	void StreamOutputSink::Write(boost::string_ref data)
+	{
+		m_stream.write(data.data(), static_cast<std::streamsize>(data.size()));
+	}
+
+	void StreamOutputSink::Flush()
+	{
+		m_stream.flush();
+	}
+
+	const size_t CallbackOutputSink::DefaultBufferSize = 16384;
+
+	CallbackOutputSink::CallbackOutputSink(Callback callback, const size_t bufferSize) :
+		m_callback(std::move(callback)),
+		m_bufferSize(bufferSize)
+	{
+		if (!m_callback)
+		{
+			throw std::runtime_error(u8"In CallbackOutputSink::CallbackOutputSink(Callback, const size_t) - The supplied callback is empty.");
+		}
+
+		m_buffer.reserve(m_bufferSize);
+	}
+
+	CallbackOutputSink::~CallbackOutputSink()
+	{
+
+	}
+
+	void CallbackOutputSink::Write(boost::string_ref data)
+	{
+		if (m_buffer.size() + data.size() > m_bufferSize)
+		{
+			Flush();
+
+			if (data.size() >= m_bufferSize)
+			{
+				m_callback(data);
+				return;
+			}
+		}
+
+		m_buffer.append(data.data(), data.size());
+	}
+
+	void CallbackOutputSink::Flush()
+	{
+		if (m_buffer.size() > 0)
+		{
+			m_callback(boost::string_ref(m_buffer));
+			m_buffer.clear();
+		}
+	}
+
+	const size_t SpanOutputSink::DefaultMinimumSpanSize = 256;
+
+	SpanOutputSink::SpanOutputSink(const size_t minimumSpanSize) :
+		m_minimumSpanSize(minimumSpanSize)
+	{
+
+	}
+
+	SpanOutputSink::~SpanOutputSink()
+	{
+
+	}
+
+	void SpanOutputSink::Write(boost::string_ref data)
+	{
+		if (data.empty())
+		{
+			return;
+		}
+
+		if (m_spans.empty() || m_spans.back().referenced != nullptr)
+		{
+			m_spans.push_back({ nullptr, m_buffer.size(), 0 });
+		}
+
+		m_buffer.append(data.data(), data.size());
+		m_spans.back().size += data.size();
+		m_size += data.size();
+	}
+
+	void SpanOutputSink::WriteReferenced(boost::string_ref data)
+	{
+		if (data.size() < m_minimumSpanSize)
+		{
+			Write(data);
+			return;
+		}
+
+		// Spans copied from the source one after another are often contiguous in it.
+		if (!m_spans.empty() && m_spans.back().referenced != nullptr && m_spans.back().referenced + m_spans.back().size == data.data())
+		{
+			m_spans.back().size += data.size();
+		}
+		else
+		{
+			m_spans.push_back({ data.data(), 0, data.size() });
+		}
+
+		m_size += data.size();
+	}
+
+	std::vector<boost::string_ref> SpanOutputSink::GetSpans() const
+	{
+		std::vector<boost::string_ref> spans;
+		spans.reserve(m_spans.size());
+
+		for (const auto& span : m_spans)
+		{
+			const char* data = span.referenced != nullptr ? span.referenced : m_buffer.data() + span.offset;
+			spans.emplace_back(data, span.size);
+		}
+
+		return spans;
+	}
+
+	const size_t SpanOutputSink::GetSpanCount() const
+	{
+		return m_spans.size();
+	}
+
+	const size_t SpanOutputSink::GetSize() const
+	{
+		return m_size;
+	}
+
+	void SpanOutputSink::Clear()
+	{
+		m_spans.clear();
+		m_buffer.clear();
+		m_size = 0;
+	}
+
+} /* namespace gq */
@@ -0,0 +1,316 @@
+/*
+* Copyright (c) 2015 Jesse Nicholson
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <boost/utility/string_ref.hpp>
+
+namespace gq
+{
+
+	/// <summary>
+	/// An OutputSink receives the output of the Serializer as it's produced, piece by piece and
+	/// in order, so that a document can be serialized straight to its destination without first
+	/// being assembled in a string. Implement ::Write(...) to send output anywhere else.
+	/// </summary>
+	class OutputSink
+	{
+
+	public:
+
+		/// <summary>
+		/// Default destructor.
+		/// </summary>
+		virtual ~OutputSink();
+
+		/// <summary>
+		/// Receives the next piece of output. The supplied data is only valid for the duration of
+		/// the call.
+		/// </summary>
+		/// <param name="data">
+		/// The next piece of output.
+		/// </param>
+		virtual void Write(boost::string_ref data) = 0;
+
+		/// <summary>
+		/// Receives the next piece of output, which the Serializer guarantees to remain valid and
+		/// unchanged for as long as the document it belongs to, and the HTML string the document
+		/// was parsed from, are alive. This is the case for any output the Serializer takes from
+		/// the source, such as text, attributes and spans copied from the source. Sinks may keep a
+		/// reference to such output rather than copying it. Calls ::Write(...) by default.
+		/// </summary>
+		/// <param name="data">
+		/// The next piece of output.
+		/// </param>
+		virtual void WriteReferenced(boost::string_ref data);
+
+		/// <summary>
+		/// Passes on any output held back by this sink. The Serializer calls this once it has
+		/// written all output for a call. Does nothing by default.
+		/// </summary>
+		virtual void Flush();
+
+	};
+
+	/// <summary>
+	/// Appends all output to a string. The Serializer overloads that return a string use this
+	/// sink internally.
+	/// </summary>
+	class StringOutputSink final : public OutputSink
+	{
+
+	public:
+
+		/// <summary>
+		/// Constructs a sink that appends to the supplied string, which must outlive the sink.
+		/// </summary>
+		/// <param name="output">
+		/// The string to append all output to.
+		/// </param>
+		StringOutputSink(std::string& output);
+
+		/// <summary>
+		/// Default destructor.
+		/// </summary>
+		virtual ~StringOutputSink();
+
+		virtual void Write(boost::string_ref data);
+
+	private:
+
+		/// <summary>
+		/// The string receiving all output.
+		/// </summary>
+		std::string& m_output;
+
+	};
+
+	/// <summary>
+	/// Writes all output to a stream.
+	/// </summary>
+	class StreamOutputSink final : public OutputSink
+	{
+
+	public:
+
+		/// <summary>
+		/// Constructs a sink that writes to the supplied stream, which must outlive the sink.
+		/// </summary>
+		/// <param name="stream">
+		/// The stream to write all output to.
+		/// </param>
+		StreamOutputSink(std::ostream& stream);
+
+		/// <summary>
+		/// Default destructor.
+		/// </summary>
+		virtual ~StreamOutputSink();
+
+		virtual void Write(boost::string_ref data);
+
+		/// <summary>
+		/// Flushes the stream.
+		/// </summary>
+		virtual void Flush();
+
+	private:
+
+		/// <summary>
+		/// The stream receiving all output.
+		/// </summary>
+		std::ostream& m_stream;
+
+	};
+
+	/// <summary>
+	/// Hands output to a user supplied callback. Since serialized output consists of many small
+	/// pieces, output is gathered into a buffer of a fixed size, and the callback is invoked each
+	/// time the buffer fills up, as well as when the sink is flushed. Pieces that are at least
+	/// as large as the buffer are handed to the callback directly.
+	/// </summary>
+	class CallbackOutputSink final : public OutputSink
+	{
+
+	public:
+
+		using Callback = std::function<void(boost::string_ref data)>;
+
+		/// <summary>
+		/// The size of the buffer when none is specified.
+		/// </summary>
+		static const size_t DefaultBufferSize;
+
+		/// <summary>
+		/// Constructs a sink that hands output to the supplied callback.
+		/// </summary>
+		/// <param name="callback">
+		/// The callback to receive output. The data it receives is only valid for the duration
+		/// of the call.
+		/// </param>
+		/// <param name="bufferSize">
+		/// The number of bytes to gather before invoking the callback.
+		/// </param>
+		CallbackOutputSink(Callback callback, const size_t bufferSize = DefaultBufferSize);
+
+		/// <summary>
+		/// Default destructor. Output that was never flushed is discarded, so that the callback
+		/// is never invoked from a destructor.
+		/// </summary>
+		virtual ~CallbackOutputSink();
+
+		virtual void Write(boost::string_ref data);
+
+		/// <summary>
+		/// Hands any buffered output to the callback.
+		/// </summary>
+		virtual void Flush();
+
+	private:
+
+		/// <summary>
+		/// The callback receiving output.
+		/// </summary>
+		Callback m_callback;
+
+		/// <summary>
+		/// Output waiting to be handed to the callback.
+		/// </summary>
+		std::string m_buffer;
+
+		/// <summary>
+		/// The number of bytes to gather before invoking the callback.
+		/// </summary>
+		size_t m_bufferSize;
+
+	};
+
+	/// <summary>
+	/// Gathers output as a list of spans rather than a contiguous string, for scatter-gather
+	/// writes such as writev(...) or WSASend(...). Output that the Serializer takes from the
+	/// source is referenced where it lies, while everything else, like generated tags, is copied
+	/// into a side buffer held by this sink. Adjacent pieces of output are merged into one span
+	/// wherever possible. Referenced pieces smaller than a minimum size are copied as well, so that
+	/// the span list doesn't grow needlessly long.
+	/// <para>&#160;</para>
+	/// The spans are only valid for as long as this sink, the document that was serialized and
+	/// the HTML string that document was parsed from are all alive, and this sink isn't written
+	/// to or cleared.
+	/// </summary>
+	class SpanOutputSink final : public OutputSink
+	{
+
+	public:
+
+		/// <summary>
+		/// The minimum size of referenced spans when none is specified.
+		/// </summary>
+		static const size_t DefaultMinimumSpanSize;
+
+		/// <summary>
+		/// Constructs an empty sink.
+		/// </summary>
+		/// <param name="minimumSpanSize">
+		/// The smallest referenced piece of output that is kept as a span of its own. Smaller
+		/// pieces are copied into the side buffer.
+		/// </param>
+		SpanOutputSink(const size_t minimumSpanSize = DefaultMinimumSpanSize);
+
+		/// <summary>
+		/// Default destructor.
+		/// </summary>
+		virtual ~SpanOutputSink();
+
+		virtual void Write(boost::string_ref data);
+
+		virtual void WriteReferenced(boost::string_ref data);
+
+		/// <summary>
+		/// Gets the spans that make up all output written to this sink so far, in order.
+		/// </summary>
+		/// <returns>
+		/// The spans that make up the output.
+		/// </returns>
+		std::vector<boost::string_ref> GetSpans() const;
+
+		/// <summary>
+		/// Gets the number of spans that make up the output.
+		/// </summary>
+		/// <returns>
+		/// The number of spans that make up the output.
+		/// </returns>
+		const size_t GetSpanCount() const;
+
+		/// <summary>
+		/// Gets the total size, in bytes, of all output written to this sink so far.
+		/// </summary>
+		/// <returns>
+		/// The total size of the output.
+		/// </returns>
+		const size_t GetSize() const;
+
+		/// <summary>
+		/// Discards all output, keeping the memory already allocated for reuse.
+		/// </summary>
+		void Clear();
+
+	private:
+
+		/// <summary>
+		/// A span of output, which either references output where it lies, or is found at an
+		/// offset within the side buffer.
+		/// </summary>
+		struct Span
+		{
+			const char* referenced;
+			size_t offset;
+			size_t size;
+		};
+
+		/// <summary>
+		/// The spans of output, in order.
+		/// </summary>
+		std::vector<Span> m_spans;
+
+		/// <summary>
+		/// Output copied into this sink.
+		/// </summary>
+		std::string m_buffer;
+
+		/// <summary>
+		/// The total size of the output.
+		/// </summary>
+		size_t m_size = 0;
+
+		/// <summary>
+		/// The smallest referenced piece of output that is kept as a span of its own.
+		/// </summary>
+		size_t m_minimumSpanSize;
+
+	};
+
+} /* namespace gq */
@@ -27,9 +27,12 @@
 * THE SOFTWARE.
 */
 
+#include <limits>
 #include "Parser.hpp"
 #include "AttributeSelector.hpp"
 #include "BinarySelector.hpp"
+#include "CharClass.hpp"
+#include "Regex.hpp"
 #include "TextSelector.hpp"
 #include "UnarySelector.hpp"
 
@@ -58,58 +61,122 @@ namespace gq
 		{ u8"empty", PseudoOp::Empty }
 	};
 
+	constexpr size_t Parser::MaxPseudoNameLength;
+
 	Parser::Parser()
 	{
-    #ifdef __linux__
-        // The locale has a '_' instead of '-' on linux
-        m_localeEnUS = std::locale(u8"en_US");
-    #else
-        m_localeEnUS = std::locale(u8"en-US");
-    #endif //__linux__
+		
 	}
 
 	Parser::~Parser()
 	{
 	}
 
-	SharedSelector Parser::CreateSelector(std::string selectorString, const bool retainOriginalString) const
+	Parser::ParseResult::operator bool() const
 	{
-		boost::string_ref input = boost::string_ref(selectorString);
+		return m_errorCode == ErrorCode::None;
+	}
 
-		try
-		{
-			SharedSelector result = ParseSelectorGroup(input);
+	const SharedSelector& Parser::ParseResult::GetSelector() const
+	{
+		return m_selector;
+	}
 
-			if (input.size() != 0) 
-			{ 
-				// There's no assert on debug here, because it's expected that user input may
-				// contain invalid data. Passing a poorly formatted selector string isn't a matter
-				// of a developer user using the library improperly, so no assert. The idea is that
-				// any user should expect this method to throw and hence be ready to handle it, and
-				// that a detailed message of the issue be returned in the error.
-				throw std::runtime_error(u8"In Parser::CreateSelector(std::string, const bool) - Improperly formatted selector string."); 
-			}
+	const Parser::ErrorCode Parser::ParseResult::GetErrorCode() const
+	{
+		return m_errorCode;
+	}
 
-			if (retainOriginalString)
-			{
-				result->m_originalSelectorString = std::move(selectorString);
-			}			
+	const size_t Parser::ParseResult::GetErrorOffset() const
+	{
+		return m_errorOffset;
+	}
+
+	const char* Parser::ParseResult::GetErrorMessage() const
+	{
+		return m_errorMessage;
+	}
 
+	Parser::ParseResult Parser::TryCreateSelector(boost::string_ref selectorString, const bool retainOriginalString) const
+	{
+		ParseResult result;
+
+		ParseState state;
+		state.begin = selectorString.data();
+
+		boost::string_ref input = selectorString;
+
+		// Every part of the selector is built in the same arena. Unless the caller has opened
+		// a scope of their own, this selector gets an arena all to itself, released along with
+		// the selector.
+		SelectorArena::Scope arenaScope;
+
+		SharedSelector selector = ParseSelectorGroup(state, input);
+
+		if (!state.Failed() && input.size() != 0)
+		{
+			// There's no assert on debug here, because it's expected that user input may
+			// contain invalid data. Passing a poorly formatted selector string isn't a matter
+			// of a developer user using the library improperly, so no assert. The idea is that
+			// any user should expect this to fail and hence be ready to handle it, and that a
+			// detailed description of the issue be returned in the result.
+			Fail(state, ErrorCode::TrailingInput, u8"In Parser::TryCreateSelector(boost::string_ref, const bool) - Improperly formatted selector string.", input);
+		}
+
+		if (state.Failed())
+		{
+			result.m_errorCode = state.errorCode;
+			result.m_errorMessage = state.errorMessage;
+			result.m_errorOffset = state.errorOffset;
 			return result;
 		}
-		catch (std::runtime_error& e)
+
+		if (retainOriginalString)
+		{
+			selector->m_originalSelectorString = selector->InternString(selectorString);
+		}
+
+		result.m_selector = std::move(selector);
+
+		return result;
+	}
+
+	SharedSelector Parser::CreateSelector(std::string selectorString, const bool retainOriginalString) const
+	{
+		ParseResult result = TryCreateSelector(selectorString, retainOriginalString);
+
+		if (!result)
 		{
-			std::string errorMessage(e.what());
-			errorMessage.append(std::string(u8" -- [HERE>>>>>") + input.to_string() + std::string(u8"<<<<<]"));
+			std::string errorMessage(result.GetErrorMessage());
+			errorMessage.append(u8" -- [HERE>>>>>").append(selectorString, result.GetErrorOffset(), std::string::npos).append(u8"<<<<<]");
 
 			throw std::runtime_error(errorMessage.c_str());
 		}		
+
+		return result.GetSelector();
+	}
+
+	void Parser::Fail(ParseState& state, const ErrorCode errorCode, const char* errorMessage, const boost::string_ref at) const
+	{
+		if (state.Failed())
+		{
+			return;
+		}
+
+		state.errorCode = errorCode;
+		state.errorMessage = errorMessage;
+		state.errorOffset = at.data() != nullptr ? static_cast<size_t>(at.data() - state.begin) : 0;
 	}
 
-	SharedSelector Parser::ParseSelectorGroup(boost::string_ref& selectorStr) const
+	SharedSelector Parser::ParseSelectorGroup(ParseState& state, boost::string_ref& selectorStr) const
 	{
 		// Parse the first selector object from the input supplied. 
-		SharedSelector ret = ParseSelector(selectorStr);
+		SharedSelector ret = ParseSelector(state, selectorStr);
+
+		if (state.Failed())
+		{
+			return nullptr;
+		}
 
 		// ParseSelector() will stop if it encounters a character in the selector string that
 		// indicates that the supplied input is a selector group. That is, if "," is encountered
@@ -124,19 +191,29 @@ namespace gq
 		{
 			selectorStr = selectorStr.substr(1);
 
-			SharedSelector second = ParseSelector(selectorStr);
+			SharedSelector second = ParseSelector(state, selectorStr);
+
+			if (state.Failed())
+			{
+				return nullptr;
+			}
 
-			ret = std::make_shared<BinarySelector>(BinarySelector::SelectorOperator::Union, ret, second);
+			ret = SelectorArena::MakeShared<BinarySelector>(BinarySelector::SelectorOperator::Union, ret, second);
 		}
 
 		return ret;
 	}
 
-	SharedSelector Parser::ParseSelector(boost::string_ref& selectorStr) const
+	SharedSelector Parser::ParseSelector(ParseState& state, boost::string_ref& selectorStr) const
 	{
 		TrimLeadingWhitespace(selectorStr);
 
-		SharedSelector ret = ParseSimpleSelectorSequence(selectorStr);
+		SharedSelector ret = ParseSimpleSelectorSequence(state, selectorStr);
+
+		if (state.Failed())
+		{
+			return nullptr;
+		}
 
 		char combinator = 0;
 
@@ -149,19 +226,21 @@ namespace gq
 				combinator = ' ';
 
 				// In the event of " > ", we do this.
-				if (selectorStr.size() > 0 && combinator == ' ' && IsCombinator(selectorStr[0]))
+				if (selectorStr.size() > 0 && combinator == ' ' && CharClass::IsCombinator(selectorStr[0]))
 				{
 					combinator = selectorStr[0];
 					
-					if (!IsCombinator(combinator))
+					if (!CharClass::IsCombinator(combinator))
 					{
-						throw std::runtime_error(u8"In Parser::ParseSelector(boost::string_ref&) - Invalid combinator supplied.");
+						Fail(state, ErrorCode::InvalidCombinator, u8"In Parser::ParseSelector(ParseState&, boost::string_ref&) - Invalid combinator supplied.", selectorStr);
+						return nullptr;
 					}
 
 					selectorStr = selectorStr.substr(1);
 					if (!TrimLeadingWhitespace(selectorStr))
 					{
-						throw std::runtime_error(u8"In Parser::ParseSelector(boost::string_ref&) - Invalid combinator supplied. Combinator had leading whitespace without trailing whitespace.");
+						Fail(state, ErrorCode::InvalidCombinator, u8"In Parser::ParseSelector(ParseState&, boost::string_ref&) - Invalid combinator supplied. Combinator had leading whitespace without trailing whitespace.", selectorStr);
+						return nullptr;
 					}
 				}
 			}
@@ -191,31 +270,36 @@ namespace gq
 				return ret;
 			}
 
-			SharedSelector selector = ParseSimpleSelectorSequence(selectorStr);
+			SharedSelector selector = ParseSimpleSelectorSequence(state, selectorStr);
+
+			if (state.Failed())
+			{
+				return nullptr;
+			}
 
 			switch (combinator)
 			{
 				case ' ':
 				{
-					ret = std::make_shared<BinarySelector>(BinarySelector::SelectorOperator::Descendant, ret, selector);
+					ret = SelectorArena::MakeShared<BinarySelector>(BinarySelector::SelectorOperator::Descendant, ret, selector);
 				}
 				break;
 
 				case '>':
 				{
-					ret = std::make_shared<BinarySelector>(BinarySelector::SelectorOperator::Child, ret, selector);
+					ret = SelectorArena::MakeShared<BinarySelector>(BinarySelector::SelectorOperator::Child, ret, selector);
 				}
 				break;
 
 				case '+':
 				{
-					ret = std::make_shared<BinarySelector>(BinarySelector::SelectorOperator::Adjacent, ret, selector);
+					ret = SelectorArena::MakeShared<BinarySelector>(BinarySelector::SelectorOperator::Adjacent, ret, selector);
 				}
 				break;
 
 				case '~':
 				{
-					ret = std::make_shared<BinarySelector>(BinarySelector::SelectorOperator::Sibling, ret, selector);
+					ret = SelectorArena::MakeShared<BinarySelector>(BinarySelector::SelectorOperator::Sibling, ret, selector);
 				}
 				break;
 
@@ -223,7 +307,8 @@ namespace gq
 					// This should never happen, since we've correctly only accepted valid
 					// combinators. However, if somehow this happens, we should explode the
 					// universe.
-					throw std::runtime_error(u8"In Parser::ParseSelector(boost::string_ref&) - Invalid combinator supplied.");
+					Fail(state, ErrorCode::InvalidCombinator, u8"In Parser::ParseSelector(ParseState&, boost::string_ref&) - Invalid combinator supplied.", selectorStr);
+					return nullptr;
 			}
 
 			combinator = 0;
@@ -232,11 +317,12 @@ namespace gq
 		return ret;
 	}
 
-	SharedSelector Parser::ParseSimpleSelectorSequence(boost::string_ref& selectorStr) const
+	SharedSelector Parser::ParseSimpleSelectorSequence(ParseState& state, boost::string_ref& selectorStr) const
 	{
 		if (selectorStr.size() == 0)
 		{
-			throw std::runtime_error(u8"In Parser::ParseSimpleSelectorSequence(boost::string_ref&) - Expected selector string, received empty string.");
+			Fail(state, ErrorCode::ExpectedSelector, u8"In Parser::ParseSimpleSelectorSequence(ParseState&, boost::string_ref&) - Expected selector string, received empty string.", selectorStr);
+			return nullptr;
 		}
 
 		SharedSelector ret = nullptr;
@@ -249,7 +335,7 @@ namespace gq
 			{
 				// Dummy selector. Matches anything.
 				selectorStr = selectorStr.substr(1);
-				return std::make_shared<Selector>(Selector::SelectorOperator::Dummy);
+				return SelectorArena::MakeShared<Selector>(Selector::SelectorOperator::Dummy);
 			}
 			break;
 
@@ -267,8 +353,13 @@ namespace gq
 			default:
 			{
 				// Assume it's a type selector. If it is valid, will return a valid object. If not,
-				// it will be nullptr. We'll handle either situation a little later.
-				ret = ParseTypeSelector(selectorStr);
+				// an error will have been recorded.
+				ret = ParseTypeSelector(state, selectorStr);
+
+				if (state.Failed())
+				{
+					return nullptr;
+				}
 			}
 			break;
 		}
@@ -281,7 +372,7 @@ namespace gq
 
 			zero = selectorStr[0];
 
-			if (IsCombinator(zero))
+			if (CharClass::IsCombinator(zero))
 			{
 				// If the next part of the string is a combinator, then we'll break and return,
 				// allowing ParseSelector() to correctly handle combined selectors.
@@ -292,25 +383,30 @@ namespace gq
 			{
 				case '#':
 				{
-					selector = ParseIDSelector(selectorStr);
+					selector = ParseIDSelector(state, selectorStr);
 				}
 				break;
 
 				case '.':
 				{
-					selector = ParseClassSelector(selectorStr);
+					selector = ParseClassSelector(state, selectorStr);
 				}
 				break;
 
 				case '[':
 				{
-					selector = ParseAttributeSelector(selectorStr);
+					selector = ParseAttributeSelector(state, selectorStr);
 				}
 				break;
 
 				case ':':
 				{
-					selector = ParsePseudoclassSelector(selectorStr);
+					selector = ParsePseudoclassSelector(state, selectorStr);
+
+					if (state.Failed())
+					{
+						return nullptr;
+					}
 
 					if (ret == nullptr)
 					{
@@ -328,7 +424,7 @@ namespace gq
 						// the only attributes we'd get from such a selector are {
 						// NORMALIZED_TAG_NAME_KEY, p }, which would only find candidates which
 						// actually cannot possibly ever match this selector.
-						selector = std::make_shared<BinarySelector>(BinarySelector::SelectorOperator::Intersection, std::make_shared<Selector>(Selector::SelectorOperator::Dummy), selector);
+						selector = SelectorArena::MakeShared<BinarySelector>(BinarySelector::SelectorOperator::Intersection, SelectorArena::MakeShared<Selector>(Selector::SelectorOperator::Dummy), selector);
 					}
 				}
 				break;
@@ -340,46 +436,70 @@ namespace gq
 				break;
 			}
 
+			if (state.Failed())
+			{
+				return nullptr;
+			}
+
 			if (ret == nullptr)
 			{
 				ret = selector;
 			}
 			else if(selector != nullptr)
 			{
-				ret = std::make_shared<BinarySelector>(BinarySelector::SelectorOperator::Intersection, ret, selector);
+				ret = SelectorArena::MakeShared<BinarySelector>(BinarySelector::SelectorOperator::Intersection, ret, selector);
 			}
 		}
 
 		if (ret == nullptr)
 		{
-			throw std::runtime_error(u8"In Parser::ParseSimpleSelectorSequence(boost::string_ref&) - Failed to generate a single selector. The supplied selector string must have been invalid.");
+			Fail(state, ErrorCode::ExpectedSelector, u8"In Parser::ParseSimpleSelectorSequence(ParseState&, boost::string_ref&) - Failed to generate a single selector. The supplied selector string must have been invalid.", selectorStr);
+			return nullptr;
 		}
 
 		return ret;
 	}
 
-	SharedSelector Parser::ParsePseudoclassSelector(boost::string_ref& selectorStr) const
+	SharedSelector Parser::ParsePseudoclassSelector(ParseState& state, boost::string_ref& selectorStr) const
 	{
 		if (selectorStr.size() == 0 || selectorStr[0] != ':')
 		{
-			throw std::runtime_error(u8"In Parser::ParsePseudoclassSelector(boost::string_ref&) - Expected pseudo class selector string.");
+			Fail(state, ErrorCode::ExpectedSelector, u8"In Parser::ParsePseudoclassSelector(ParseState&, boost::string_ref&) - Expected pseudo class selector string.", selectorStr);
+			return nullptr;
 		}
 
 		selectorStr = selectorStr.substr(1);
 
-		boost::string_ref name = ParseIdentifier(selectorStr);
+		const boost::string_ref nameStart = selectorStr;
+
+		boost::string_ref name = ParseIdentifier(state, selectorStr);
+
+		if (state.Failed())
+		{
+			return nullptr;
+		}
+
+		// Fold the name to lower case into a buffer on the stack for the lookup. Anything longer
+		// than the buffer can't be a supported pseudo selector, so it's left to fail the lookup.
+		char lowerName[MaxPseudoNameLength];
+		auto pseudoOperatorResult = PseudoOps.end();
 
-		// Unfortunately, we need to copy out to a new string so we can force it to lower case 
-		std::string nameAsString = name.to_string();
-		boost::to_lower(nameAsString);
-		name = boost::string_ref(nameAsString);
+		if (name.size() <= MaxPseudoNameLength)
+		{
+			for (size_t i = 0; i < name.size(); ++i)
+			{
+				lowerName[i] = CharClass::ToLower(name[i]);
+			}
 
-		const auto pseudoOperatorResult = PseudoOps.find(name);
+			pseudoOperatorResult = PseudoOps.find(boost::string_ref(lowerName, name.size()));
+		}
 
 		if (pseudoOperatorResult == PseudoOps.end())
 		{
-			std::string errString = u8"In Parser::ParsePseudoclassSelector(boost::string_ref&) - Unsupported Pseudo selector type: " + nameAsString;
-			throw std::runtime_error(errString.c_str());
+			// The offset of the error is the start of the name, so the unsupported name itself
+			// is what gets pointed out to the user.
+			Fail(state, ErrorCode::UnsupportedPseudoClass, u8"In Parser::ParsePseudoclassSelector(ParseState&, boost::string_ref&) - Unsupported Pseudo selector type.", nameStart);
+			return nullptr;
 		}
 
 		switch (pseudoOperatorResult->second)
@@ -388,11 +508,17 @@ namespace gq
 			case PseudoOp::Has:
 			case PseudoOp::HasChild:
 			{
-				ConsumeOpeningParenthesis(selectorStr);
+				if (!ConsumeOpeningParenthesis(state, selectorStr))
+				{
+					return nullptr;
+				}
 
-				SharedSelector sel = ParseSelectorGroup(selectorStr);
+				SharedSelector sel = ParseSelectorGroup(state, selectorStr);
 
-				ConsumeClosingParenthesis(selectorStr);
+				if (state.Failed() || !ConsumeClosingParenthesis(state, selectorStr))
+				{
+					return nullptr;
+				}
 
 				UnarySelector::SelectorOperator op;
 
@@ -409,7 +535,7 @@ namespace gq
 					op = UnarySelector::SelectorOperator::HasChild;
 				}
 
-				return std::make_shared<UnarySelector>(op, sel);
+				return SelectorArena::MakeShared<UnarySelector>(op, sel);
 			}
 			break;
 
@@ -418,23 +544,35 @@ namespace gq
 			case PseudoOp::Matches:
 			case PseudoOp::MatchesOwn:
 			{
-				ConsumeOpeningParenthesis(selectorStr);
+				if (!ConsumeOpeningParenthesis(state, selectorStr))
+				{
+					return nullptr;
+				}
+
+				const boost::string_ref valueStart = selectorStr;
 
 				boost::string_ref value;
 
-				const char& c = selectorStr[0];
-				if (c == '\'' || c == '"')
+				if (selectorStr.size() > 0 && (selectorStr[0] == '\'' || selectorStr[0] == '"'))
 				{
-					value = ParseString(selectorStr);
+					value = ParseString(state, selectorStr);
 				}
 				else
 				{
-					value = ParseIdentifier(selectorStr);
+					value = ParseIdentifier(state, selectorStr);
+				}
+
+				if (state.Failed())
+				{
+					return nullptr;
 				}
 
 				TrimLeadingWhitespace(selectorStr);
 
-				ConsumeClosingParenthesis(selectorStr);
+				if (!ConsumeClosingParenthesis(state, selectorStr))
+				{
+					return nullptr;
+				}
 
 				TextSelector::SelectorOperator op;
 
@@ -455,7 +593,22 @@ namespace gq
 					op = TextSelector::SelectorOperator::MatchesOwn;
 				}
 
-				return std::make_shared<TextSelector>(op, value);
+				if (op == TextSelector::SelectorOperator::Matches || op == TextSelector::SelectorOperator::MatchesOwn)
+				{
+					// The expression is held until the selector is built, so that the selector picks up
+					// this same compiled instance from the cache rather than compiling it again.
+					auto expression = Regex::Get(value);
+
+					if (expression == nullptr)
+					{
+						Fail(state, ErrorCode::InvalidRegex, u8"In Parser::ParsePseudoclassSelector(ParseState&, boost::string_ref&) - Invalid or unsupported regular expression supplied.", valueStart);
+						return nullptr;
+					}
+
+					return SelectorArena::MakeShared<TextSelector>(op, value);
+				}
+
+				return SelectorArena::MakeShared<TextSelector>(op, value);
 			}
 			break;
 
@@ -464,59 +617,59 @@ namespace gq
 			case PseudoOp::NthOfType:
 			case PseudoOp::NthLastOfType:
 			{
-				ConsumeOpeningParenthesis(selectorStr);
-
 				int lhs, rhs;
-				ParseNth(selectorStr, lhs, rhs);
 
-				ConsumeClosingParenthesis(selectorStr);
+				if (!ConsumeOpeningParenthesis(state, selectorStr) || !ParseNth(state, selectorStr, lhs, rhs) || !ConsumeClosingParenthesis(state, selectorStr))
+				{
+					return nullptr;
+				}
 
 				bool matchLast = (pseudoOperatorResult->second == PseudoOp::NthLastChild || pseudoOperatorResult->second == PseudoOp::NthLastOfType);
 				bool matchType = (pseudoOperatorResult->second == PseudoOp::NthOfType || pseudoOperatorResult->second == PseudoOp::NthLastOfType);
 				
-				return std::make_shared<Selector>(lhs, rhs, matchLast, matchType);
+				return SelectorArena::MakeShared<Selector>(lhs, rhs, matchLast, matchType);
 			}
 			break;
 
 			case PseudoOp::FirstChild:
 			{
-				return std::make_shared<Selector>(0, 1, false, false);
+				return SelectorArena::MakeShared<Selector>(0, 1, false, false);
 			}
 			break;
 
 			case PseudoOp::LastChild:
 			{
-				return std::make_shared<Selector>(0, 1, true, false);
+				return SelectorArena::MakeShared<Selector>(0, 1, true, false);
 			}
 			break;
 
 			case PseudoOp::FirstOfType:
 			{
-				return std::make_shared<Selector>(0, 1, false, true);
+				return SelectorArena::MakeShared<Selector>(0, 1, false, true);
 			}
 			break;
 
 			case PseudoOp::LastOfType:
 			{
-				return std::make_shared<Selector>(0, 1, true, true);
+				return SelectorArena::MakeShared<Selector>(0, 1, true, true);
 			}
 			break;
 
 			case PseudoOp::OnlyChild:
 			{
-				return std::make_shared<Selector>(false);
+				return SelectorArena::MakeShared<Selector>(false);
 			}
 			break;
 
 			case PseudoOp::OnlyOfType:
 			{
-				return std::make_shared<Selector>(true);
+				return SelectorArena::MakeShared<Selector>(true);
 			}
 			break;
 
 			case PseudoOp::Empty:
 			{
-				return std::make_shared<Selector>(Selector::SelectorOperator::Empty);
+				return SelectorArena::MakeShared<Selector>(Selector::SelectorOperator::Empty);
 			}
 			break;
 		} /* switch (pseudoOperatorResult->second) */
@@ -524,11 +677,12 @@ namespace gq
 		return nullptr;
 	}
 
-	SharedSelector Parser::ParseAttributeSelector(boost::string_ref& selectorStr) const
+	SharedSelector Parser::ParseAttributeSelector(ParseState& state, boost::string_ref& selectorStr) const
 	{
 		if (selectorStr.size() == 0 || selectorStr[0] != '[')
 		{
-			throw std::runtime_error(u8"In Parser::ParseAttributeSelector(boost::string_ref&) - Expected atrribute selector string.");
+			Fail(state, ErrorCode::InvalidAttributeSelector, u8"In Parser::ParseAttributeSelector(ParseState&, boost::string_ref&) - Expected atrribute selector string.", selectorStr);
+			return nullptr;
 		}
 
 		selectorStr = selectorStr.substr(1);
@@ -536,7 +690,8 @@ namespace gq
 
 		if (selectorStr.length() == 0)
 		{
-			throw std::runtime_error(u8"In Parser::ParseAttributeSelector(boost::string_ref&) - Expected identifier, reached EOF instead.");
+			Fail(state, ErrorCode::InvalidAttributeSelector, u8"In Parser::ParseAttributeSelector(ParseState&, boost::string_ref&) - Expected identifier, reached EOF instead.", selectorStr);
+			return nullptr;
 		}
 
 		// This is used for matching attributes not exactly, but by a specific prefix. If this is
@@ -548,19 +703,23 @@ namespace gq
 		//		someplace="theplaceattheend"
 		//
 		// XXX TODO it has been decided that the complexity this adds is undesirable.
-		bool doesAttributeHasPrefix = false;
 		if (selectorStr[0] == '^')
 		{
-			throw std::runtime_error(u8"In Parser::ParseAttributeSelector(boost::string_ref&) - Attribute name as prefix selector is unsupported.");
-			doesAttributeHasPrefix = true;
-			selectorStr = selectorStr.substr(1);
+			Fail(state, ErrorCode::InvalidAttributeSelector, u8"In Parser::ParseAttributeSelector(ParseState&, boost::string_ref&) - Attribute name as prefix selector is unsupported.", selectorStr);
+			return nullptr;
 		}
 
-		boost::string_ref key = ParseIdentifier(selectorStr);
+		boost::string_ref key = ParseIdentifier(state, selectorStr);
+
+		if (state.Failed())
+		{
+			return nullptr;
+		}
 
 		if (selectorStr.length() == 0)
 		{
-			throw std::runtime_error(u8"In Parser::ParseAttributeSelector(boost::string_ref&) - No value for identifier specified and no closing brace found.");
+			Fail(state, ErrorCode::InvalidAttributeSelector, u8"In Parser::ParseAttributeSelector(ParseState&, boost::string_ref&) - No value for identifier specified and no closing brace found.", selectorStr);
+			return nullptr;
 		}
 
 		const char& valueMatchFirstChar = selectorStr[0];
@@ -578,7 +737,7 @@ namespace gq
 			// though as well.
 			selectorStr = selectorStr.substr(1);
 
-			return std::make_shared<AttributeSelector>(key);
+			return SelectorArena::MakeShared<AttributeSelector>(key);
 		}
 		break;
 
@@ -593,7 +752,8 @@ namespace gq
 			}
 			else
 			{
-				throw std::runtime_error(u8"In Parser::ParseAttributeSelector(boost::string_ref&) - Broken hypen attribute value match supplied.");
+				Fail(state, ErrorCode::InvalidAttributeSelector, u8"In Parser::ParseAttributeSelector(ParseState&, boost::string_ref&) - Broken hypen attribute value match supplied.", selectorStr);
+				return nullptr;
 			}
 		}
 		break;
@@ -608,7 +768,8 @@ namespace gq
 			}
 			else
 			{
-				throw std::runtime_error(u8"In Parser::ParseAttributeSelector(boost::string_ref&) - Broken whitespace attribute value match supplied.");
+				Fail(state, ErrorCode::InvalidAttributeSelector, u8"In Parser::ParseAttributeSelector(ParseState&, boost::string_ref&) - Broken whitespace attribute value match supplied.", selectorStr);
+				return nullptr;
 			}
 		}
 		break;
@@ -623,7 +784,8 @@ namespace gq
 			}
 			else
 			{
-				throw std::runtime_error(u8"In Parser::ParseAttributeSelector(boost::string_ref&) - Broken prefix attribute value match supplied.");
+				Fail(state, ErrorCode::InvalidAttributeSelector, u8"In Parser::ParseAttributeSelector(ParseState&, boost::string_ref&) - Broken prefix attribute value match supplied.", selectorStr);
+				return nullptr;
 			}
 		}
 		break;
@@ -638,7 +800,8 @@ namespace gq
 			}
 			else
 			{
-				throw std::runtime_error(u8"In Parser::ParseAttributeSelector(boost::string_ref&) - Broken suffix attribute value match supplied.");
+				Fail(state, ErrorCode::InvalidAttributeSelector, u8"In Parser::ParseAttributeSelector(ParseState&, boost::string_ref&) - Broken suffix attribute value match supplied.", selectorStr);
+				return nullptr;
 			}
 		}
 		break;
@@ -653,7 +816,8 @@ namespace gq
 			}
 			else
 			{
-				throw std::runtime_error(u8"In Parser::ParseAttributeSelector(boost::string_ref&) - Broken substring attribute value match supplied.");
+				Fail(state, ErrorCode::InvalidAttributeSelector, u8"In Parser::ParseAttributeSelector(ParseState&, boost::string_ref&) - Broken substring attribute value match supplied.", selectorStr);
+				return nullptr;
 			}
 		}
 		break;
@@ -669,13 +833,15 @@ namespace gq
 			}
 			else
 			{
-				throw std::runtime_error(u8"In Parser::ParseAttributeSelector(boost::string_ref&) - Broken substring attribute value match supplied. Expected value, got EOF.");
+				Fail(state, ErrorCode::InvalidAttributeSelector, u8"In Parser::ParseAttributeSelector(ParseState&, boost::string_ref&) - Broken substring attribute value match supplied. Expected value, got EOF.", selectorStr);
+				return nullptr;
 			}
 		}
 		break;
 
 		default:
-			throw std::runtime_error(u8"In Parser::ParseAttributeSelector(boost::string_ref&) - Invalid attribute value specifier.");
+			Fail(state, ErrorCode::InvalidAttributeSelector, u8"In Parser::ParseAttributeSelector(ParseState&, boost::string_ref&) - Invalid attribute value specifier.", selectorStr);
+			return nullptr;
 		} /* switch (valueMatchFirstChar) */
 
 		// Trim off the match specifier
@@ -687,31 +853,51 @@ namespace gq
 
 		if (firstValueChar == '"' || firstValueChar == '\'')
 		{
-			value = ParseString(selectorStr);
+			value = ParseString(state, selectorStr);
 		}
 		else
 		{
-			value = ParseIdentifier(selectorStr);
+			value = ParseIdentifier(state, selectorStr);
+		}
+
+		if (state.Failed())
+		{
+			return nullptr;
 		}
 
 		TrimLeadingWhitespace(selectorStr);
 
+		// The value may be followed by a flag, where "i" requests that the value be matched
+		// without regard to ASCII case and "s" requests the default, case sensitive matching.
+		bool caseInsensitive = false;
+
+		if (selectorStr.length() > 1 && (selectorStr[0] == 'i' || selectorStr[0] == 'I' || selectorStr[0] == 's' || selectorStr[0] == 'S') &&
+			(selectorStr[1] == ']' || CharClass::IsWhitespace(selectorStr[1])))
+		{
+			caseInsensitive = selectorStr[0] == 'i' || selectorStr[0] == 'I';
+
+			selectorStr = selectorStr.substr(1);
+			TrimLeadingWhitespace(selectorStr);
+		}
+
 		if (selectorStr.length() == 0 || selectorStr[0] != ']')
 		{
-			throw std::runtime_error(u8"In Parser::ParseAttributeSelector(boost::string_ref&) - Expected attribute closing tag aka ']', found invalid character or EOF instead.");
+			Fail(state, ErrorCode::InvalidAttributeSelector, u8"In Parser::ParseAttributeSelector(ParseState&, boost::string_ref&) - Expected attribute closing tag aka ']', found invalid character or EOF instead.", selectorStr);
+			return nullptr;
 		}
 
 		// Consume the closing bracket
 		selectorStr = selectorStr.substr(1);
 
-		return std::make_shared<AttributeSelector>(op, key, value);
+		return SelectorArena::MakeShared<AttributeSelector>(op, key, value, caseInsensitive);
 	}
 
-	SharedSelector Parser::ParseClassSelector(boost::string_ref& selectorStr) const
+	SharedSelector Parser::ParseClassSelector(ParseState& state, boost::string_ref& selectorStr) const
 	{
 		if (selectorStr.size() < 2 || selectorStr[0] != '.')
 		{
-			throw std::runtime_error(u8"In Parser::ParseClassSelector(boost::string_ref&) - Expected class specifier, got insufficient string or non-class definition.");
+			Fail(state, ErrorCode::InvalidIdentifier, u8"In Parser::ParseClassSelector(ParseState&, boost::string_ref&) - Expected class specifier, got insufficient string or non-class definition.", selectorStr);
+			return nullptr;
 		}
 
 		selectorStr = selectorStr.substr(1);
@@ -720,23 +906,29 @@ namespace gq
 
 		if (selectorStr[0] == '"' || selectorStr[0] == '\'')
 		{
-			className = ParseString(selectorStr);
+			className = ParseString(state, selectorStr);
 		}
 		else
 		{
-			className = ParseIdentifier(selectorStr);
+			className = ParseIdentifier(state, selectorStr);
+		}
+
+		if (state.Failed())
+		{
+			return nullptr;
 		}
 
 		boost::string_ref clazz = u8"class";
 
-		return std::make_shared<AttributeSelector>(AttributeSelector::SelectorOperator::ValueContainsElementInWhitespaceSeparatedList, clazz, className);
+		return SelectorArena::MakeShared<AttributeSelector>(AttributeSelector::SelectorOperator::ValueContainsElementInWhitespaceSeparatedList, clazz, className);
 	}
 
-	SharedSelector Parser::ParseIDSelector(boost::string_ref& selectorStr) const
+	SharedSelector Parser::ParseIDSelector(ParseState& state, boost::string_ref& selectorStr) const
 	{
 		if (selectorStr.size() < 2 || selectorStr[0] != '#')
 		{
-			throw std::runtime_error(u8"In Parser::ParseIDSelector(boost::string_ref&) - Expected ID specifier, got insufficient string or non-ID definition.");
+			Fail(state, ErrorCode::InvalidIdentifier, u8"In Parser::ParseIDSelector(ParseState&, boost::string_ref&) - Expected ID specifier, got insufficient string or non-ID definition.", selectorStr);
+			return nullptr;
 		}
 
 		selectorStr = selectorStr.substr(1);
@@ -745,37 +937,49 @@ namespace gq
 
 		if (selectorStr[0] == '"' || selectorStr[0] == '\'')
 		{
-			elementId = ParseString(selectorStr);
+			elementId = ParseString(state, selectorStr);
 		}
 		else
 		{
-			elementId = ParseName(selectorStr);
+			elementId = ParseName(state, selectorStr);
+		}
+
+		if (state.Failed())
+		{
+			return nullptr;
 		}
 
 		boost::string_ref id = u8"id";
 		
-		return std::make_shared<AttributeSelector>(AttributeSelector::SelectorOperator::ValueEquals, id, elementId);
+		return SelectorArena::MakeShared<AttributeSelector>(AttributeSelector::SelectorOperator::ValueEquals, id, elementId);
 	}
 
-	SharedSelector Parser::ParseTypeSelector(boost::string_ref& selectorStr) const
+	SharedSelector Parser::ParseTypeSelector(ParseState& state, boost::string_ref& selectorStr) const
 	{
 		if (selectorStr.size() == 0)
 		{
-			throw std::runtime_error(u8"In Parser::ParseTypeSelector(boost::string_ref&) - Expected Tag specifier, got empty string.");
+			Fail(state, ErrorCode::ExpectedSelector, u8"In Parser::ParseTypeSelector(ParseState&, boost::string_ref&) - Expected Tag specifier, got empty string.", selectorStr);
+			return nullptr;
 		}
 
-		boost::string_ref tag = ParseIdentifier(selectorStr);
+		boost::string_ref tag = ParseIdentifier(state, selectorStr);
+
+		if (state.Failed())
+		{
+			return nullptr;
+		}
 			 
-		return std::make_shared<Selector>(gumbo_tag_enum(tag.to_string().c_str()));
+		return SelectorArena::MakeShared<Selector>(gumbo_tagn_enum(tag.data(), static_cast<unsigned int>(tag.size())));
 	}
 
-	void Parser::ParseNth(boost::string_ref& selectorStr, int& lhs, int& rhs) const
+	const bool Parser::ParseNth(ParseState& state, boost::string_ref& selectorStr, int& lhs, int& rhs) const
 	{
 		TrimLeadingWhitespace(selectorStr);
 
 		if (selectorStr.length() == 0)
 		{
-			throw std::runtime_error(u8"In Parser::ParseNth(boost::string_ref&, const int& ,const int&) - Expected Nth(...) definintion, got empty string.");
+			Fail(state, ErrorCode::InvalidNth, u8"In Parser::ParseNth(ParseState&, boost::string_ref&, int&, int&) - Expected Nth(...) definintion, got empty string.", selectorStr);
+			return false;
 		}
 
 		const size_t nPosition = selectorStr.find_first_of(u8"nNdD");
@@ -783,270 +987,188 @@ namespace gq
 
 		if (closingParenPosition == boost::string_ref::npos)
 		{
-			throw std::runtime_error(u8"In Parser::ParseNth(boost::string_ref&, const int& ,const int&) - No closing parenthesis was found for nth parameter.");
+			Fail(state, ErrorCode::MissingParenthesis, u8"In Parser::ParseNth(ParseState&, boost::string_ref&, int&, int&) - No closing parenthesis was found for nth parameter.", selectorStr);
+			return false;
 		}
 
 		if (nPosition != boost::string_ref::npos && nPosition < closingParenPosition)
 		{
-			if (nPosition > 0)
+			if (nPosition > 0 && CharClass::IsAlpha(selectorStr[nPosition - 1]))
 			{
-				if (std::isalpha(selectorStr[nPosition - 1], m_localeEnUS))
-				{
-					// This is either odd, even or an invalid string
+				// This is either odd, even or an invalid string
 
-					boost::string_ref name = ParseName(selectorStr);
-					std::string nameString = name.to_string();
-					boost::to_lower(nameString);
+				boost::string_ref name = ParseName(state, selectorStr);
 
-					if (nameString.compare(u8"odd") == 0)
-					{
-						lhs = 2;
-						rhs = 1;
-					}
-					else if (nameString.compare(u8"even") == 0)
-					{
-						lhs = 2;
-						rhs = 0;
-					}
-					else
-					{
-						throw std::runtime_error(u8"In Parser::ParseNth(boost::string_ref&, const int& ,const int&) - Expected 'odd' or 'even', invalid nth value found.");
-					}
+				if (state.Failed())
+				{
+					return false;
+				}
 
-					return;
+				if (CharClass::EqualsLowerCase(name, u8"odd"))
+				{
+					lhs = 2;
+					rhs = 1;
+				}
+				else if (CharClass::EqualsLowerCase(name, u8"even"))
+				{
+					lhs = 2;
+					rhs = 0;
 				}
 				else
 				{
-					// This is almost certainly an expression using N, such as -n+ 6
-					boost::string_ref wholeParam = selectorStr.substr(0, closingParenPosition);
-					boost::string_ref leftHandSide = wholeParam.substr(0, nPosition);
-					boost::string_ref rightHandSide = wholeParam.substr(nPosition + 1);
-
-					selectorStr = selectorStr.substr(closingParenPosition);
-
-					std::string lhss = leftHandSide.to_string();
-					std::string rhss = rightHandSide.to_string();
-
-					boost::replace_all(lhss, u8"\t\f\r\n ", u8"");
-					boost::replace_all(rhss, u8"\t\f\r\n ", u8"");
-
-					// The left hand side could be "-n", etc.
-					if (lhss.size() == 1)
-					{
-						if (lhss[0] == '-')
-						{
-							lhs = -0;
-						}
-						else if (lhss[0] == '+')
-						{
-							lhs = 0;
-						}
-						else if (std::isdigit(lhss[0], m_localeEnUS))
-						{
-							lhs = std::atoi(&lhss[0]);
-						}
-						else
-						{
-							throw std::runtime_error(u8"In Parser::ParseNth(boost::string_ref&, const int& ,const int&) - Single character left hand side of nth is neither '+', '-' or a digit.");
-						}
-					}
-					else
-					{
-						if (lhss.size() > 0)
-						{
-							size_t i = 0;
-
-							if (lhss[0] == '-' || lhss[0] == '+')
-							{
-								i = 1;
-							}
-
-							for (i; i < lhss.length(); ++i)
-							{
-								if (!std::isdigit(lhss[i], m_localeEnUS))
-								{
-									throw std::runtime_error(u8"In Parser::ParseNth(boost::string_ref&, const int& ,const int&) - Nth parameter left hand side contained non-digit input.");
-								}
-							}
-
-							lhs = std::stoi(lhss);
-						}						
-					}
+					Fail(state, ErrorCode::InvalidNth, u8"In Parser::ParseNth(ParseState&, boost::string_ref&, int&, int&) - Expected 'odd' or 'even', invalid nth value found.", selectorStr);
+					return false;
+				}
 
-					// The right hand side must be just a number, be it positive, negative, doesn't
-					// matter. That's all it can be.
-					size_t rhsStartPos = 0;
+				return true;
+			}
 
-					if (rhss[0] == '-' || rhss[0] == '+')
-					{
-						rhsStartPos = 1;
-					}
+			if (selectorStr[nPosition] != 'n' && selectorStr[nPosition] != 'N')
+			{
+				Fail(state, ErrorCode::InvalidNth, u8"In Parser::ParseNth(ParseState&, boost::string_ref&, int&, int&) - Nth parameter contains alphabetical character other than N.", selectorStr.substr(nPosition));
+				return false;
+			}
 
-					size_t rhsslen = rhss.length();
-					
-					for (size_t i = rhsStartPos; i < rhsslen; ++i)
-					{
-						if (!std::isdigit(rhss[i], m_localeEnUS))
-						{							
-							std::string errMessage(u8"In Parser::ParseNth(boost::string_ref&, const int& ,const int&) - Nth parameter right hand side \"");
-							errMessage.append(rhss).append(u8"\" contained non-digit input.");
-							throw std::runtime_error(errMessage.c_str());
-						}
-					}
+			// This is an expression using N, such as -n+ 6, n+2 or 3n. Either side of the N may
+			// be empty, in which case that side is zero.
+			boost::string_ref leftHandSide = selectorStr.substr(0, nPosition);
+			boost::string_ref rightHandSide = selectorStr.substr(nPosition + 1, closingParenPosition - nPosition - 1);
 
-					rhs = std::stoi(rhss);
+			// The left hand side could be "-n", etc. A lone sign has always been taken as zero.
+			boost::string_ref sign = leftHandSide;
+			while (sign.size() > 0 && CharClass::IsWhitespace(sign.back()))
+			{
+				sign.remove_suffix(1);
+			}
 
-					return;
-				}
+			if (sign.size() == 1 && (sign[0] == '-' || sign[0] == '+'))
+			{
+				lhs = 0;
 			}
-			else
+			else if (!ParseInteger(leftHandSide, lhs))
 			{
-				// Possible expression starting with n
-				if (selectorStr[0] == 'n' || selectorStr[0] == 'N')
-				{
-					lhs = 0;
-
-					boost::string_ref wholeParam = selectorStr.substr(0, closingParenPosition);
-					boost::string_ref rightHandSide = wholeParam.substr(1);
-
-					selectorStr = selectorStr.substr(closingParenPosition);
-
-					std::string rhss = rightHandSide.to_string();
+				Fail(state, ErrorCode::InvalidNth, u8"In Parser::ParseNth(ParseState&, boost::string_ref&, int&, int&) - Nth parameter left hand side contained non-digit input or is out of range.", leftHandSide);
+				return false;
+			}
 
-					boost::replace_all(rhss, u8"\t\f\r\n ", u8"");
+			// The right hand side must be just a number, be it positive, negative, doesn't
+			// matter. That's all it can be.
+			if (!ParseInteger(rightHandSide, rhs))
+			{
+				Fail(state, ErrorCode::InvalidNth, u8"In Parser::ParseNth(ParseState&, boost::string_ref&, int&, int&) - Nth parameter right hand side contained non-digit input or is out of range.", rightHandSide);
+				return false;
+			}
 
-					size_t rhsStartPos = 0;
+			selectorStr = selectorStr.substr(closingParenPosition);
 
-					if (rhss[0] == '-' || rhss[0] == '+')
-					{
-						rhsStartPos = 1;
-					}
+			return true;
+		}
 
-					for (size_t i = rhsStartPos; i < rhss.length(); ++i)
-					{
-						if (!std::isdigit(rhss[i], m_localeEnUS))
-						{
-							std::string errMessage(u8"In Parser::ParseNth(boost::string_ref&, const int& ,const int&) - Nth parameter right hand side \"");
-							errMessage.append(rhss).append(u8"\" contained non-digit input.");
-							throw std::runtime_error(errMessage.c_str());
-						}
-					}
+		// No 'N' is part of the nth parameter, so it must be a single integer value
+		boost::string_ref wholeParam = selectorStr.substr(0, closingParenPosition);
 
-					rhs = std::stoi(rhss);
-				}
-				else
-				{
-					throw std::runtime_error(u8"In Parser::ParseNth(boost::string_ref&, const int& ,const int&) - Nth parameter starts with alphabetical character other than N.");
-				}
-			}
-		}
-		else
+		if (wholeParam.size() == 0 || !ParseInteger(wholeParam, rhs))
 		{
-			// No 'N' is part of the nth parameter, so it must be a single integer value
-
-			boost::string_ref wholeParam = selectorStr.substr(0, closingParenPosition);
+			Fail(state, ErrorCode::InvalidNth, u8"In Parser::ParseNth(ParseState&, boost::string_ref&, int&, int&) - Single integer Nth parameter contained non-digit input or is out of range.", wholeParam);
+			return false;
+		}
 
-			selectorStr = selectorStr.substr(closingParenPosition);
+		lhs = 0;
 
-			std::string paramStr = wholeParam.to_string();
+		selectorStr = selectorStr.substr(closingParenPosition);
 
-			boost::replace_all(paramStr, u8"\t\f\r\n ", u8"");
+		return true;
+	}
 
-			size_t startPos = 0;
+	const bool Parser::ParseInteger(boost::string_ref str, int& value) const
+	{
+		// Accumulated as a negative number, since the magnitude of the smallest int is one
+		// greater than that of the largest.
+		int result = 0;
+		bool negative = false;
+		bool hasSign = false;
+		bool hasDigits = false;
+
+		for (size_t i = 0; i < str.size(); ++i)
+		{
+			const char c = str[i];
 
-			if (paramStr[0] == '-' || paramStr[0] == '+')
+			if (CharClass::IsWhitespace(c))
 			{
-				startPos = 1;
+				continue;
 			}
 
-			for (size_t i = startPos; i < paramStr.length(); ++i)
+			if ((c == '-' || c == '+') && !hasSign && !hasDigits)
 			{
-				if (!std::isdigit(paramStr[i], m_localeEnUS))
-				{
-					std::string errorMessage(u8"In Parser::ParseNth(boost::string_ref&, const int& ,const int&) - Single integer Nth parameter contained non-digit input. String is: ");
-					errorMessage.append(paramStr);
-					throw std::runtime_error(errorMessage.c_str());
-				}
+				hasSign = true;
+				negative = (c == '-');
+				continue;
 			}
 
-			rhs = std::stoi(paramStr);
-
-			lhs = 0;
-
-			return;
-		}
-	}
-
-	const int Parser::ParseInteger(boost::string_ref& selectorStr) const
-	{
-		if (selectorStr.length() == 0)
-		{
-			throw std::runtime_error(u8"In Parser::ParseInteger(boost::string_ref&) - Expected number in string representation, got empty string.");
-		}
-
-		TrimLeadingWhitespace(selectorStr);
+			if (!CharClass::IsDigit(c))
+			{
+				return false;
+			}
 
-		size_t endPos = 0;
+			const int digit = c - '0';
 
-		if (selectorStr[0] == '-' || selectorStr[1] == '+')
-		{
-			endPos = 1;
-		}
+			if (result < (std::numeric_limits<int>::min() + digit) / 10)
+			{
+				return false;
+			}
 
-		if (!std::isdigit(selectorStr[endPos], m_localeEnUS))
-		{
-			throw std::runtime_error(u8"In Parser::ParseInteger(boost::string_ref&) - Expected number in string representation, got non-digit characters.");
+			result = (result * 10) - digit;
+			hasDigits = true;
 		}
 
-		++endPos;
-
-		if (endPos >= selectorStr.size())
+		if (hasSign && !hasDigits)
 		{
-			throw std::runtime_error(u8"In Parser::ParseInteger(boost::string_ref&) - Expected number in string representation, got EOF instead.");
+			return false;
 		}
 
-		while (endPos < selectorStr.size())
+		if (!negative)
 		{
-			if (!std::isdigit(selectorStr[endPos], m_localeEnUS))
+			if (result == std::numeric_limits<int>::min())
 			{
-				break;
+				return false;
 			}
 
-			endPos++;
+			result = -result;
 		}
 
-		boost::string_ref numStr = selectorStr.substr(endPos);
-		selectorStr = selectorStr.substr(endPos);
+		value = result;
 
-		return stoi(numStr.to_string());
+		return true;
 	}
 
-	void Parser::ConsumeClosingParenthesis(boost::string_ref& selectorStr) const
+	const bool Parser::ConsumeClosingParenthesis(ParseState& state, boost::string_ref& selectorStr) const
 	{
 		TrimLeadingWhitespace(selectorStr);
 
 		if (selectorStr.size() == 0 || selectorStr[0] != ')')
 		{
-			std::string errorMessage(u8"In Parser::ConsumeClosingParenthesis(boost::string_ref&) - Expected string with closing parenthesis, got empty string or string not preceeded by opening parenthesis. String Is: ");
-			errorMessage.append(selectorStr.to_string());
-			throw std::runtime_error(errorMessage.c_str());
+			Fail(state, ErrorCode::MissingParenthesis, u8"In Parser::ConsumeClosingParenthesis(ParseState&, boost::string_ref&) - Expected string with closing parenthesis, got empty string or string not preceeded by opening parenthesis.", selectorStr);
+			return false;
 		}
 
 		selectorStr = selectorStr.substr(1);
+
+		return true;
 	}
 
-	void Parser::ConsumeOpeningParenthesis(boost::string_ref& selectorStr) const
+	const bool Parser::ConsumeOpeningParenthesis(ParseState& state, boost::string_ref& selectorStr) const
 	{
 		if (selectorStr.size() == 0 || selectorStr[0] != '(')
 		{
-			std::string errorMessage(u8"In Parser::ConsumeOpeningParenthesis(boost::string_ref&) - Expected string with opening parenthesis, got empty string or string not preceeded by opening parenthesis. String Is: ");
-			errorMessage.append(selectorStr.to_string());
-			throw std::runtime_error(errorMessage.c_str());
+			Fail(state, ErrorCode::MissingParenthesis, u8"In Parser::ConsumeOpeningParenthesis(ParseState&, boost::string_ref&) - Expected string with opening parenthesis, got empty string or string not preceeded by opening parenthesis.", selectorStr);
+			return false;
 		}
 
 		selectorStr = selectorStr.substr(1);
 
 		TrimLeadingWhitespace(selectorStr);
+
+		return true;
 	}
 
 	const bool Parser::TrimLeadingWhitespace(boost::string_ref& str) const
@@ -1064,7 +1186,7 @@ namespace gq
 
 		while (str.length() > 0)
 		{
-			if (std::isspace(str[0], m_localeEnUS))
+			if (CharClass::IsWhitespace(str[0]))
 			{
 				str = str.substr(1);
 				trimmed = true;
@@ -1078,7 +1200,7 @@ namespace gq
 		return trimmed;
 	}
 
-	boost::string_ref Parser::ParseString(boost::string_ref& selectorStr) const
+	boost::string_ref Parser::ParseString(ParseState& state, boost::string_ref& selectorStr) const
 	{
 		// This method assumes it has been called when the first character in the supplied
 		// string_ref is either a ' or " quote. This function is a complete rewrite over the
@@ -1089,14 +1211,16 @@ namespace gq
 
 		if (selectorStr.size() == 0)
 		{
-			throw std::runtime_error(u8"In Parser::ParseString(boost::string_ref&) - Expected quoted string, got empty string.");
+			Fail(state, ErrorCode::InvalidString, u8"In Parser::ParseString(ParseState&, boost::string_ref&) - Expected quoted string, got empty string.", selectorStr);
+			return boost::string_ref();
 		}
 
 		const char& quoteChar = selectorStr[0];
 
 		if (quoteChar != '\'' && quoteChar != '"')
 		{
-			throw std::runtime_error(u8"In Parser::ParseString(boost::string_ref&) - Expected quoted string, string does not begin with valid quote characters.");
+			Fail(state, ErrorCode::InvalidString, u8"In Parser::ParseString(ParseState&, boost::string_ref&) - Expected quoted string, string does not begin with valid quote characters.", selectorStr);
+			return boost::string_ref();
 		}
 
 		// Remove the opening quote
@@ -1106,14 +1230,16 @@ namespace gq
 
 		if (pos == std::string::npos)
 		{
-			throw std::runtime_error(u8"In Parser::ParseString(boost::string_ref&) - No closing quote found in supplied quoted string.");
+			Fail(state, ErrorCode::InvalidString, u8"In Parser::ParseString(ParseState&, boost::string_ref&) - No closing quote found in supplied quoted string.", selectorStr);
+			return boost::string_ref();
 		}
 		else if (pos == 0)
 		{
-			throw std::runtime_error(u8"In Parser::ParseString(boost::string_ref&) - String begins with unescaped quote character.");
+			Fail(state, ErrorCode::InvalidString, u8"In Parser::ParseString(ParseState&, boost::string_ref&) - String begins with unescaped quote character.", selectorStr);
+			return boost::string_ref();
 		}
 
-		size_t endOffset = 0;
+		size_t endOffset = boost::string_ref::npos;
 		
 		for (pos; pos < selectorStr.size(); ++pos)
 		{
@@ -1135,7 +1261,8 @@ namespace gq
 
 		if (endOffset == boost::string_ref::npos || endOffset > selectorStr.size())
 		{
-			throw std::runtime_error(u8"In Parser::ParseString(boost::string_ref&) - No unescaped closing quote found in supplied quoted string.");
+			Fail(state, ErrorCode::InvalidString, u8"In Parser::ParseString(ParseState&, boost::string_ref&) - No unescaped closing quote found in supplied quoted string.", selectorStr);
+			return boost::string_ref();
 		}
 
 		boost::string_ref value = selectorStr.substr(0, endOffset);
@@ -1145,16 +1272,17 @@ namespace gq
 		return value;
 	}
 
-	boost::string_ref Parser::ParseName(boost::string_ref& selectorStr) const
+	boost::string_ref Parser::ParseName(ParseState& state, boost::string_ref& selectorStr) const
 	{
-		return ParseIdentifier(selectorStr);
+		return ParseIdentifier(state, selectorStr);
 	}
 
-	boost::string_ref Parser::ParseIdentifier(boost::string_ref& selectorStr) const
+	boost::string_ref Parser::ParseIdentifier(ParseState& state, boost::string_ref& selectorStr) const
 	{
 		if (selectorStr.size() == 0)
 		{
-			throw std::runtime_error(u8"In Parser::ParseIdentifier(boost::string_ref&) - Expected selector containing identifier, got empty string.");
+			Fail(state, ErrorCode::InvalidIdentifier, u8"In Parser::ParseIdentifier(ParseState&, boost::string_ref&) - Expected selector containing identifier, got empty string.", selectorStr);
+			return boost::string_ref();
 		}
 
 		bool notDone = true;
@@ -1170,7 +1298,8 @@ namespace gq
 
 				if (endPos == boost::string_ref::npos)
 				{
-					throw std::runtime_error(u8"In Parser::ParseIdentifier(boost::string_ref&) - Encountered improperly formatted named or numbered character reference.");
+					Fail(state, ErrorCode::InvalidIdentifier, u8"In Parser::ParseIdentifier(ParseState&, boost::string_ref&) - Encountered improperly formatted named or numbered character reference.", selectorStr);
+					return boost::string_ref();
 				}
 
 				ind += static_cast<int>(endPos+1);
@@ -1189,17 +1318,17 @@ namespace gq
 				bool foundEscapeSequenceEnd = false;
 				for (ind; ind < static_cast<int>(selectorStr.size()); ++ind)
 				{
-					if (IsSpecial(selectorStr[ind]))
+					if (CharClass::IsSpecial(selectorStr[ind]))
 					{
 						++ind;
 						foundEscapeSequenceEnd = true;
 						break;
 					}
-					else if (IsHexDigit(selectorStr[ind]))
+					else if (CharClass::IsHexDigit(selectorStr[ind]))
 					{
 						continue;
 					}
-					else if (std::isspace(selectorStr[ind], m_localeEnUS))
+					else if (CharClass::IsWhitespace(selectorStr[ind]))
 					{
 						++ind;
 						foundEscapeSequenceEnd = true;
@@ -1209,10 +1338,11 @@ namespace gq
 
 				if (!foundEscapeSequenceEnd)
 				{
-					throw std::runtime_error(u8"In Parser::ParseIdentifier(boost::string_ref&) - Encountered improperly formatted character escape sequence. Escaped character sequences must be followed by a space.");
+					Fail(state, ErrorCode::InvalidIdentifier, u8"In Parser::ParseIdentifier(ParseState&, boost::string_ref&) - Encountered improperly formatted character escape sequence. Escaped character sequences must be followed by a space.", selectorStr);
+					return boost::string_ref();
 				}
 			}
-			else if (!IsNameChar(selectorStr[ind]))
+			else if (!CharClass::IsNameChar(selectorStr[ind]))
 			{
 				notDone = false;
 				break;
@@ -1223,7 +1353,8 @@ namespace gq
 
 		if (ind <= 0)
 		{
-			throw std::runtime_error(u8"In Parser::ParseIdentifier(boost::string_ref&) - Expected selector containing identifier, yet no valid identifier was found.");
+			Fail(state, ErrorCode::InvalidIdentifier, u8"In Parser::ParseIdentifier(ParseState&, boost::string_ref&) - Expected selector containing identifier, yet no valid identifier was found.", selectorStr);
+			return boost::string_ref();
 		}		
 
 		if (ind > static_cast<int>(selectorStr.size()))
@@ -1237,62 +1368,4 @@ namespace gq
 		return value;
 	}
 
-	const bool Parser::IsNameChar(const char& c) const
-	{
-		// We need to be able to support alphabet, 0-9, underscores
-		return IsNameStart(c) || (c == '-') || (c >= '0' && c <= '9');
-	}
-
-	const bool Parser::IsNameStart(const char& c) const
-	{
-		return std::isalpha(c, m_localeEnUS) || c == '_';
-	}
-
-	const bool Parser::IsCombinator(const char& c) const
-	{
-		switch (c)
-		{
-			case ' ':
-			case '~':
-			case '>':
-			case '+':
-			{
-				return true;
-			}
-			break;
-
-			default:
-				return false;
-		}
-	}
-
-	const bool Parser::IsSpecial(const char& c) const
-	{
-		switch (c)
-		{
-			case ' ':
-			case '~':
-			case '>':
-			case '+':
-			case ':':
-			case '|':
-			case '*':
-			case ';':
-			case '&':
-			case ',':
-			{
-				return true;
-			}
-			break;
-
-			default:
-				return false;
-		}
-	}
-
-	const bool Parser::IsHexDigit(const char& c) const
-	{
-		return std::isxdigit(c, m_localeEnUS);
-	}
-
 } /* namespace gq */
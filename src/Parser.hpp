@@ -33,7 +33,6 @@
 #include <unordered_map>
 #include "StrRefHash.hpp"
 #include <stdexcept>
-#include <locale>
 
 namespace gq
 {
@@ -48,7 +47,7 @@ namespace gq
 	public:
 
 		/// <summary>
-		/// Construcst a new Parser.
+		/// Construcst a new Parser. The parser holds no state, so construction is free.
 		/// </summary>
 		Parser();
 
@@ -57,10 +56,114 @@ namespace gq
 		/// </summary>
 		~Parser();
 
+		/// <summary>
+		/// The kinds of error that can stop a selector string from being compiled.
+		/// </summary>
+		enum class ErrorCode
+		{
+			None,
+			ExpectedSelector,
+			TrailingInput,
+			InvalidCombinator,
+			InvalidIdentifier,
+			InvalidString,
+			InvalidAttributeSelector,
+			UnsupportedPseudoClass,
+			InvalidNth,
+			MissingParenthesis,
+			InvalidRegex
+		};
+
+		/// <summary>
+		/// The outcome of compiling a selector string with ::TryCreateSelector(...). Holds either
+		/// the compiled selector, or a description of why the selector string could not be
+		/// compiled. Error messages are static strings, so reporting an error never allocates.
+		/// </summary>
+		class ParseResult
+		{
+
+			friend class Parser;
+
+		public:
+
+			/// <summary>
+			/// Checks whether the selector string was compiled.
+			/// </summary>
+			/// <returns>
+			/// True if the result holds a compiled selector, false if it holds an error.
+			/// </returns>
+			explicit operator bool() const;
+
+			/// <summary>
+			/// Gets the compiled selector.
+			/// </summary>
+			/// <returns>
+			/// The compiled selector, or nullptr if the selector string could not be compiled.
+			/// </returns>
+			const SharedSelector& GetSelector() const;
+
+			/// <summary>
+			/// Gets the kind of error that stopped the selector string from being compiled.
+			/// </summary>
+			/// <returns>
+			/// The error code, or ErrorCode::None if the selector string was compiled.
+			/// </returns>
+			const ErrorCode GetErrorCode() const;
+
+			/// <summary>
+			/// Gets the offset within the selector string at which the error was found.
+			/// </summary>
+			/// <returns>
+			/// The offset of the error in bytes from the start of the selector string. Zero if the
+			/// selector string was compiled.
+			/// </returns>
+			const size_t GetErrorOffset() const;
+
+			/// <summary>
+			/// Gets a description of the error that stopped the selector string from being
+			/// compiled.
+			/// </summary>
+			/// <returns>
+			/// A static, null terminated description of the error. Empty if the selector string
+			/// was compiled.
+			/// </returns>
+			const char* GetErrorMessage() const;
+
+		private:
+
+			SharedSelector m_selector;
+
+			ErrorCode m_errorCode = ErrorCode::None;
+
+			size_t m_errorOffset = 0;
+
+			const char* m_errorMessage = u8"";
+
+		};
+
+		/// <summary>
+		/// Create a selector instance from the supplied raw selector string, without throwing on
+		/// improperly formatted input. Nothing on this path raises or catches exceptions, aside
+		/// from compiling the pattern of a :matches or :matchesOwn selector, so this is the
+		/// method to use when compiling large numbers of selectors of unknown quality.
+		/// </summary>
+		/// <param name="selectorString">
+		/// The raw selector string to parse and compile into a selector. 
+		/// </param>
+		/// <param name="retainOriginalString">
+		/// If true, the original string will be copied into the returned selector. This is not
+		/// necessary, and is only recommended for debugging selectors. Default is false.
+		/// </param>
+		/// <returns>
+		/// The compiled selector, or a description of why it could not be compiled. 
+		/// </returns>
+		ParseResult TryCreateSelector(boost::string_ref selectorString, const bool retainOriginalString = false) const;
+
 		/// <summary>
 		/// Create a selector instance from the supplied raw selector string. There are several
 		/// potential issues that can arise in parsing, such as errors discovered in the syntax of
-		/// the supplied rule string. This method should be wrapped in a try/catch.
+		/// the supplied rule string. This method should be wrapped in a try/catch. Use
+		/// ::TryCreateSelector(...) to have errors returned instead.
 		/// </summary>
 		/// <param name="selectorString">
 		/// The raw selector string to parse and compile into a selector. 
@@ -108,9 +211,44 @@ namespace gq
 		static const std::unordered_map<boost::string_ref, PseudoOp, StringRefHash> PseudoOps;
 
 		/// <summary>
-		/// For supplying to isalpha, etc.
+		/// The length of the longest name in ::PseudoOps. Pseudo selector names are folded to lower
+		/// case into a buffer of this size on the stack before being looked up.
+		/// </summary>
+		static constexpr size_t MaxPseudoNameLength = 16;
+
+		/// <summary>
+		/// The state of a single parse, passed through every parsing member. Only the first error
+		/// is kept, since every member stops and returns as soon as an error has been recorded.
 		/// </summary>
-		std::locale m_localeEnUS;
+		struct ParseState
+		{
+			const char* begin = nullptr;
+			ErrorCode errorCode = ErrorCode::None;
+			const char* errorMessage = u8"";
+			size_t errorOffset = 0;
+
+			const bool Failed() const
+			{
+				return errorCode != ErrorCode::None;
+			}
+		};
+
+		/// <summary>
+		/// Records an error in the supplied state, unless an error has already been recorded.
+		/// </summary>
+		/// <param name="state">
+		/// The state of the parse in progress.
+		/// </param>
+		/// <param name="errorCode">
+		/// The kind of error.
+		/// </param>
+		/// <param name="errorMessage">
+		/// A static description of the error.
+		/// </param>
+		/// <param name="at">
+		/// The remaining input, starting at the point where the error was found.
+		/// </param>
+		void Fail(ParseState& state, const ErrorCode errorCode, const char* errorMessage, const boost::string_ref at) const;
 
 		/// <summary>
 		/// Attempts to extract one selector, or two or more combined selectors, and returns the
@@ -120,18 +258,22 @@ namespace gq
 		/// chain.
 		/// <para>&#160;</para>
 		/// As with all other parsing members, this function will consume characters from the front
-		/// of the supplied string. If no error is thrown, the consumption should leave the supplied
-		/// string in a valid state that the parser can continue from. If an error is thrown, the
-		/// supplied input will most certainly be mangled as the comsumption most likely would have
-		/// stopped at an undefined state.
+		/// of the supplied string. If no error is recorded, the consumption should leave the
+		/// supplied string in a valid state that the parser can continue from. If an error is
+		/// recorded in the supplied state, the supplied input will most certainly be mangled as the
+		/// comsumption most likely would have stopped at an undefined state, and the return value
+		/// must be ignored.
 		/// </summary>
+		/// <param name="state">
+		/// The state of the parse in progress. The first error encountered is recorded here.
+		/// </param>
 		/// <param name="selectorStr">
 		/// The string containing a single selector or multiple grouped selectors. 
 		/// </param>
 		/// <returns>
 		/// The compiled selector. 
 		/// </returns>
-		SharedSelector ParseSelectorGroup(boost::string_ref& selectorStr) const;
+		SharedSelector ParseSelectorGroup(ParseState& state, boost::string_ref& selectorStr) const;
 
 		/// <summary>
 		/// Attempts top build one or more selector from the supplied string. Will handle all matter
@@ -142,18 +284,22 @@ namespace gq
 		/// ::ParseSimpleSelectorSequence(...) and then handles the combining, if any, internally.
 		/// <para>&#160;</para>
 		/// As with all other parsing members, this function will consume characters from the front
-		/// of the supplied string. If no error is thrown, the consumption should leave the supplied
-		/// string in a valid state that the parser can continue from. If an error is thrown, the
-		/// supplied input will most certainly be mangled as the comsumption most likely would have
-		/// stopped at an undefined state.
+		/// of the supplied string. If no error is recorded, the consumption should leave the
+		/// supplied string in a valid state that the parser can continue from. If an error is
+		/// recorded in the supplied state, the supplied input will most certainly be mangled as the
+		/// comsumption most likely would have stopped at an undefined state, and the return value
+		/// must be ignored.
 		/// </summary>
+		/// <param name="state">
+		/// The state of the parse in progress. The first error encountered is recorded here.
+		/// </param>
 		/// <param name="selectorStr">
 		/// The string containing a single selector or multiple combined selectors. 
 		/// </param>
 		/// <returns>
 		/// The compiled selector. 
 		/// </returns>
-		SharedSelector ParseSelector(boost::string_ref& selectorStr) const;
+		SharedSelector ParseSelector(ParseState& state, boost::string_ref& selectorStr) const;
 
 		/// <summary>
 		/// Attempts to parse a single selector from the supplied string. This object exists on
@@ -163,18 +309,22 @@ namespace gq
 		/// determined needs to be parsed based on the input string.
 		/// <para>&#160;</para>
 		/// As with all other parsing members, this function will consume characters from the front
-		/// of the supplied string. If no error is thrown, the consumption should leave the supplied
-		/// string in a valid state that the parser can continue from. If an error is thrown, the
-		/// supplied input will most certainly be mangled as the comsumption most likely would have
-		/// stopped at an undefined state.
+		/// of the supplied string. If no error is recorded, the consumption should leave the
+		/// supplied string in a valid state that the parser can continue from. If an error is
+		/// recorded in the supplied state, the supplied input will most certainly be mangled as the
+		/// comsumption most likely would have stopped at an undefined state, and the return value
+		/// must be ignored.
 		/// </summary>
+		/// <param name="state">
+		/// The state of the parse in progress. The first error encountered is recorded here.
+		/// </param>
 		/// <param name="selectorStr">
 		/// The string containing a single selector or multiple combined selectors. 
 		/// </param>
 		/// <returns>
 		/// The compiled selector. 
 		/// </returns>
-		SharedSelector ParseSimpleSelectorSequence(boost::string_ref& selectorStr) const;
+		SharedSelector ParseSimpleSelectorSequence(ParseState& state, boost::string_ref& selectorStr) const;
 
 		/// <summary>
 		/// Parses a single pseudo class selector from the supplied string. Returns a single,
@@ -182,18 +332,22 @@ namespace gq
 		/// is left up to invoking methods such as ::ParseSelector(...).
 		/// <para>&#160;</para>
 		/// As with all other parsing members, this function will consume characters from the front
-		/// of the supplied string. If no error is thrown, the consumption should leave the supplied
-		/// string in a valid state that the parser can continue from. If an error is thrown, the
-		/// supplied input will most certainly be mangled as the comsumption most likely would have
-		/// stopped at an undefined state.
+		/// of the supplied string. If no error is recorded, the consumption should leave the
+		/// supplied string in a valid state that the parser can continue from. If an error is
+		/// recorded in the supplied state, the supplied input will most certainly be mangled as the
+		/// comsumption most likely would have stopped at an undefined state, and the return value
+		/// must be ignored.
 		/// </summary>
+		/// <param name="state">
+		/// The state of the parse in progress. The first error encountered is recorded here.
+		/// </param>
 		/// <param name="selectorStr">
 		/// The string containing a single selector or multiple combined selectors. 
 		/// </param>
 		/// <returns>
 		/// The compiled selector. 
 		/// </returns>
-		SharedSelector ParsePseudoclassSelector(boost::string_ref& selectorStr) const;
+		SharedSelector ParsePseudoclassSelector(ParseState& state, boost::string_ref& selectorStr) const;
 
 		/// <summary>
 		/// Parses a single attribute selector from the supplied string. Returns a single,
@@ -201,18 +355,22 @@ namespace gq
 		/// is left up to invoking methods such as ::ParseSelector(...).
 		/// <para>&#160;</para>
 		/// As with all other parsing members, this function will consume characters from the front
-		/// of the supplied string. If no error is thrown, the consumption should leave the supplied
-		/// string in a valid state that the parser can continue from. If an error is thrown, the
-		/// supplied input will most certainly be mangled as the comsumption most likely would have
-		/// stopped at an undefined state.
+		/// of the supplied string. If no error is recorded, the consumption should leave the
+		/// supplied string in a valid state that the parser can continue from. If an error is
+		/// recorded in the supplied state, the supplied input will most certainly be mangled as the
+		/// comsumption most likely would have stopped at an undefined state, and the return value
+		/// must be ignored.
 		/// </summary>
+		/// <param name="state">
+		/// The state of the parse in progress. The first error encountered is recorded here.
+		/// </param>
 		/// <param name="selectorStr">
 		/// The string containing a single selector or multiple combined selectors. 
 		/// </param>
 		/// <returns>
 		/// The compiled selector. 
 		/// </returns>
-		SharedSelector ParseAttributeSelector(boost::string_ref& selectorStr) const;
+		SharedSelector ParseAttributeSelector(ParseState& state, boost::string_ref& selectorStr) const;
 
 		/// <summary>
 		/// Parses a single class selector from the supplied string. Returns a single,
@@ -220,18 +378,22 @@ namespace gq
 		/// is left up to invoking methods such as ::ParseSelector(...).
 		/// <para>&#160;</para>
 		/// As with all other parsing members, this function will consume characters from the front
-		/// of the supplied string. If no error is thrown, the consumption should leave the supplied
-		/// string in a valid state that the parser can continue from. If an error is thrown, the
-		/// supplied input will most certainly be mangled as the comsumption most likely would have
-		/// stopped at an undefined state.
+		/// of the supplied string. If no error is recorded, the consumption should leave the
+		/// supplied string in a valid state that the parser can continue from. If an error is
+		/// recorded in the supplied state, the supplied input will most certainly be mangled as the
+		/// comsumption most likely would have stopped at an undefined state, and the return value
+		/// must be ignored.
 		/// </summary>
+		/// <param name="state">
+		/// The state of the parse in progress. The first error encountered is recorded here.
+		/// </param>
 		/// <param name="selectorStr">
 		/// The string containing a single selector or multiple combined selectors. 
 		/// </param>
 		/// <returns>
 		/// The compiled selector. 
 		/// </returns>
-		SharedSelector ParseClassSelector(boost::string_ref& selectorStr) const;
+		SharedSelector ParseClassSelector(ParseState& state, boost::string_ref& selectorStr) const;
 
 		/// <summary>
 		/// Parses a ID selector from the supplied string. Returns a single, non-chained selector
@@ -239,18 +401,22 @@ namespace gq
 		/// invoking methods such as ::ParseSelector(...).
 		/// <para>&#160;</para>
 		/// As with all other parsing members, this function will consume characters from the front
-		/// of the supplied string. If no error is thrown, the consumption should leave the supplied
-		/// string in a valid state that the parser can continue from. If an error is thrown, the
-		/// supplied input will most certainly be mangled as the comsumption most likely would have
-		/// stopped at an undefined state.
+		/// of the supplied string. If no error is recorded, the consumption should leave the
+		/// supplied string in a valid state that the parser can continue from. If an error is
+		/// recorded in the supplied state, the supplied input will most certainly be mangled as the
+		/// comsumption most likely would have stopped at an undefined state, and the return value
+		/// must be ignored.
 		/// </summary>
+		/// <param name="state">
+		/// The state of the parse in progress. The first error encountered is recorded here.
+		/// </param>
 		/// <param name="selectorStr">
 		/// The string containing a single selector or multiple combined selectors. 
 		/// </param>
 		/// <returns>
 		/// The compiled selector. 
 		/// </returns>
-		SharedSelector ParseIDSelector(boost::string_ref& selectorStr) const;
+		SharedSelector ParseIDSelector(ParseState& state, boost::string_ref& selectorStr) const;
 
 		/// <summary>
 		/// Parses a Selector that matches against a specific HTML element by its tag type from
@@ -259,29 +425,37 @@ namespace gq
 		/// ::ParseSelector(...).
 		/// <para>&#160;</para>
 		/// As with all other parsing members, this function will consume characters from the front
-		/// of the supplied string. If no error is thrown, the consumption should leave the supplied
-		/// string in a valid state that the parser can continue from. If an error is thrown, the
-		/// supplied input will most certainly be mangled as the comsumption most likely would have
-		/// stopped at an undefined state.
+		/// of the supplied string. If no error is recorded, the consumption should leave the
+		/// supplied string in a valid state that the parser can continue from. If an error is
+		/// recorded in the supplied state, the supplied input will most certainly be mangled as the
+		/// comsumption most likely would have stopped at an undefined state, and the return value
+		/// must be ignored.
 		/// </summary>
+		/// <param name="state">
+		/// The state of the parse in progress. The first error encountered is recorded here.
+		/// </param>
 		/// <param name="selectorStr">
 		/// The string containing a single selector or multiple combined selectors. 
 		/// </param>
 		/// <returns>
 		/// The compiled selector. 
 		/// </returns>
-		SharedSelector ParseTypeSelector(boost::string_ref& selectorStr) const;
+		SharedSelector ParseTypeSelector(ParseState& state, boost::string_ref& selectorStr) const;
 
 		/// <summary>
 		/// Attempts to parse the left hand and right hand side of the supplied nth parameter
 		/// string. Handles nth notation such as -n4, 3n+2, odd/even etc.
 		/// <para>&#160;</para>
 		/// As with all other parsing members, this function will consume characters from the front
-		/// of the supplied string. If no error is thrown, the consumption should leave the supplied
-		/// string in a valid state that the parser can continue from. If an error is thrown, the
-		/// supplied input will most certainly be mangled as the comsumption most likely would have
-		/// stopped at an undefined state.
+		/// of the supplied string. If no error is recorded, the consumption should leave the
+		/// supplied string in a valid state that the parser can continue from. If an error is
+		/// recorded in the supplied state, the supplied input will most certainly be mangled as the
+		/// comsumption most likely would have stopped at an undefined state, and the return value
+		/// must be ignored.
 		/// </summary>
+		/// <param name="state">
+		/// The state of the parse in progress. The first error encountered is recorded here.
+		/// </param>
 		/// <param name="selectorStr">
 		/// The string containing nth parameter. It is expected that the opening bracket has been
 		/// consumed before being supplied here.
@@ -292,60 +466,74 @@ namespace gq
 		/// <param name="rhs">
 		/// The right hand side reference to set on successful parsing. 
 		/// </param>
-		void ParseNth(boost::string_ref& selectorStr, int& lhs, int& rhs) const;
+		/// <returns>
+		/// True if the nth parameter was parsed, false if an error was recorded.
+		/// </returns>
+		const bool ParseNth(ParseState& state, boost::string_ref& selectorStr, int& lhs, int& rhs) const;
 
 		/// <summary>
-		/// Attempts to extract a number from the front of the supplied selector string, converting
-		/// it to an integer.
-		/// <para>&#160;</para>
-		/// As with all other parsing members, this function will consume characters from the front
-		/// of the supplied string. If no error is thrown, the consumption should leave the supplied
-		/// string in a valid state that the parser can continue from. If an error is thrown, the
-		/// supplied input will most certainly be mangled as the comsumption most likely would have
-		/// stopped at an undefined state.
+		/// Converts the entirety of the supplied string to an integer, with an optional leading
+		/// sign. Whitespace anywhere in the string is ignored, and an empty string is zero. Unlike
+		/// the other parsing members, nothing is consumed and no error is recorded, since the
+		/// caller knows best what a bad number means in its context.
 		/// </summary>
-		/// <param name="selectorStr">
-		/// The string containing the integer. It is expected that the supplied string begins with a
-		/// digit character or whitespace immediately followed by a widget character.
+		/// <param name="str">
+		/// The string containing the integer.
+		/// </param>
+		/// <param name="value">
+		/// The integer reference to set on successful conversion.
 		/// </param>
 		/// <returns>
-		/// The extracted integer value. 
+		/// True if the string held an integer that fits in an int, false otherwise.
 		/// </returns>
-		const int ParseInteger(boost::string_ref& selectorStr) const;
+		const bool ParseInteger(boost::string_ref str, int& value) const;
 
 		/// <summary>
 		/// Trims any whitspace that may be between the start of the supplied selector string and a
 		/// closing parenthesis. This function expects that absolutely nothing but whitespace is
 		/// (optionally) contained in the front of the string leading, leading up to a closing
-		/// parenthesis. If these conditions are not met, this function will throw because either
-		/// the supplied selector string is fundamentally broken, or the user has made an error in
-		/// logic by calling this method when it ought not to be.
+		/// parenthesis. If these conditions are not met, this function will record an error because
+		/// either the supplied selector string is fundamentally broken, or the user has made an
+		/// error in logic by calling this method when it ought not to be.
 		/// </summary>
+		/// <param name="state">
+		/// The state of the parse in progress. The first error encountered is recorded here.
+		/// </param>
 		/// <param name="selectorStr">
 		/// The string beginning with either whitespace and a closing parenthesis, or just a closing
 		/// parenthesis.
 		/// </param>
-		void ConsumeClosingParenthesis(boost::string_ref& selectorStr) const;
+		/// <returns>
+		/// True if the parenthesis was consumed, false if an error was recorded.
+		/// </returns>
+		const bool ConsumeClosingParenthesis(ParseState& state, boost::string_ref& selectorStr) const;
 
 		/// <summary>
 		/// Consumes the opening parenthesis at the beginning of the supplied string, and any
 		/// whitespace found immediately following the opening parenthesis present at position 0. If
 		/// an opening parenthesis is not found at position zero in the supplied string, this
-		/// function will throw, because either the supplied selector string is fundamentally
-		/// broken, or the user has mad an error in logic by calling this method when it ought not
-		/// to be.
+		/// function will record an error, because either the supplied selector string is
+		/// fundamentally broken, or the user has mad an error in logic by calling this method when
+		/// it ought not to be.
 		/// <para>&#160;</para>
 		/// As with all other parsing members, this function will consume characters from the front
-		/// of the supplied string. If no error is thrown, the consumption should leave the supplied
-		/// string in a valid state that the parser can continue from. If an error is thrown, the
-		/// supplied input will most certainly be mangled as the comsumption most likely would have
-		/// stopped at an undefined state.
+		/// of the supplied string. If no error is recorded, the consumption should leave the
+		/// supplied string in a valid state that the parser can continue from. If an error is
+		/// recorded in the supplied state, the supplied input will most certainly be mangled as the
+		/// comsumption most likely would have stopped at an undefined state, and the return value
+		/// must be ignored.
 		/// </summary>
+		/// <param name="state">
+		/// The state of the parse in progress. The first error encountered is recorded here.
+		/// </param>
 		/// <param name="selectorStr">
 		/// The string beginning with an opening parenthesis, optionally followed by whitespace
 		/// characters to be consumed as well.
 		/// </param>
-		void ConsumeOpeningParenthesis(boost::string_ref& selectorStr) const;
+		/// <returns>
+		/// True if the parenthesis was consumed, false if an error was recorded.
+		/// </returns>
+		const bool ConsumeOpeningParenthesis(ParseState& state, boost::string_ref& selectorStr) const;
 
 		/// <summary>
 		/// Removes any whitespace characters found in the start of the supplied string.
@@ -368,14 +556,18 @@ namespace gq
 		/// Note that this function absolutely expects that the first character is either a single
 		/// or double quote, and an acceptabled closing quote of the same kind is present in the
 		/// string. Supplying a string to this function that does not meet those requirements will
-		/// cause this function to throw.
+		/// cause this function to record an error.
 		/// <para>&#160;</para>
 		/// As with all other parsing members, this function will consume characters from the front
-		/// of the supplied string. If no error is thrown, the consumption should leave the supplied
-		/// string in a valid state that the parser can continue from. If an error is thrown, the
-		/// supplied input will most certainly be mangled as the comsumption most likely would have
-		/// stopped at an undefined state.
+		/// of the supplied string. If no error is recorded, the consumption should leave the
+		/// supplied string in a valid state that the parser can continue from. If an error is
+		/// recorded in the supplied state, the supplied input will most certainly be mangled as the
+		/// comsumption most likely would have stopped at an undefined state, and the return value
+		/// must be ignored.
 		/// </summary>
+		/// <param name="state">
+		/// The state of the parse in progress. The first error encountered is recorded here.
+		/// </param>
 		/// <param name="selectorStr">
 		/// A valid string starting with an unescsaped quote character, and a matching unescaped
 		/// closing character present.
@@ -384,7 +576,7 @@ namespace gq
 		/// The substring containing the contents between the opening quote character and first
 		/// matched closing quote character.
 		/// </returns>
-		boost::string_ref ParseString(boost::string_ref& selectorStr) const;
+		boost::string_ref ParseString(ParseState& state, boost::string_ref& selectorStr) const;
 
 		/// <summary>
 		/// Delegates directly to ParseIdentifier. This function will most likely be entirely
@@ -404,11 +596,15 @@ namespace gq
 		/// removed and replaced with ::ParseIdentifier(...). It's left here to remind me.
 		/// <para>&#160;</para>
 		/// As with all other parsing members, this function will consume characters from the front
-		/// of the supplied string. If no error is thrown, the consumption should leave the supplied
-		/// string in a valid state that the parser can continue from. If an error is thrown, the
-		/// supplied input will most certainly be mangled as the comsumption most likely would have
-		/// stopped at an undefined state.
+		/// of the supplied string. If no error is recorded, the consumption should leave the
+		/// supplied string in a valid state that the parser can continue from. If an error is
+		/// recorded in the supplied state, the supplied input will most certainly be mangled as the
+		/// comsumption most likely would have stopped at an undefined state, and the return value
+		/// must be ignored.
 		/// </summary>
+		/// <param name="state">
+		/// The state of the parse in progress. The first error encountered is recorded here.
+		/// </param>
 		/// <param name="selectorStr">
 		/// The string from which to extract a valid name. The name is extracted from the front end
 		/// of the supplied string, removing it and placing it in the returned object.
@@ -416,7 +612,7 @@ namespace gq
 		/// <returns>
 		/// The extracted name. 
 		/// </returns>
-		boost::string_ref ParseName(boost::string_ref& selectorStr) const;
+		boost::string_ref ParseName(ParseState& state, boost::string_ref& selectorStr) const;
 
 		/// <summary>
 		/// Extracts a valid identifier from the front of the supplied string, removing it from the
@@ -425,14 +621,18 @@ namespace gq
 		/// Accepts named character and numbered character references as valid portions of an
 		/// indetifier. Also accepts escaped characters like "\E9 " as valid portions of an
 		/// identifier. The format for escaped characters must be followed, however. Must be a
-		/// slash, followed by ONLY valid hex digits, then a single space. Anything else will throw.
+		/// slash, followed by ONLY valid hex digits, then a single space. Anything else is an error.
 		/// <para>&#160;</para>
 		/// As with all other parsing members, this function will consume characters from the front
-		/// of the supplied string. If no error is thrown, the consumption should leave the supplied
-		/// string in a valid state that the parser can continue from. If an error is thrown, the
-		/// supplied input will most certainly be mangled as the comsumption most likely would have
-		/// stopped at an undefined state.
+		/// of the supplied string. If no error is recorded, the consumption should leave the
+		/// supplied string in a valid state that the parser can continue from. If an error is
+		/// recorded in the supplied state, the supplied input will most certainly be mangled as the
+		/// comsumption most likely would have stopped at an undefined state, and the return value
+		/// must be ignored.
 		/// </summary>
+		/// <param name="state">
+		/// The state of the parse in progress. The first error encountered is recorded here.
+		/// </param>
 		/// <param name="selectorStr">
 		/// The string from which to extract a identifier name. The identifier is extracted from the
 		/// front end of the supplied string, removing it and placing it in the returned object.
@@ -440,69 +640,7 @@ namespace gq
 		/// <returns>
 		/// The extracted identifier. 
 		/// </returns>
-		boost::string_ref ParseIdentifier(boost::string_ref& selectorStr) const;
-
-		/// <summary>
-		/// Checks whether the supplied character is a valid named entity character. Internally uses
-		/// std::isalpha with en_US-UTF8 locale.
-		/// </summary>
-		/// <param name="c">
-		/// The character to validate. 
-		/// </param>
-		/// <returns>
-		/// True of the supplied character is valid for a named entity, false otherwise. 
-		/// </returns>
-		const bool IsNameChar(const char& c) const;
-
-		/// <summary>
-		/// Checks if the supplied character is a valid starting character for a named entity.
-		/// Internally uses std::isalpha with en_US-UTF8 locale.
-		/// </summary>
-		/// <param name="c">
-		/// The character to validate. 
-		/// </param>
-		/// <returns>
-		/// True of the supplied character is a valid starting character for a named entity, false
-		/// otherwise.
-		/// </returns>
-		const bool IsNameStart(const char& c) const;
-
-		/// <summary>
-		/// Checks if the supplied character is a valid CSS selector combinator. 
-		/// </summary>
-		/// <param name="c">
-		/// The character to validate. 
-		/// </param>
-		/// <returns>
-		/// True if the supplied character is a valid CSS selector combinator, false otherwise. 
-		/// </returns>
-		const bool IsCombinator(const char& c) const;
-
-		/// <summary>
-		/// Check if the supplied character is a "special" character in CSS selectors. Not
-		/// necessarily a complete list. This function is meant to determine if certain escaped
-		/// characters found in identifiers are valid escaped characters, aka special characters
-		/// escaped that are commonly found in selector identifiers. For example, ":" can appear in
-		/// divs.
-		/// </summary>
-		/// <param name="c">
-		/// The character to check. 
-		/// </param>
-		/// <returns>
-		/// True if the supplied character is "special", false otherwise. 
-		/// </returns>
-		const bool IsSpecial(const char& c) const;
-
-		/// <summary>
-		/// Checks if the supplied character is a valid hexidecimal digit. 
-		/// </summary>
-		/// <param name="c">
-		/// The character to validate. 
-		/// </param>
-		/// <returns>
-		/// True if the supplied character is a valid hexidecimal digit, false otherwise. 
-		/// </returns>
-		const bool IsHexDigit(const char& c) const;		
+		boost::string_ref ParseIdentifier(ParseState& state, boost::string_ref& selectorStr) const;
 
 	};
 } /* namespace gq */
@@ -0,0 +1,1252 @@
+/*
+* Copyright (c) 2015 Jesse Nicholson
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+
+#include "Regex.hpp"
+#include <algorithm>
+#include <limits>
+#include <mutex>
+#include <unordered_map>
+
+namespace gq
+{
+
+	namespace
+	{
+
+		/// <summary>
+		/// Decodes the UTF-8 sequence at the supplied offset and advances the offset past it. A
+		/// byte which doesn't begin a complete and valid sequence is returned as is, on its own.
+		/// </summary>
+		uint32_t DecodeCharacter(boost::string_ref text, size_t& offset)
+		{
+			const unsigned char lead = static_cast<unsigned char>(text[offset]);
+
+			if (lead < 0x80)
+			{
+				++offset;
+				return lead;
+			}
+
+			const size_t length = (lead >= 0xC2 && lead <= 0xDF) ? 2 : (lead >= 0xE0 && lead <= 0xEF) ? 3 : (lead >= 0xF0 && lead <= 0xF4) ? 4 : 0;
+
+			if (length == 0 || offset + length > text.size())
+			{
+				++offset;
+				return lead;
+			}
+
+			uint32_t c = lead & (0x7F >> length);
+
+			for (size_t i = 1; i < length; ++i)
+			{
+				const unsigned char continuation = static_cast<unsigned char>(text[offset + i]);
+
+				if ((continuation & 0xC0) != 0x80)
+				{
+					++offset;
+					return lead;
+				}
+
+				c = (c << 6) | (continuation & 0x3F);
+			}
+
+			offset += length;
+			return c;
+		}
+
+		const uint32_t MaxCodePoint = 0x10FFFF;
+
+		typedef std::vector< std::pair<uint32_t, uint32_t> > CodePointRanges;
+
+		const CodePointRanges DigitRanges = { { '0', '9' } };
+
+		const CodePointRanges WordRanges = { { '0', '9' }, { 'A', 'Z' }, { '_', '_' }, { 'a', 'z' } };
+
+		const CodePointRanges SpaceRanges = 
+		{
+			{ 0x09, 0x0D }, { 0x20, 0x20 }, { 0xA0, 0xA0 }, { 0x1680, 0x1680 }, { 0x2000, 0x200A }, 
+			{ 0x2028, 0x2029 }, { 0x202F, 0x202F }, { 0x205F, 0x205F }, { 0x3000, 0x3000 }, { 0xFEFF, 0xFEFF }
+		};
+
+		/// <summary>
+		/// Sorts the supplied ranges and merges any that overlap or touch.
+		/// </summary>
+		void NormalizeRanges(CodePointRanges& ranges)
+		{
+			std::sort(ranges.begin(), ranges.end());
+
+			CodePointRanges merged;
+			merged.reserve(ranges.size());
+
+			for (const auto& range : ranges)
+			{
+				if (merged.size() > 0 && range.first <= merged.back().second + 1)
+				{
+					merged.back().second = std::max(merged.back().second, range.second);
+				}
+				else
+				{
+					merged.push_back(range);
+				}
+			}
+
+			ranges.swap(merged);
+		}
+
+		/// <summary>
+		/// Gets every code point that is not within the supplied ranges, which must already be
+		/// normalized.
+		/// </summary>
+		CodePointRanges ComplementRanges(const CodePointRanges& ranges)
+		{
+			CodePointRanges complement;
+			uint32_t next = 0;
+
+			for (const auto& range : ranges)
+			{
+				if (range.first > next)
+				{
+					complement.emplace_back(next, range.first - 1);
+				}
+
+				next = range.second + 1;
+			}
+
+			if (next <= MaxCodePoint)
+			{
+				complement.emplace_back(next, MaxCodePoint);
+			}
+
+			return complement;
+		}
+
+	}
+
+	const uint32_t Regex::NoCharacter = std::numeric_limits<uint32_t>::max();
+
+	const size_t Regex::MaxProgramSize = 16384;
+
+	/// <summary>
+	/// The Compiler parses a pattern into a tree and then compiles the tree into the program of a
+	/// Regex. Parsing stops at the first error.
+	/// </summary>
+	class Regex::Compiler
+	{
+
+	public:
+
+		Compiler(boost::string_ref pattern, Regex& expression) :
+			m_pattern(pattern), m_offset(0), m_depth(0), m_failed(false), m_expression(expression)
+		{
+
+		}
+
+		/// <summary>
+		/// Compiles the pattern into the expression.
+		/// </summary>
+		/// <returns>
+		/// True if the pattern was compiled, false if it was malformed or unsupported.
+		/// </returns>
+		const bool Compile()
+		{
+			Node root;
+
+			if (!ParseDisjunction(root))
+			{
+				return false;
+			}
+
+			if (m_offset < m_pattern.size())
+			{
+				// Only an unmatched closing parenthesis stops a disjunction early.
+				return false;
+			}
+
+			m_expression.m_anchored = root.kind == Node::Kind::Begin || (root.kind == Node::Kind::Concatenation && root.children.front().kind == Node::Kind::Begin);
+
+			Emit(root);
+			Push(Opcode::Match);
+
+			return !m_failed;
+		}
+
+	private:
+
+		/// <summary>
+		/// The deepest that groups may be nested, so that parsing can't overflow the stack.
+		/// </summary>
+		static const size_t MaxDepth = 128;
+
+		/// <summary>
+		/// The largest count a counted repetition may have.
+		/// </summary>
+		static const uint32_t MaxRepetitions = 1000;
+
+		/// <summary>
+		/// Stands in for the maximum of a repetition that has no upper bound.
+		/// </summary>
+		static const uint32_t Unbounded = std::numeric_limits<uint32_t>::max();
+
+		/// <summary>
+		/// A node of the parsed pattern.
+		/// </summary>
+		struct Node
+		{
+			enum class Kind
+			{
+				Empty,
+				Character,
+				Class,
+				AnyButLineTerminator,
+				Begin,
+				End,
+				WordBoundary,
+				NotWordBoundary,
+				Concatenation,
+				Alternation,
+				Repetition
+			};
+
+			Kind kind = Kind::Empty;
+
+			/// <summary>
+			/// The code point of a character, or the index of a class.
+			/// </summary>
+			uint32_t value = 0;
+
+			uint32_t min = 0;
+
+			uint32_t max = 0;
+
+			std::vector<Node> children;
+		};
+
+		boost::string_ref m_pattern;
+
+		size_t m_offset;
+
+		size_t m_depth;
+
+		bool m_failed;
+
+		Regex& m_expression;
+
+		const bool Fail()
+		{
+			m_failed = true;
+			return false;
+		}
+
+		const bool IsAt(const char c) const
+		{
+			return m_offset < m_pattern.size() && m_pattern[m_offset] == c;
+		}
+
+		const bool ParseDisjunction(Node& node)
+		{
+			Node alternative;
+
+			if (!ParseAlternative(alternative))
+			{
+				return false;
+			}
+
+			if (!IsAt('|'))
+			{
+				node = std::move(alternative);
+				return true;
+			}
+
+			node.kind = Node::Kind::Alternation;
+			node.children.push_back(std::move(alternative));
+
+			while (IsAt('|'))
+			{
+				++m_offset;
+
+				Node next;
+
+				if (!ParseAlternative(next))
+				{
+					return false;
+				}
+
+				node.children.push_back(std::move(next));
+			}
+
+			return true;
+		}
+
+		const bool ParseAlternative(Node& node)
+		{
+			node.kind = Node::Kind::Concatenation;
+
+			while (m_offset < m_pattern.size() && !IsAt('|') && !IsAt(')'))
+			{
+				if (!ParseTerm(node.children))
+				{
+					return false;
+				}
+			}
+
+			if (node.children.size() == 0)
+			{
+				node.kind = Node::Kind::Empty;
+			}
+			else if (node.children.size() == 1)
+			{
+				Node only = std::move(node.children.front());
+				node = std::move(only);
+			}
+
+			return true;
+		}
+
+		const bool ParseTerm(std::vector<Node>& terms)
+		{
+			Node atom;
+
+			switch (m_pattern[m_offset])
+			{
+				case '^':
+				case '$':
+				{
+					atom.kind = m_pattern[m_offset] == '^' ? Node::Kind::Begin : Node::Kind::End;
+					++m_offset;
+					terms.push_back(std::move(atom));
+
+					// Assertions can't be repeated.
+					return !IsQuantifierAt() || Fail();
+				}
+				break;
+
+				case '\\':
+				{
+					if (m_offset + 1 < m_pattern.size() && (m_pattern[m_offset + 1] == 'b' || m_pattern[m_offset + 1] == 'B'))
+					{
+						atom.kind = m_pattern[m_offset + 1] == 'b' ? Node::Kind::WordBoundary : Node::Kind::NotWordBoundary;
+						m_offset += 2;
+						terms.push_back(std::move(atom));
+						return !IsQuantifierAt() || Fail();
+					}
+
+					++m_offset;
+
+					uint32_t c = 0;
+					CodePointRanges ranges;
+
+					if (!ParseEscape(c, ranges, false))
+					{
+						return false;
+					}
+
+					if (ranges.size() > 0)
+					{
+						atom.kind = Node::Kind::Class;
+						atom.value = AddClass(std::move(ranges), false);
+					}
+					else
+					{
+						atom.kind = Node::Kind::Character;
+						atom.value = c;
+					}
+				}
+				break;
+
+				case '(':
+				{
+					++m_offset;
+
+					if (IsAt('?'))
+					{
+						// Only non-capturing groups are supported. Look around assertions and
+						// named groups are not.
+						if (m_offset + 1 >= m_pattern.size() || m_pattern[m_offset + 1] != ':')
+						{
+							return Fail();
+						}
+
+						m_offset += 2;
+					}
+
+					if (++m_depth > MaxDepth || !ParseDisjunction(atom))
+					{
+						return Fail();
+					}
+
+					--m_depth;
+
+					if (!IsAt(')'))
+					{
+						return Fail();
+					}
+
+					++m_offset;
+				}
+				break;
+
+				case '.':
+				{
+					atom.kind = Node::Kind::AnyButLineTerminator;
+					++m_offset;
+				}
+				break;
+
+				case '[':
+				{
+					if (!ParseClass(atom))
+					{
+						return false;
+					}
+				}
+				break;
+
+				case '*':
+				case '+':
+				case '?':
+				case '{':
+				{
+					// Nothing to repeat.
+					return Fail();
+				}
+				break;
+
+				default:
+				{
+					atom.kind = Node::Kind::Character;
+					atom.value = DecodeCharacter(m_pattern, m_offset);
+				}
+				break;
+			}
+
+			if (!ParseQuantifier(atom))
+			{
+				return false;
+			}
+
+			terms.push_back(std::move(atom));
+
+			return true;
+		}
+
+		const bool IsQuantifierAt()
+		{
+			uint32_t min, max;
+			const size_t offset = m_offset;
+			const bool isQuantifier = IsAt('*') || IsAt('+') || IsAt('?') || ParseBraces(min, max);
+			m_offset = offset;
+			return isQuantifier;
+		}
+
+		/// <summary>
+		/// Parses a counted repetition such as {2}, {2,} or {2,5}. If there isn't one at the
+		/// current offset, the offset is left where it was.
+		/// </summary>
+		const bool ParseBraces(uint32_t& min, uint32_t& max)
+		{
+			const size_t offset = m_offset;
+
+			if (!IsAt('{'))
+			{
+				return false;
+			}
+
+			++m_offset;
+
+			if (!ParseDecimal(min))
+			{
+				m_offset = offset;
+				return false;
+			}
+
+			max = min;
+
+			if (IsAt(','))
+			{
+				++m_offset;
+
+				if (!ParseDecimal(max))
+				{
+					max = Unbounded;
+				}
+			}
+
+			if (!IsAt('}'))
+			{
+				m_offset = offset;
+				return false;
+			}
+
+			++m_offset;
+			return true;
+		}
+
+		const bool ParseDecimal(uint32_t& value)
+		{
+			const size_t offset = m_offset;
+			value = 0;
+
+			while (m_offset < m_pattern.size() && m_pattern[m_offset] >= '0' && m_pattern[m_offset] <= '9')
+			{
+				// Anything past the limit is rejected later, so the value only needs to stay
+				// above it.
+				value = std::min(value * 10 + static_cast<uint32_t>(m_pattern[m_offset] - '0'), MaxRepetitions + 1);
+				++m_offset;
+			}
+
+			return m_offset > offset;
+		}
+
+		const bool ParseQuantifier(Node& atom)
+		{
+			uint32_t min = 0;
+			uint32_t max = 0;
+
+			if (IsAt('*'))
+			{
+				min = 0;
+				max = Unbounded;
+				++m_offset;
+			}
+			else if (IsAt('+'))
+			{
+				min = 1;
+				max = Unbounded;
+				++m_offset;
+			}
+			else if (IsAt('?'))
+			{
+				min = 0;
+				max = 1;
+				++m_offset;
+			}
+			else if (!ParseBraces(min, max))
+			{
+				return true;
+			}
+
+			if (min > MaxRepetitions || (max != Unbounded && (max > MaxRepetitions || max < min)))
+			{
+				return Fail();
+			}
+
+			// Lazy quantifiers match the same text, and only whether or not there is a match is
+			// of interest.
+			if (IsAt('?'))
+			{
+				++m_offset;
+			}
+
+			Node repetition;
+			repetition.kind = Node::Kind::Repetition;
+			repetition.min = min;
+			repetition.max = max;
+			repetition.children.push_back(std::move(atom));
+			atom = std::move(repetition);
+
+			return true;
+		}
+
+		const bool ParseHex(const size_t digits, uint32_t& value)
+		{
+			if (m_offset + digits > m_pattern.size())
+			{
+				return Fail();
+			}
+
+			value = 0;
+
+			for (size_t i = 0; i < digits; ++i)
+			{
+				const char c = m_pattern[m_offset + i];
+				const uint32_t digit = (c >= '0' && c <= '9') ? c - '0' : (c >= 'a' && c <= 'f') ? c - 'a' + 10 : (c >= 'A' && c <= 'F') ? c - 'A' + 10 : 16;
+
+				if (digit > 15)
+				{
+					return Fail();
+				}
+
+				value = (value << 4) | digit;
+			}
+
+			m_offset += digits;
+			return true;
+		}
+
+		/// <summary>
+		/// Parses what follows a backslash. Class escapes such as \d fill the supplied ranges,
+		/// everything else gives a single character.
+		/// </summary>
+		const bool ParseEscape(uint32_t& c, CodePointRanges& ranges, const bool inClass)
+		{
+			if (m_offset >= m_pattern.size())
+			{
+				return Fail();
+			}
+
+			const char escaped = m_pattern[m_offset];
+			++m_offset;
+
+			switch (escaped)
+			{
+				case 'd':
+				case 'D':
+				case 'w':
+				case 'W':
+				case 's':
+				case 'S':
+				{
+					ranges = escaped == 'd' || escaped == 'D' ? DigitRanges : escaped == 'w' || escaped == 'W' ? WordRanges : SpaceRanges;
+
+					if (escaped == 'D' || escaped == 'W' || escaped == 'S')
+					{
+						ranges = ComplementRanges(ranges);
+					}
+
+					return true;
+				}
+				break;
+
+				case 'b':
+				{
+					// Only reached within a class, where it is a backspace.
+					c = 0x08;
+					return inClass || Fail();
+				}
+				break;
+
+				case 't':
+				{
+					c = 0x09;
+				}
+				break;
+
+				case 'n':
+				{
+					c = 0x0A;
+				}
+				break;
+
+				case 'v':
+				{
+					c = 0x0B;
+				}
+				break;
+
+				case 'f':
+				{
+					c = 0x0C;
+				}
+				break;
+
+				case 'r':
+				{
+					c = 0x0D;
+				}
+				break;
+
+				case '0':
+				{
+					// Anything more would be an octal escape or a back reference.
+					if (m_offset < m_pattern.size() && m_pattern[m_offset] >= '0' && m_pattern[m_offset] <= '9')
+					{
+						return Fail();
+					}
+
+					c = 0;
+				}
+				break;
+
+				case 'c':
+				{
+					if (m_offset >= m_pattern.size() || !((m_pattern[m_offset] >= 'a' && m_pattern[m_offset] <= 'z') || (m_pattern[m_offset] >= 'A' && m_pattern[m_offset] <= 'Z')))
+					{
+						return Fail();
+					}
+
+					c = static_cast<uint32_t>(m_pattern[m_offset]) % 32;
+					++m_offset;
+				}
+				break;
+
+				case 'x':
+				{
+					return ParseHex(2, c);
+				}
+				break;
+
+				case 'u':
+				{
+					return ParseHex(4, c);
+				}
+				break;
+
+				default:
+				{
+					// Back references, and escaped letters and digits with no meaning, are
+					// rejected. Anything else stands for itself.
+					if ((escaped >= '0' && escaped <= '9') || (escaped >= 'a' && escaped <= 'z') || (escaped >= 'A' && escaped <= 'Z'))
+					{
+						return Fail();
+					}
+
+					--m_offset;
+					c = DecodeCharacter(m_pattern, m_offset);
+				}
+				break;
+			}
+
+			return true;
+		}
+
+		const bool ParseClassAtom(uint32_t& c, CodePointRanges& ranges)
+		{
+			if (IsAt('\\'))
+			{
+				++m_offset;
+				return ParseEscape(c, ranges, true);
+			}
+
+			c = DecodeCharacter(m_pattern, m_offset);
+			return true;
+		}
+
+		const bool ParseClass(Node& atom)
+		{
+			++m_offset;
+
+			const bool negated = IsAt('^');
+
+			if (negated)
+			{
+				++m_offset;
+			}
+
+			CodePointRanges members;
+
+			while (m_offset < m_pattern.size() && !IsAt(']'))
+			{
+				uint32_t first = 0;
+				CodePointRanges escapeRanges;
+
+				if (!ParseClassAtom(first, escapeRanges))
+				{
+					return false;
+				}
+
+				if (escapeRanges.size() > 0)
+				{
+					members.insert(members.end(), escapeRanges.begin(), escapeRanges.end());
+					continue;
+				}
+
+				if (IsAt('-') && m_offset + 1 < m_pattern.size() && m_pattern[m_offset + 1] != ']')
+				{
+					++m_offset;
+
+					uint32_t last = 0;
+
+					if (!ParseClassAtom(last, escapeRanges))
+					{
+						return false;
+					}
+
+					if (escapeRanges.size() > 0 || last < first)
+					{
+						return Fail();
+					}
+
+					members.emplace_back(first, last);
+				}
+				else
+				{
+					members.emplace_back(first, first);
+				}
+			}
+
+			if (!IsAt(']'))
+			{
+				return Fail();
+			}
+
+			++m_offset;
+
+			atom.kind = Node::Kind::Class;
+			atom.value = AddClass(std::move(members), negated);
+
+			return true;
+		}
+
+		const uint32_t AddClass(CodePointRanges ranges, const bool negated)
+		{
+			NormalizeRanges(ranges);
+
+			CharacterClass characterClass;
+			characterClass.ranges = negated ? ComplementRanges(ranges) : std::move(ranges);
+			characterClass.ascii[0] = 0;
+			characterClass.ascii[1] = 0;
+
+			for (const auto& range : characterClass.ranges)
+			{
+				for (uint32_t c = range.first; c <= range.second && c < 128; ++c)
+				{
+					characterClass.ascii[c / 64] |= static_cast<uint64_t>(1) << (c % 64);
+				}
+			}
+
+			m_expression.m_classes.push_back(std::move(characterClass));
+
+			return static_cast<uint32_t>(m_expression.m_classes.size() - 1);
+		}
+
+		const size_t Push(const Opcode opcode, const uint32_t first = 0, const uint32_t second = 0)
+		{
+			if (m_expression.m_program.size() >= MaxProgramSize)
+			{
+				m_failed = true;
+				return m_expression.m_program.size();
+			}
+
+			Instruction instruction;
+			instruction.opcode = opcode;
+			instruction.first = first;
+			instruction.second = second;
+			m_expression.m_program.push_back(instruction);
+
+			return m_expression.m_program.size() - 1;
+		}
+
+		/// <summary>
+		/// Sets the second operand of the supplied split instruction, if it was emitted.
+		/// </summary>
+		void PatchSecond(const size_t instruction, const size_t target)
+		{
+			if (instruction < m_expression.m_program.size())
+			{
+				m_expression.m_program[instruction].second = static_cast<uint32_t>(target);
+			}
+		}
+
+		void Emit(const Node& node)
+		{
+			if (m_failed)
+			{
+				return;
+			}
+
+			auto& program = m_expression.m_program;
+
+			switch (node.kind)
+			{
+				case Node::Kind::Empty:
+				break;
+
+				case Node::Kind::Character:
+				{
+					Push(Opcode::Character, node.value);
+				}
+				break;
+
+				case Node::Kind::Class:
+				{
+					Push(Opcode::Class, node.value);
+				}
+				break;
+
+				case Node::Kind::AnyButLineTerminator:
+				{
+					Push(Opcode::AnyButLineTerminator);
+				}
+				break;
+
+				case Node::Kind::Begin:
+				{
+					Push(Opcode::AssertBegin);
+				}
+				break;
+
+				case Node::Kind::End:
+				{
+					Push(Opcode::AssertEnd);
+				}
+				break;
+
+				case Node::Kind::WordBoundary:
+				{
+					Push(Opcode::AssertWordBoundary);
+				}
+				break;
+
+				case Node::Kind::NotWordBoundary:
+				{
+					Push(Opcode::AssertNotWordBoundary);
+				}
+				break;
+
+				case Node::Kind::Concatenation:
+				{
+					for (const auto& child : node.children)
+					{
+						Emit(child);
+					}
+				}
+				break;
+
+				case Node::Kind::Alternation:
+				{
+					std::vector<size_t> jumps;
+
+					for (size_t i = 0; i + 1 < node.children.size(); ++i)
+					{
+						const size_t split = Push(Opcode::Split, static_cast<uint32_t>(program.size() + 1));
+						Emit(node.children[i]);
+						jumps.push_back(Push(Opcode::Jump));
+						PatchSecond(split, program.size());
+					}
+
+					Emit(node.children.back());
+
+					for (const auto jump : jumps)
+					{
+						if (jump < program.size())
+						{
+							program[jump].first = static_cast<uint32_t>(program.size());
+						}
+					}
+				}
+				break;
+
+				case Node::Kind::Repetition:
+				{
+					const Node& child = node.children.front();
+
+					for (uint32_t i = 0; i < node.min && !m_failed; ++i)
+					{
+						Emit(child);
+					}
+
+					if (node.max == Unbounded)
+					{
+						const size_t loop = program.size();
+						const size_t split = Push(Opcode::Split, static_cast<uint32_t>(loop + 1));
+						Emit(child);
+						Push(Opcode::Jump, static_cast<uint32_t>(loop));
+						PatchSecond(split, program.size());
+					}
+					else
+					{
+						std::vector<size_t> splits;
+
+						for (uint32_t i = node.min; i < node.max && !m_failed; ++i)
+						{
+							splits.push_back(Push(Opcode::Split, static_cast<uint32_t>(program.size() + 1)));
+							Emit(child);
+						}
+
+						for (const auto split : splits)
+						{
+							PatchSecond(split, program.size());
+						}
+					}
+				}
+				break;
+			}
+		}
+
+	};
+
+	Regex::Searcher::Searcher(const Regex& expression) :
+		m_expression(expression), m_visited(expression.m_program.size(), 0), m_position(0), m_previous(NoCharacter), m_matched(false), m_done(false)
+	{
+		m_pending.reserve(expression.m_program.size());
+		m_current.reserve(expression.m_program.size());
+	}
+
+	Regex::Searcher::~Searcher()
+	{
+
+	}
+
+	void Regex::Searcher::Feed(boost::string_ref text)
+	{
+		size_t offset = 0;
+
+		while (!m_done && offset < text.size())
+		{
+			Step(DecodeCharacter(text, offset));
+		}
+	}
+
+	const bool Regex::Searcher::Finish()
+	{
+		if (!m_done)
+		{
+			Step(NoCharacter);
+		}
+
+		return m_matched;
+	}
+
+	const bool Regex::Searcher::IsDone() const
+	{
+		return m_done;
+	}
+
+	void Regex::Searcher::Step(const uint32_t next)
+	{
+		if (++m_position == 0)
+		{
+			// The positions have wrapped around, so the record of what was visited when has to
+			// start over.
+			std::fill(m_visited.begin(), m_visited.end(), 0);
+			m_position = 1;
+		}
+
+		m_current.clear();
+
+		for (size_t i = 0; i < m_pending.size() && !m_matched; ++i)
+		{
+			Follow(m_pending[i], next);
+		}
+
+		// A new match may begin at every position, unless matches must begin at the beginning.
+		if (!m_matched && (!m_expression.m_anchored || m_previous == NoCharacter))
+		{
+			Follow(0, next);
+		}
+
+		m_pending.clear();
+
+		if (m_matched || next == NoCharacter)
+		{
+			m_done = true;
+			return;
+		}
+
+		for (const auto instruction : m_current)
+		{
+			const auto& current = m_expression.m_program[instruction];
+			bool consumed = false;
+
+			switch (current.opcode)
+			{
+				case Opcode::Character:
+				{
+					consumed = current.first == next;
+				}
+				break;
+
+				case Opcode::Class:
+				{
+					consumed = m_expression.m_classes[current.first].Contains(next);
+				}
+				break;
+
+				case Opcode::AnyButLineTerminator:
+				{
+					consumed = next != 0x0A && next != 0x0D && next != 0x2028 && next != 0x2029;
+				}
+				break;
+
+				default:
+				break;
+			}
+
+			if (consumed)
+			{
+				m_pending.push_back(instruction + 1);
+			}
+		}
+
+		m_previous = next;
+
+		if (m_pending.size() == 0 && m_expression.m_anchored)
+		{
+			// Nothing is left that could match.
+			m_done = true;
+		}
+	}
+
+	void Regex::Searcher::Follow(const uint32_t instruction, const uint32_t next)
+	{
+		m_stack.push_back(instruction);
+
+		while (m_stack.size() > 0)
+		{
+			const uint32_t index = m_stack.back();
+			m_stack.pop_back();
+
+			if (m_visited[index] == m_position)
+			{
+				continue;
+			}
+
+			m_visited[index] = m_position;
+
+			const auto& current = m_expression.m_program[index];
+
+			switch (current.opcode)
+			{
+				case Opcode::Split:
+				{
+					m_stack.push_back(current.second);
+					m_stack.push_back(current.first);
+				}
+				break;
+
+				case Opcode::Jump:
+				{
+					m_stack.push_back(current.first);
+				}
+				break;
+
+				case Opcode::AssertBegin:
+				{
+					if (m_previous == NoCharacter)
+					{
+						m_stack.push_back(index + 1);
+					}
+				}
+				break;
+
+				case Opcode::AssertEnd:
+				{
+					if (next == NoCharacter)
+					{
+						m_stack.push_back(index + 1);
+					}
+				}
+				break;
+
+				case Opcode::AssertWordBoundary:
+				case Opcode::AssertNotWordBoundary:
+				{
+					const bool isBoundary = IsWordCharacter(m_previous) != IsWordCharacter(next);
+
+					if (isBoundary == (current.opcode == Opcode::AssertWordBoundary))
+					{
+						m_stack.push_back(index + 1);
+					}
+				}
+				break;
+
+				case Opcode::Match:
+				{
+					m_matched = true;
+					m_stack.clear();
+					return;
+				}
+				break;
+
+				default:
+				{
+					m_current.push_back(index);
+				}
+				break;
+			}
+		}
+	}
+
+	std::shared_ptr<const Regex> Regex::Get(boost::string_ref pattern)
+	{
+		// Expressions are only held weakly, so that the cache never keeps an expression alive
+		// once no selector is using it.
+		static std::mutex cacheMutex;
+		static std::unordered_map< std::string, std::weak_ptr<const Regex> > cache;
+		static size_t nextSweepSize = 64;
+
+		std::lock_guard<std::mutex> lock(cacheMutex);
+
+		const std::string key = pattern.to_string();
+
+		auto existing = cache.find(key);
+
+		if (existing != cache.end())
+		{
+			auto expression = existing->second.lock();
+
+			if (expression != nullptr)
+			{
+				return expression;
+			}
+		}
+
+		std::shared_ptr<Regex> expression(new Regex());
+		Compiler compiler(pattern, *expression);
+
+		if (!compiler.Compile())
+		{
+			return nullptr;
+		}
+
+		if (cache.size() >= nextSweepSize)
+		{
+			for (auto entry = cache.begin(); entry != cache.end();)
+			{
+				entry = entry->second.expired() ? cache.erase(entry) : std::next(entry);
+			}
+
+			nextSweepSize = std::max(static_cast<size_t>(64), cache.size() * 2);
+		}
+
+		cache[key] = expression;
+
+		return expression;
+	}
+
+	Regex::Regex() :
+		m_anchored(false)
+	{
+
+	}
+
+	Regex::~Regex()
+	{
+
+	}
+
+	const bool Regex::Search(boost::string_ref text) const
+	{
+		Searcher searcher(*this);
+		searcher.Feed(text);
+		return searcher.Finish();
+	}
+
+	const bool Regex::CharacterClass::Contains(const uint32_t c) const
+	{
+		if (c < 128)
+		{
+			return (ascii[c / 64] & (static_cast<uint64_t>(1) << (c % 64))) != 0;
+		}
+
+		auto range = std::upper_bound(ranges.begin(), ranges.end(), std::make_pair(c, NoCharacter));
+
+		return range != ranges.begin() && (range - 1)->second >= c;
+	}
+
+	const bool Regex::IsWordCharacter(const uint32_t c)
+	{
+		return (c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || c == '_';
+	}
+
+} /* namespace gq */
@@ -0,0 +1,287 @@
+/*
+* Copyright (c) 2015 Jesse Nicholson
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include <boost/utility/string_ref.hpp>
+
+namespace gq
+{
+
+	/// <summary>
+	/// The Regex is a regular expression engine that searches in time linear in the length of the
+	/// text, no matter what the pattern is. Patterns are compiled into a Thompson NFA, which is run
+	/// by advancing every possible state at once over each character of the text in turn, so no
+	/// character is ever looked at twice and there is no backtracking to blow up.
+	/// <para>&#160;</para>
+	/// Patterns follow the ECMAScript grammar, minus the features that can't be matched without
+	/// backtracking. Supported are literals, ".", character classes with ranges and negation, the
+	/// \d \D \w \W \s \S class escapes, the \t \n \v \f \r \0 \cX \xHH \uHHHH character escapes,
+	/// identity escapes, grouping with (...) and (?:...), alternation, the * + ? {n} {n,} {n,m}
+	/// quantifiers and their lazy forms, and the ^ $ \b \B assertions. Back references and look
+	/// around assertions are rejected. Since only whether or not the text matches is reported,
+	/// groups capture nothing and lazy quantifiers behave the same as greedy ones.
+	/// <para>&#160;</para>
+	/// Text and patterns are UTF-8, and are matched one code point at a time. Bytes which are not
+	/// part of a valid UTF-8 sequence are matched as the code point of the same value.
+	/// <para>&#160;</para>
+	/// Compiled expressions are immutable and may be shared by any number of threads. ::Get(...)
+	/// hands out a single shared instance for every distinct pattern in use.
+	/// </summary>
+	class Regex
+	{
+
+	public:
+
+		/// <summary>
+		/// The Searcher runs a single search of a Regex over text that is supplied in pieces, as
+		/// if the pieces were one string. This lets text spread over many nodes be searched
+		/// without first being copied together.
+		/// </summary>
+		class Searcher
+		{
+
+		public:
+
+			/// <summary>
+			/// Begins a search for the supplied expression. The expression must outlive the
+			/// searcher.
+			/// </summary>
+			/// <param name="expression">
+			/// The expression to search for. 
+			/// </param>
+			Searcher(const Regex& expression);
+
+			/// <summary>
+			/// Default destructor.
+			/// </summary>
+			~Searcher();
+
+			/// <summary>
+			/// Searches the next piece of text. Does nothing once the outcome of the search is
+			/// known.
+			/// </summary>
+			/// <param name="text">
+			/// The next piece of text. Pieces must break between characters, never inside a UTF-8
+			/// sequence.
+			/// </param>
+			void Feed(boost::string_ref text);
+
+			/// <summary>
+			/// Ends the text and gets the outcome of the search.
+			/// </summary>
+			/// <returns>
+			/// True if the expression matched anywhere within the text, false otherwise.
+			/// </returns>
+			const bool Finish();
+
+			/// <summary>
+			/// Checks whether the outcome of the search is already known, so that no more text
+			/// needs to be fed.
+			/// </summary>
+			/// <returns>
+			/// True if the outcome of the search is known, false otherwise.
+			/// </returns>
+			const bool IsDone() const;
+
+		private:
+
+			/// <summary>
+			/// The expression being searched for.
+			/// </summary>
+			const Regex& m_expression;
+
+			/// <summary>
+			/// The instructions to resume from at the current position, before following any
+			/// instructions which don't consume a character.
+			/// </summary>
+			std::vector<uint32_t> m_pending;
+
+			/// <summary>
+			/// The consuming instructions reached at the current position.
+			/// </summary>
+			std::vector<uint32_t> m_current;
+
+			/// <summary>
+			/// Instructions waiting to be followed at the current position.
+			/// </summary>
+			std::vector<uint32_t> m_stack;
+
+			/// <summary>
+			/// The position at which each instruction was last reached, so that no instruction is
+			/// followed twice at the same position.
+			/// </summary>
+			std::vector<uint32_t> m_visited;
+
+			/// <summary>
+			/// The current position, counting from one.
+			/// </summary>
+			uint32_t m_position;
+
+			/// <summary>
+			/// The character before the current position, or ::NoCharacter at the beginning.
+			/// </summary>
+			uint32_t m_previous;
+
+			/// <summary>
+			/// Whether or not the expression has matched.
+			/// </summary>
+			bool m_matched;
+
+			/// <summary>
+			/// Whether or not the outcome of the search is known.
+			/// </summary>
+			bool m_done;
+
+			/// <summary>
+			/// Follows every pending instruction at the current position, given the character at
+			/// that position, and then steps over the character.
+			/// </summary>
+			void Step(const uint32_t next);
+
+			/// <summary>
+			/// Follows the supplied instruction and every instruction it leads to without
+			/// consuming a character.
+			/// </summary>
+			void Follow(const uint32_t instruction, const uint32_t next);
+
+		};
+
+		/// <summary>
+		/// Gets the compiled expression for the supplied pattern. Every caller that asks for the
+		/// same pattern while a previous instance is still alive gets that same instance. This
+		/// method is thread safe.
+		/// </summary>
+		/// <param name="pattern">
+		/// The pattern to compile. 
+		/// </param>
+		/// <returns>
+		/// The compiled expression, or nullptr if the pattern is malformed or uses an unsupported
+		/// feature.
+		/// </returns>
+		static std::shared_ptr<const Regex> Get(boost::string_ref pattern);
+
+		/// <summary>
+		/// Default destructor.
+		/// </summary>
+		~Regex();
+
+		/// <summary>
+		/// Searches the supplied text.
+		/// </summary>
+		/// <param name="text">
+		/// The text to search. 
+		/// </param>
+		/// <returns>
+		/// True if the expression matched anywhere within the text, false otherwise.
+		/// </returns>
+		const bool Search(boost::string_ref text) const;
+
+	private:
+
+		class Compiler;
+
+		/// <summary>
+		/// Stands in for the character before the beginning, and after the end, of the text.
+		/// </summary>
+		static const uint32_t NoCharacter;
+
+		/// <summary>
+		/// The largest number of instructions a pattern may compile to. Counted repetitions copy
+		/// what they repeat, so this is what stops a short pattern from taking over memory.
+		/// </summary>
+		static const size_t MaxProgramSize;
+
+		enum class Opcode : uint8_t
+		{
+			Character,
+			Class,
+			AnyButLineTerminator,
+			Split,
+			Jump,
+			AssertBegin,
+			AssertEnd,
+			AssertWordBoundary,
+			AssertNotWordBoundary,
+			Match
+		};
+
+		/// <summary>
+		/// A single instruction. The meaning of the operands depends on the opcode. Character
+		/// takes the code point to match, Class the index of the class, Jump the instruction to
+		/// continue at and Split both instructions to continue at.
+		/// </summary>
+		struct Instruction
+		{
+			Opcode opcode;
+			uint32_t first;
+			uint32_t second;
+		};
+
+		/// <summary>
+		/// A set of code points, held as sorted and disjoint inclusive ranges, with a bitmap of
+		/// the ASCII members for speed.
+		/// </summary>
+		struct CharacterClass
+		{
+			std::vector< std::pair<uint32_t, uint32_t> > ranges;
+			uint64_t ascii[2];
+
+			const bool Contains(const uint32_t c) const;
+		};
+
+		/// <summary>
+		/// Builds an empty expression, to be filled in by the Compiler.
+		/// </summary>
+		Regex();
+
+		/// <summary>
+		/// The compiled program. The first instruction is where every match begins.
+		/// </summary>
+		std::vector<Instruction> m_program;
+
+		/// <summary>
+		/// The character classes used by the program.
+		/// </summary>
+		std::vector<CharacterClass> m_classes;
+
+		/// <summary>
+		/// Whether or not every match must begin at the beginning of the text, in which case a
+		/// search can give up as soon as the program runs out of states.
+		/// </summary>
+		bool m_anchored;
+
+		/// <summary>
+		/// Checks if the supplied character is a word character, as far as \b and \B are
+		/// concerned.
+		/// </summary>
+		static const bool IsWordCharacter(const uint32_t c);
+
+	};
+
+} /* namespace gq */
@@ -27,6 +27,8 @@
 * THE SOFTWARE.
 */
 
+#include <algorithm>
+#include <new>
 #include <unordered_set>
 #include "Selector.hpp"
 #include "Node.hpp"
@@ -77,7 +79,8 @@ namespace gq
 		if (m_selectorOperator == SelectorOperator::Dummy)
 		{
 			// A dummy can match anything. So we add a trait that it can match against any tag type.
-			AddMatchTrait(SpecialTraits::GetTagKey(), SpecialTraits::GetAnyValue());
+			AddMatchTraits(GetAnyElementTraits());
+			SetHasExactMatchTraits(true);
 		}
 
 		#ifndef NDEBUG
@@ -159,14 +162,30 @@ namespace gq
 
 	const boost::string_ref Selector::GetNormalizedTagTypeToMatch() const
 	{
-		return m_normalizedTagTypeToMatch;
+		if (m_tagTypeToMatch == GUMBO_TAG_UNKNOWN)
+		{
+			return boost::string_ref();
+		}
+
+		// Gumbo hands out static strings for normalized names, so there's no need to keep a copy.
+		return boost::string_ref(gumbo_normalized_tagname(m_tagTypeToMatch));
 	}
 
-	const std::vector< std::pair<boost::string_ref, boost::string_ref> >& Selector::GetMatchTraits() const
+	const Selector::TraitCollection& Selector::GetMatchTraits() const
 	{
 		return m_matchTraits;
 	}
 
+	const Selector::TraitCollection& Selector::GetExclusionTraits() const
+	{
+		return m_exclusionTraits;
+	}
+
+	const bool Selector::HasExactMatchTraits() const
+	{
+		return m_hasExactMatchTraits;
+	}
+
 	const Selector::MatchResult Selector::Match(const Node* node) const
 	{
 
@@ -386,7 +405,7 @@ namespace gq
 
 	boost::string_ref Selector::GetOriginalSelectorString() const
 	{
-		return boost::string_ref(m_originalSelectorString);
+		return m_originalSelectorString;
 	}
 
 	void Selector::SetTagTypeToMatch(const GumboTag tag)
@@ -395,31 +414,112 @@ namespace gq
 
 		if (m_tagTypeToMatch != GUMBO_TAG_UNKNOWN)
 		{
-			const char* normalName = gumbo_normalized_tagname(m_tagTypeToMatch);
-			
-			m_normalizedTagTypeToMatch = boost::string_ref(normalName);
-
-			// Add the tag type as a match trait
-			AddMatchTrait(SpecialTraits::GetTagKey(), m_normalizedTagTypeToMatch);
+			// Add the tag type as a match trait. Every node indexed under this tag name is of
+			// this tag type, so the trait is exact.
+			AddMatchTrait(SpecialTraits::GetTagKey(), GetNormalizedTagTypeToMatch());
+			SetHasExactMatchTraits(true);
 		}
 	}
 
 	void Selector::AddMatchTrait(boost::string_ref key, boost::string_ref value)
 	{
-		auto pair = std::make_pair(key, value);
-		if (std::find(m_matchTraits.begin(), m_matchTraits.end(), pair) == m_matchTraits.end())
+		const Trait trait(key, value);
+		MergeTraits(m_matchTraits, &trait, 1, false);
+	}
+
+	void Selector::AddExclusionTrait(boost::string_ref key, boost::string_ref value)
+	{
+		const Trait trait(key, value);
+		MergeTraits(m_exclusionTraits, &trait, 1, false);
+	}
+
+	void Selector::AddMatchTraits(const TraitCollection& traits)
+	{
+		MergeTraits(m_matchTraits, traits.begin(), traits.size(), true);
+	}
+
+	void Selector::AddExclusionTraits(const TraitCollection& traits)
+	{
+		MergeTraits(m_exclusionTraits, traits.begin(), traits.size(), true);
+	}
+
+	const Selector::TraitCollection& Selector::GetAnyElementTraits()
+	{
+		static const Trait anyElement[1] = { Trait(SpecialTraits::GetTagKey(), SpecialTraits::GetAnyValue()) };
+		static const TraitCollection anyElementTraits(anyElement, 1);
+		return anyElementTraits;
+	}
+
+	boost::string_ref Selector::InternString(boost::string_ref str)
+	{
+		if (str.size() == 0)
 		{
-			m_matchTraits.emplace_back(std::move(pair));
+			return boost::string_ref();
 		}
+
+		return GetArena().Intern(str);
+	}
+
+	SelectorArena& Selector::GetArena()
+	{
+		if (m_arena == nullptr)
+		{
+			m_arena = SelectorArena::Create();
+		}
+
+		return *m_arena;
+	}
+
+	void Selector::MergeTraits(TraitCollection& target, const Trait* traits, const size_t count, const bool shareable)
+	{
+		if (count == 0)
+		{
+			return;
+		}
+
+		if (target.size() == 0 && shareable)
+		{
+			// Traits taken on in bulk come from a child selector that this selector holds on to,
+			// or from static storage, so they'll outlive us and can simply be shared.
+			target = TraitCollection(traits, count);
+			return;
+		}
+
+		// Collections are immutable once published, so growing one means building a new run in
+		// the arena. Selectors only ever have a handful of traits, so this costs little.
+		Trait* merged = static_cast<Trait*>(GetArena().Allocate(sizeof(Trait) * (target.size() + count), alignof(Trait)));
+		size_t mergedCount = 0;
+
+		for (const auto& existing : target)
+		{
+			new (merged + mergedCount++) Trait(existing);
+		}
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			if (std::find(merged, merged + mergedCount, traits[i]) == merged + mergedCount)
+			{
+				new (merged + mergedCount++) Trait(traits[i]);
+			}
+		}
+
+		target = TraitCollection(merged, mergedCount);
+	}
+
+	void Selector::SetHasExactMatchTraits(const bool exact)
+	{
+		m_hasExactMatchTraits = exact;
 	}
 
 	void Selector::InitDefaults()
 	{
+		m_hasExactMatchTraits = false;
 		m_matchType = false;
 		m_leftHandSideOfNth = 0;
 		m_rightHandSideOfNth = 0;
 		m_matchLast = false;
 		m_tagTypeToMatch = GUMBO_TAG_UNKNOWN;
+		m_arena = SelectorArena::GetCurrent();
 	}
 
 	void Selector::MatchAllInto(const Node* node, std::vector< const Node* >& nodes) const
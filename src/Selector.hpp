@@ -35,6 +35,7 @@
 #include <vector>
 #include <cassert>
 #include <boost/utility/string_ref.hpp>
+#include "SelectorArena.hpp"
 
 // For printing debug information about compiled selectors to the console.
 #ifndef NDEBUG
@@ -58,6 +59,12 @@ namespace gq
 		// the request of the user.
 		friend class Parser;
 
+		// So that compiled selectors can be written to and read back from the binary format.
+		friend class SelectorCodec;
+
+		// So that equivalent compiled selectors can be recognized and merged.
+		friend class SelectorCanonicalizer;
+
 	public:
 
 		enum class SelectorOperator
@@ -88,6 +95,60 @@ namespace gq
 			Tag
 		};
 
+		/// <summary>
+		/// A trait is an attribute name and value pair, used for looking up candidates in the
+		/// TreeMap. See ::GetMatchTraits().
+		/// </summary>
+		typedef std::pair<boost::string_ref, boost::string_ref> Trait;
+
+		/// <summary>
+		/// An immutable run of traits. Traits are stored once, in the arena of the selector that
+		/// created them, and combining selectors that take on the traits of a child refer to the
+		/// child's traits rather than copying them.
+		/// </summary>
+		class TraitCollection
+		{
+
+		public:
+
+			TraitCollection() : m_traits(nullptr), m_size(0)
+			{
+
+			}
+
+			TraitCollection(const Trait* traits, const size_t size) : m_traits(traits), m_size(size)
+			{
+
+			}
+
+			const Trait* begin() const
+			{
+				return m_traits;
+			}
+
+			const Trait* end() const
+			{
+				return m_traits + m_size;
+			}
+
+			const size_t size() const
+			{
+				return m_size;
+			}
+
+			const Trait& operator[](const size_t index) const
+			{
+				return m_traits[index];
+			}
+
+		private:
+
+			const Trait* m_traits;
+
+			size_t m_size;
+
+		};
+
 		/// <summary>
 		/// Not all selectors are simple. Some selectors search for children or even descendants of
 		/// nodes. When such selectors are run, they are expected to return the most righthand
@@ -227,7 +288,31 @@ namespace gq
 		/// <returns>
 		/// A collection of attributes that can be used to narrow down potential match candidates. 
 		/// </returns>
-		const std::vector< std::pair<boost::string_ref, boost::string_ref> >& GetMatchTraits() const;
+		const TraitCollection& GetMatchTraits() const;
+
+		/// <summary>
+		/// Get a collection of attributes that identify nodes which this selector can never match.
+		/// Nodes found through these attributes are subtracted from the candidates found through
+		/// the match traits before any matching is attempted. This is what allows selectors such
+		/// as :not(...) to start from a broad candidate set without testing the nodes that are
+		/// already known to fail.
+		/// </summary>
+		/// <returns>
+		/// A collection of attributes that can be used to eliminate potential match candidates. 
+		/// </returns>
+		const TraitCollection& GetExclusionTraits() const;
+
+		/// <summary>
+		/// Determine whether or not the match traits of this selector describe exactly the nodes
+		/// that this selector matches, rather than a superset of potential candidates. Only
+		/// selectors with exact traits can have their traits used as exclusion traits by a
+		/// negating selector.
+		/// </summary>
+		/// <returns>
+		/// True if every node found through the match traits of this selector is guaranteed to be
+		/// matched by this selector, false otherwise.
+		/// </returns>
+		const bool HasExactMatchTraits() const;
 
 		/// <summary>
 		/// Check if this selector is a match against the supplied node. 
@@ -298,6 +383,70 @@ namespace gq
 		/// </param>
 		void AddMatchTrait(boost::string_ref key, boost::string_ref value);
 
+		/// <summary>
+		/// Adds the supplied trait to the selector's internal exclusion traits collection. Any node
+		/// found through an exclusion trait is guaranteed not to match this selector.
+		/// </summary>
+		/// <param name="key">
+		/// The trait key. The key should be the name of some attribute in a potential candidate. 
+		/// </param>
+		/// <param name="value">
+		/// The trait value. The value should either be an exact attribute value, or a "*" to
+		/// exclude every node containing the supplied attribute.
+		/// </param>
+		void AddExclusionTrait(boost::string_ref key, boost::string_ref value);
+
+		/// <summary>
+		/// Takes on all of the supplied traits as match traits. If this selector has no match
+		/// traits yet, the supplied traits are shared rather than copied, so the selector that
+		/// owns them must be kept alive by this selector.
+		/// </summary>
+		/// <param name="traits">
+		/// The traits to take on. 
+		/// </param>
+		void AddMatchTraits(const TraitCollection& traits);
+
+		/// <summary>
+		/// Takes on all of the supplied traits as exclusion traits. If this selector has no
+		/// exclusion traits yet, the supplied traits are shared rather than copied, so the selector
+		/// that owns them must be kept alive by this selector.
+		/// </summary>
+		/// <param name="traits">
+		/// The traits to take on. 
+		/// </param>
+		void AddExclusionTraits(const TraitCollection& traits);
+
+		/// <summary>
+		/// Gets the single trait which every element has, that being any value for the tag key.
+		/// This is stored once for the whole process, and may be shared by any selector.
+		/// </summary>
+		/// <returns>
+		/// The traits matching any element. 
+		/// </returns>
+		static const TraitCollection& GetAnyElementTraits();
+
+		/// <summary>
+		/// Stores a copy of the supplied string in the arena of this selector, or finds the copy
+		/// that is already there. Strings that selectors match against must be stored this way, so
+		/// that they live exactly as long as the selector does.
+		/// </summary>
+		/// <param name="str">
+		/// The string to store. 
+		/// </param>
+		/// <returns>
+		/// The stored copy of the string. 
+		/// </returns>
+		boost::string_ref InternString(boost::string_ref str);
+
+		/// <summary>
+		/// Declares whether or not the match traits of this selector are exact. See
+		/// ::HasExactMatchTraits().
+		/// </summary>
+		/// <param name="exact">
+		/// True if every node found through the match traits is guaranteed to match. 
+		/// </param>
+		void SetHasExactMatchTraits(const bool exact);
+
 	private:
 		
 		/// <summary>
@@ -306,12 +455,6 @@ namespace gq
 		/// </summary>
 		GumboTag m_tagTypeToMatch = GumboTag(0);
 
-		/// <summary>
-		/// The value of gumbo_normalized_tagname(m_tagTypeToMatch), if m_tagTypeToMatch !=
-		/// GUMBO_TAG_UNKNOWN.
-		/// </summary>
-		boost::string_ref m_normalizedTagTypeToMatch;
-
 		/// <summary>
 		/// Defines how the matching in this selector will work. Based on the option, the text to be
 		/// matched will be matched in different ways. See comments in the operator class.
@@ -358,11 +501,17 @@ namespace gq
 		bool m_matchType;	
 
 		/// <summary>
-		/// A copy of the original selector string. Is only set if the user requested that the
-		/// original string be retained when constructing the selector. Default constructed to empty
-		/// string.
+		/// Whether or not m_matchTraits describes exactly the set of nodes matched by this
+		/// selector. See ::HasExactMatchTraits().
 		/// </summary>
-		std::string m_originalSelectorString;
+		bool m_hasExactMatchTraits;
+
+		/// <summary>
+		/// A copy of the original selector string, stored in the arena of this selector. Is only
+		/// set if the user requested that the original string be retained when constructing the
+		/// selector. Empty otherwise.
+		/// </summary>
+		boost::string_ref m_originalSelectorString;
 
 		/// <summary>
 		/// Stores "traits" about potential candidates. This is used heavily in the core matching
@@ -373,7 +522,32 @@ namespace gq
 		/// goal for this project that manual searching should be eliminated as a requirement
 		/// altogether.
 		/// </summary>
-		std::vector< std::pair<boost::string_ref, boost::string_ref> > m_matchTraits;
+		TraitCollection m_matchTraits;
+
+		/// <summary>
+		/// Stores traits of nodes that can never be matched by this selector. See
+		/// ::GetExclusionTraits().
+		/// </summary>
+		TraitCollection m_exclusionTraits;
+
+		/// <summary>
+		/// The arena holding the traits and strings of this selector. This is the arena that was
+		/// current when the selector was constructed. Selectors built outside of any
+		/// SelectorArena::Scope get an arena of their own, created the first time they need one.
+		/// </summary>
+		std::shared_ptr<SelectorArena> m_arena;
+
+		/// <summary>
+		/// Gets the arena of this selector, creating it if necessary.
+		/// </summary>
+		SelectorArena& GetArena();
+
+		/// <summary>
+		/// Appends the supplied traits to the supplied collection, skipping any that are already
+		/// present. If the collection is empty and the supplied traits are shareable, meaning
+		/// they'll outlive this selector, they're shared outright rather than copied.
+		/// </summary>
+		void MergeTraits(TraitCollection& target, const Trait* traits, const size_t count, const bool shareable);
 
 		/// <summary>
 		/// Init member defaults across multiple constructors.
@@ -0,0 +1,170 @@
+/*
+* Copyright (c) 2015 Jesse Nicholson
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#include "SelectorArena.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+namespace gq
+{
+
+	const size_t SelectorArena::DefaultFirstBlockSize;
+
+	const size_t SelectorArena::MaxBlockSize;
+
+	const size_t SelectorArena::BlockHeaderSize;
+
+	const size_t SelectorArena::InternThreshold;
+
+	thread_local SelectorArena::Scope* SelectorArena::Scope::s_current = nullptr;
+
+	SelectorArena::Scope::Scope(const size_t firstBlockSize) :
+		m_previous(s_current), m_arena(s_current != nullptr ? s_current->m_arena : SelectorArena::Create(firstBlockSize))
+	{
+		s_current = this;
+	}
+
+	SelectorArena::Scope::Scope(std::shared_ptr<SelectorArena> arena) :
+		m_previous(s_current), m_arena(std::move(arena))
+	{
+		#ifndef NDEBUG
+			assert(m_arena != nullptr && u8"In SelectorArena::Scope::Scope(std::shared_ptr<SelectorArena>) - Supplied arena is nullptr.");
+		#else
+			if (m_arena == nullptr) { throw std::runtime_error(u8"In SelectorArena::Scope::Scope(std::shared_ptr<SelectorArena>) - Supplied arena is nullptr."); }
+		#endif
+
+		s_current = this;
+	}
+
+	SelectorArena::Scope::~Scope()
+	{
+		s_current = m_previous;
+	}
+
+	SelectorArena::SelectorArena(const size_t firstBlockSize) :
+		m_next(nullptr), m_remaining(0), m_nextBlockSize(std::max(firstBlockSize, static_cast<size_t>(64))), m_bytesReserved(0),
+		m_lastBlock(nullptr), m_stringCount(0)
+	{
+
+	}
+
+	SelectorArena::~SelectorArena()
+	{
+		while (m_lastBlock != nullptr)
+		{
+			char* previous;
+			std::memcpy(&previous, m_lastBlock, sizeof(previous));
+			::operator delete(m_lastBlock);
+			m_lastBlock = previous;
+		}
+	}
+
+	std::shared_ptr<SelectorArena> SelectorArena::Create(const size_t firstBlockSize)
+	{
+		return std::make_shared<SelectorArena>(firstBlockSize);
+	}
+
+	const std::shared_ptr<SelectorArena>& SelectorArena::GetCurrent()
+	{
+		static const std::shared_ptr<SelectorArena> none;
+
+		return Scope::s_current != nullptr ? Scope::s_current->m_arena : none;
+	}
+
+	void* SelectorArena::Allocate(const size_t size, const size_t alignment)
+	{
+		#ifndef NDEBUG
+			assert(alignment > 0 && (alignment & (alignment - 1)) == 0 && alignment <= alignof(std::max_align_t) && u8"In SelectorArena::Allocate(const size_t, const size_t) - Unsupported alignment.");
+		#else
+			if (alignment == 0 || (alignment & (alignment - 1)) != 0 || alignment > alignof(std::max_align_t)) { throw std::runtime_error(u8"In SelectorArena::Allocate(const size_t, const size_t) - Unsupported alignment."); }
+		#endif
+
+		size_t padding = (alignment - (reinterpret_cast<uintptr_t>(m_next) & (alignment - 1))) & (alignment - 1);
+
+		if (padding + size > m_remaining)
+		{
+			// Blocks come from operator new, which is suitably aligned for anything, and the
+			// header is padded to keep it that way, so no padding is needed at the start of a
+			// fresh block.
+			size_t blockSize = std::max(m_nextBlockSize, size);
+			char* block = static_cast<char*>(::operator new(BlockHeaderSize + blockSize));
+			std::memcpy(block, &m_lastBlock, sizeof(m_lastBlock));
+			m_lastBlock = block;
+			m_bytesReserved += BlockHeaderSize + blockSize;
+
+			m_next = block + BlockHeaderSize;
+			m_remaining = blockSize;
+			padding = 0;
+
+			m_nextBlockSize = std::min(m_nextBlockSize * 2, MaxBlockSize);
+		}
+
+		void* result = m_next + padding;
+		m_next += padding + size;
+		m_remaining -= padding + size;
+
+		return result;
+	}
+
+	boost::string_ref SelectorArena::Intern(boost::string_ref str)
+	{
+		if (str.size() == 0)
+		{
+			return boost::string_ref();
+		}
+
+		if (m_internedSet != nullptr)
+		{
+			auto existing = m_internedSet->find(str);
+
+			if (existing != m_internedSet->end())
+			{
+				return *existing;
+			}
+		}
+
+		char* storage = static_cast<char*>(Allocate(str.size(), 1));
+		std::memcpy(storage, str.data(), str.size());
+		boost::string_ref interned(storage, str.size());
+
+		if (++m_stringCount > InternThreshold)
+		{
+			if (m_internedSet == nullptr)
+			{
+				m_internedSet.reset(new std::unordered_set<boost::string_ref, StringRefHash, StringRefEquality>());
+			}
+
+			m_internedSet->insert(interned);
+		}
+
+		return interned;
+	}
+
+	const size_t SelectorArena::GetBytesReserved() const
+	{
+		return m_bytesReserved;
+	}
+
+} /* namespace gq */
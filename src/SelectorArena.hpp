@@ -0,0 +1,336 @@
+/*
+* Copyright (c) 2015 Jesse Nicholson
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#pragma once
+
+#include "StrRefHash.hpp"
+#include <cstddef>
+#include <memory>
+#include <unordered_set>
+#include <utility>
+#include <boost/utility/string_ref.hpp>
+
+namespace gq
+{
+
+	/// <summary>
+	/// The SelectorArena owns the memory of a graph of compiled selectors. Selector nodes, their
+	/// traits and the strings they match against are all carved out of a few large blocks rather
+	/// than being allocated one by one, and identical strings are stored only once. Nothing in an
+	/// arena is ever freed individually. The whole arena is released at once, when the last
+	/// selector built in it is destroyed.
+	/// <para>&#160;</para>
+	/// Selectors are placed in an arena by building them while a ::Scope is open on the calling
+	/// thread. Parser::CreateSelector(...) opens a scope with a fresh arena for each selector that
+	/// it compiles, unless a scope is already open, in which case the selector joins the open
+	/// scope's arena. Bulk compilation through SelectorSet opens one scope for many selectors,
+	/// so that they share one arena and one set of strings.
+	/// <para>&#160;</para>
+	/// Building selectors in an arena is not thread-safe, so an arena must only be open in a
+	/// scope on one thread at a time. Once built, selectors are immutable and may be shared and
+	/// destroyed on any thread.
+	/// </summary>
+	class SelectorArena
+	{
+
+	public:
+
+		/// <summary>
+		/// Makes an arena current on the calling thread for as long as the scope is alive. Every
+		/// selector built on the calling thread while the scope is open is placed in that arena.
+		/// Scopes nest, and closing a scope restores whatever scope was previously open.
+		/// </summary>
+		class Scope
+		{
+
+			friend class SelectorArena;
+
+		public:
+
+			/// <summary>
+			/// Opens a scope on the arena that is already current on the calling thread. If there
+			/// is no current arena, a new arena is created for this scope.
+			/// </summary>
+			/// <param name="firstBlockSize">
+			/// The size of the first block of the arena, should a new arena be created. See
+			/// ::Create(const size_t).
+			/// </param>
+			explicit Scope(const size_t firstBlockSize = DefaultFirstBlockSize);
+
+			/// <summary>
+			/// Opens a scope on the supplied arena.
+			/// </summary>
+			/// <param name="arena">
+			/// The arena to make current. Must not be nullptr.
+			/// </param>
+			Scope(std::shared_ptr<SelectorArena> arena);
+
+			/// <summary>
+			/// Closes this scope, restoring whatever scope was previously open on the calling
+			/// thread, if any.
+			/// </summary>
+			~Scope();
+
+			Scope(const Scope&) = delete;
+			Scope& operator=(const Scope&) = delete;
+
+		private:
+
+			/// <summary>
+			/// The scope that was open on this thread when this scope was opened. 
+			/// </summary>
+			Scope* m_previous;
+
+			/// <summary>
+			/// The arena made current by this scope.
+			/// </summary>
+			std::shared_ptr<SelectorArena> m_arena;
+
+			/// <summary>
+			/// The scope presently open on the calling thread. Will be nullptr if there is none.
+			/// </summary>
+			static thread_local Scope* s_current;
+
+		};
+
+		/// <summary>
+		/// A standard allocator which allocates from an arena. Every copy of the allocator keeps
+		/// the arena alive, so objects created through std::allocate_shared(...) with this
+		/// allocator keep the memory they live in alive. Deallocation does nothing, since arena
+		/// memory is only ever released with the arena itself.
+		/// </summary>
+		template<typename T>
+		class Allocator
+		{
+
+			template<typename U>
+			friend class Allocator;
+
+		public:
+
+			typedef T value_type;
+
+			Allocator(std::shared_ptr<SelectorArena> arena) : m_arena(std::move(arena))
+			{
+
+			}
+
+			template<typename U>
+			Allocator(const Allocator<U>& other) : m_arena(other.m_arena)
+			{
+
+			}
+
+			T* allocate(const size_t n)
+			{
+				return static_cast<T*>(m_arena->Allocate(n * sizeof(T), alignof(T)));
+			}
+
+			void deallocate(T*, const size_t)
+			{
+
+			}
+
+			template<typename U>
+			const bool operator==(const Allocator<U>& other) const
+			{
+				return m_arena == other.m_arena;
+			}
+
+			template<typename U>
+			const bool operator!=(const Allocator<U>& other) const
+			{
+				return m_arena != other.m_arena;
+			}
+
+		private:
+
+			std::shared_ptr<SelectorArena> m_arena;
+
+		};
+
+		/// <summary>
+		/// The size of the first block of an arena, unless another size is requested. This is
+		/// enough for a typical selector, so compiling a single selector usually costs just one
+		/// block.
+		/// </summary>
+		static const size_t DefaultFirstBlockSize = 288;
+
+		/// <summary>
+		/// Constructs a new, empty arena. Prefer ::Create(const size_t).
+		/// </summary>
+		/// <param name="firstBlockSize">
+		/// The size of the first block the arena allocates. See ::Create(const size_t).
+		/// </param>
+		explicit SelectorArena(const size_t firstBlockSize = DefaultFirstBlockSize);
+
+		/// <summary>
+		/// Releases every block of memory held by the arena.
+		/// </summary>
+		~SelectorArena();
+
+		SelectorArena(const SelectorArena&) = delete;
+		SelectorArena& operator=(const SelectorArena&) = delete;
+
+		/// <summary>
+		/// Creates a new, empty arena. No memory is reserved until the first allocation.
+		/// </summary>
+		/// <param name="firstBlockSize">
+		/// The size of the first block the arena allocates. Each following block doubles in size,
+		/// up to ::MaxBlockSize. Arenas that will hold a great many selectors gain nothing from a
+		/// small first block, while arenas holding one selector waste whatever the selector
+		/// leaves unused.
+		/// </param>
+		/// <returns>
+		/// The new arena.
+		/// </returns>
+		static std::shared_ptr<SelectorArena> Create(const size_t firstBlockSize = DefaultFirstBlockSize);
+
+		/// <summary>
+		/// Gets the arena of the scope presently open on the calling thread.
+		/// </summary>
+		/// <returns>
+		/// The current arena, or nullptr if no scope is open on the calling thread.
+		/// </returns>
+		static const std::shared_ptr<SelectorArena>& GetCurrent();
+
+		/// <summary>
+		/// Constructs an object managed by a shared_ptr. If a scope is open on the calling thread,
+		/// the object and its reference count are placed in the current arena. Otherwise, this is
+		/// the same as std::make_shared(...).
+		/// </summary>
+		/// <param name="args">
+		/// The arguments to construct the object with.
+		/// </param>
+		/// <returns>
+		/// The constructed object.
+		/// </returns>
+		template<typename T, typename... Args>
+		static std::shared_ptr<T> MakeShared(Args&&... args)
+		{
+			const auto& arena = GetCurrent();
+
+			if (arena == nullptr)
+			{
+				return std::make_shared<T>(std::forward<Args>(args)...);
+			}
+
+			return std::allocate_shared<T>(Allocator<T>(arena), std::forward<Args>(args)...);
+		}
+
+		/// <summary>
+		/// Allocates uninitialized memory from the arena. The memory remains valid for as long as
+		/// the arena is alive.
+		/// </summary>
+		/// <param name="size">
+		/// The number of bytes to allocate.
+		/// </param>
+		/// <param name="alignment">
+		/// The required alignment, which must be a power of two no greater than
+		/// alignof(std::max_align_t).
+		/// </param>
+		/// <returns>
+		/// The allocated memory. 
+		/// </returns>
+		void* Allocate(const size_t size, const size_t alignment);
+
+		/// <summary>
+		/// Stores a copy of the supplied string in the arena, unless an identical string has
+		/// already been stored, in which case the existing copy is returned. See
+		/// ::InternThreshold.
+		/// </summary>
+		/// <param name="str">
+		/// The string to store.
+		/// </param>
+		/// <returns>
+		/// The stored copy of the string, which remains valid for as long as the arena is alive.
+		/// </returns>
+		boost::string_ref Intern(boost::string_ref str);
+
+		/// <summary>
+		/// Gets the total number of bytes the arena has reserved from the system for its blocks.
+		/// </summary>
+		/// <returns>
+		/// The number of bytes reserved by the arena.
+		/// </returns>
+		const size_t GetBytesReserved() const;
+
+	private:
+
+		/// <summary>
+		/// The largest size that blocks grow to. Allocations larger than this get a block of
+		/// their own.
+		/// </summary>
+		static const size_t MaxBlockSize = 65536;
+
+		/// <summary>
+		/// Each block begins with a pointer to the block allocated before it, padded so that the
+		/// memory handed out from the block is suitably aligned for anything.
+		/// </summary>
+		static const size_t BlockHeaderSize = ((sizeof(char*) + alignof(std::max_align_t) - 1) / alignof(std::max_align_t)) * alignof(std::max_align_t);
+
+		/// <summary>
+		/// The first this many strings stored in an arena are simply copied, and only strings
+		/// stored after them are deduplicated. This spares arenas holding a single selector, which
+		/// rarely repeats a string, from building a hash set.
+		/// </summary>
+		static const size_t InternThreshold = 16;
+
+		/// <summary>
+		/// The next free byte in the current block. 
+		/// </summary>
+		char* m_next;
+
+		/// <summary>
+		/// The number of free bytes remaining in the current block. 
+		/// </summary>
+		size_t m_remaining;
+
+		/// <summary>
+		/// The size of the next block to allocate. 
+		/// </summary>
+		size_t m_nextBlockSize;
+
+		/// <summary>
+		/// Total bytes reserved, for ::GetBytesReserved(). 
+		/// </summary>
+		size_t m_bytesReserved;
+
+		/// <summary>
+		/// The most recently allocated block, which links to every block allocated before it. 
+		/// </summary>
+		char* m_lastBlock;
+
+		/// <summary>
+		/// The number of strings stored in the arena. 
+		/// </summary>
+		size_t m_stringCount;
+
+		/// <summary>
+		/// Strings stored once there are more than ::InternThreshold of them. Only created once it
+		/// is needed.
+		/// </summary>
+		std::unique_ptr< std::unordered_set<boost::string_ref, StringRefHash, StringRefEquality> > m_internedSet;
+
+	};
+
+} /* namespace gq */
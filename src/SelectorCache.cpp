@@ -0,0 +1,126 @@
+/*
+* Copyright (c) 2015 Jesse Nicholson
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#include "SelectorCache.hpp"
+
+namespace gq
+{
+
+	const size_t SelectorCache::DefaultCapacity = 1024;
+
+	SelectorCache::SelectorCache(const size_t capacity) :
+		m_capacity(capacity)
+	{
+
+	}
+
+	SelectorCache::~SelectorCache()
+	{
+
+	}
+
+	SelectorCache& SelectorCache::GetShared()
+	{
+		static SelectorCache sharedCache;
+		return sharedCache;
+	}
+
+	SharedSelector SelectorCache::Get(const std::string& selectorString)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			auto existing = m_entriesByString.find(boost::string_ref(selectorString));
+
+			if (existing != m_entriesByString.end())
+			{
+				// Move the entry to the front, marking it as the most recently used.
+				m_entries.splice(m_entries.begin(), m_entries, existing->second);
+				return existing->second->second;
+			}
+		}
+
+		// Compile without holding the lock, since this is the expensive part. This will throw on
+		// invalid selectors, and so they never make it into the cache.
+		auto selector = m_parser.CreateSelector(selectorString);
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		if (m_capacity == 0)
+		{
+			return selector;
+		}
+
+		// Another thread may have compiled the same string while we were compiling. If so, keep
+		// theirs, so that every caller shares the one instance.
+		auto existing = m_entriesByString.find(boost::string_ref(selectorString));
+
+		if (existing != m_entriesByString.end())
+		{
+			m_entries.splice(m_entries.begin(), m_entries, existing->second);
+			return existing->second->second;
+		}
+
+		m_entries.emplace_front(selectorString, selector);
+		m_entriesByString.insert({ boost::string_ref(m_entries.front().first), m_entries.begin() });
+
+		EvictToCapacity();
+
+		return selector;
+	}
+
+	const size_t SelectorCache::GetCapacity() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_capacity;
+	}
+
+	void SelectorCache::SetCapacity(const size_t capacity)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_capacity = capacity;
+		EvictToCapacity();
+	}
+
+	const size_t SelectorCache::Size() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_entries.size();
+	}
+
+	void SelectorCache::Clear()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_entriesByString.clear();
+		m_entries.clear();
+	}
+
+	void SelectorCache::EvictToCapacity()
+	{
+		while (m_entries.size() > m_capacity)
+		{
+			m_entriesByString.erase(boost::string_ref(m_entries.back().first));
+			m_entries.pop_back();
+		}
+	}
+
+} /* namespace gq */
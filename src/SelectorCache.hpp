@@ -0,0 +1,170 @@
+/*
+* Copyright (c) 2015 Jesse Nicholson
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#pragma once
+
+#include "Selector.hpp"
+#include "Parser.hpp"
+#include "StrRefHash.hpp"
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+namespace gq
+{
+
+	/// <summary>
+	/// The SelectorCache holds compiled selectors keyed by the selector string they were compiled
+	/// from, so that callers passing the same raw selector strings over and over only pay for
+	/// compilation once. The cache is bounded, and when it is full, the least recently used
+	/// selector is evicted to make room for a new one.
+	/// <para>&#160;</para>
+	/// All members are thread-safe. Selectors are compiled outside of the internal lock, so
+	/// threads missing the cache at the same time do not wait on one another.
+	/// <para>&#160;</para>
+	/// The string overloads of Node::Find(...) and Node::Each(...) use the cache returned by
+	/// ::GetShared(). Callers may use that same cache directly, resize it, or create caches of
+	/// their own.
+	/// </summary>
+	class SelectorCache
+	{
+
+	public:
+
+		/// <summary>
+		/// The number of selectors a cache can hold when no capacity is specified.
+		/// </summary>
+		static const size_t DefaultCapacity;
+
+		/// <summary>
+		/// Constructs a new, empty cache that can hold the supplied number of selectors.
+		/// </summary>
+		/// <param name="capacity">
+		/// The maximum number of selectors the cache can hold. A capacity of zero disables
+		/// caching entirely, in which case every request compiles a fresh selector.
+		/// </param>
+		SelectorCache(const size_t capacity = DefaultCapacity);
+
+		/// <summary>
+		/// Default destructor.
+		/// </summary>
+		~SelectorCache();
+
+		SelectorCache(const SelectorCache&) = delete;
+		SelectorCache& operator=(const SelectorCache&) = delete;
+
+		/// <summary>
+		/// Gets the shared cache used internally by the string overloads of Node::Find(...) and
+		/// Node::Each(...).
+		/// </summary>
+		/// <returns>
+		/// The shared cache.
+		/// </returns>
+		static SelectorCache& GetShared();
+
+		/// <summary>
+		/// Gets the compiled selector for the supplied selector string. If the string is not
+		/// already in the cache, it is compiled and added, evicting the least recently used
+		/// selector if the cache is full. Just like Parser::CreateSelector(...), this method will
+		/// throw when supplied with an invalid selector. Invalid selectors are never cached.
+		/// </summary>
+		/// <param name="selectorString">
+		/// The raw selector string to get the compiled selector for. 
+		/// </param>
+		/// <returns>
+		/// The compiled selector object.
+		/// </returns>
+		SharedSelector Get(const std::string& selectorString);
+
+		/// <summary>
+		/// Gets the maximum number of selectors the cache can hold.
+		/// </summary>
+		/// <returns>
+		/// The capacity of the cache.
+		/// </returns>
+		const size_t GetCapacity() const;
+
+		/// <summary>
+		/// Sets the maximum number of selectors the cache can hold. If the cache presently holds
+		/// more than the new capacity, the least recently used selectors are evicted.
+		/// </summary>
+		/// <param name="capacity">
+		/// The new capacity. Zero disables caching. 
+		/// </param>
+		void SetCapacity(const size_t capacity);
+
+		/// <summary>
+		/// Gets the number of selectors presently held in the cache.
+		/// </summary>
+		/// <returns>
+		/// The number of cached selectors.
+		/// </returns>
+		const size_t Size() const;
+
+		/// <summary>
+		/// Evicts every selector from the cache.
+		/// </summary>
+		void Clear();
+
+	private:
+
+		/// <summary>
+		/// Cached entries, ordered from most recently used to least recently used. Lists never
+		/// invalidate iterators or move their elements, so the selector strings stored here are
+		/// what the keys of m_entriesByString refer to.
+		/// </summary>
+		typedef std::list< std::pair<std::string, SharedSelector> > EntryList;
+
+		/// <summary>
+		/// The parser used to compile selectors on a cache miss.
+		/// </summary>
+		Parser m_parser;
+
+		/// <summary>
+		/// The maximum number of entries. 
+		/// </summary>
+		size_t m_capacity;
+
+		/// <summary>
+		/// All cached entries, most recently used first. 
+		/// </summary>
+		EntryList m_entries;
+
+		/// <summary>
+		/// Index into m_entries by selector string. 
+		/// </summary>
+		std::unordered_map<boost::string_ref, EntryList::iterator, StringRefHash, StringRefEquality> m_entriesByString;
+
+		/// <summary>
+		/// Guards every member other than m_parser, whose CreateSelector(...) is const.
+		/// </summary>
+		mutable std::mutex m_mutex;
+
+		/// <summary>
+		/// Evicts least recently used entries until no more than m_capacity remain. The caller
+		/// must hold m_mutex.
+		/// </summary>
+		void EvictToCapacity();
+
+	};
+
+} /* namespace gq */
@@ -0,0 +1,551 @@
+/*
+* Copyright (c) 2015 Jesse Nicholson
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+
+#include "SelectorCanonicalizer.hpp"
+#include "AttributeSelector.hpp"
+#include "StrRefHash.hpp"
+#include "TextSelector.hpp"
+#include "UnarySelector.hpp"
+#include <algorithm>
+
+namespace gq
+{
+
+	namespace
+	{
+
+		/// <summary>
+		/// Appends the supplied value in double quotes, escaping any quotes and backslashes within
+		/// it so that the end of the value is never ambiguous.
+		/// </summary>
+		void AppendQuoted(std::string& output, boost::string_ref value)
+		{
+			output.push_back('"');
+
+			for (const char c : value)
+			{
+				if (c == '"' || c == '\\')
+				{
+					output.push_back('\\');
+				}
+
+				output.push_back(c);
+			}
+
+			output.push_back('"');
+		}
+
+	}
+
+	SelectorCanonicalizer::SelectorCanonicalizer()
+	{
+
+	}
+
+	SelectorCanonicalizer::~SelectorCanonicalizer()
+	{
+
+	}
+
+	std::string SelectorCanonicalizer::GetCanonicalForm(const SharedSelector& selector)
+	{
+		#ifndef NDEBUG
+			assert(selector != nullptr && u8"In SelectorCanonicalizer::GetCanonicalForm(const SharedSelector&) - Supplied selector is nullptr.");
+		#else
+			if (selector == nullptr) { throw std::runtime_error(u8"In SelectorCanonicalizer::GetCanonicalForm(const SharedSelector&) - Supplied selector is nullptr."); }
+		#endif
+
+		SelectorCanonicalizer canonicalizer;
+		SharedSelector canonical;
+
+		return canonicalizer.CanonicalizeNode(selector, canonical);
+	}
+
+	size_t SelectorCanonicalizer::GetStructuralHash(const SharedSelector& selector)
+	{
+		return StringRefHash()(GetCanonicalForm(selector));
+	}
+
+	SharedSelector SelectorCanonicalizer::Canonicalize(const SharedSelector& selector)
+	{
+		#ifndef NDEBUG
+			assert(selector != nullptr && u8"In SelectorCanonicalizer::Canonicalize(const SharedSelector&) - Supplied selector is nullptr.");
+		#else
+			if (selector == nullptr) { throw std::runtime_error(u8"In SelectorCanonicalizer::Canonicalize(const SharedSelector&) - Supplied selector is nullptr."); }
+		#endif
+
+		SharedSelector canonical;
+		CanonicalizeNode(selector, canonical);
+
+		return canonical;
+	}
+
+	const size_t SelectorCanonicalizer::GetDistinctCount() const
+	{
+		return m_instances.size();
+	}
+
+	const std::string& SelectorCanonicalizer::CanonicalizeNode(const SharedSelector& selector, SharedSelector& canonical)
+	{
+		auto known = m_forms.find(selector.get());
+
+		if (known != m_forms.end())
+		{
+			// Already a canonical instance.
+			canonical = selector;
+			return *known->second;
+		}
+
+		std::string form;
+
+		if (auto binary = dynamic_cast<const BinarySelector*>(selector.get()))
+		{
+			const auto op = binary->m_operator;
+
+			if (op == BinarySelector::SelectorOperator::Union || op == BinarySelector::SelectorOperator::Intersection)
+			{
+				// Order doesn't matter to what either operator matches, so the whole chain is
+				// flattened and its form is made from the forms of its operands in sorted order.
+				// Since every form has exactly one instance, comparing the addresses of the forms
+				// is enough to find duplicate operands. The chain itself is rebuilt in the order
+				// the operands were written, as that decides the order in which Node::Find(...)
+				// returns the nodes matched.
+				std::vector<SharedSelector> operands;
+				CollectOperands(selector, op, operands);
+
+				std::vector< std::pair<const std::string*, SharedSelector> > canonicalOperands;
+				canonicalOperands.reserve(operands.size());
+
+				for (const auto& operand : operands)
+				{
+					SharedSelector canonicalOperand;
+					const std::string* operandForm = &CanonicalizeNode(operand, canonicalOperand);
+
+					auto isDuplicate = [operandForm](const std::pair<const std::string*, SharedSelector>& existing)
+					{
+						return existing.first == operandForm;
+					};
+
+					if (std::none_of(canonicalOperands.begin(), canonicalOperands.end(), isDuplicate))
+					{
+						canonicalOperands.emplace_back(operandForm, std::move(canonicalOperand));
+					}
+				}
+
+				if (op == BinarySelector::SelectorOperator::Intersection)
+				{
+					// The parser puts a dummy beside pseudo classes that have nothing else to draw
+					// candidates from. It adds nothing to what is matched, so it is only kept when
+					// no other operand has specific traits of its own, since it then decides which
+					// candidates are found.
+					auto isDummy = [](const std::pair<const std::string*, SharedSelector>& operand)
+					{
+						return typeid(*operand.second) == typeid(Selector) && operand.second->m_selectorOperator == Selector::SelectorOperator::Dummy;
+					};
+
+					bool hasSpecificTraits = false;
+
+					for (const auto& operand : canonicalOperands)
+					{
+						const auto& traits = operand.second->GetMatchTraits();
+
+						if (traits.size() > 0 && !BinarySelector::IsAnyElementTraits(traits))
+						{
+							hasSpecificTraits = true;
+							break;
+						}
+					}
+
+					if (hasSpecificTraits)
+					{
+						canonicalOperands.erase(std::remove_if(canonicalOperands.begin(), canonicalOperands.end(), isDummy), canonicalOperands.end());
+					}
+				}
+
+				SharedSelector chain = canonicalOperands[0].second;
+
+				if (canonicalOperands.size() == 1)
+				{
+					canonical = chain;
+					return *canonicalOperands[0].first;
+				}
+
+				std::vector<const std::pair<const std::string*, SharedSelector>*> sortedOperands;
+				sortedOperands.reserve(canonicalOperands.size());
+				sortedOperands.push_back(&canonicalOperands[0]);
+
+				const std::string* chainForm = nullptr;
+
+				for (size_t i = 1; i < canonicalOperands.size(); ++i)
+				{
+					const auto& operand = canonicalOperands[i];
+
+					// Each link of the chain is interned under the form of the operands it holds so
+					// far, so chains that start with the same operands share those links.
+					sortedOperands.insert(std::upper_bound(sortedOperands.begin(), sortedOperands.end(), &operand,
+						[](const std::pair<const std::string*, SharedSelector>* a, const std::pair<const std::string*, SharedSelector>* b)
+					{
+						return *a->first < *b->first;
+					}), &operand);
+
+					form.clear();
+
+					for (size_t f = 0; f < sortedOperands.size(); ++f)
+					{
+						if (op == BinarySelector::SelectorOperator::Union)
+						{
+							form.append(f > 0 ? u8", " : u8"");
+							form.append(*sortedOperands[f]->first);
+						}
+						else
+						{
+							AppendOperand(form, *sortedOperands[f]->first, GetPrecedence(sortedOperands[f]->second.get()) < 2);
+						}
+					}
+
+					// The supplied selector is reused as the last link of the chain if it already
+					// has exactly the right operands.
+					const bool isReusable = (i + 1 == canonicalOperands.size()) && binary->m_leftHandSide == chain && binary->m_rightHandSide == operand.second;
+
+					chainForm = &Intern(form, isReusable ? selector : nullptr, [op, &chain, &operand]()
+					{
+						return SelectorArena::MakeShared<BinarySelector>(op, chain, operand.second);
+					}, chain);
+				}
+
+				canonical = chain;
+				return *chainForm;
+			}
+
+			SharedSelector left;
+			SharedSelector right;
+			const std::string& leftForm = CanonicalizeNode(binary->m_leftHandSide, left);
+			const std::string& rightForm = CanonicalizeNode(binary->m_rightHandSide, right);
+
+			// Combinators are left associative, so only a combinator on the right needs to be
+			// kept apart from this one.
+			AppendOperand(form, leftForm, GetPrecedence(left.get()) < 1);
+
+			switch (op)
+			{
+				case BinarySelector::SelectorOperator::Child:
+				{
+					form.append(u8" > ");
+				}
+				break;
+
+				case BinarySelector::SelectorOperator::Descendant:
+				{
+					form.append(u8" ");
+				}
+				break;
+
+				case BinarySelector::SelectorOperator::Adjacent:
+				{
+					form.append(u8" + ");
+				}
+				break;
+
+				case BinarySelector::SelectorOperator::Sibling:
+				{
+					form.append(u8" ~ ");
+				}
+				break;
+
+				default:
+				{
+					// Unions and intersections are flattened above and never get here. Leaving
+					// an operator out of the form would give different selectors the same key.
+					const bool isCombinator = false;
+
+					#ifndef NDEBUG
+						assert(isCombinator && u8"In SelectorCanonicalizer::CanonicalizeNode(const SharedSelector&, SharedSelector&) - Binary selector operator is not a combinator.");
+					#else
+						if (!isCombinator) { throw std::runtime_error(u8"In SelectorCanonicalizer::CanonicalizeNode(const SharedSelector&, SharedSelector&) - Binary selector operator is not a combinator."); }
+					#endif
+				}
+				break;
+			}
+
+			AppendOperand(form, rightForm, GetPrecedence(right.get()) < 2);
+
+			const bool isReusable = binary->m_leftHandSide == left && binary->m_rightHandSide == right;
+
+			return Intern(std::move(form), isReusable ? selector : nullptr, [op, &left, &right]()
+			{
+				return SelectorArena::MakeShared<BinarySelector>(op, left, right);
+			}, canonical);
+		}
+
+		if (auto unary = dynamic_cast<const UnarySelector*>(selector.get()))
+		{
+			SharedSelector inner;
+			const std::string& innerForm = CanonicalizeNode(unary->m_selector, inner);
+
+			switch (unary->m_operator)
+			{
+				case UnarySelector::SelectorOperator::Not:
+				{
+					form.append(u8":not(");
+				}
+				break;
+
+				case UnarySelector::SelectorOperator::HasDescendant:
+				{
+					form.append(u8":has(");
+				}
+				break;
+
+				case UnarySelector::SelectorOperator::HasChild:
+				{
+					form.append(u8":haschild(");
+				}
+				break;
+			}
+
+			form.append(innerForm);
+			form.push_back(')');
+
+			const auto op = unary->m_operator;
+			const bool isReusable = unary->m_selector == inner;
+
+			return Intern(std::move(form), isReusable ? selector : nullptr, [op, &inner]()
+			{
+				return SelectorArena::MakeShared<UnarySelector>(op, inner);
+			}, canonical);
+		}
+
+		// Everything else has no selectors within it, so the supplied selector is always the one
+		// to keep.
+		auto reuse = [&selector]()
+		{
+			return selector;
+		};
+
+		if (auto attribute = dynamic_cast<const AttributeSelector*>(selector.get()))
+		{
+			form.push_back('[');
+			form.append(attribute->m_attributeNameRef.begin(), attribute->m_attributeNameRef.end());
+
+			switch (attribute->m_operator)
+			{
+				case AttributeSelector::SelectorOperator::Exists:
+				{
+					form.push_back(']');
+					return Intern(std::move(form), selector, reuse, canonical);
+				}
+				break;
+
+				case AttributeSelector::SelectorOperator::ValueEquals:
+				{
+					form.append(u8"=");
+				}
+				break;
+
+				case AttributeSelector::SelectorOperator::ValueHasPrefix:
+				{
+					form.append(u8"^=");
+				}
+				break;
+
+				case AttributeSelector::SelectorOperator::ValueHasSuffix:
+				{
+					form.append(u8"$=");
+				}
+				break;
+
+				case AttributeSelector::SelectorOperator::ValueContains:
+				{
+					form.append(u8"*=");
+				}
+				break;
+
+				case AttributeSelector::SelectorOperator::ValueContainsElementInWhitespaceSeparatedList:
+				{
+					form.append(u8"~=");
+				}
+				break;
+
+				case AttributeSelector::SelectorOperator::ValueIsHyphenSeparatedListStartingWith:
+				{
+					form.append(u8"|=");
+				}
+				break;
+			}
+
+			AppendQuoted(form, attribute->m_attributeValueRef);
+
+			if (attribute->m_caseInsensitive)
+			{
+				form.append(u8" i");
+			}
+
+			form.push_back(']');
+
+			return Intern(std::move(form), selector, reuse, canonical);
+		}
+
+		if (auto text = dynamic_cast<const TextSelector*>(selector.get()))
+		{
+			switch (text->m_operator)
+			{
+				case TextSelector::SelectorOperator::Contains:
+				{
+					form.append(u8":contains(");
+				}
+				break;
+
+				case TextSelector::SelectorOperator::ContainsOwn:
+				{
+					form.append(u8":containsown(");
+				}
+				break;
+
+				case TextSelector::SelectorOperator::Matches:
+				{
+					form.append(u8":matches(");
+				}
+				break;
+
+				case TextSelector::SelectorOperator::MatchesOwn:
+				{
+					form.append(u8":matchesown(");
+				}
+				break;
+			}
+
+			AppendQuoted(form, text->m_textToMatchStrRef);
+			form.push_back(')');
+
+			return Intern(std::move(form), selector, reuse, canonical);
+		}
+
+		switch (selector->m_selectorOperator)
+		{
+			case Selector::SelectorOperator::Dummy:
+			{
+				form.push_back('*');
+			}
+			break;
+
+			case Selector::SelectorOperator::Empty:
+			{
+				form.append(u8":empty");
+			}
+			break;
+
+			case Selector::SelectorOperator::OnlyChild:
+			{
+				form.append(selector->m_matchType ? u8":only-of-type" : u8":only-child");
+			}
+			break;
+
+			case Selector::SelectorOperator::NthChild:
+			{
+				// Always spelled out in full, so that :first-child and :nth-child(1) come out
+				// the same.
+				form.append(u8":nth-");
+				form.append(selector->m_matchLast ? u8"last-" : u8"");
+				form.append(selector->m_matchType ? u8"of-type(" : u8"child(");
+				form.append(std::to_string(selector->m_leftHandSideOfNth));
+				form.push_back('n');
+				form.push_back(selector->m_rightHandSideOfNth < 0 ? '-' : '+');
+				form.append(std::to_string(std::abs(static_cast<long long>(selector->m_rightHandSideOfNth))));
+				form.push_back(')');
+			}
+			break;
+
+			case Selector::SelectorOperator::Tag:
+			{
+				// Every tag that Gumbo doesn't know is the same unknown tag as far as matching is
+				// concerned.
+				boost::string_ref tagName = selector->m_tagTypeToMatch != GUMBO_TAG_UNKNOWN ? gumbo_normalized_tagname(selector->m_tagTypeToMatch) : u8"";
+				form.append(tagName.size() > 0 ? tagName.to_string() : std::string(u8"unknown-tag"));
+			}
+			break;
+		}
+
+		return Intern(std::move(form), selector, reuse, canonical);
+	}
+
+	template<typename Builder>
+	const std::string& SelectorCanonicalizer::Intern(std::string form, const SharedSelector& selector, Builder build, SharedSelector& canonical)
+	{
+		auto existing = m_instances.find(form);
+
+		if (existing != m_instances.end())
+		{
+			canonical = existing->second;
+			return existing->first;
+		}
+
+		canonical = selector != nullptr ? selector : build();
+
+		auto inserted = m_instances.emplace(std::move(form), canonical);
+		m_forms.emplace(canonical.get(), &inserted.first->first);
+
+		return inserted.first->first;
+	}
+
+	void SelectorCanonicalizer::CollectOperands(const SharedSelector& selector, const BinarySelector::SelectorOperator op, std::vector<SharedSelector>& operands)
+	{
+		auto binary = dynamic_cast<const BinarySelector*>(selector.get());
+
+		if (binary != nullptr && binary->m_operator == op)
+		{
+			CollectOperands(binary->m_leftHandSide, op, operands);
+			CollectOperands(binary->m_rightHandSide, op, operands);
+			return;
+		}
+
+		operands.push_back(selector);
+	}
+
+	const int SelectorCanonicalizer::GetPrecedence(const Selector* selector)
+	{
+		auto binary = dynamic_cast<const BinarySelector*>(selector);
+
+		if (binary == nullptr || binary->m_operator == BinarySelector::SelectorOperator::Intersection)
+		{
+			return 2;
+		}
+
+		return binary->m_operator == BinarySelector::SelectorOperator::Union ? 0 : 1;
+	}
+
+	void SelectorCanonicalizer::AppendOperand(std::string& output, const std::string& form, const bool parenthesize)
+	{
+		if (parenthesize)
+		{
+			output.push_back('(');
+		}
+
+		output.append(form);
+
+		if (parenthesize)
+		{
+			output.push_back(')');
+		}
+	}
+
+} /* namespace gq */
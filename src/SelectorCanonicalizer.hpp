@@ -0,0 +1,162 @@
+/*
+* Copyright (c) 2015 Jesse Nicholson
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+
+#pragma once
+
+#include "BinarySelector.hpp"
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace gq
+{
+
+	/// <summary>
+	/// The SelectorCanonicalizer reduces compiled selectors to a canonical form, so that selectors
+	/// which are written differently but match exactly the same nodes can be recognized as one.
+	/// <para>&#160;</para>
+	/// Whitespace and letter case in pseudo class names are already removed by the parser. On top
+	/// of that, the parts of a compound selector such as "div.a[href]" and the selectors in a
+	/// group such as "a, b" are order independent, so they are flattened, stripped of duplicates
+	/// and sorted within the canonical form. The canonical instance keeps its parts in the order
+	/// of the first selector it was built from, since that order decides the order in which
+	/// Node::Find(...) returns what it matched. Dummy selectors that the parser adds beside pseudo classes are dropped when
+	/// another part of the compound already supplies specific match traits. Everything else is
+	/// kept exactly as compiled.
+	/// <para>&#160;</para>
+	/// An instance of this class also shares structure between the selectors passed through it.
+	/// Every distinct canonical selector, and every distinct sub-tree within one, is built only
+	/// once, and every later equivalent is replaced by that one instance. Instances are not thread
+	/// safe.
+	/// </summary>
+	class SelectorCanonicalizer
+	{
+
+	public:
+
+		/// <summary>
+		/// Constructs a canonicalizer that has not yet seen any selectors.
+		/// </summary>
+		SelectorCanonicalizer();
+
+		/// <summary>
+		/// Default destructor.
+		/// </summary>
+		~SelectorCanonicalizer();
+
+		/// <summary>
+		/// Gets the canonical form of the supplied selector. Two selectors have the same canonical
+		/// form if and only if they are structurally equivalent. The form reads much like the
+		/// selector string it came from, but every part is spelled out, for example "[class~="a"]"
+		/// rather than ".a", and it is not guaranteed to be accepted by the Parser.
+		/// </summary>
+		/// <param name="selector">
+		/// The selector to get the canonical form of. 
+		/// </param>
+		/// <returns>
+		/// The canonical form of the selector.
+		/// </returns>
+		static std::string GetCanonicalForm(const SharedSelector& selector);
+
+		/// <summary>
+		/// Gets a hash of the canonical form of the supplied selector. Structurally equivalent
+		/// selectors always have the same hash.
+		/// </summary>
+		/// <param name="selector">
+		/// The selector to hash. 
+		/// </param>
+		/// <returns>
+		/// The structural hash of the selector.
+		/// </returns>
+		static size_t GetStructuralHash(const SharedSelector& selector);
+
+		/// <summary>
+		/// Gets the canonical instance of the supplied selector. The first time a selector with a
+		/// given canonical form is supplied, an instance is built for it, reusing the supplied
+		/// selector and any of its sub-trees wherever they are already canonical. Every later
+		/// selector with the same canonical form gets that same instance back. New selectors are
+		/// built in the current SelectorArena.
+		/// </summary>
+		/// <param name="selector">
+		/// The selector to canonicalize. 
+		/// </param>
+		/// <returns>
+		/// The canonical instance of the selector.
+		/// </returns>
+		SharedSelector Canonicalize(const SharedSelector& selector);
+
+		/// <summary>
+		/// Gets the number of distinct selectors, counting sub-trees, held by this canonicalizer.
+		/// </summary>
+		/// <returns>
+		/// The number of distinct selectors.
+		/// </returns>
+		const size_t GetDistinctCount() const;
+
+	private:
+
+		/// <summary>
+		/// Every canonical instance, by canonical form.
+		/// </summary>
+		std::unordered_map<std::string, SharedSelector> m_instances;
+
+		/// <summary>
+		/// The canonical form of every canonical instance. The forms are the keys of
+		/// ::m_instances, which are never moved.
+		/// </summary>
+		std::unordered_map<const Selector*, const std::string*> m_forms;
+
+		/// <summary>
+		/// Canonicalizes the supplied selector and returns its canonical form.
+		/// </summary>
+		const std::string& CanonicalizeNode(const SharedSelector& selector, SharedSelector& canonical);
+
+		/// <summary>
+		/// Returns the existing instance with the supplied form, or adds an instance under that
+		/// form if there is none. The instance to add is the supplied selector when it isn't
+		/// nullptr, and is otherwise made by the supplied builder.
+		/// </summary>
+		template<typename Builder>
+		const std::string& Intern(std::string form, const SharedSelector& selector, Builder build, SharedSelector& canonical);
+
+		/// <summary>
+		/// Collects the operands of a chain of unions or intersections, looking through nested
+		/// selectors of the same operator.
+		/// </summary>
+		static void CollectOperands(const SharedSelector& selector, const BinarySelector::SelectorOperator op, std::vector<SharedSelector>& operands);
+
+		/// <summary>
+		/// Gets how tightly the supplied selector binds in its canonical form, which decides
+		/// whether it needs parentheses as the operand of another selector. Groups bind loosest,
+		/// then combinators, then everything else.
+		/// </summary>
+		static const int GetPrecedence(const Selector* selector);
+
+		/// <summary>
+		/// Appends the supplied form to the output, in parentheses if required.
+		/// </summary>
+		static void AppendOperand(std::string& output, const std::string& form, const bool parenthesize);
+
+	};
+
+} /* namespace gq */
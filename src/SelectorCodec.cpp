@@ -0,0 +1,470 @@
+/*
+* Copyright (c) 2015 Jesse Nicholson
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#include "SelectorCodec.hpp"
+#include "AttributeSelector.hpp"
+#include "BinarySelector.hpp"
+#include "TextSelector.hpp"
+#include "UnarySelector.hpp"
+#include "StrRefHash.hpp"
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace gq
+{
+
+	namespace
+	{
+
+		const char Magic[4] = { 'G', 'Q', 'S', 'S' };
+
+		const size_t HeaderSize = 24;
+
+		const size_t RuleRecordSize = 32;
+
+		const size_t NodeRecordSize = 28;
+
+		const uint8_t MatchLastFlag = 1 << 0;
+
+		const uint8_t MatchTypeFlag = 1 << 1;
+
+		const uint8_t CaseInsensitiveFlag = 1 << 2;
+
+		const uint32_t ExceptionFlag = 1 << 0;
+
+		void WriteU8(std::string& output, const uint8_t value)
+		{
+			output.push_back(static_cast<char>(value));
+		}
+
+		void WriteU32(std::string& output, const uint32_t value)
+		{
+			output.push_back(static_cast<char>(value & 0xFF));
+			output.push_back(static_cast<char>((value >> 8) & 0xFF));
+			output.push_back(static_cast<char>((value >> 16) & 0xFF));
+			output.push_back(static_cast<char>((value >> 24) & 0xFF));
+		}
+
+		void WriteU64(std::string& output, const uint64_t value)
+		{
+			WriteU32(output, static_cast<uint32_t>(value & 0xFFFFFFFF));
+			WriteU32(output, static_cast<uint32_t>(value >> 32));
+		}
+
+		uint32_t ReadU32(const char* data)
+		{
+			const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+
+			return static_cast<uint32_t>(bytes[0]) |
+				(static_cast<uint32_t>(bytes[1]) << 8) |
+				(static_cast<uint32_t>(bytes[2]) << 16) |
+				(static_cast<uint32_t>(bytes[3]) << 24);
+		}
+
+		uint64_t ReadU64(const char* data)
+		{
+			return static_cast<uint64_t>(ReadU32(data)) | (static_cast<uint64_t>(ReadU32(data + 4)) << 32);
+		}
+
+		uint32_t CheckedU32(const size_t value)
+		{
+			if (value > static_cast<size_t>(std::numeric_limits<uint32_t>::max()))
+			{
+				throw std::runtime_error(u8"In SelectorCodec::Encode(const SelectorSet&, std::string&) - The set is too large to be encoded.");
+			}
+
+			return static_cast<uint32_t>(value);
+		}
+
+		/// <summary>
+		/// Writes every distinct string once, handing back the offset of each.
+		/// </summary>
+		class StringTable
+		{
+
+		public:
+
+			void Write(std::string& output, boost::string_ref str)
+			{
+				uint32_t offset = 0;
+
+				if (str.size() > 0)
+				{
+					auto existing = m_offsets.find(str);
+
+					if (existing == m_offsets.end())
+					{
+						offset = CheckedU32(m_contents.size());
+						m_contents.append(str.begin(), str.end());
+						m_offsets.emplace(str, offset);
+					}
+					else
+					{
+						offset = existing->second;
+					}
+				}
+
+				WriteU32(output, offset);
+				WriteU32(output, CheckedU32(str.size()));
+			}
+
+			const std::string& GetContents() const
+			{
+				return m_contents;
+			}
+
+		private:
+
+			// The keys refer to strings owned by the selectors being encoded, which outlive the
+			// table.
+			std::unordered_map<boost::string_ref, uint32_t, StringRefHash, StringRefEquality> m_offsets;
+
+			std::string m_contents;
+
+		};
+
+	}
+
+	class SelectorCodec::EncodeState
+	{
+
+	public:
+
+		std::vector<NodeRecord> nodes;
+
+		std::unordered_map<const Selector*, uint32_t> indices;
+
+	};
+
+	const uint32_t SelectorCodec::FormatVersion = 1;
+
+	void SelectorCodec::Encode(const SelectorSet& set, std::string& output)
+	{
+		EncodeState state;
+		std::vector<uint32_t> roots;
+		roots.reserve(set.GetRuleCount());
+
+		for (size_t i = 0; i < set.GetRuleCount(); ++i)
+		{
+			roots.push_back(EncodeSelector(set.GetRuleAt(i).GetSelector().get(), state));
+		}
+
+		StringTable strings;
+		std::string records;
+		records.reserve(set.GetRuleCount() * RuleRecordSize + state.nodes.size() * NodeRecordSize);
+
+		for (size_t i = 0; i < set.GetRuleCount(); ++i)
+		{
+			const auto& rule = set.GetRuleAt(i);
+
+			WriteU64(records, static_cast<uint64_t>(rule.GetId()));
+			WriteU32(records, roots[i]);
+			WriteU32(records, rule.IsException() ? ExceptionFlag : 0);
+			strings.Write(records, rule.GetDomains());
+			strings.Write(records, rule.GetSelector()->GetOriginalSelectorString());
+		}
+
+		for (const auto& node : state.nodes)
+		{
+			WriteU8(records, static_cast<uint8_t>(node.kind));
+			WriteU8(records, node.op);
+			WriteU8(records, node.flags);
+			WriteU8(records, 0);
+			WriteU32(records, static_cast<uint32_t>(node.first));
+			WriteU32(records, static_cast<uint32_t>(node.second));
+			strings.Write(records, node.firstString);
+			strings.Write(records, node.secondString);
+		}
+
+		output.reserve(output.size() + HeaderSize + records.size() + strings.GetContents().size());
+
+		output.append(Magic, sizeof(Magic));
+		WriteU32(output, FormatVersion);
+		WriteU32(output, CheckedU32(set.GetRuleCount()));
+		WriteU32(output, CheckedU32(state.nodes.size()));
+		WriteU32(output, CheckedU32(strings.GetContents().size()));
+		WriteU32(output, 0);
+
+		output.append(records);
+		output.append(strings.GetContents());
+	}
+
+	SelectorSet SelectorCodec::Decode(boost::string_ref data, std::vector<SelectorSet::Diagnostic>& diagnostics)
+	{
+		try
+		{
+			if (data.size() < HeaderSize || std::memcmp(data.data(), Magic, sizeof(Magic)) != 0)
+			{
+				throw std::runtime_error(u8"The data is not a precompiled selector set.");
+			}
+
+			const uint32_t version = ReadU32(data.data() + 4);
+
+			if (version != FormatVersion)
+			{
+				throw std::runtime_error(std::string(u8"The data is version ") + std::to_string(version) + std::string(u8", but only version ") + std::to_string(FormatVersion) + std::string(u8" is supported."));
+			}
+
+			const uint64_t ruleCount = ReadU32(data.data() + 8);
+			const uint64_t nodeCount = ReadU32(data.data() + 12);
+			const uint64_t stringTableSize = ReadU32(data.data() + 16);
+
+			// Computed in 64 bits, since the counts are untrusted and could overflow otherwise.
+			const uint64_t expectedSize = HeaderSize + (ruleCount * RuleRecordSize) + (nodeCount * NodeRecordSize) + stringTableSize;
+
+			if (expectedSize != static_cast<uint64_t>(data.size()))
+			{
+				throw std::runtime_error(u8"The size of the data does not match the size recorded in its header.");
+			}
+
+			const char* ruleRecords = data.data() + HeaderSize;
+			const char* nodeRecords = ruleRecords + (ruleCount * RuleRecordSize);
+			boost::string_ref stringTable(nodeRecords + (nodeCount * NodeRecordSize), static_cast<size_t>(stringTableSize));
+
+			auto readString = [&stringTable](const char* field) -> boost::string_ref
+			{
+				const uint64_t offset = ReadU32(field);
+				const uint64_t length = ReadU32(field + 4);
+
+				if (offset + length > stringTable.size())
+				{
+					throw std::runtime_error(u8"A string lies outside of the string table.");
+				}
+
+				return stringTable.substr(static_cast<size_t>(offset), static_cast<size_t>(length));
+			};
+
+			// The whole set is decoded into a single arena, so strings shared between rules are
+			// stored just once.
+			auto arena = SelectorArena::Create();
+			SelectorArena::Scope arenaScope(arena);
+
+			std::vector<SharedSelector> decoded;
+			decoded.reserve(static_cast<size_t>(nodeCount));
+
+			for (uint64_t i = 0; i < nodeCount; ++i)
+			{
+				const char* field = nodeRecords + (i * NodeRecordSize);
+
+				NodeRecord record;
+				record.kind = static_cast<NodeKind>(static_cast<uint8_t>(field[0]));
+				record.op = static_cast<uint8_t>(field[1]);
+				record.flags = static_cast<uint8_t>(field[2]);
+				record.first = static_cast<int32_t>(ReadU32(field + 4));
+				record.second = static_cast<int32_t>(ReadU32(field + 8));
+				record.firstString = readString(field + 12);
+				record.secondString = readString(field + 20);
+
+				decoded.push_back(DecodeSelector(record, decoded));
+			}
+
+			SelectorSet set;
+
+			for (uint64_t i = 0; i < ruleCount; ++i)
+			{
+				const char* field = ruleRecords + (i * RuleRecordSize);
+
+				const uint64_t id = ReadU64(field);
+				const uint32_t root = ReadU32(field + 8);
+				const uint32_t flags = ReadU32(field + 12);
+
+				if (root >= decoded.size())
+				{
+					throw std::runtime_error(u8"A rule refers to a selector that does not exist.");
+				}
+
+				boost::string_ref domains = readString(field + 16);
+				boost::string_ref original = readString(field + 24);
+
+				if (original.size() > 0 && decoded[root]->m_originalSelectorString.size() == 0)
+				{
+					decoded[root]->m_originalSelectorString = decoded[root]->InternString(original);
+				}
+
+				// The domains are interned into the arena as well, rather than copied into a string
+				// for every rule.
+				set.AddRule(SelectorSet::Rule(static_cast<size_t>(id), domains, arena, (flags & ExceptionFlag) != 0, decoded[root]));
+			}
+
+			set.BuildContainsMatcher();
+
+			return set;
+		}
+		catch (std::exception& e)
+		{
+			diagnostics.emplace_back(0, std::string(u8"In SelectorCodec::Decode(boost::string_ref, std::vector<SelectorSet::Diagnostic>&) - ") + e.what());
+			return SelectorSet();
+		}
+	}
+
+	uint32_t SelectorCodec::EncodeSelector(const Selector* selector, EncodeState& state)
+	{
+		auto existing = state.indices.find(selector);
+
+		if (existing != state.indices.end())
+		{
+			return existing->second;
+		}
+
+		NodeRecord record;
+
+		if (auto attribute = dynamic_cast<const AttributeSelector*>(selector))
+		{
+			record.kind = NodeKind::Attribute;
+			record.op = static_cast<uint8_t>(attribute->m_operator);
+			record.firstString = attribute->m_attributeNameRef;
+			record.secondString = attribute->m_attributeValueRef;
+			record.flags = attribute->m_caseInsensitive ? CaseInsensitiveFlag : 0;
+		}
+		else if (auto binary = dynamic_cast<const BinarySelector*>(selector))
+		{
+			record.kind = NodeKind::Binary;
+			record.op = static_cast<uint8_t>(binary->m_operator);
+			record.first = static_cast<int32_t>(EncodeSelector(binary->m_leftHandSide.get(), state));
+			record.second = static_cast<int32_t>(EncodeSelector(binary->m_rightHandSide.get(), state));
+		}
+		else if (auto unary = dynamic_cast<const UnarySelector*>(selector))
+		{
+			record.kind = NodeKind::Unary;
+			record.op = static_cast<uint8_t>(unary->m_operator);
+			record.first = static_cast<int32_t>(EncodeSelector(unary->m_selector.get(), state));
+		}
+		else if (auto text = dynamic_cast<const TextSelector*>(selector))
+		{
+			record.kind = NodeKind::Text;
+			record.op = static_cast<uint8_t>(text->m_operator);
+			record.firstString = text->m_textToMatchStrRef;
+		}
+		else
+		{
+			record.kind = NodeKind::Simple;
+			record.op = static_cast<uint8_t>(selector->m_selectorOperator);
+			record.flags = static_cast<uint8_t>((selector->m_matchLast ? MatchLastFlag : 0) | (selector->m_matchType ? MatchTypeFlag : 0));
+			record.first = selector->m_leftHandSideOfNth;
+			record.second = selector->m_rightHandSideOfNth;
+
+			if (selector->m_selectorOperator == Selector::SelectorOperator::Tag && selector->m_tagTypeToMatch != GUMBO_TAG_UNKNOWN)
+			{
+				record.firstString = boost::string_ref(gumbo_normalized_tagname(selector->m_tagTypeToMatch));
+			}
+		}
+
+		auto index = CheckedU32(state.nodes.size());
+		state.nodes.push_back(record);
+		state.indices.emplace(selector, index);
+
+		return index;
+	}
+
+	SharedSelector SelectorCodec::DecodeSelector(const NodeRecord& record, const std::vector<SharedSelector>& decoded)
+	{
+		// Nodes only ever refer to nodes written before them, which also rules out cycles.
+		auto child = [&decoded](const int32_t index) -> const SharedSelector&
+		{
+			if (index < 0 || static_cast<size_t>(index) >= decoded.size())
+			{
+				throw std::runtime_error(u8"A selector refers to a selector that does not precede it.");
+			}
+
+			return decoded[static_cast<size_t>(index)];
+		};
+
+		switch (record.kind)
+		{
+			case NodeKind::Simple:
+			{
+				switch (static_cast<Selector::SelectorOperator>(record.op))
+				{
+					case Selector::SelectorOperator::Dummy:
+					case Selector::SelectorOperator::Empty:
+						return SelectorArena::MakeShared<Selector>(static_cast<Selector::SelectorOperator>(record.op));
+
+					case Selector::SelectorOperator::OnlyChild:
+						return SelectorArena::MakeShared<Selector>((record.flags & MatchTypeFlag) != 0);
+
+					case Selector::SelectorOperator::NthChild:
+						return SelectorArena::MakeShared<Selector>(record.first, record.second, (record.flags & MatchLastFlag) != 0, (record.flags & MatchTypeFlag) != 0);
+
+					case Selector::SelectorOperator::Tag:
+						return SelectorArena::MakeShared<Selector>(gumbo_tagn_enum(record.firstString.data(), static_cast<unsigned int>(record.firstString.size())));
+				}
+			}
+			break;
+
+			case NodeKind::Attribute:
+			{
+				if (record.op > AttributeSelector::SelectorOperator::ValueIsHyphenSeparatedListStartingWith)
+				{
+					break;
+				}
+
+				auto op = static_cast<AttributeSelector::SelectorOperator>(record.op);
+
+				if (op == AttributeSelector::SelectorOperator::Exists)
+				{
+					return SelectorArena::MakeShared<AttributeSelector>(record.firstString);
+				}
+
+				return SelectorArena::MakeShared<AttributeSelector>(op, record.firstString, record.secondString, (record.flags & CaseInsensitiveFlag) != 0);
+			}
+			break;
+
+			case NodeKind::Binary:
+			{
+				if (record.op > static_cast<uint8_t>(BinarySelector::SelectorOperator::Sibling))
+				{
+					break;
+				}
+
+				return SelectorArena::MakeShared<BinarySelector>(static_cast<BinarySelector::SelectorOperator>(record.op), child(record.first), child(record.second));
+			}
+			break;
+
+			case NodeKind::Unary:
+			{
+				if (record.op > static_cast<uint8_t>(UnarySelector::SelectorOperator::HasChild))
+				{
+					break;
+				}
+
+				return SelectorArena::MakeShared<UnarySelector>(static_cast<UnarySelector::SelectorOperator>(record.op), child(record.first));
+			}
+			break;
+
+			case NodeKind::Text:
+			{
+				if (record.op > static_cast<uint8_t>(TextSelector::SelectorOperator::MatchesOwn))
+				{
+					break;
+				}
+
+				return SelectorArena::MakeShared<TextSelector>(static_cast<TextSelector::SelectorOperator>(record.op), record.firstString);
+			}
+			break;
+		}
+
+		throw std::runtime_error(u8"A selector record has an unknown kind or operator.");
+	}
+
+} /* namespace gq */
@@ -0,0 +1,134 @@
+/*
+* Copyright (c) 2015 Jesse Nicholson
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#pragma once
+
+#include "SelectorSet.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <boost/utility/string_ref.hpp>
+
+namespace gq
+{
+
+	/// <summary>
+	/// The SelectorCodec writes compiled selectors to, and reads them back from, a compact
+	/// versioned binary format, so that large rule lists only ever need to be parsed once.
+	/// <para>&#160;</para>
+	/// The format is a fixed size header, followed by a table of rule records, a table of node
+	/// records, and a table of strings. Nodes are written children first, so every node refers only
+	/// to nodes that come before it, and a selector tree that is shared by several rules is written
+	/// only once. Identical strings are likewise written only once. All integers are little endian.
+	/// <para>&#160;</para>
+	/// Match traits are not written. They depend on keys which are randomly generated every time
+	/// the process starts (see SpecialTraits), and the selector constructors rebuild them directly
+	/// from the node records, so no selector string is ever parsed on load. Tags are written by
+	/// name rather than by GumboTag value, so files remain valid across Gumbo versions.
+	/// </summary>
+	class SelectorCodec
+	{
+
+	public:
+
+		/// <summary>
+		/// The version of the binary format written by ::Encode(...). Files of any other version
+		/// are rejected by ::Decode(...).
+		/// </summary>
+		static const uint32_t FormatVersion;
+
+		/// <summary>
+		/// Appends the binary representation of the supplied set to the supplied output.
+		/// </summary>
+		/// <param name="set">
+		/// The set to encode. 
+		/// </param>
+		/// <param name="output">
+		/// The buffer to append the encoded set to. 
+		/// </param>
+		static void Encode(const SelectorSet& set, std::string& output);
+
+		/// <summary>
+		/// Rebuilds a set from its binary representation. This method does not throw. If the data
+		/// is malformed, truncated or of another version, an empty set is returned along with a
+		/// single diagnostic on line zero. Rules are otherwise restored with the ids they were
+		/// saved with, so diagnostics about individual rules report those ids as line numbers.
+		/// </summary>
+		/// <param name="data">
+		/// The encoded set. The data only needs to remain valid for the duration of the call. 
+		/// </param>
+		/// <param name="diagnostics">
+		/// Receives a diagnostic for each problem encountered. 
+		/// </param>
+		/// <returns>
+		/// The decoded set. 
+		/// </returns>
+		static SelectorSet Decode(boost::string_ref data, std::vector<SelectorSet::Diagnostic>& diagnostics);
+
+	private:
+
+		/// <summary>
+		/// The kind of selector that a node record describes.
+		/// </summary>
+		enum class NodeKind : uint8_t
+		{
+			Simple,
+			Attribute,
+			Binary,
+			Unary,
+			Text
+		};
+
+		/// <summary>
+		/// The in memory form of a node record, before it is written out or after it has been
+		/// read in.
+		/// </summary>
+		struct NodeRecord
+		{
+			NodeKind kind = NodeKind::Simple;
+			uint8_t op = 0;
+			uint8_t flags = 0;
+			int32_t first = 0;
+			int32_t second = 0;
+			boost::string_ref firstString;
+			boost::string_ref secondString;
+		};
+
+		/// <summary>
+		/// State used while encoding a single set.
+		/// </summary>
+		class EncodeState;
+
+		/// <summary>
+		/// Builds the record for the supplied selector, after encoding any selectors it is built
+		/// from, and returns the index of the record.
+		/// </summary>
+		static uint32_t EncodeSelector(const Selector* selector, EncodeState& state);
+
+		/// <summary>
+		/// Builds the selector described by the supplied record. Throws on invalid records.
+		/// </summary>
+		static SharedSelector DecodeSelector(const NodeRecord& record, const std::vector<SharedSelector>& decoded);
+
+	};
+
+} /* namespace gq */
@@ -0,0 +1,404 @@
+/*
+* Copyright (c) 2015 Jesse Nicholson
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+
+#pragma once
+
+#include "CharClass.hpp"
+#include "Selector.hpp"
+#include <stdexcept>
+
+/// <summary>
+/// Compiles a selector written as a string literal, for use anywhere a SharedSelector is accepted,
+/// such as Node::Find(...) and Node::Each(...). The literal is checked at compile time, so a
+/// malformed selector fails the build rather than throwing at runtime. The selector is compiled
+/// the first time the expression is evaluated, and every later evaluation returns that same
+/// selector, so no parsing is done on the hot path. See SelectorLiteral for what literals may
+/// contain.
+/// <para>&#160;</para>
+/// For example: document->Find(GQ_SELECTOR(u8"div.title > a[href]"));
+/// </summary>
+#define GQ_SELECTOR(selectorLiteral) \
+	([]() -> const ::gq::SharedSelector& \
+	{ \
+		static_assert(::gq::SelectorLiteral::Validate(selectorLiteral) == sizeof(selectorLiteral) - 1, "Malformed selector literal."); \
+		static const ::gq::SharedSelector compiledSelectorLiteral = ::gq::SelectorLiteral::Compile(selectorLiteral); \
+		return compiledSelectorLiteral; \
+	}())
+
+namespace gq
+{
+
+	/// <summary>
+	/// The SelectorLiteral validates selectors written as string literals at compile time, for
+	/// selectors which are fixed in code. It is normally used through the GQ_SELECTOR macro.
+	/// <para>&#160;</para>
+	/// Literals follow the same grammar as the Parser, with a few restrictions that keep the
+	/// check exact. Every literal that passes is accepted by the Parser. Named and numbered
+	/// character references, such as "&amp;", and backslash escapes are not allowed outside of
+	/// quoted strings. Combinators must be surrounded by whitespace, just as the Parser requires,
+	/// and must be followed by a selector. Nth arguments are limited to "odd", "even", "an+b",
+	/// "an", "+n", "-n+b" and the like, or a single integer, with no more than nine digits in
+	/// any number. The pattern of :matches(...) and :matchesown(...) can only be checked when the
+	/// literal is compiled.
+	/// <para>&#160;</para>
+	/// A malformed literal is reported by the compiler as an expression that isn't constant,
+	/// pointing to the check in this class that failed along with its message.
+	/// <para>&#160;</para>
+	/// All checks are written as single expressions so that they can be evaluated by compilers
+	/// which only support C++11 constexpr functions. Each nested part and each character within
+	/// a name or string adds to the depth of the evaluation, so very long literals may run into
+	/// the compiler's constexpr depth limit.
+	/// </summary>
+	class SelectorLiteral
+	{
+
+	public:
+
+		/// <summary>
+		/// Checks the supplied selector literal, failing constant evaluation if it is malformed.
+		/// </summary>
+		/// <param name="selectorLiteral">
+		/// The selector literal to check. 
+		/// </param>
+		/// <returns>
+		/// The length of the literal, not counting its terminator.
+		/// </returns>
+		template<size_t N>
+		static constexpr size_t Validate(const char (&selectorLiteral)[N])
+		{
+			return ExpectEnd(N - 1, ParseSelectorGroup(selectorLiteral, N - 1, 0));
+		}
+
+		/// <summary>
+		/// Compiles a selector literal which has already been checked by ::Validate(...). The
+		/// original selector string is retained. Throws std::runtime_error if the pattern of a
+		/// :matches(...) or :matchesown(...) is invalid.
+		/// </summary>
+		/// <param name="selectorLiteral">
+		/// The selector literal to compile. 
+		/// </param>
+		/// <returns>
+		/// The compiled selector.
+		/// </returns>
+		template<size_t N>
+		static SharedSelector Compile(const char (&selectorLiteral)[N])
+		{
+			return Compile(boost::string_ref(selectorLiteral, N - 1));
+		}
+
+	private:
+
+		/// <summary>
+		/// Compiles the supplied selector string with the Parser.
+		/// </summary>
+		static SharedSelector Compile(boost::string_ref selectorString);
+
+		/// <summary>
+		/// Fails constant evaluation with the supplied message. Only a null message is a constant
+		/// expression, which is never supplied by the checks below.
+		/// </summary>
+		static constexpr size_t Fail(const char* message)
+		{
+			return message == nullptr ? static_cast<size_t>(0) : throw std::runtime_error(message);
+		}
+
+		static constexpr bool HasFlags(const char c, const uint8_t flags)
+		{
+			return (CharClass::Classify(static_cast<unsigned char>(c)) & flags) != 0;
+		}
+
+		static constexpr bool IsAt(const char* s, const size_t n, const size_t i, const char c)
+		{
+			return i < n && s[i] == c;
+		}
+
+		static constexpr bool IsQuoteAt(const char* s, const size_t n, const size_t i)
+		{
+			return IsAt(s, n, i, '"') || IsAt(s, n, i, '\'');
+		}
+
+		static constexpr bool IsSignAt(const char* s, const size_t n, const size_t i)
+		{
+			return IsAt(s, n, i, '-') || IsAt(s, n, i, '+');
+		}
+
+		static constexpr size_t SkipWhitespace(const char* s, const size_t n, const size_t i)
+		{
+			return i < n && HasFlags(s[i], CharClass::Whitespace) ? SkipWhitespace(s, n, i + 1) : i;
+		}
+
+		static constexpr size_t SkipNameChars(const char* s, const size_t n, const size_t i)
+		{
+			return i < n && HasFlags(s[i], CharClass::NameChar) ? SkipNameChars(s, n, i + 1) : i;
+		}
+
+		static constexpr size_t SkipDigits(const char* s, const size_t n, const size_t i)
+		{
+			return i < n && HasFlags(s[i], CharClass::Digit) ? SkipDigits(s, n, i + 1) : i;
+		}
+
+		static constexpr bool EqualsLowerCase(const char* s, const size_t begin, const size_t end, const char* lowerCase)
+		{
+			return begin == end ? *lowerCase == '\0' :
+				(*lowerCase != '\0' && CharClass::Lower(static_cast<unsigned char>(s[begin])) == static_cast<unsigned char>(*lowerCase) && EqualsLowerCase(s, begin + 1, end, lowerCase + 1));
+		}
+
+		static constexpr size_t ExpectEnd(const size_t n, const size_t i)
+		{
+			return i == n ? i : Fail(u8"Unexpected input after selector. Combinators must be surrounded by whitespace.");
+		}
+
+		static constexpr size_t ExpectClosingParenthesis(const char* s, const size_t n, const size_t i)
+		{
+			return IsAt(s, n, i, ')') ? i + 1 : Fail(u8"Expected closing parenthesis.");
+		}
+
+		static constexpr size_t ExpectNoEscape(const char* s, const size_t n, const size_t i)
+		{
+			return IsAt(s, n, i, '&') || IsAt(s, n, i, '\\') ? Fail(u8"Character references and escapes are not supported in selector literals.") : i;
+		}
+
+		/// <summary>
+		/// Checks an identifier from begin, which runs up to end.
+		/// </summary>
+		static constexpr size_t ParseIdentifier(const char* s, const size_t n, const size_t begin, const size_t end)
+		{
+			return ExpectNoEscape(s, n, end) > begin ? end : Fail(u8"Expected identifier.");
+		}
+
+		static constexpr size_t ParseIdentifier(const char* s, const size_t n, const size_t i)
+		{
+			return ParseIdentifier(s, n, i, SkipNameChars(s, n, i));
+		}
+
+		static constexpr size_t FindClosingQuote(const char* s, const size_t n, const char quote, const size_t i)
+		{
+			return i >= n ? Fail(u8"No unescaped closing quote found in quoted string.") :
+				(s[i] == quote && s[i - 1] != '\\') ? i + 1 : FindClosingQuote(s, n, quote, i + 1);
+		}
+
+		static constexpr size_t ParseString(const char* s, const size_t n, const size_t i)
+		{
+			return i + 1 < n && s[i + 1] != s[i] ? FindClosingQuote(s, n, s[i], i + 2) : Fail(u8"Expected non-empty quoted string.");
+		}
+
+		static constexpr size_t ParseStringOrIdentifier(const char* s, const size_t n, const size_t i)
+		{
+			return IsQuoteAt(s, n, i) ? ParseString(s, n, i) : ParseIdentifier(s, n, i);
+		}
+
+		static constexpr bool IsAttributeFlagAt(const char* s, const size_t n, const size_t i)
+		{
+			return (IsAt(s, n, i, 'i') || IsAt(s, n, i, 'I') || IsAt(s, n, i, 's') || IsAt(s, n, i, 'S')) &&
+				(IsAt(s, n, i + 1, ']') || (i + 1 < n && HasFlags(s[i + 1], CharClass::Whitespace)));
+		}
+
+		/// <summary>
+		/// Checks the end of an attribute selector, with i just past its value and any whitespace,
+		/// where an "i" or "s" flag may precede the closing bracket.
+		/// </summary>
+		static constexpr size_t ParseAttributeClose(const char* s, const size_t n, const size_t i)
+		{
+			return IsAt(s, n, i, ']') ? i + 1 :
+				(IsAttributeFlagAt(s, n, i) && IsAt(s, n, SkipWhitespace(s, n, i + 1), ']')) ? SkipWhitespace(s, n, i + 1) + 1 :
+				Fail(u8"Expected attribute closing bracket.");
+		}
+
+		static constexpr size_t ParseAttributeValue(const char* s, const size_t n, const size_t i)
+		{
+			return ParseAttributeClose(s, n, SkipWhitespace(s, n, ParseStringOrIdentifier(s, n, i)));
+		}
+
+		/// <summary>
+		/// Checks what follows the name of an attribute selector, from i.
+		/// </summary>
+		static constexpr size_t ParseAttributeOperator(const char* s, const size_t n, const size_t i)
+		{
+			return IsAt(s, n, i, ']') ? i + 1 :
+				IsAt(s, n, i, '=') ? ParseAttributeValue(s, n, i + 1) :
+				((IsAt(s, n, i, '|') || IsAt(s, n, i, '~') || IsAt(s, n, i, '^') || IsAt(s, n, i, '$') || IsAt(s, n, i, '*')) && IsAt(s, n, i + 1, '=')) ? ParseAttributeValue(s, n, i + 2) :
+				Fail(u8"Invalid attribute value specifier. No whitespace is allowed around it.");
+		}
+
+		/// <summary>
+		/// Checks an attribute selector, with i just past the opening bracket and any whitespace.
+		/// </summary>
+		static constexpr size_t ParseAttributeName(const char* s, const size_t n, const size_t i)
+		{
+			return IsAt(s, n, i, '^') ? Fail(u8"Attribute name as prefix selector is unsupported.") : ParseAttributeOperator(s, n, ParseIdentifier(s, n, i));
+		}
+
+		/// <summary>
+		/// Checks an integer of at most nine digits, from i to end, preceded by an optional sign
+		/// and any whitespace.
+		/// </summary>
+		static constexpr bool IsShortInteger(const size_t i, const size_t end)
+		{
+			return end > i && end - i <= 9;
+		}
+
+		/// <summary>
+		/// Checks what follows the 'n' of an nth argument, with i just past the 'n' and any
+		/// whitespace.
+		/// </summary>
+		static constexpr size_t ParseNthOffset(const char* s, const size_t n, const size_t i)
+		{
+			return !IsSignAt(s, n, i) ? (SkipDigits(s, n, i) == i || IsShortInteger(i, SkipDigits(s, n, i)) ? SkipDigits(s, n, i) : Fail(u8"Nth offset is out of range.")) :
+				IsShortInteger(SkipWhitespace(s, n, i + 1), SkipDigits(s, n, SkipWhitespace(s, n, i + 1))) ? SkipDigits(s, n, SkipWhitespace(s, n, i + 1)) :
+				Fail(u8"Nth offset must be a number of no more than nine digits.");
+		}
+
+		/// <summary>
+		/// Checks an nth argument, with begin at its first character and digits just past any
+		/// sign and digits that it starts with.
+		/// </summary>
+		static constexpr size_t ParseNth(const char* s, const size_t n, const size_t begin, const size_t digits)
+		{
+			return (IsAt(s, n, digits, 'n') || IsAt(s, n, digits, 'N')) ?
+				((digits == begin || (IsSignAt(s, n, begin) && digits == begin + 1) || IsShortInteger(IsSignAt(s, n, begin) ? begin + 1 : begin, digits)) ?
+					ParseNthOffset(s, n, SkipWhitespace(s, n, digits + 1)) : Fail(u8"Nth step must be a number of no more than nine digits.")) :
+				IsShortInteger(IsSignAt(s, n, begin) ? begin + 1 : begin, digits) ? digits :
+				Fail(u8"Expected 'odd', 'even', an+b or an integer of no more than nine digits.");
+		}
+
+		static constexpr size_t ParseNth(const char* s, const size_t n, const size_t i)
+		{
+			return i < n && HasFlags(s[i], CharClass::Alpha) && s[i] != 'n' && s[i] != 'N' ?
+				(EqualsLowerCase(s, i, SkipNameChars(s, n, i), u8"odd") || EqualsLowerCase(s, i, SkipNameChars(s, n, i), u8"even") ? SkipNameChars(s, n, i) : Fail(u8"Expected 'odd' or 'even'.")) :
+				ParseNth(s, n, i, SkipDigits(s, n, IsSignAt(s, n, i) ? i + 1 : i));
+		}
+
+		/// <summary>
+		/// The kinds of argument taken by supported pseudo classes.
+		/// </summary>
+		enum PseudoArgument
+		{
+			Unsupported,
+			SelectorGroup,
+			Text,
+			Nth,
+			None
+		};
+
+		static constexpr PseudoArgument GetPseudoArgument(const char* s, const size_t begin, const size_t end)
+		{
+			return (EqualsLowerCase(s, begin, end, u8"not") || EqualsLowerCase(s, begin, end, u8"has") || EqualsLowerCase(s, begin, end, u8"haschild")) ? SelectorGroup :
+				(EqualsLowerCase(s, begin, end, u8"contains") || EqualsLowerCase(s, begin, end, u8"containsown") || EqualsLowerCase(s, begin, end, u8"matches") || EqualsLowerCase(s, begin, end, u8"matchesown")) ? Text :
+				(EqualsLowerCase(s, begin, end, u8"nth-child") || EqualsLowerCase(s, begin, end, u8"nth-last-child") || EqualsLowerCase(s, begin, end, u8"nth-of-type") || EqualsLowerCase(s, begin, end, u8"nth-last-of-type")) ? Nth :
+				(EqualsLowerCase(s, begin, end, u8"first-child") || EqualsLowerCase(s, begin, end, u8"last-child") || EqualsLowerCase(s, begin, end, u8"first-of-type") || EqualsLowerCase(s, begin, end, u8"last-of-type") ||
+				 EqualsLowerCase(s, begin, end, u8"only-child") || EqualsLowerCase(s, begin, end, u8"only-of-type") || EqualsLowerCase(s, begin, end, u8"empty")) ? None :
+				Unsupported;
+		}
+
+		/// <summary>
+		/// Checks the argument of a pseudo class, with i just past its name.
+		/// </summary>
+		static constexpr size_t ParsePseudoArgument(const char* s, const size_t n, const size_t i, const PseudoArgument argument)
+		{
+			return argument == Unsupported ? Fail(u8"Unsupported pseudo class.") :
+				argument == None ? i :
+				!IsAt(s, n, i, '(') ? Fail(u8"Expected opening parenthesis.") :
+				argument == SelectorGroup ? ExpectClosingParenthesis(s, n, SkipWhitespace(s, n, ParseSelectorGroup(s, n, i + 1))) :
+				argument == Text ? ExpectClosingParenthesis(s, n, SkipWhitespace(s, n, ParseStringOrIdentifier(s, n, SkipWhitespace(s, n, i + 1)))) :
+				ExpectClosingParenthesis(s, n, SkipWhitespace(s, n, ParseNth(s, n, SkipWhitespace(s, n, i + 1))));
+		}
+
+		static constexpr size_t ParsePseudoClass(const char* s, const size_t n, const size_t i)
+		{
+			return ParsePseudoArgument(s, n, ParseIdentifier(s, n, i), GetPseudoArgument(s, i, SkipNameChars(s, n, i)));
+		}
+
+		/// <summary>
+		/// Checks a single ID, class, attribute or pseudo class selector, starting at i.
+		/// </summary>
+		static constexpr size_t ParseQualifier(const char* s, const size_t n, const size_t i)
+		{
+			return (IsAt(s, n, i, '#') || IsAt(s, n, i, '.')) ? ParseStringOrIdentifier(s, n, i + 1) :
+				IsAt(s, n, i, '[') ? ParseAttributeName(s, n, SkipWhitespace(s, n, i + 1)) :
+				ParsePseudoClass(s, n, i + 1);
+		}
+
+		static constexpr bool IsQualifierAt(const char* s, const size_t n, const size_t i)
+		{
+			return IsAt(s, n, i, '#') || IsAt(s, n, i, '.') || IsAt(s, n, i, '[') || IsAt(s, n, i, ':');
+		}
+
+		/// <summary>
+		/// Checks the qualifiers of a simple selector sequence, starting at i. At least one is
+		/// required unless the sequence began with a type.
+		/// </summary>
+		static constexpr size_t ParseQualifiers(const char* s, const size_t n, const size_t i, const bool hasType)
+		{
+			return IsQualifierAt(s, n, i) ? ParseQualifiers(s, n, ParseQualifier(s, n, i), true) :
+				hasType ? i : Fail(u8"Expected selector.");
+		}
+
+		/// <summary>
+		/// Checks a simple selector sequence such as "div.a:first-child", starting at i. As with
+		/// the Parser, "*" stands alone.
+		/// </summary>
+		static constexpr size_t ParseSimpleSelectorSequence(const char* s, const size_t n, const size_t i)
+		{
+			return i >= n ? Fail(u8"Expected selector.") :
+				s[i] == '*' ? i + 1 :
+				IsQualifierAt(s, n, i) ? ParseQualifiers(s, n, i, false) :
+				ParseQualifiers(s, n, ParseIdentifier(s, n, i), true);
+		}
+
+		/// <summary>
+		/// Checks whatever combines the selector sequence ending at i with the next, if anything.
+		/// </summary>
+		static constexpr size_t ParseCombinator(const char* s, const size_t n, const size_t i, const size_t afterWhitespace)
+		{
+			return afterWhitespace == i || afterWhitespace == n || IsAt(s, n, afterWhitespace, ',') || IsAt(s, n, afterWhitespace, ')') ? afterWhitespace :
+				!(IsAt(s, n, afterWhitespace, '>') || IsAt(s, n, afterWhitespace, '+') || IsAt(s, n, afterWhitespace, '~')) ? ParseCombinators(s, n, ParseSimpleSelectorSequence(s, n, afterWhitespace)) :
+				SkipWhitespace(s, n, afterWhitespace + 1) == afterWhitespace + 1 ? Fail(u8"Combinators must be surrounded by whitespace.") :
+				ParseCombinators(s, n, ParseSimpleSelectorSequence(s, n, SkipWhitespace(s, n, afterWhitespace + 1)));
+		}
+
+		static constexpr size_t ParseCombinators(const char* s, const size_t n, const size_t i)
+		{
+			return ParseCombinator(s, n, i, SkipWhitespace(s, n, i));
+		}
+
+		static constexpr size_t ParseSelector(const char* s, const size_t n, const size_t i)
+		{
+			return ParseCombinators(s, n, ParseSimpleSelectorSequence(s, n, SkipWhitespace(s, n, i)));
+		}
+
+		static constexpr size_t ParseSelectorGroupRest(const char* s, const size_t n, const size_t i)
+		{
+			return IsAt(s, n, i, ',') ? ParseSelectorGroupRest(s, n, ParseSelector(s, n, i + 1)) : i;
+		}
+
+		/// <summary>
+		/// Checks a comma separated group of selectors, starting at i.
+		/// </summary>
+		static constexpr size_t ParseSelectorGroup(const char* s, const size_t n, const size_t i)
+		{
+			return ParseSelectorGroupRest(s, n, ParseSelector(s, n, i));
+		}
+
+	};
+
+} /* namespace gq */
@@ -0,0 +1,643 @@
+/*
+* Copyright (c) 2015 Jesse Nicholson
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#include "SelectorSet.hpp"
+#include "CharClass.hpp"
+#include "Parser.hpp"
+#include "SelectorCanonicalizer.hpp"
+#include "SelectorCodec.hpp"
+#include "Util.hpp"
+#include <algorithm>
+#include <cassert>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <thread>
+
+#ifdef _WIN32
+	#ifndef WIN32_LEAN_AND_MEAN
+		#define WIN32_LEAN_AND_MEAN
+	#endif
+	#ifndef NOMINMAX
+		#define NOMINMAX
+	#endif
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+namespace gq
+{
+
+	namespace
+	{
+
+		/// <summary>
+		/// An element hiding rule which has been split out of a rule list, but not yet compiled.
+		/// The string members refer directly into the rule list.
+		/// </summary>
+		struct PendingRule
+		{
+			size_t lineNumber;
+			boost::string_ref domains;
+			boost::string_ref selector;
+			bool isException;
+		};
+
+		/// <summary>
+		/// Trims whitespace from both ends of the supplied line.
+		/// </summary>
+		boost::string_ref TrimLine(boost::string_ref line)
+		{
+			while (line.size() > 0 && CharClass::IsWhitespace(line.front()))
+			{
+				line.remove_prefix(1);
+			}
+
+			while (line.size() > 0 && CharClass::IsWhitespace(line.back()))
+			{
+				line.remove_suffix(1);
+			}
+
+			return line;
+		}
+
+		/// <summary>
+		/// Attempts to split the supplied line as an element hiding rule. This follows the same
+		/// rules as Adblock Plus, where the domains before the separator may not contain any of
+		/// the characters /*|@"!, which is what tells an element hiding rule apart from a network
+		/// rule that happens to contain "##" in its URL.
+		/// </summary>
+		/// <returns>
+		/// True if the line is an element hiding rule or exception, false otherwise.
+		/// </returns>
+		bool SplitElementHidingRule(boost::string_ref line, PendingRule& rule)
+		{
+			auto separator = line.find('#');
+
+			if (separator == boost::string_ref::npos)
+			{
+				return false;
+			}
+
+			boost::string_ref domains = line.substr(0, separator);
+
+			if (domains.find_first_of(u8"/*|@\"!") != boost::string_ref::npos)
+			{
+				return false;
+			}
+
+			boost::string_ref rest = line.substr(separator + 1);
+
+			if (rest.starts_with(u8"#"))
+			{
+				rule.isException = false;
+				rest.remove_prefix(1);
+			}
+			else if (rest.starts_with(u8"@#"))
+			{
+				rule.isException = true;
+				rest.remove_prefix(2);
+			}
+			else
+			{
+				// Either a lone '#', or an extended rule such as "#?#" or "#$#", which are not
+				// CSS selectors.
+				return false;
+			}
+
+			rule.domains = domains;
+			rule.selector = rest;
+
+			return true;
+		}
+
+		/// <summary>
+		/// Owns a read only mapping of an entire file for the duration of a compile.
+		/// </summary>
+		class MappedFile
+		{
+
+		public:
+
+			MappedFile(const std::string& filePath)
+			{
+				#ifdef _WIN32
+					m_file = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+					if (m_file == INVALID_HANDLE_VALUE)
+					{
+						m_error = u8"The file could not be opened.";
+						return;
+					}
+
+					LARGE_INTEGER size;
+					if (!GetFileSizeEx(m_file, &size))
+					{
+						m_error = u8"The size of the file could not be determined.";
+						return;
+					}
+
+					if (static_cast<unsigned long long>(size.QuadPart) > static_cast<unsigned long long>(std::numeric_limits<size_t>::max()))
+					{
+						m_error = u8"The file is too large to be mapped.";
+						return;
+					}
+
+					m_size = static_cast<size_t>(size.QuadPart);
+
+					if (m_size == 0)
+					{
+						// Empty files can't be mapped, but there's nothing to map anyway.
+						return;
+					}
+
+					m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+					if (m_mapping == nullptr)
+					{
+						m_error = u8"The file could not be mapped.";
+						return;
+					}
+
+					m_data = static_cast<const char*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+
+					if (m_data == nullptr)
+					{
+						m_error = u8"The file could not be mapped.";
+						return;
+					}
+				#else
+					m_file = open(filePath.c_str(), O_RDONLY);
+
+					if (m_file < 0)
+					{
+						m_error = u8"The file could not be opened.";
+						return;
+					}
+
+					struct stat fileStat;
+					if (fstat(m_file, &fileStat) != 0)
+					{
+						m_error = u8"The size of the file could not be determined.";
+						return;
+					}
+
+					m_size = static_cast<size_t>(fileStat.st_size);
+
+					if (m_size == 0)
+					{
+						// Empty files can't be mapped, but there's nothing to map anyway.
+						return;
+					}
+
+					void* mapped = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, m_file, 0);
+
+					if (mapped == MAP_FAILED)
+					{
+						m_error = u8"The file could not be mapped.";
+						return;
+					}
+
+					m_data = static_cast<const char*>(mapped);
+				#endif
+			}
+
+			~MappedFile()
+			{
+				#ifdef _WIN32
+					if (m_data != nullptr)
+					{
+						UnmapViewOfFile(m_data);
+					}
+
+					if (m_mapping != nullptr)
+					{
+						CloseHandle(m_mapping);
+					}
+
+					if (m_file != INVALID_HANDLE_VALUE)
+					{
+						CloseHandle(m_file);
+					}
+				#else
+					if (m_data != nullptr)
+					{
+						munmap(const_cast<char*>(m_data), m_size);
+					}
+
+					if (m_file >= 0)
+					{
+						close(m_file);
+					}
+				#endif
+			}
+
+			MappedFile(const MappedFile&) = delete;
+			MappedFile& operator=(const MappedFile&) = delete;
+
+			const std::string& GetError() const
+			{
+				return m_error;
+			}
+
+			boost::string_ref GetContents() const
+			{
+				if (m_data == nullptr)
+				{
+					return boost::string_ref();
+				}
+
+				return boost::string_ref(m_data, m_size);
+			}
+
+		private:
+
+			#ifdef _WIN32
+				HANDLE m_file = INVALID_HANDLE_VALUE;
+				HANDLE m_mapping = nullptr;
+			#else
+				int m_file = -1;
+			#endif
+
+			const char* m_data = nullptr;
+
+			size_t m_size = 0;
+
+			std::string m_error;
+
+		};
+
+	}
+
+	const size_t SelectorSet::MinRulesPerThread = 256;
+
+	SelectorSet::Rule::Rule(const size_t id, std::string domains, const bool isException, SharedSelector selector) :
+		m_id(id), m_domains(std::move(domains)), m_isException(isException), m_selector(std::move(selector)), m_distinctIndex(0)
+	{
+
+	}
+
+	SelectorSet::Rule::Rule(const size_t id, boost::string_ref domains, std::shared_ptr<SelectorArena> domainsArena, const bool isException, SharedSelector selector) :
+		m_id(id), m_internedDomains(domainsArena->Intern(domains)), m_domainsArena(std::move(domainsArena)), m_isException(isException), m_selector(std::move(selector)), m_distinctIndex(0)
+	{
+
+	}
+
+	const size_t SelectorSet::Rule::GetId() const
+	{
+		return m_id;
+	}
+
+	boost::string_ref SelectorSet::Rule::GetDomains() const
+	{
+		if (m_domainsArena != nullptr)
+		{
+			return m_internedDomains;
+		}
+
+		return m_domains;
+	}
+
+	const bool SelectorSet::Rule::IsException() const
+	{
+		return m_isException;
+	}
+
+	const SharedSelector& SelectorSet::Rule::GetSelector() const
+	{
+		return m_selector;
+	}
+
+	SelectorSet::Result::Result(const SelectorSet* set, std::vector<Selection> selections) :
+		m_set(set), m_selections(std::move(selections))
+	{
+
+	}
+
+	const size_t SelectorSet::Result::GetRuleCount() const
+	{
+		return m_set->m_rules.size();
+	}
+
+	const Selection& SelectorSet::Result::GetSelectionAt(const size_t ruleIndex) const
+	{
+		if (ruleIndex >= m_set->m_rules.size())
+		{
+			throw std::runtime_error(u8"In SelectorSet::Result::GetSelectionAt(const size_t) - The supplied index is out of bounds.");
+		}
+
+		return m_selections[m_set->m_rules[ruleIndex].m_distinctIndex];
+	}
+
+	SelectorSet::Diagnostic::Diagnostic(const size_t lineNumber, std::string message) :
+		m_lineNumber(lineNumber), m_message(std::move(message))
+	{
+
+	}
+
+	const size_t SelectorSet::Diagnostic::GetLineNumber() const
+	{
+		return m_lineNumber;
+	}
+
+	const std::string& SelectorSet::Diagnostic::GetMessage() const
+	{
+		return m_message;
+	}
+
+	SelectorSet::SelectorSet()
+	{
+
+	}
+
+	SelectorSet::~SelectorSet()
+	{
+
+	}
+
+	SelectorSet SelectorSet::CompileRuleList(boost::string_ref ruleList, std::vector<Diagnostic>& diagnostics, const size_t maxThreads)
+	{
+		// Split out every element hiding rule first. This is a cheap linear scan, and it lets the
+		// expensive part, compilation, be divided up evenly between threads.
+		std::vector<PendingRule> pending;
+
+		size_t lineNumber = 0;
+
+		while (ruleList.size() > 0)
+		{
+			++lineNumber;
+
+			auto lineEnd = ruleList.find('\n');
+			boost::string_ref line = ruleList.substr(0, lineEnd);
+			ruleList = lineEnd == boost::string_ref::npos ? boost::string_ref() : ruleList.substr(lineEnd + 1);
+
+			line = TrimLine(line);
+
+			if (line.size() == 0 || line[0] == '!' || line[0] == '[')
+			{
+				// Skip empty lines, comments and the list header.
+				continue;
+			}
+
+			PendingRule rule;
+
+			if (!SplitElementHidingRule(line, rule))
+			{
+				continue;
+			}
+
+			rule.lineNumber = lineNumber;
+			pending.push_back(rule);
+		}
+
+		// Each rule is compiled into its own slot, so threads never write to the same element
+		// and the results come out in line order no matter how the work was divided.
+		std::vector<SharedSelector> compiled(pending.size());
+		std::vector<std::string> errors(pending.size());
+
+		auto compileRange = [&pending, &compiled, &errors](const size_t begin, const size_t end)
+		{
+			Parser parser;
+
+			// Each range is compiled into an arena of its own, since arenas can only be built
+			// in on one thread at a time.
+			SelectorArena::Scope arenaScope(SelectorArena::Create());
+
+			for (size_t i = begin; i < end; ++i)
+			{
+				if (pending[i].selector.size() == 0)
+				{
+					errors[i] = u8"In SelectorSet::CompileRuleList(boost::string_ref, std::vector<Diagnostic>&, const size_t) - Element hiding rule has no selector.";
+					continue;
+				}
+
+				// Rule lists are full of rules that don't compile, so they're reported through the
+				// result rather than thrown and caught one at a time.
+				auto result = parser.TryCreateSelector(pending[i].selector);
+
+				if (result)
+				{
+					compiled[i] = result.GetSelector();
+				}
+				else
+				{
+					errors[i] = result.GetErrorMessage();
+					errors[i].append(u8" -- [HERE>>>>>").append(pending[i].selector.substr(result.GetErrorOffset()).to_string()).append(u8"<<<<<]");
+				}
+			}
+		};
+
+		size_t numThreads = maxThreads > 0 ? maxThreads : static_cast<size_t>(std::thread::hardware_concurrency());
+		numThreads = std::max(static_cast<size_t>(1), std::min(numThreads, pending.size() / MinRulesPerThread));
+
+		auto rangeSize = pending.size() / numThreads;
+
+		Util::ForEachRange(numThreads, [&compileRange, &pending, rangeSize, numThreads](const size_t range) -> void
+		{
+			auto begin = range * rangeSize;
+			auto end = (range + 1 == numThreads) ? pending.size() : begin + rangeSize;
+
+			compileRange(begin, end);
+		});
+
+		SelectorSet set;
+		set.m_rules.reserve(pending.size());
+
+		for (size_t i = 0; i < pending.size(); ++i)
+		{
+			if (compiled[i] != nullptr)
+			{
+				set.Add(pending[i].lineNumber, std::move(compiled[i]), pending[i].domains.to_string(), pending[i].isException);
+			}
+			else
+			{
+				diagnostics.emplace_back(pending[i].lineNumber, std::move(errors[i]));
+			}
+		}
+
+		// Rule lists repeat the same selectors across many domains, often written slightly
+		// differently, so it pays to merge them once here rather than evaluate each copy.
+		set.Deduplicate();
+
+		return set;
+	}
+
+	SelectorSet SelectorSet::CompileRuleListFile(const std::string& filePath, std::vector<Diagnostic>& diagnostics, const size_t maxThreads)
+	{
+		MappedFile file(filePath);
+
+		if (file.GetError().size() > 0)
+		{
+			diagnostics.emplace_back(0, std::string(u8"In SelectorSet::CompileRuleListFile(const std::string&, std::vector<Diagnostic>&, const size_t) - ") + file.GetError() + std::string(u8" Path: ") + filePath);
+			return SelectorSet();
+		}
+
+		return CompileRuleList(file.GetContents(), diagnostics, maxThreads);
+	}
+
+	SelectorSet SelectorSet::LoadBinary(boost::string_ref data, std::vector<Diagnostic>& diagnostics)
+	{
+		return SelectorCodec::Decode(data, diagnostics);
+	}
+
+	SelectorSet SelectorSet::LoadBinaryFile(const std::string& filePath, std::vector<Diagnostic>& diagnostics)
+	{
+		MappedFile file(filePath);
+
+		if (file.GetError().size() > 0)
+		{
+			diagnostics.emplace_back(0, std::string(u8"In SelectorSet::LoadBinaryFile(const std::string&, std::vector<Diagnostic>&) - ") + file.GetError() + std::string(u8" Path: ") + filePath);
+			return SelectorSet();
+		}
+
+		return SelectorCodec::Decode(file.GetContents(), diagnostics);
+	}
+
+	void SelectorSet::SaveBinary(std::string& output) const
+	{
+		SelectorCodec::Encode(*this, output);
+	}
+
+	const bool SelectorSet::SaveBinaryFile(const std::string& filePath) const
+	{
+		std::string output;
+		SaveBinary(output);
+
+		std::ofstream out(filePath, std::ios::binary | std::ios::out | std::ios::trunc);
+
+		if (out.fail() || !out.is_open())
+		{
+			return false;
+		}
+
+		out.write(output.data(), static_cast<std::streamsize>(output.size()));
+		out.close();
+
+		return !out.fail();
+	}
+
+	void SelectorSet::Add(const size_t id, SharedSelector selector, std::string domains, const bool isException)
+	{
+		#ifndef NDEBUG
+			assert(selector != nullptr && u8"In SelectorSet::Add(const size_t, SharedSelector, std::string, const bool) - Supplied selector is nullptr.");
+		#else
+			if (selector == nullptr) { throw std::runtime_error(u8"In SelectorSet::Add(const size_t, SharedSelector, std::string, const bool) - Supplied selector is nullptr."); }
+		#endif
+
+		AddRule(Rule(id, std::move(domains), isException, std::move(selector)));
+	}
+
+	void SelectorSet::AddRule(Rule rule)
+	{
+		rule.m_distinctIndex = GetDistinctIndex(rule.m_selector);
+
+		m_rules.push_back(std::move(rule));
+
+		m_containsMatcher.reset();
+	}
+
+	const size_t SelectorSet::GetRuleCount() const
+	{
+		return m_rules.size();
+	}
+
+	const SelectorSet::Rule& SelectorSet::GetRuleAt(const size_t index) const
+	{
+		if (m_rules.size() == 0 || index >= m_rules.size())
+		{
+			throw std::runtime_error(u8"In SelectorSet::GetRuleAt(const size_t) - The supplied index is out of bounds.");
+		}
+
+		return m_rules[index];
+	}
+
+	void SelectorSet::Deduplicate()
+	{
+		SelectorArena::Scope arenaScope(SelectorArena::Create());
+		SelectorCanonicalizer canonicalizer;
+
+		m_distinctSelectors.clear();
+		m_distinctIndices.clear();
+
+		for (auto& rule : m_rules)
+		{
+			rule.m_selector = canonicalizer.Canonicalize(rule.m_selector);
+			rule.m_distinctIndex = GetDistinctIndex(rule.m_selector);
+		}
+
+		BuildContainsMatcher();
+	}
+
+	const size_t SelectorSet::GetDistinctSelectorCount() const
+	{
+		return m_distinctSelectors.size();
+	}
+
+	const SelectorSet::Result SelectorSet::Find(const Node& scope) const
+	{
+		std::vector<Selection> selections;
+		selections.reserve(m_distinctSelectors.size());
+
+		auto containsMatcher = m_containsMatcher != nullptr ? m_containsMatcher : std::make_shared<const ContainsMatcher>(m_distinctSelectors);
+
+		// Every needle is searched for within the whole scope at once, up front. The text
+		// selectors then only look up the result for the node they're matching against.
+		std::unique_ptr<ContainsMatcher::Scope> containsScope;
+
+		if (containsMatcher->GetPatternCount() > 0)
+		{
+			containsScope.reset(new ContainsMatcher::Scope(*containsMatcher, scope));
+		}
+
+		for (const auto& selector : m_distinctSelectors)
+		{
+			selections.push_back(scope.Find(selector));
+		}
+
+		return Result(this, std::move(selections));
+	}
+
+	const size_t SelectorSet::GetDistinctIndex(const SharedSelector& selector)
+	{
+		auto existing = m_distinctIndices.find(selector.get());
+
+		if (existing != m_distinctIndices.end())
+		{
+			return existing->second;
+		}
+
+		m_distinctIndices.emplace(selector.get(), m_distinctSelectors.size());
+		m_distinctSelectors.push_back(selector);
+
+		return m_distinctSelectors.size() - 1;
+	}
+
+	void SelectorSet::BuildContainsMatcher()
+	{
+		m_containsMatcher = std::make_shared<const ContainsMatcher>(m_distinctSelectors);
+	}
+
+} /* namespace gq */
@@ -0,0 +1,465 @@
+/*
+* Copyright (c) 2015 Jesse Nicholson
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#pragma once
+
+#include "ContainsMatcher.hpp"
+#include "Selection.hpp"
+#include "Selector.hpp"
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <boost/utility/string_ref.hpp>
+
+namespace gq
+{
+
+	/// <summary>
+	/// The SelectorSet holds a collection of compiled selectors, each tagged with the rule it was
+	/// compiled from. Rule lists in the EasyList/Adblock Plus format can be compiled straight into
+	/// a set with ::CompileRuleList(...) or ::CompileRuleListFile(...), which split out the
+	/// element hiding rules, compile them in parallel, and report any rule that fails to compile
+	/// without throwing.
+	/// <para>&#160;</para>
+	/// Rules are grouped by the selector instance they hold, and ::Find(...) evaluates each
+	/// distinct selector only once, no matter how many rules share it. ::Deduplicate() merges
+	/// selectors which are written differently but are structurally equivalent, as described by
+	/// SelectorCanonicalizer, into shared instances.
+	/// <para>&#160;</para>
+	/// The needles of every :contains(...) and :containsOwn(...) selector in the set are gathered
+	/// into a single ContainsMatcher, and ::Find(...) scans the text within its scope for all of
+	/// them in one pass, rather than having each text selector search the text on its own.
+	/// </summary>
+	class SelectorSet
+	{
+
+		// So that a decoded set can be readied for searching.
+		friend class SelectorCodec;
+
+	public:
+
+		/// <summary>
+		/// A single compiled rule within the set.
+		/// </summary>
+		class Rule
+		{
+
+			friend class SelectorSet;
+			friend class SelectorCodec;
+
+		public:
+
+			/// <summary>
+			/// Gets the id of the rule. For rules compiled from a rule list, this is the line
+			/// number, starting at one, that the rule was found on.
+			/// </summary>
+			/// <returns>
+			/// The id of the rule. 
+			/// </returns>
+			const size_t GetId() const;
+
+			/// <summary>
+			/// Gets the comma separated list of domains the rule is restricted to, exactly as it
+			/// appeared before the "##" separator. Empty for rules that apply everywhere.
+			/// </summary>
+			/// <returns>
+			/// The domains the rule applies to. 
+			/// </returns>
+			boost::string_ref GetDomains() const;
+
+			/// <summary>
+			/// Checks whether the rule is an element hiding exception, written with the "#@#"
+			/// separator, rather than an element hiding rule.
+			/// </summary>
+			/// <returns>
+			/// True if the rule is an exception, false otherwise. 
+			/// </returns>
+			const bool IsException() const;
+
+			/// <summary>
+			/// Gets the compiled selector for the rule. 
+			/// </summary>
+			/// <returns>
+			/// The compiled selector. 
+			/// </returns>
+			const SharedSelector& GetSelector() const;
+
+		private:
+
+			Rule(const size_t id, std::string domains, const bool isException, SharedSelector selector);
+
+			/// <summary>
+			/// Constructs a rule whose domains are interned into the supplied arena rather than
+			/// copied into a string of their own, so that loading a set doesn't allocate for the
+			/// domains of every rule.
+			/// </summary>
+			Rule(const size_t id, boost::string_ref domains, std::shared_ptr<SelectorArena> domainsArena, const bool isException, SharedSelector selector);
+
+			size_t m_id;
+
+			/// <summary>
+			/// The domains of a rule added with ::Add(...). Empty for rules whose domains are
+			/// interned.
+			/// </summary>
+			std::string m_domains;
+
+			/// <summary>
+			/// The domains of a rule loaded from a binary set, interned into ::m_domainsArena.
+			/// </summary>
+			boost::string_ref m_internedDomains;
+
+			/// <summary>
+			/// The arena holding ::m_internedDomains. Will be nullptr for rules added with
+			/// ::Add(...).
+			/// </summary>
+			std::shared_ptr<SelectorArena> m_domainsArena;
+
+			bool m_isException;
+
+			SharedSelector m_selector;
+
+			size_t m_distinctIndex;
+
+		};
+
+		/// <summary>
+		/// The nodes matched by every rule in a set, as returned by ::Find(...). Rules which share
+		/// a selector share a single selection. The result refers to the set it came from, and so
+		/// must not outlive it.
+		/// </summary>
+		class Result
+		{
+
+			friend class SelectorSet;
+
+		public:
+
+			/// <summary>
+			/// Gets the number of rules in the set the result came from.
+			/// </summary>
+			/// <returns>
+			/// The number of rules.
+			/// </returns>
+			const size_t GetRuleCount() const;
+
+			/// <summary>
+			/// Gets the nodes matched by the rule at the supplied index within the set. The nodes
+			/// are exactly those, in the same order, that Node::Find(...) returns for the rule's
+			/// selector. Throws std::runtime_error if the index is out of bounds.
+			/// </summary>
+			/// <param name="ruleIndex">
+			/// The index of the rule within the set. 
+			/// </param>
+			/// <returns>
+			/// The nodes matched by the rule.
+			/// </returns>
+			const Selection& GetSelectionAt(const size_t ruleIndex) const;
+
+		private:
+
+			Result(const SelectorSet* set, std::vector<Selection> selections);
+
+			const SelectorSet* m_set;
+
+			std::vector<Selection> m_selections;
+
+		};
+
+		/// <summary>
+		/// Describes a rule within a rule list that could not be compiled.
+		/// </summary>
+		class Diagnostic
+		{
+
+		public:
+
+			/// <summary>
+			/// Constructs a new diagnostic.
+			/// </summary>
+			/// <param name="lineNumber">
+			/// The line, starting at one, that the diagnostic applies to. Zero when the diagnostic
+			/// applies to the rule list as a whole, such as when a file can't be read.
+			/// </param>
+			/// <param name="message">
+			/// A description of the problem.
+			/// </param>
+			Diagnostic(const size_t lineNumber, std::string message);
+
+			/// <summary>
+			/// Gets the line, starting at one, that the diagnostic applies to. Zero when the
+			/// diagnostic applies to the rule list as a whole.
+			/// </summary>
+			/// <returns>
+			/// The line number. 
+			/// </returns>
+			const size_t GetLineNumber() const;
+
+			/// <summary>
+			/// Gets the description of the problem.
+			/// </summary>
+			/// <returns>
+			/// The description of the problem. 
+			/// </returns>
+			const std::string& GetMessage() const;
+
+		private:
+
+			size_t m_lineNumber;
+
+			std::string m_message;
+
+		};
+
+		/// <summary>
+		/// Constructs an empty set.
+		/// </summary>
+		SelectorSet();
+
+		/// <summary>
+		/// Default destructor.
+		/// </summary>
+		~SelectorSet();
+
+		/// <summary>
+		/// Compiles every element hiding rule in the supplied rule list. The list is expected to
+		/// be in the EasyList/Adblock Plus format, one rule per line, where element hiding rules
+		/// take the form "domains##selector" and exceptions take the form "domains#@#selector".
+		/// Comments beginning with "!", the "[Adblock Plus x.y]" header, empty lines, network
+		/// rules and extended rules such as "#?#" are skipped.
+		/// <para>&#160;</para>
+		/// Selectors are compiled in parallel across the requested number of threads. The rules in
+		/// the returned set are in the same order as they appear in the list. This method does not
+		/// throw on malformed input. Instead, every rule that fails to compile is left out of the
+		/// set and described by a diagnostic, in line order.
+		/// </summary>
+		/// <param name="ruleList">
+		/// The contents of the rule list. 
+		/// </param>
+		/// <param name="diagnostics">
+		/// Receives a diagnostic for each rule that could not be compiled. 
+		/// </param>
+		/// <param name="maxThreads">
+		/// The maximum number of threads to compile with, including the calling thread. Zero uses
+		/// std::thread::hardware_concurrency(). Short lists are always compiled on the calling
+		/// thread alone.
+		/// </param>
+		/// <returns>
+		/// A set containing every element hiding rule that compiled successfully.
+		/// </returns>
+		static SelectorSet CompileRuleList(boost::string_ref ruleList, std::vector<Diagnostic>& diagnostics, const size_t maxThreads = 0);
+
+		/// <summary>
+		/// Memory maps the rule list at the supplied path and compiles it, exactly as
+		/// ::CompileRuleList(...) does. If the file can't be opened or mapped, an empty set is
+		/// returned along with a single diagnostic on line zero.
+		/// </summary>
+		/// <param name="filePath">
+		/// The path of the rule list to compile. 
+		/// </param>
+		/// <param name="diagnostics">
+		/// Receives a diagnostic for each rule that could not be compiled. 
+		/// </param>
+		/// <param name="maxThreads">
+		/// The maximum number of threads to compile with, including the calling thread. Zero uses
+		/// std::thread::hardware_concurrency().
+		/// </param>
+		/// <returns>
+		/// A set containing every element hiding rule that compiled successfully.
+		/// </returns>
+		static SelectorSet CompileRuleListFile(const std::string& filePath, std::vector<Diagnostic>& diagnostics, const size_t maxThreads = 0);
+
+		/// <summary>
+		/// Rebuilds a set from the binary form written by ::SaveBinary(...). This is much faster
+		/// than compiling the original rule list, since no selector strings are parsed. This
+		/// method does not throw. If the data is malformed or was written by an incompatible
+		/// version, an empty set is returned along with a single diagnostic on line zero, and the
+		/// caller should fall back to compiling the original rule list.
+		/// </summary>
+		/// <param name="data">
+		/// The binary form of a set. 
+		/// </param>
+		/// <param name="diagnostics">
+		/// Receives a diagnostic if the data can't be loaded. 
+		/// </param>
+		/// <returns>
+		/// The loaded set. 
+		/// </returns>
+		static SelectorSet LoadBinary(boost::string_ref data, std::vector<Diagnostic>& diagnostics);
+
+		/// <summary>
+		/// Memory maps the file at the supplied path and loads the binary form of a set from it,
+		/// exactly as ::LoadBinary(...) does. The file is unmapped before this method returns.
+		/// </summary>
+		/// <param name="filePath">
+		/// The path of the file written by ::SaveBinaryFile(...). 
+		/// </param>
+		/// <param name="diagnostics">
+		/// Receives a diagnostic if the file can't be loaded. 
+		/// </param>
+		/// <returns>
+		/// The loaded set. 
+		/// </returns>
+		static SelectorSet LoadBinaryFile(const std::string& filePath, std::vector<Diagnostic>& diagnostics);
+
+		/// <summary>
+		/// Appends the binary form of this set to the supplied buffer. Every rule is written with
+		/// its id, domains, exception flag and selector. See SelectorCodec for details of the
+		/// format.
+		/// </summary>
+		/// <param name="output">
+		/// The buffer to append to. 
+		/// </param>
+		void SaveBinary(std::string& output) const;
+
+		/// <summary>
+		/// Writes the binary form of this set to the file at the supplied path, replacing the file
+		/// if it exists.
+		/// </summary>
+		/// <param name="filePath">
+		/// The path of the file to write. 
+		/// </param>
+		/// <returns>
+		/// True if the file was written in full, false otherwise. 
+		/// </returns>
+		const bool SaveBinaryFile(const std::string& filePath) const;
+
+		/// <summary>
+		/// Adds a compiled selector to the set.
+		/// </summary>
+		/// <param name="id">
+		/// The id to report for the rule. 
+		/// </param>
+		/// <param name="selector">
+		/// The compiled selector. 
+		/// </param>
+		/// <param name="domains">
+		/// The comma separated list of domains the rule is restricted to, if any. 
+		/// </param>
+		/// <param name="isException">
+		/// Whether the rule is an element hiding exception. 
+		/// </param>
+		void Add(const size_t id, SharedSelector selector, std::string domains = std::string(), const bool isException = false);
+
+		/// <summary>
+		/// Gets the number of rules in the set.
+		/// </summary>
+		/// <returns>
+		/// The number of rules in the set.
+		/// </returns>
+		const size_t GetRuleCount() const;
+
+		/// <summary>
+		/// Gets the rule at the supplied index. Throws std::runtime_error if the index is out of
+		/// bounds.
+		/// </summary>
+		/// <param name="index">
+		/// The index of the rule to get. 
+		/// </param>
+		/// <returns>
+		/// The rule at the supplied index.
+		/// </returns>
+		const Rule& GetRuleAt(const size_t index) const;
+
+		/// <summary>
+		/// Merges every group of structurally equivalent selectors in the set into a single
+		/// instance, and shares identical sub-trees between the selectors that remain. Every rule
+		/// is kept, with its id, domains and exception flag, and continues to be reported on its
+		/// own by ::Find(...). Selectors compiled by ::CompileRuleList(...) are already
+		/// deduplicated. Any selectors that need to be built are built in an arena of their own.
+		/// Sets built with ::Add(...) should be deduplicated before they are searched, since
+		/// this also builds the automaton ::Find(...) uses for text selectors.
+		/// </summary>
+		void Deduplicate();
+
+		/// <summary>
+		/// Gets the number of distinct selectors in the set, which is the number of selectors that
+		/// ::Find(...) evaluates.
+		/// </summary>
+		/// <returns>
+		/// The number of distinct selectors.
+		/// </returns>
+		const size_t GetDistinctSelectorCount() const;
+
+		/// <summary>
+		/// Finds the nodes matched by every rule in the set, within the supplied scope. Each
+		/// distinct selector is evaluated once.
+		/// </summary>
+		/// <param name="scope">
+		/// The node to search within, as with Node::Find(...). 
+		/// </param>
+		/// <returns>
+		/// The nodes matched by each rule.
+		/// </returns>
+		const Result Find(const Node& scope) const;
+
+	private:
+
+		/// <summary>
+		/// Lists with fewer element hiding rules than this per thread are not worth splitting up.
+		/// </summary>
+		static const size_t MinRulesPerThread;
+
+		/// <summary>
+		/// Appends the supplied rule, recording the distinct selector it holds.
+		/// </summary>
+		/// <param name="rule">
+		/// The rule to append.
+		/// </param>
+		void AddRule(Rule rule);
+
+		/// <summary>
+		/// All rules in the set, in the order they were added.
+		/// </summary>
+		std::vector<Rule> m_rules;
+
+		/// <summary>
+		/// Every distinct selector held by the rules, in the order each was first added.
+		/// </summary>
+		std::vector<SharedSelector> m_distinctSelectors;
+
+		/// <summary>
+		/// The index of each selector within ::m_distinctSelectors.
+		/// </summary>
+		std::unordered_map<const Selector*, size_t> m_distinctIndices;
+
+		/// <summary>
+		/// The needles of every text selector within ::m_distinctSelectors. Will be nullptr if
+		/// selectors have been added since it was last built, in which case ::Find(...) builds
+		/// one of its own on each call.
+		/// </summary>
+		std::shared_ptr<const ContainsMatcher> m_containsMatcher;
+
+		/// <summary>
+		/// Gets the index of the supplied selector within ::m_distinctSelectors, adding it first
+		/// if it isn't there yet.
+		/// </summary>
+		const size_t GetDistinctIndex(const SharedSelector& selector);
+
+		/// <summary>
+		/// Builds ::m_containsMatcher over the present distinct selectors.
+		/// </summary>
+		void BuildContainsMatcher();
+
+	};
+
+} /* namespace gq */
@@ -20,11 +20,114 @@
 
 #include "Serializer.hpp"
 #include "Node.hpp"
+#include "TreeMap.hpp"
 #include "Util.hpp"
+#include "StringKernels.hpp"
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <unordered_map>
 
 namespace gq
 {
 
+	namespace
+	{
+
+		/// <summary>
+		/// Passes output on to another sink with all leading and trailing whitespace trimmed
+		/// away, the same as boost::trim(...) would do to the whole output. Whitespace that may
+		/// turn out to be trailing is held back until more output follows it, and is dropped
+		/// if nothing does.
+		/// </summary>
+		class TrimmingOutputSink final : public OutputSink
+		{
+
+		public:
+
+			TrimmingOutputSink(OutputSink& target) : m_target(target)
+			{
+
+			}
+
+			virtual void Write(boost::string_ref data)
+			{
+				WriteTrimmed(data, false);
+			}
+
+			virtual void WriteReferenced(boost::string_ref data)
+			{
+				WriteTrimmed(data, true);
+			}
+
+		private:
+
+			static bool IsSpace(const char c)
+			{
+				return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+			}
+
+			void WriteTrimmed(boost::string_ref data, const bool referenced)
+			{
+				size_t begin = 0;
+
+				if (!m_started)
+				{
+					while (begin < data.size() && IsSpace(data[begin]))
+					{
+						++begin;
+					}
+
+					if (begin == data.size())
+					{
+						return;
+					}
+
+					m_started = true;
+				}
+
+				size_t end = data.size();
+
+				while (end > begin && IsSpace(data[end - 1]))
+				{
+					--end;
+				}
+
+				if (end == begin)
+				{
+					m_pending.append(data.data() + begin, data.size() - begin);
+					return;
+				}
+
+				if (m_pending.size() > 0)
+				{
+					m_target.Write(m_pending);
+					m_pending.clear();
+				}
+
+				if (referenced)
+				{
+					m_target.WriteReferenced(data.substr(begin, end - begin));
+				}
+				else
+				{
+					m_target.Write(data.substr(begin, end - begin));
+				}
+
+				m_pending.assign(data.data() + end, data.size() - end);
+			}
+
+			OutputSink& m_target;
+
+			std::string m_pending;
+
+			bool m_started = false;
+
+		};
+
+	}
+
 	const std::unordered_set<boost::string_ref, StringRefHash> Serializer::EmptyTags =
 	{
 		{ u8"area" },
@@ -52,50 +155,757 @@ namespace gq
 		{ u8"wbr" }
 	};
 
-	const std::unordered_set<boost::string_ref, StringRefHash> Serializer::SpecialHandling =
-	{
-		{ u8"html" },
-		{ u8"body" }
-	};
+	const std::unordered_set<boost::string_ref, StringRefHash> Serializer::SpecialHandling =
+	{
+		{ u8"html" },
+		{ u8"body" }
+	};
+
+	Serializer::Serializer()
+	{
+	}
+
+	Serializer::~Serializer()
+	{
+	}
+
+	constexpr size_t Serializer::UnknownNodeIndex;
+
+	constexpr size_t Serializer::ElementGrowthEstimate;
+
+	std::string Serializer::Serialize(const Node* node, const NodeMutationCollection* mutationCollection)
+	{
+		std::string results;
+		Serialize(node, results, mutationCollection);
+		return results;
+	}
+
+	std::string Serializer::Serialize(const GumboNode* node, const NodeMutationCollection* mutationCollection)
+	{
+		std::string results;
+		Serialize(node, results, mutationCollection);
+		return results;
+	}
+
+	std::string Serializer::SerializeContent(const Node* node, const bool omitText, const NodeMutationCollection* mutationCollection)
+	{
+		std::string contents;
+		SerializeContent(node, contents, omitText, mutationCollection);
+		return contents;
+	}
+
+	std::string Serializer::SerializeContent(const GumboNode* node, const bool omitText, const NodeMutationCollection* mutationCollection)
+	{
+		std::string contents;
+		SerializeContent(node, contents, omitText, mutationCollection);
+		return contents;
+	}
+
+	void Serializer::Serialize(const Node* node, std::string& output, const NodeMutationCollection* mutationCollection)
+	{
+		output.clear();
+		output.reserve(EstimateSize(node, mutationCollection));
+
+		StringOutputSink sink(output);
+		Serialize(node, sink, mutationCollection);
+	}
+
+	void Serializer::Serialize(const GumboNode* node, std::string& output, const NodeMutationCollection* mutationCollection)
+	{
+		output.clear();
+		output.reserve(EstimateSize(node, mutationCollection));
+
+		StringOutputSink sink(output);
+		Serialize(node, sink, mutationCollection);
+	}
+
+	void Serializer::SerializeContent(const Node* node, std::string& output, const bool omitText, const NodeMutationCollection* mutationCollection)
+	{
+		output.clear();
+		output.reserve(EstimateSize(node, mutationCollection));
+
+		StringOutputSink sink(output);
+		SerializeContent(node, sink, omitText, mutationCollection);
+	}
+
+	void Serializer::SerializeContent(const GumboNode* node, std::string& output, const bool omitText, const NodeMutationCollection* mutationCollection)
+	{
+		output.clear();
+		output.reserve(EstimateSize(node, mutationCollection));
+
+		StringOutputSink sink(output);
+		SerializeContent(node, sink, omitText, mutationCollection);
+	}
+
+	const size_t Serializer::EstimateSize(const Node* node, const NodeMutationCollection* mutationCollection)
+	{
+		const size_t elementCount = node->m_rootTreeMap->GetSubtreeEnd(node->m_indexWithinDocument) - node->m_indexWithinDocument;
+
+		return GetSourceExtent(node->m_node) + (elementCount * ElementGrowthEstimate) + GetActionsExtent(mutationCollection);
+	}
+
+	const size_t Serializer::EstimateSize(const GumboNode* node, const NodeMutationCollection* mutationCollection)
+	{
+		const size_t sourceExtent = GetSourceExtent(node);
+
+		return sourceExtent + (sourceExtent / 4) + GetActionsExtent(mutationCollection);
+	}
+
+	void Serializer::Serialize(const Node* node, OutputSink& sink, const NodeMutationCollection* mutationCollection)
+	{
+		WriteNode(node->m_node, node->m_indexWithinDocument, sink, mutationCollection);
+		sink.Flush();
+	}
+
+	void Serializer::Serialize(const GumboNode* node, OutputSink& sink, const NodeMutationCollection* mutationCollection)
+	{
+		WriteNode(node, GetFirstNodeIndex(node, false), sink, mutationCollection);
+		sink.Flush();
+	}
+
+	void Serializer::SerializeContent(const Node* node, OutputSink& sink, const bool omitText, const NodeMutationCollection* mutationCollection)
+	{
+		// Children are indexed right after their parent, so the first element within the node
+		// follows it.
+		WriteContent(node->m_node, node->m_indexWithinDocument + 1, sink, omitText, mutationCollection);
+		sink.Flush();
+	}
+
+	void Serializer::SerializeContent(const GumboNode* node, OutputSink& sink, const bool omitText, const NodeMutationCollection* mutationCollection)
+	{
+		WriteContent(node, GetFirstNodeIndex(node, true), sink, omitText, mutationCollection);
+		sink.Flush();
+	}
+
+	/// <summary>
+	/// The state of a node whose contents are being serialized.
+	/// </summary>
+	struct Serializer::Frame
+	{
+		/// <summary>
+		/// How the node itself is written.
+		/// </summary>
+		enum class Kind
+		{
+			/// <summary>
+			/// Only the contents of the node are written.
+			/// </summary>
+			Content,
+
+			/// <summary>
+			/// The node is written as an element, with its tags built from the parsed document.
+			/// </summary>
+			Element,
+
+			/// <summary>
+			/// The node is written by copying its source span, around its children.
+			/// </summary>
+			Source
+		};
+
+		Frame(const GumboNode* frameNode, const Kind frameKind, OutputSink& frameSink) :
+			node(frameNode),
+			kind(frameKind),
+			sink(&frameSink),
+			contentSink(&frameSink)
+		{
+
+		}
+
+		/// <summary>
+		/// The node being serialized.
+		/// </summary>
+		const GumboNode* node;
+
+		/// <summary>
+		/// How the node itself is written.
+		/// </summary>
+		Kind kind;
+
+		/// <summary>
+		/// The sink that the node is written to.
+		/// </summary>
+		OutputSink* sink;
+
+		/// <summary>
+		/// The sink that the contents of the node are written to. This differs from ::sink only
+		/// for specially handled tags, whose contents are trimmed.
+		/// </summary>
+		OutputSink* contentSink;
+
+		/// <summary>
+		/// The sink trimming the contents of specially handled tags, if any.
+		/// </summary>
+		std::unique_ptr<OutputSink> trimmingSink;
+
+		/// <summary>
+		/// The index of the next child to write.
+		/// </summary>
+		size_t nextChild = 0;
+
+		/// <summary>
+		/// Whether or not text children are left out.
+		/// </summary>
+		bool omitText = false;
+
+		/// <summary>
+		/// The tag name of an element, for its closing tag.
+		/// </summary>
+		std::string tagName;
+
+		/// <summary>
+		/// Whether or not an element is one of the SpecialHandling tags.
+		/// </summary>
+		bool needSpecialHandling = false;
+
+		/// <summary>
+		/// Whether or not an element is one of the EmptyTags.
+		/// </summary>
+		bool isEmptyTag = false;
+
+		/// <summary>
+		/// The first action declared on an element, for the HTML to insert after it.
+		/// </summary>
+		uint32_t firstAction = NodeMutationCollection::NoAction;
+
+		/// <summary>
+		/// The end of the source that has been copied so far, when copying from the source.
+		/// </summary>
+		const char* cursor = nullptr;
+
+		/// <summary>
+		/// The end of the source span of the node, when copying from the source.
+		/// </summary>
+		const char* end = nullptr;
+	};
+
+	/// <summary>
+	/// The state of the search for the nodes of the user collection, as the document is
+	/// serialized.
+	/// </summary>
+	struct Serializer::Mutations
+	{
+		/// <summary>
+		/// User defined collection of nodes that the user has requested to have control of the
+		/// serialization process for.
+		/// </summary>
+		const NodeMutationCollection* collection = nullptr;
+
+		/// <summary>
+		/// Whether or not the frozen table of the collection is walked alongside the document.
+		/// Otherwise, every element is looked up in the collection.
+		/// </summary>
+		bool ordered = false;
+
+		/// <summary>
+		/// The first node in the frozen table that hasn't been passed yet.
+		/// </summary>
+		const NodeMutationCollection::FrozenNode* next = nullptr;
+
+		/// <summary>
+		/// The end of the frozen table.
+		/// </summary>
+		const NodeMutationCollection::FrozenNode* last = nullptr;
+
+		/// <summary>
+		/// The index within the document of the next element to be looked up.
+		/// </summary>
+		size_t nodeIndex = 0;
+
+		/// <summary>
+		/// The end of the range of indices held by the subtree of the element last looked up.
+		/// </summary>
+		size_t subtreeEnd = 0;
+
+		/// <summary>
+		/// The output of elements that have already been serialized, when serializing in
+		/// parallel, or nullptr.
+		/// </summary>
+		const std::unordered_map<const GumboNode*, boost::string_ref>* written = nullptr;
+	};
+
+	const size_t Serializer::GetFirstNodeIndex(const GumboNode* node, const bool content)
+	{
+		// The root element is the only element within the document node, and is indexed first.
+		if (node->type == GUMBO_NODE_DOCUMENT)
+		{
+			return 0;
+		}
+
+		if (node->parent != nullptr && node->parent->type == GUMBO_NODE_DOCUMENT)
+		{
+			return content ? 1 : 0;
+		}
+
+		return UnknownNodeIndex;
+	}
+
+	void Serializer::WriteNode(const GumboNode* node, const size_t nodeIndex, OutputSink& sink, const NodeMutationCollection* mutationCollection)
+	{
+		Mutations mutations;
+		BeginMutations(mutations, node, nodeIndex, mutationCollection);
+
+		std::vector<Frame> stack;
+		BeginNode(node, sink, mutations, stack);
+		Run(stack, mutations);
+	}
+
+	void Serializer::WriteContent(const GumboNode* node, const size_t nodeIndex, OutputSink& sink, const bool omitText, const NodeMutationCollection* mutationCollection)
+	{
+		Mutations mutations;
+		BeginMutations(mutations, node, nodeIndex, mutationCollection);
+
+		std::vector<Frame> stack;
+		stack.emplace_back(node, Frame::Kind::Content, sink);
+		stack.back().omitText = omitText;
+		Run(stack, mutations);
+	}
+
+	const size_t Serializer::DefaultParallelSerializeThreshold = 8192;
+
+	std::string Serializer::SerializeParallel(const Node* node, const NodeMutationCollection* mutationCollection, const size_t serialThreshold, const size_t maxThreads)
+	{
+		std::string results;
+		results.reserve(EstimateSize(node, mutationCollection));
+
+		StringOutputSink sink(results);
+		SerializeParallel(node, sink, mutationCollection, serialThreshold, maxThreads);
+		return results;
+	}
+
+	void Serializer::SerializeParallel(const Node* node, OutputSink& sink, const NodeMutationCollection* mutationCollection, const size_t serialThreshold, const size_t maxThreads)
+	{
+		const TreeMap* treeMap = node->m_rootTreeMap;
+
+		auto getSubtreeSize = [treeMap](const Node* subtree) -> size_t
+		{
+			return treeMap->GetSubtreeEnd(subtree->m_indexWithinDocument) - subtree->m_indexWithinDocument;
+		};
+
+		const size_t nodeCount = getSubtreeSize(node);
+
+		size_t numThreads = maxThreads > 0 ? maxThreads : static_cast<size_t>(std::thread::hardware_concurrency());
+
+		if (nodeCount < serialThreshold || numThreads < 2 || !CanSplit(node, mutationCollection))
+		{
+			Serialize(node, sink, mutationCollection);
+			return;
+		}
+
+		// Split the node into subtrees, in document order, until none of them holds more than a
+		// small share of the elements, so that they can be divided evenly among the threads.
+		const size_t maxSubtreeSize = std::max<size_t>(nodeCount / (numThreads * 8), 1);
+
+		std::vector<const Node*> subtrees;
+		std::vector<const Node*> pending;
+
+		for (auto child = node->m_children.rbegin(); child != node->m_children.rend(); ++child)
+		{
+			pending.push_back(child->get());
+		}
+
+		while (!pending.empty())
+		{
+			const Node* current = pending.back();
+			pending.pop_back();
+
+			if (getSubtreeSize(current) > maxSubtreeSize && current->m_children.size() > 0 && CanSplit(current, mutationCollection))
+			{
+				for (auto child = current->m_children.rbegin(); child != current->m_children.rend(); ++child)
+				{
+					pending.push_back(child->get());
+				}
+
+				continue;
+			}
+
+			subtrees.push_back(current);
+		}
+
+		if (subtrees.size() < 2)
+		{
+			Serialize(node, sink, mutationCollection);
+			return;
+		}
+
+		numThreads = std::min(numThreads, subtrees.size());
+
+		// Divide the subtrees into contiguous ranges holding roughly equal numbers of elements.
+		size_t subtreesSize = 0;
+
+		for (const Node* subtree : subtrees)
+		{
+			subtreesSize += getSubtreeSize(subtree);
+		}
+
+		std::vector<size_t> rangeEnds;
+		rangeEnds.reserve(numThreads);
+
+		size_t rangesSize = 0;
+
+		for (size_t i = 0; i + 1 < subtrees.size() && rangeEnds.size() + 1 < numThreads; ++i)
+		{
+			rangesSize += getSubtreeSize(subtrees[i]);
+
+			if (rangesSize * numThreads >= subtreesSize * (rangeEnds.size() + 1))
+			{
+				rangeEnds.push_back(i + 1);
+			}
+		}
+
+		rangeEnds.push_back(subtrees.size());
+
+		// Each thread serializes one range of the subtrees into its own buffer, recording where
+		// the output of every subtree ends.
+		std::vector<size_t> outputEnds(subtrees.size());
+		std::vector<std::string> rangeOutputs(rangeEnds.size());
+
+		Util::ForEachRange(rangeEnds.size(), [&subtrees, &outputEnds, &rangeEnds, &rangeOutputs, mutationCollection](const size_t range) -> void
+		{
+			std::string& output = rangeOutputs[range];
+			StringOutputSink rangeSink(output);
+
+			for (size_t i = range > 0 ? rangeEnds[range - 1] : 0; i < rangeEnds[range]; ++i)
+			{
+				WriteNode(subtrees[i]->m_node, subtrees[i]->m_indexWithinDocument, rangeSink, mutationCollection);
+				outputEnds[i] = output.size();
+			}
+		});
+
+		std::unordered_map<const GumboNode*, boost::string_ref> written;
+		written.reserve(subtrees.size());
+
+		for (size_t r = 0, i = 0; r < rangeEnds.size(); ++r)
+		{
+			size_t offset = 0;
+
+			for (; i < rangeEnds[r]; ++i)
+			{
+				written.emplace(subtrees[i]->m_node, boost::string_ref(rangeOutputs[r].data() + offset, outputEnds[i] - offset));
+				offset = outputEnds[i];
+			}
+		}
+
+		// Write everything between the subtrees, with each subtree taken from the buffers as it
+		// comes along.
+		Mutations mutations;
+		BeginMutations(mutations, node->m_node, node->m_indexWithinDocument, mutationCollection);
+		mutations.written = &written;
+
+		std::vector<Frame> stack;
+		BeginNode(node->m_node, sink, mutations, stack);
+		Run(stack, mutations);
+
+		sink.Flush();
+	}
+
+	void Serializer::BeginMutations(Mutations& mutations, const GumboNode* node, const size_t nodeIndex, const NodeMutationCollection* mutationCollection)
+	{
+		mutations.collection = mutationCollection;
+
+		if (mutationCollection == nullptr || !mutationCollection->m_frozen)
+		{
+			return;
+		}
+
+		const auto& frozenNodes = mutationCollection->m_frozenNodes;
+
+		if (!frozenNodes.empty())
+		{
+			if (nodeIndex == UnknownNodeIndex)
+			{
+				return;
+			}
+
+			const GumboNode* document = node;
+
+			while (document->parent != nullptr)
+			{
+				document = document->parent;
+			}
+
+			if (document != mutationCollection->m_frozenDocument)
+			{
+				return;
+			}
+		}
+
+		mutations.ordered = true;
+		mutations.next = frozenNodes.data();
+		mutations.last = frozenNodes.data() + frozenNodes.size();
+		mutations.nodeIndex = nodeIndex;
+	}
+
+	void Serializer::FindMutations(Mutations& mutations, const GumboNode* node, bool& found, bool& foundWithin, uint32_t& firstAction)
+	{
+		found = false;
+		foundWithin = false;
+		firstAction = NodeMutationCollection::NoAction;
+
+		const NodeMutationCollection* mutationCollection = mutations.collection;
+
+		if (mutationCollection == nullptr)
+		{
+			return;
+		}
+
+		if (mutations.ordered)
+		{
+			// Once the table has been passed, nothing else can be found and the indices of the
+			// remaining elements no longer matter.
+			if (mutations.next == mutations.last)
+			{
+				return;
+			}
+
+			const TreeMap* treeMap = mutationCollection->m_frozenTreeMap;
+			const size_t index = mutations.nodeIndex;
+
+			if (index < treeMap->GetNodeCount())
+			{
+				while (mutations.next != mutations.last && mutations.next->index < index)
+				{
+					++mutations.next;
+				}
+
+				const NodeMutationCollection::FrozenNode* candidate = mutations.next;
+
+				if (candidate == mutations.last || candidate->index != index || candidate->node == node)
+				{
+					++mutations.nodeIndex;
+					mutations.subtreeEnd = treeMap->GetSubtreeEnd(index);
+
+					if (candidate != mutations.last && candidate->index == index)
+					{
+						found = true;
+						firstAction = candidate->firstAction;
+						++candidate;
+					}
+
+					foundWithin = candidate != mutations.last && candidate->index < mutations.subtreeEnd;
+					return;
+				}
+			}
+
+			// The document doesn't line up with the table, as it would if it had been parsed
+			// again since the collection was frozen. Look up every element from here on.
+			mutations.ordered = false;
+		}
+
+		found = mutationCollection->Contains(node);
+
+		if (found)
+		{
+			firstAction = mutationCollection->GetFirstAction(node);
+		}
+		else if (mutationCollection->m_sourcePassthrough)
+		{
+			foundWithin = mutationCollection->ContainsWithin(node);
+		}
+	}
+
+	const bool Serializer::CanSplit(const Node* node, const NodeMutationCollection* mutationCollection)
+	{
+		if (mutationCollection == nullptr)
+		{
+			return true;
+		}
+
+		if (mutationCollection->Contains(node->m_node))
+		{
+			return false;
+		}
+
+		return !mutationCollection->m_sourcePassthrough || mutationCollection->ContainsWithin(node->m_node);
+	}
+
+	void Serializer::SkipMutationsWithin(Mutations& mutations)
+	{
+		if (mutations.ordered && mutations.nodeIndex < mutations.subtreeEnd)
+		{
+			mutations.nodeIndex = mutations.subtreeEnd;
+		}
+	}
+
+	void Serializer::Run(std::vector<Frame>& stack, Mutations& mutations)
+	{
+		while (!stack.empty())
+		{
+			// Note that beginning a child element may push a frame, after which this reference
+			// is no longer valid.
+			Frame& frame = stack.back();
+
+			const GumboVector* children = &frame.node->v.element.children;
+
+			if (frame.nextChild >= children->length)
+			{
+				EndNode(frame, mutations.collection);
+				stack.pop_back();
+				continue;
+			}
+
+			const GumboNode* child = static_cast<const GumboNode*>(children->data[frame.nextChild++]);
+			OutputSink& sink = *frame.contentSink;
+
+			if (frame.kind == Frame::Kind::Source)
+			{
+				// The span of every child was verified before the frame was pushed. Copy the
+				// source leading up to the child, then the child itself.
+				boost::string_ref childSpan;
+				GetSourceSpan(child, childSpan);
+
+				sink.WriteReferenced(boost::string_ref(frame.cursor, childSpan.begin() - frame.cursor));
+				frame.cursor = childSpan.end();
+
+				if (child->type == GUMBO_NODE_ELEMENT || child->type == GUMBO_NODE_TEMPLATE)
+				{
+					BeginNode(child, sink, mutations, stack);
+				}
+				else
+				{
+					sink.WriteReferenced(childSpan);
+				}
+
+				continue;
+			}
+
+			switch (child->type)
+			{
+				case GUMBO_NODE_TEXT:
+				{
+					if (!frame.omitText) 
+					{
+						sink.WriteReferenced(boost::string_ref(child->v.text.original_text.data, child->v.text.original_text.length));
+					}					
+				}
+				break;
+
+				case GUMBO_NODE_ELEMENT:
+				case GUMBO_NODE_TEMPLATE:
+				{
+					BeginNode(child, sink, mutations, stack);
+				}
+				break;
 
-	Serializer::Serializer()
-	{
-	}
+				case GUMBO_NODE_WHITESPACE:
+				{
+					// keep all whitespace to keep as close to original as possible
+					sink.WriteReferenced(boost::string_ref(child->v.text.text));
+				}
+				break;
 
-	Serializer::~Serializer()
-	{
+				case GUMBO_NODE_COMMENT:
+				case GUMBO_NODE_CDATA:
+				{
+					sink.WriteReferenced(boost::string_ref(child->v.text.original_text.data, child->v.text.original_text.length));
+				}
+				break;
+			}
+		}
 	}
 
-	std::string Serializer::Serialize(const Node* node, const NodeMutationCollection* mutationCollection)
+	void Serializer::BeginNode(const GumboNode* node, OutputSink& sink, Mutations& mutations, std::vector<Frame>& stack)
 	{
-		return Serialize(node->m_node, mutationCollection);
-	}
-
-	std::string Serializer::Serialize(const GumboNode* node, const NodeMutationCollection* mutationCollection)
-	{		
 		// special case the document node
 		if (node->type == GUMBO_NODE_DOCUMENT)
 		{
-			std::string docResults = BuildDocType(node);
-			docResults.append(SerializeContent(node, false, mutationCollection));
-
-			return docResults;
+			WriteDocType(node, sink);
+			stack.emplace_back(node, Frame::Kind::Content, sink);
+			return;
 		}
 
-		std::string close;
-		std::string closeTag;
-		std::string atts;
-		std::string tagname;
+		const NodeMutationCollection* mutationCollection = mutations.collection;
+
+		// Elements that have already been serialized are written as they are.
+		if (mutations.written != nullptr)
+		{
+			const auto writtenNode = mutations.written->find(node);
+
+			if (writtenNode != mutations.written->end())
+			{
+				bool found = false;
+				bool foundWithin = false;
+				uint32_t firstAction = NodeMutationCollection::NoAction;
+
+				FindMutations(mutations, node, found, foundWithin, firstAction);
+				SkipMutationsWithin(mutations);
 
-		std::string tagOpeningText;
+				sink.Write(writtenNode->second);
+				return;
+			}
+		}
 
 		// Check to see if the supplied collection is valid and if the current node can be found in
 		// it.
 		bool foundNodeInUserCollection = false;
+		bool foundWithinNode = false;
+		uint32_t firstAction = NodeMutationCollection::NoAction;
+
+		FindMutations(mutations, node, foundNodeInUserCollection, foundWithinNode, firstAction);
+
+		// Elements that are not in the user collection may be copied from the source. Those
+		// containing no node in the collection are copied whole, others around their children.
+		if (mutationCollection && mutationCollection->m_sourcePassthrough && !foundNodeInUserCollection)
+		{
+			const bool untouched = !foundWithinNode;
+
+			if (untouched ? IsSubtreeFaithfulToSource(node) : IsFaithfulToSource(node))
+			{
+				boost::string_ref span;
+				GetSourceSpan(node, span);
+
+				if (untouched)
+				{
+					sink.WriteReferenced(span);
+					SkipMutationsWithin(mutations);
+					return;
+				}
+
+				stack.emplace_back(node, Frame::Kind::Source, sink);
+				stack.back().cursor = span.begin();
+				stack.back().end = span.end();
+				return;
+			}
+		}
+
+		// Actions declared on the node come before any callbacks.
+		const NodeMutationCollection::Action* replacedContent = nullptr;
+		bool removed = false;
+
+		for (uint32_t a = firstAction; a != NodeMutationCollection::NoAction; a = mutationCollection->m_actions[a].next)
+		{
+			const auto& action = mutationCollection->m_actions[a];
+
+			switch (action.type)
+			{
+				case NodeMutationCollection::ActionType::InsertBefore:
+				{
+					sink.Write(mutationCollection->GetActionValue(action));
+				}
+				break;
+
+				case NodeMutationCollection::ActionType::RemoveElement:
+				{
+					removed = true;
+				}
+				break;
+
+				case NodeMutationCollection::ActionType::ReplaceContent:
+				{
+					replacedContent = &action;
+				}
+				break;
+
+				default:
+				break;
+			}
+		}
 
-		if (mutationCollection && mutationCollection->Contains(node))
+		if (removed)
 		{
-			foundNodeInUserCollection = true;
+			WriteInsertedAfter(firstAction, sink, mutationCollection);
+			SkipMutationsWithin(mutations);
+			return;
 		}
 
 		if (foundNodeInUserCollection && mutationCollection->m_onTagStart)
@@ -103,27 +913,48 @@ namespace gq
 			auto result = mutationCollection->m_onTagStart(node->v.element.tag);
 
 			// If the user opted to not start building the tag, then the user doesn't want it.
-			// Return the empty string.
+			// Write nothing at all.
 			if (result == false)
 			{
-				return tagOpeningText;
+				WriteInsertedAfter(firstAction, sink, mutationCollection);
+				SkipMutationsWithin(mutations);
+				return;
 			}
 		}
 
-		tagname = GetTagName(node);
-		tagOpeningText.append(u8"<" + tagname);
+		std::string tagname = GetTagName(node);
 
 		boost::string_ref tagNameStrRef(tagname);
 
 		bool needSpecialHandling = (SpecialHandling.find(tagNameStrRef) != SpecialHandling.end());
 		bool isEmptyTag = (EmptyTags.find(tagNameStrRef) != EmptyTags.end());
 
-		// build attributes into a single string  
-		const GumboVector* attribs = &node->v.element.attributes;		
-		
+		sink.Write(u8"<");
+		sink.Write(tagNameStrRef);
+
+		// Attributes of nodes in the user collection are built by the user, into a string that
+		// is written once all of them have been handled.
+		const GumboVector* attribs = &node->v.element.attributes;
+		std::string atts;
+
 		for (size_t i = 0; i < attribs->length; ++i)
 		{
 			GumboAttribute* attribute = static_cast<GumboAttribute*>(attribs->data[i]);
+
+			if (firstAction != NodeMutationCollection::NoAction)
+			{
+				const auto* action = FindAttributeAction(firstAction, boost::string_ref(attribute->name), mutationCollection);
+
+				if (action != nullptr)
+				{
+					if (action->type == NodeMutationCollection::ActionType::SetAttribute)
+					{
+						WriteAttribute(*action, sink, mutationCollection);
+					}
+
+					continue;
+				}
+			}
 			
 			if (foundNodeInUserCollection && mutationCollection->m_onTagAttribute)
 			{
@@ -148,129 +979,370 @@ namespace gq
 				continue;
 			}
 			
-			atts.append(BuildAttributes(attribute));
+			WriteAttribute(attribute, sink);
+		}
+
+		sink.Write(atts);
+
+		// Attributes set on the node that it doesn't already have follow all others.
+		for (uint32_t a = firstAction; a != NodeMutationCollection::NoAction; a = mutationCollection->m_actions[a].next)
+		{
+			const auto& action = mutationCollection->m_actions[a];
+
+			if (action.type != NodeMutationCollection::ActionType::SetAttribute ||
+				FindAttributeAction(firstAction, mutationCollection->GetActionName(action), mutationCollection) != &action)
+			{
+				continue;
+			}
+
+			bool present = false;
+
+			for (size_t i = 0; !present && i < attribs->length; ++i)
+			{
+				const GumboAttribute* attribute = static_cast<const GumboAttribute*>(attribs->data[i]);
+				present = StringKernels::EqualsIgnoreCase(boost::string_ref(attribute->name), mutationCollection->GetActionName(action));
+			}
+
+			if (!present)
+			{
+				WriteAttribute(action, sink, mutationCollection);
+			}
 		}
 
 		// determine closing tag type
-		if (isEmptyTag) {
-			close = u8"/";
+		sink.Write(isEmptyTag ? u8"/>" : u8">");
+
+		if (needSpecialHandling)
+		{
+			sink.Write(u8"\n");
 		}
-		else
+
+		stack.emplace_back(node, Frame::Kind::Element, sink);
+		Frame& frame = stack.back();
+		frame.tagName = std::move(tagname);
+		frame.needSpecialHandling = needSpecialHandling;
+		frame.isEmptyTag = isEmptyTag;
+		frame.firstAction = firstAction;
+
+		// The contents of specially handled tags have all leading and trailing whitespace
+		// trimmed away, which is done as they are written.
+		if (needSpecialHandling)
 		{
-			closeTag = u8"</" + tagname + u8">";
+			frame.trimmingSink.reset(new TrimmingOutputSink(sink));
+			frame.contentSink = frame.trimmingSink.get();
 		}
 
 		// serialize your contents
-		std::string contents;
-		
-		if (foundNodeInUserCollection && mutationCollection->m_onTagContent)
+		if (replacedContent != nullptr)
+		{
+			frame.contentSink->Write(mutationCollection->GetActionValue(*replacedContent));
+			frame.nextChild = node->v.element.children.length;
+			SkipMutationsWithin(mutations);
+		}
+		else if (foundNodeInUserCollection && mutationCollection->m_onTagContent)
 		{
+			std::string contents;
 			auto result = mutationCollection->m_onTagContent(node->v.element.tag, contents);
 
 			if (contents.size() > 0)
 			{
+				frame.contentSink->Write(contents);
+
 				if (result == true)
 				{
 					// The supplied user content should replace text nodes in the content, if any.
 					// Everything else should be appended normally.
-					contents.append(SerializeContent(node, true, mutationCollection));
+					frame.omitText = true;
 				}
 				else if (result == false)
 				{
 					// Only the user data is to be appended as the contents of this node. That means
-					// we don't need to call SerializeContent at all.
-				}
+					// no children are to be written at all.
+					frame.nextChild = node->v.element.children.length;
+					SkipMutationsWithin(mutations);
+				}					
 			}
-			else 
-			{
-				// The user returned nothing, so as promised, serialize normally.
-				contents = SerializeContent(node, false, mutationCollection);
-			}					
+
+			// Otherwise the user returned nothing, so as promised, serialize normally.
 		}
-		else
+	}
+
+	void Serializer::EndNode(Frame& frame, const NodeMutationCollection* mutationCollection)
+	{
+		switch (frame.kind)
 		{
-			contents = SerializeContent(node, false, mutationCollection);
-		}		
+			case Frame::Kind::Content:
+			break;
 
-		if (needSpecialHandling) {
-			boost::trim(contents);
-			contents.append(u8"\n");
-		}
+			case Frame::Kind::Source:
+			{
+				frame.sink->WriteReferenced(boost::string_ref(frame.cursor, frame.end - frame.cursor));
+			}
+			break;
 
-		// build results
-		std::string results;
+			case Frame::Kind::Element:
+			{
+				OutputSink& sink = *frame.sink;
 
-		results.append(tagOpeningText + atts + close + u8">");
+				if (frame.needSpecialHandling)
+				{
+					sink.Write(u8"\n");
+				}
 
-		if (needSpecialHandling)
-		{
-			results.append(u8"\n");
+				if (!frame.isEmptyTag)
+				{
+					sink.Write(u8"</");
+					sink.Write(frame.tagName);
+					sink.Write(u8">");
+				}
+
+				if (frame.needSpecialHandling)
+				{
+					sink.Write(u8"\n");
+				}
+
+				WriteInsertedAfter(frame.firstAction, sink, mutationCollection);
+			}
+			break;
 		}
+	}
 
-		results.append(contents);
-		results.append(closeTag);
+	const NodeMutationCollection::Action* Serializer::FindAttributeAction(const uint32_t firstAction, boost::string_ref attributeName, const NodeMutationCollection* mutationCollection)
+	{
+		const NodeMutationCollection::Action* found = nullptr;
 
-		if (needSpecialHandling)
+		for (uint32_t a = firstAction; a != NodeMutationCollection::NoAction; a = mutationCollection->m_actions[a].next)
 		{
-			results.append(u8"\n");
+			const auto& action = mutationCollection->m_actions[a];
+
+			if ((action.type == NodeMutationCollection::ActionType::RemoveAttribute || action.type == NodeMutationCollection::ActionType::SetAttribute) &&
+				StringKernels::EqualsIgnoreCase(mutationCollection->GetActionName(action), attributeName))
+			{
+				found = &action;
+			}
 		}
 
-		return results;
+		return found;
 	}
 
-	std::string Serializer::SerializeContent(const Node* node, const bool omitText, const NodeMutationCollection* mutationCollection)
+	void Serializer::WriteInsertedAfter(const uint32_t firstAction, OutputSink& sink, const NodeMutationCollection* mutationCollection)
 	{
-		return SerializeContent(node->m_node, omitText, mutationCollection);
+		for (uint32_t a = firstAction; a != NodeMutationCollection::NoAction; a = mutationCollection->m_actions[a].next)
+		{
+			const auto& action = mutationCollection->m_actions[a];
+
+			if (action.type == NodeMutationCollection::ActionType::InsertAfter)
+			{
+				sink.Write(mutationCollection->GetActionValue(action));
+			}
+		}
 	}
 
-	std::string Serializer::SerializeContent(const GumboNode* node, const bool omitText, const NodeMutationCollection* mutationCollection)
+	const bool Serializer::GetSourceSpan(const GumboNode* node, boost::string_ref& span)
 	{
-		std::string tagNameStr = GetTagName(node);
-		boost::string_ref tagNameStrRef(tagNameStr);
-		std::string contents;
+		switch (node->type)
+		{
+			case GUMBO_NODE_ELEMENT:
+			case GUMBO_NODE_TEMPLATE:
+			{
+				const GumboElement& element = node->v.element;
+
+				// Elements implied by the parser have no start tag in the source.
+				if (element.original_tag.length == 0)
+				{
+					return false;
+				}
+
+				const char* start = element.original_tag.data;
+				const char* end = start + element.original_tag.length;
+
+				if (element.original_end_tag.length > 0)
+				{
+					// Elements closed implicitly are given the end tag that closed them, which
+					// needn't be their own.
+					GumboStringPiece startName = element.original_tag;
+					GumboStringPiece endName = element.original_end_tag;
+					gumbo_tag_from_original_text(&startName);
+					gumbo_tag_from_original_text(&endName);
+
+					if (element.original_end_tag.data < end ||
+						!StringKernels::EqualsIgnoreCase(boost::string_ref(startName.data, startName.length), boost::string_ref(endName.data, endName.length)))
+					{
+						return false;
+					}
+
+					end = element.original_end_tag.data + element.original_end_tag.length;
+				}
+				else if (element.children.length > 0 || EmptyTags.find(boost::string_ref(gumbo_normalized_tagname(element.tag))) == EmptyTags.end())
+				{
+					return false;
+				}
+
+				span = boost::string_ref(start, end - start);
+				return true;
+			}
+
+			case GUMBO_NODE_TEXT:
+			case GUMBO_NODE_WHITESPACE:
+			case GUMBO_NODE_COMMENT:
+			case GUMBO_NODE_CDATA:
+			{
+				if (node->v.text.original_text.length == 0)
+				{
+					return false;
+				}
+
+				span = boost::string_ref(node->v.text.original_text.data, node->v.text.original_text.length);
+				return true;
+			}
+
+			default:
+				return false;
+		}
+	}
+
+	const bool Serializer::IsFaithfulToSource(const GumboNode* node)
+	{
+		boost::string_ref span;
+
+		if (!GetSourceSpan(node, span))
+		{
+			return false;
+		}
+
+		const char* cursor = node->v.element.original_tag.data + node->v.element.original_tag.length;
+		const char* end = span.end() - node->v.element.original_end_tag.length;
 
-		// build up result for each child, recursively if need be
 		const GumboVector* children = &node->v.element.children;
 
 		for (size_t i = 0; i < children->length; ++i)
 		{
-			GumboNode* child = static_cast<GumboNode*> (children->data[i]);
+			const GumboNode* child = static_cast<const GumboNode*>(children->data[i]);
 
-			switch (child->type)
+			// Children moved about by the parser are out of place in the source.
+			boost::string_ref childSpan;
+
+			if (!GetSourceSpan(child, childSpan) || childSpan.begin() < cursor || childSpan.end() > end)
 			{
-				case GUMBO_NODE_TEXT:
-				{
-					if (!omitText) 
-					{
-						contents.append(std::string(child->v.text.original_text.data, child->v.text.original_text.length));
-					}					
-				}
-				break;
+				return false;
+			}
 
-				case GUMBO_NODE_ELEMENT:
-				case GUMBO_NODE_TEMPLATE:
+			cursor = childSpan.end();
+		}
+
+		return true;
+	}
+
+	const bool Serializer::IsSubtreeFaithfulToSource(const GumboNode* node)
+	{
+		// Visit every element in the subtree in document order, by way of parent pointers rather
+		// than recursion.
+		const GumboNode* current = node;
+
+		while (true)
+		{
+			if (!IsFaithfulToSource(current))
+			{
+				return false;
+			}
+
+			const GumboNode* next = GetElementChild(current, 0);
+
+			while (next == nullptr)
+			{
+				if (current == node)
 				{
-					contents.append(Serialize(child, mutationCollection));
+					return true;
 				}
-				break;
 
-				case GUMBO_NODE_WHITESPACE:
+				next = GetElementChild(current->parent, current->index_within_parent + 1);
+				current = current->parent;
+			}
+
+			current = next;
+		}
+	}
+
+	const size_t Serializer::GetSourceExtent(const GumboNode* node)
+	{
+		switch (node->type)
+		{
+			case GUMBO_NODE_DOCUMENT:
+			{
+				const GumboDocument& document = node->v.document;
+
+				// The DOCTYPE declaration is built rather than copied, and is given room for
+				// everything ::WriteDocType(...) may write.
+				size_t extent = 0;
+
+				if (document.has_doctype)
 				{
-					// keep all whitespace to keep as close to original as possible
-					contents.append(std::string(child->v.text.text));
+					extent += std::strlen(u8"<!DOCTYPE  PUBLIC \"\" \"\">\n");
+					extent += document.name != nullptr ? std::strlen(document.name) : 0;
+					extent += document.public_identifier != nullptr ? std::strlen(document.public_identifier) : 0;
+					extent += document.system_identifier != nullptr ? std::strlen(document.system_identifier) : 0;
 				}
-				break;
 
-				case GUMBO_NODE_COMMENT:
-				case GUMBO_NODE_CDATA:
+				for (size_t i = 0; i < document.children.length; ++i)
 				{
-					contents.append(std::string(child->v.text.original_text.data, child->v.text.original_text.length));
+					extent += GetSourceExtent(static_cast<const GumboNode*>(document.children.data[i]));
 				}
-				break;
+
+				return extent;
+			}
+
+			case GUMBO_NODE_ELEMENT:
+			case GUMBO_NODE_TEMPLATE:
+			{
+				const GumboElement& element = node->v.element;
+
+				// Elements implied by the parser still span everything parsed within them.
+				const size_t start = element.start_pos.offset;
+				const size_t end = element.end_pos.offset + element.original_end_tag.length;
+
+				return end > start ? end - start : 0;
+			}
+
+			case GUMBO_NODE_TEXT:
+			case GUMBO_NODE_WHITESPACE:
+			case GUMBO_NODE_COMMENT:
+			case GUMBO_NODE_CDATA:
+			{
+				return node->v.text.original_text.length;
 			}
+
+			default:
+				return 0;
 		}
+	}
 
-		return contents;
+	const size_t Serializer::GetActionsExtent(const NodeMutationCollection* mutationCollection)
+	{
+		if (mutationCollection == nullptr)
+		{
+			return 0;
+		}
+
+		// Every string declared by an action is written at most once, set attributes along with
+		// a space, an equals sign and two quotes.
+		return mutationCollection->m_actionStrings.size() + (mutationCollection->m_actions.size() * 4);
+	}
+
+	const GumboNode* Serializer::GetElementChild(const GumboNode* node, const size_t first)
+	{
+		const GumboVector* children = &node->v.element.children;
+
+		for (size_t i = first; i < children->length; ++i)
+		{
+			const GumboNode* child = static_cast<const GumboNode*>(children->data[i]);
+
+			if (child->type == GUMBO_NODE_ELEMENT || child->type == GUMBO_NODE_TEMPLATE)
+			{
+				return child;
+			}
+		}
+
+		return nullptr;
 	}
 
 	std::string Serializer::GetTagName(const GumboNode* node)
@@ -279,14 +1351,12 @@ namespace gq
 		return Util::GetNodeTagName(node);
 	}
 
-	std::string Serializer::BuildDocType(const GumboNode* node)
+	void Serializer::WriteDocType(const GumboNode* node, OutputSink& sink)
 	{
-		std::string results;
-
 		if (node->v.document.has_doctype)
 		{
-			results.append(u8"<!DOCTYPE ");
-			results.append(node->v.document.name);
+			sink.Write(u8"<!DOCTYPE ");
+			sink.Write(node->v.document.name);
 
 			if (node->v.document.public_identifier != nullptr)
 			{
@@ -294,35 +1364,54 @@ namespace gq
 
 				if (!pi.empty())
 				{
-					results.append(u8" PUBLIC \"");
-					results.append(node->v.document.public_identifier);
-					results.append(u8"\" \"");
-					results.append(node->v.document.system_identifier);
-					results.append(u8"\"");
+					sink.Write(u8" PUBLIC \"");
+					sink.Write(pi);
+					sink.Write(u8"\" \"");
+					sink.Write(node->v.document.system_identifier);
+					sink.Write(u8"\"");
 				}
 			}
 
-			results.append(u8">\n");
+			sink.Write(u8">\n");
 		}
-
-		return results;
 	}
 
-	std::string Serializer::BuildAttributes(const GumboAttribute* at)
+	void Serializer::WriteAttribute(const GumboAttribute* at, OutputSink& sink)
 	{
-		std::string atts(u8" ");
-		atts.append(at->original_name.data, at->original_name.length);
+		sink.Write(u8" ");
+		sink.WriteReferenced(boost::string_ref(at->original_name.data, at->original_name.length));
 
 		boost::string_ref attValue(at->original_value.data, at->original_value.length);		
 
 		if (!attValue.empty())
 		{
-			atts.append(u8"=");
+			sink.Write(u8"=");
+			sink.WriteReferenced(attValue);
+		}
+	}
+
+	void Serializer::WriteAttribute(const NodeMutationCollection::Action& action, OutputSink& sink, const NodeMutationCollection* mutationCollection)
+	{
+		sink.Write(u8" ");
+		sink.Write(mutationCollection->GetActionName(action));
+		sink.Write(u8"=\"");
 
-			atts.append(attValue.to_string());
+		// Escape the value as it's written.
+		boost::string_ref value = mutationCollection->GetActionValue(action);
+		size_t written = 0;
+
+		for (size_t i = 0; i < value.size(); ++i)
+		{
+			if (value[i] == '"' || value[i] == '&')
+			{
+				sink.Write(value.substr(written, i - written));
+				sink.Write(value[i] == '"' ? u8"&quot;" : u8"&amp;");
+				written = i + 1;
+			}
 		}
 
-		return atts;
+		sink.Write(value.substr(written));
+		sink.Write(u8"\"");
 	}
 
 } /* namespace gq */
@@ -20,10 +20,13 @@
 
 #pragma once
 
+#include <limits>
 #include <unordered_set>
+#include <vector>
 #include <gumbo.h>
 #include "StrRefHash.hpp"
 #include "NodeMutationCollection.hpp"
+#include "OutputSink.hpp"
 
 namespace gq
 {
@@ -35,6 +38,20 @@ namespace gq
 	/// string. Two methods are exposed, one will serialize the node and its contents, the other
 	/// will serialze only the contents of the node. This can be used behind the scenes on jquery
 	/// like methods such as .Html() and .InnerHtml().
+	/// <para>&#160;</para>
+	/// Each method can also write its output to an OutputSink as it's produced, rather than
+	/// returning a string. The whole document is then written in a single pass, with every byte
+	/// copied to the sink once. The overloads returning a string simply write to a
+	/// StringOutputSink.
+	/// <para>&#160;</para>
+	/// When a NodeMutationCollection with source passthrough enabled is supplied, every part of
+	/// the document that the collection leaves untouched is copied from the original source,
+	/// rather than being built again from the parsed document. See
+	/// NodeMutationCollection::SetSourcePassthrough(const bool).
+	/// <para>&#160;</para>
+	/// When the supplied NodeMutationCollection is frozen, its nodes are found by walking its
+	/// table alongside the document, and subtrees holding none of them are told apart by their
+	/// indices. See NodeMutationCollection::Freeze().
 	/// </summary>
 	class Serializer
 	{
@@ -99,6 +116,232 @@ namespace gq
 		/// </returns>
 		static std::string SerializeContent(const GumboNode* node, const bool omitText = false, const NodeMutationCollection* mutationCollection = nullptr);
 
+		/// <summary>
+		/// Writes the supplied node and all of its contents, as HTML, to the supplied sink. The
+		/// sink is flushed once everything has been written.
+		/// </summary>
+		/// <param name="node">
+		/// The node to serialize along with all of its contents. 
+		/// </param>
+		/// <param name="sink">
+		/// The sink to write the HTML to.
+		/// </param>
+		/// <param name="mutationCollection">
+		/// User defined collection of nodes that the user has requested to have control of the
+		/// serialization process for.
+		/// </param>
+		static void Serialize(const Node* node, OutputSink& sink, const NodeMutationCollection* mutationCollection = nullptr);
+
+		/// <summary>
+		/// Writes the supplied node and all of its contents, as HTML, to the supplied sink. The
+		/// sink is flushed once everything has been written.
+		/// </summary>
+		/// <param name="node">
+		/// The node to serialize along with all of its contents. 
+		/// </param>
+		/// <param name="sink">
+		/// The sink to write the HTML to.
+		/// </param>
+		static void Serialize(const GumboNode* node, OutputSink& sink, const NodeMutationCollection* mutationCollection = nullptr);
+
+		/// <summary>
+		/// Writes the contents of the supplied node, as HTML, to the supplied sink, without the
+		/// HTML of the node itself. The sink is flushed once everything has been written.
+		/// </summary>
+		/// <param name="node">
+		/// The node containing the contents to serialize.
+		/// </param>
+		/// <param name="sink">
+		/// The sink to write the HTML to.
+		/// </param>
+		/// <param name="mutationCollection">
+		/// User defined collection of nodes that the user has requested to have control of the
+		/// serialization process for.
+		/// </param>
+		static void SerializeContent(const Node* node, OutputSink& sink, const bool omitText = false, const NodeMutationCollection* mutationCollection = nullptr);
+
+		/// <summary>
+		/// Writes the contents of the supplied node, as HTML, to the supplied sink, without the
+		/// HTML of the node itself. The sink is flushed once everything has been written.
+		/// </summary>
+		/// <param name="node">
+		/// The node containing the contents to serialize.
+		/// </param>
+		/// <param name="sink">
+		/// The sink to write the HTML to.
+		/// </param>
+		static void SerializeContent(const GumboNode* node, OutputSink& sink, const bool omitText = false, const NodeMutationCollection* mutationCollection = nullptr);
+
+		/// <summary>
+		/// Converts the supplied node and all of its contents back into an HTML string, replacing
+		/// the contents of the supplied string. The string is reserved up front to the size
+		/// estimated by ::EstimateSize(const Node*, const NodeMutationCollection*), so a string
+		/// reused for every serialization stops allocating once it has grown large enough.
+		/// </summary>
+		/// <param name="node">
+		/// The node to serialize along with all of its contents. 
+		/// </param>
+		/// <param name="output">
+		/// The string to write the HTML to.
+		/// </param>
+		/// <param name="mutationCollection">
+		/// User defined collection of nodes that the user has requested to have control of the
+		/// serialization process for.
+		/// </param>
+		static void Serialize(const Node* node, std::string& output, const NodeMutationCollection* mutationCollection = nullptr);
+
+		/// <summary>
+		/// Converts the supplied node and all of its contents back into an HTML string, replacing
+		/// the contents of the supplied string. See ::Serialize(const Node*, std::string&, const
+		/// NodeMutationCollection*).
+		/// </summary>
+		/// <param name="node">
+		/// The node to serialize along with all of its contents. 
+		/// </param>
+		/// <param name="output">
+		/// The string to write the HTML to.
+		/// </param>
+		/// <param name="mutationCollection">
+		/// User defined collection of nodes that the user has requested to have control of the
+		/// serialization process for.
+		/// </param>
+		static void Serialize(const GumboNode* node, std::string& output, const NodeMutationCollection* mutationCollection = nullptr);
+
+		/// <summary>
+		/// Converts the contents of the supplied node back into an HTML string, replacing the
+		/// contents of the supplied string. See ::Serialize(const Node*, std::string&, const
+		/// NodeMutationCollection*).
+		/// </summary>
+		/// <param name="node">
+		/// The node containing the contents to serialize.
+		/// </param>
+		/// <param name="output">
+		/// The string to write the HTML to.
+		/// </param>
+		/// <param name="mutationCollection">
+		/// User defined collection of nodes that the user has requested to have control of the
+		/// serialization process for.
+		/// </param>
+		static void SerializeContent(const Node* node, std::string& output, const bool omitText = false, const NodeMutationCollection* mutationCollection = nullptr);
+
+		/// <summary>
+		/// Converts the contents of the supplied node back into an HTML string, replacing the
+		/// contents of the supplied string. See ::Serialize(const Node*, std::string&, const
+		/// NodeMutationCollection*).
+		/// </summary>
+		/// <param name="node">
+		/// The node containing the contents to serialize.
+		/// </param>
+		/// <param name="output">
+		/// The string to write the HTML to.
+		/// </param>
+		/// <param name="mutationCollection">
+		/// User defined collection of nodes that the user has requested to have control of the
+		/// serialization process for.
+		/// </param>
+		static void SerializeContent(const GumboNode* node, std::string& output, const bool omitText = false, const NodeMutationCollection* mutationCollection = nullptr);
+
+		/// <summary>
+		/// Estimates the size of the HTML that serializing the supplied node would produce. The
+		/// estimate is the extent of the node in the original source, plus an allowance for every
+		/// element within it to grow as it's normalized, plus the size of every string declared
+		/// by actions in the supplied collection. This is meant to be an upper bound, though
+		/// documents whose elements grow a great deal when normalized, and content supplied by
+		/// callbacks, can exceed it.
+		/// </summary>
+		/// <param name="node">
+		/// The node to be serialized.
+		/// </param>
+		/// <param name="mutationCollection">
+		/// The collection that the node is to be serialized with.
+		/// </param>
+		/// <returns>
+		/// The estimated size of the HTML, in bytes.
+		/// </returns>
+		static const size_t EstimateSize(const Node* node, const NodeMutationCollection* mutationCollection = nullptr);
+
+		/// <summary>
+		/// Estimates the size of the HTML that serializing the supplied node would produce. The
+		/// number of elements within the node isn't known, so the allowance for growth is made in
+		/// proportion to the extent of the node instead. See ::EstimateSize(const Node*, const
+		/// NodeMutationCollection*).
+		/// </summary>
+		/// <param name="node">
+		/// The node to be serialized.
+		/// </param>
+		/// <param name="mutationCollection">
+		/// The collection that the node is to be serialized with.
+		/// </param>
+		/// <returns>
+		/// The estimated size of the HTML, in bytes.
+		/// </returns>
+		static const size_t EstimateSize(const GumboNode* node, const NodeMutationCollection* mutationCollection = nullptr);
+
+		/// <summary>
+		/// The default minimum number of elements that a node must hold before
+		/// ::SerializeParallel(...) will spread serialization across multiple threads.
+		/// </summary>
+		static const size_t DefaultParallelSerializeThreshold;
+
+		/// <summary>
+		/// Converts the supplied node and all of its contents back into an HTML string,
+		/// serializing in parallel. See ::SerializeParallel(const Node*, OutputSink&, const
+		/// NodeMutationCollection*, const size_t, const size_t).
+		/// </summary>
+		/// <param name="node">
+		/// The node to serialize along with all of its contents. 
+		/// </param>
+		/// <param name="mutationCollection">
+		/// User defined collection of nodes that the user has requested to have control of the
+		/// serialization process for.
+		/// </param>
+		/// <param name="serialThreshold">
+		/// The minimum number of elements required before serialization is done in parallel.
+		/// </param>
+		/// <param name="maxThreads">
+		/// The maximum number of threads to serialize with. When zero, the number of hardware
+		/// threads available is used.
+		/// </param>
+		/// <returns>
+		/// The HTML of the node, identical to that returned by ::Serialize(const Node*, const
+		/// NodeMutationCollection*).
+		/// </returns>
+		static std::string SerializeParallel(const Node* node, const NodeMutationCollection* mutationCollection = nullptr, const size_t serialThreshold = DefaultParallelSerializeThreshold, const size_t maxThreads = 0);
+
+		/// <summary>
+		/// Writes the supplied node and all of its contents, as HTML, to the supplied sink,
+		/// serializing in parallel. The node is split into subtrees of roughly equal numbers of
+		/// elements, the subtrees are divided into contiguous ranges, and each range is
+		/// serialized on its own thread into its own buffer. What lies between the subtrees is
+		/// then written on the calling thread, along with the buffers in document order. The
+		/// output is identical to that of ::Serialize(const Node*, OutputSink&, const
+		/// NodeMutationCollection*).
+		/// <para>&#160;</para>
+		/// Subtrees are never split at nodes in the supplied collection. The callbacks of the
+		/// collection may however be invoked from several threads at once, and must be safe to
+		/// invoke concurrently. When the node holds fewer elements than the supplied threshold,
+		/// the cost of starting threads outweighs the benefit, so the node is serialized on the
+		/// calling thread.
+		/// </summary>
+		/// <param name="node">
+		/// The node to serialize along with all of its contents. 
+		/// </param>
+		/// <param name="sink">
+		/// The sink to write the HTML to.
+		/// </param>
+		/// <param name="mutationCollection">
+		/// User defined collection of nodes that the user has requested to have control of the
+		/// serialization process for.
+		/// </param>
+		/// <param name="serialThreshold">
+		/// The minimum number of elements required before serialization is done in parallel.
+		/// </param>
+		/// <param name="maxThreads">
+		/// The maximum number of threads to serialize with. When zero, the number of hardware
+		/// threads available is used.
+		/// </param>
+		static void SerializeParallel(const Node* node, OutputSink& sink, const NodeMutationCollection* mutationCollection = nullptr, const size_t serialThreshold = DefaultParallelSerializeThreshold, const size_t maxThreads = 0);
+
 	private:
 
 		Serializer();
@@ -114,6 +357,37 @@ namespace gq
 		/// </summary>
 		static const std::unordered_set<boost::string_ref, StringRefHash> SpecialHandling;
 
+		/// <summary>
+		/// The number of bytes that every element is allowed to grow by when normalized, when
+		/// estimating the size of serialized HTML. This covers end tags that the source left
+		/// implied, quotes added around attribute values and the like.
+		/// </summary>
+		static constexpr size_t ElementGrowthEstimate = 8;
+
+		/// <summary>
+		/// Gets the number of bytes of the original source that the supplied node was parsed
+		/// from, including implied elements and the DOCTYPE declaration of the document node.
+		/// </summary>
+		/// <param name="node">
+		/// The node to get the extent of.
+		/// </param>
+		/// <returns>
+		/// The extent of the node in the source, in bytes.
+		/// </returns>
+		static const size_t GetSourceExtent(const GumboNode* node);
+
+		/// <summary>
+		/// Gets the number of bytes that the actions declared in the supplied collection may add
+		/// to serialized HTML.
+		/// </summary>
+		/// <param name="mutationCollection">
+		/// The collection holding the actions, or nullptr.
+		/// </param>
+		/// <returns>
+		/// The number of bytes the actions may add.
+		/// </returns>
+		static const size_t GetActionsExtent(const NodeMutationCollection* mutationCollection);
+
 		/// <summary>
 		/// Gets a string representation of the tag name for the supplied node. 
 		/// </summary>
@@ -126,30 +400,292 @@ namespace gq
 		static std::string GetTagName(const GumboNode* node);
 
 		/// <summary>
-		/// Builds a correct string DOCTYPE declaration for the supplied node. 
+		/// Writes a correct DOCTYPE declaration for the supplied node. 
 		/// </summary>
 		/// <param name="node">
-		/// The document node from which to build the DOCTYPE declaration string. 
+		/// The document node from which to build the DOCTYPE declaration. 
+		/// </param>
+		/// <param name="sink">
+		/// The sink to write the declaration to.
+		/// </param>
+		static void WriteDocType(const GumboNode* node, OutputSink& sink);
+
+		/// <summary>
+		/// Writes the supplied attribute, preceeded by a space. 
+		/// </summary>
+		/// <param name="at">
+		/// The attribute to serialize. 
+		/// </param>
+		/// <param name="sink">
+		/// The sink to write the attribute to.
+		/// </param>
+		static void WriteAttribute(const GumboAttribute* at, OutputSink& sink);
+
+		/// <summary>
+		/// Writes the attribute set by the supplied action, preceeded by a space.
+		/// </summary>
+		/// <param name="action">
+		/// The action setting the attribute.
+		/// </param>
+		/// <param name="sink">
+		/// The sink to write the attribute to.
+		/// </param>
+		/// <param name="mutationCollection">
+		/// The collection holding the action.
+		/// </param>
+		static void WriteAttribute(const NodeMutationCollection::Action& action, OutputSink& sink, const NodeMutationCollection* mutationCollection);
+
+		/// <summary>
+		/// Gets the span of the original source that the supplied node was parsed from. Elements
+		/// only have such a span when both their start tag and matching end tag are present in
+		/// the source, or when they are empty tags without either an end tag or content.
+		/// </summary>
+		/// <param name="node">
+		/// The node to get the source span of.
+		/// </param>
+		/// <param name="span">
+		/// The span of the source that the node was parsed from.
 		/// </param>
 		/// <returns>
-		/// A string DOCTYPE declaration for the supplied document node. 
+		/// True if the node has a source span, false otherwise.
 		/// </returns>
-		static std::string BuildDocType(const GumboNode* node);
+		static const bool GetSourceSpan(const GumboNode* node, boost::string_ref& span);
 
 		/// <summary>
-		/// Builds a string representation of the attributes supplied. 
+		/// Checks if the supplied element is faithful to its source span. That is, the element has
+		/// a source span, and each of its children has a source span that follows the span of the
+		/// previous child, all within the content of the element. Copying the source of such an
+		/// element, around its children, reproduces the element and its children as they were
+		/// parsed.
 		/// </summary>
-		/// <param name="at">
-		/// The attributes to serialize. 
+		/// <param name="node">
+		/// The element to check.
+		/// </param>
+		/// <returns>
+		/// True if the element is faithful to its source span, false otherwise.
+		/// </returns>
+		static const bool IsFaithfulToSource(const GumboNode* node);
+
+		/// <summary>
+		/// Checks if the supplied element, and every element within it, is faithful to its source
+		/// span, in which case copying the source span of the element reproduces the entire
+		/// subtree. See ::IsFaithfulToSource(const GumboNode*).
+		/// </summary>
+		/// <param name="node">
+		/// The element to check.
+		/// </param>
+		/// <returns>
+		/// True if the subtree is faithful to its source span, false otherwise.
+		/// </returns>
+		static const bool IsSubtreeFaithfulToSource(const GumboNode* node);
+
+		/// <summary>
+		/// Gets the first child of the supplied node, at or after the supplied index, that is an
+		/// element.
+		/// </summary>
+		/// <param name="node">
+		/// The node whose children to search.
+		/// </param>
+		/// <param name="first">
+		/// The index of the first child to consider.
+		/// </param>
+		/// <returns>
+		/// The child element, or nullptr if there is none.
+		/// </returns>
+		static const GumboNode* GetElementChild(const GumboNode* node, const size_t first);
+
+		/// <summary>
+		/// The state of a node whose contents are being serialized. Serialization keeps these on
+		/// an explicit stack rather than recursing, so that the depth of a document is limited
+		/// only by memory.
+		/// </summary>
+		struct Frame;
+
+		/// <summary>
+		/// The state of the search for the nodes of the user collection, as the document is
+		/// serialized.
+		/// </summary>
+		struct Mutations;
+
+		/// <summary>
+		/// Stands in for the index within the document of the first element to be serialized,
+		/// when it isn't known.
+		/// </summary>
+		static constexpr size_t UnknownNodeIndex = std::numeric_limits<size_t>::max();
+
+		/// <summary>
+		/// Gets the index within the document of the first element that serializing the supplied
+		/// node, or its contents, comes across. This is only known when serializing from the
+		/// document node or the root element.
+		/// </summary>
+		/// <param name="node">
+		/// The node being serialized.
+		/// </param>
+		/// <param name="content">
+		/// Whether only the contents of the node are serialized.
+		/// </param>
+		/// <returns>
+		/// The index of the first element, or ::UnknownNodeIndex.
+		/// </returns>
+		static const size_t GetFirstNodeIndex(const GumboNode* node, const bool content);
+
+		/// <summary>
+		/// Does the work of ::Serialize(const GumboNode*, OutputSink&, const
+		/// NodeMutationCollection*), without flushing the sink.
+		/// </summary>
+		static void WriteNode(const GumboNode* node, const size_t nodeIndex, OutputSink& sink, const NodeMutationCollection* mutationCollection);
+
+		/// <summary>
+		/// Does the work of ::SerializeContent(const GumboNode*, OutputSink&, const bool, const
+		/// NodeMutationCollection*), without flushing the sink.
+		/// </summary>
+		static void WriteContent(const GumboNode* node, const size_t nodeIndex, OutputSink& sink, const bool omitText, const NodeMutationCollection* mutationCollection);
+
+		/// <summary>
+		/// Prepares the search for the nodes of the supplied collection. The frozen table of the
+		/// collection is walked when the index of the first element is known, and the node being
+		/// serialized belongs to the document that the table was built from.
+		/// </summary>
+		/// <param name="mutations">
+		/// The search to prepare.
+		/// </param>
+		/// <param name="node">
+		/// The node being serialized.
+		/// </param>
+		/// <param name="nodeIndex">
+		/// The index within the document of the first element to be serialized, or
+		/// ::UnknownNodeIndex.
+		/// </param>
+		/// <param name="mutationCollection">
+		/// User defined collection of nodes that the user has requested to have control of the
+		/// serialization process for.
+		/// </param>
+		static void BeginMutations(Mutations& mutations, const GumboNode* node, const size_t nodeIndex, const NodeMutationCollection* mutationCollection);
+
+		/// <summary>
+		/// Looks up the supplied element, which must be the next element in document order, in
+		/// the user collection.
+		/// </summary>
+		/// <param name="mutations">
+		/// The search for the nodes of the user collection.
+		/// </param>
+		/// <param name="node">
+		/// The element to look up.
+		/// </param>
+		/// <param name="found">
+		/// Whether or not the element is in the collection.
 		/// </param>
-		/// <param name="noEntities">
-		/// A bool used to indicate if special XML characters within any of the attribute values
-		/// should be converted to character references or not.
+		/// <param name="foundWithin">
+		/// Whether or not any descendant of the element is in the collection.
+		/// </param>
+		/// <param name="firstAction">
+		/// The first action declared on the element.
+		/// </param>
+		static void FindMutations(Mutations& mutations, const GumboNode* node, bool& found, bool& foundWithin, uint32_t& firstAction);
+
+		/// <summary>
+		/// Checks whether parallel serialization may serialize the children of the supplied node
+		/// apart from the node itself. That is, the node isn't in the user collection. When source
+		/// passthrough is enabled, the node must also hold some node in the collection, since it
+		/// would otherwise be copied whole. Nodes whose contents are trimmed may be split, since
+		/// the output of their children is trimmed as it's written, wherever it comes from.
+		/// </summary>
+		/// <param name="node">
+		/// The node to check.
+		/// </param>
+		/// <param name="mutationCollection">
+		/// User defined collection of nodes that the user has requested to have control of the
+		/// serialization process for.
 		/// </param>
 		/// <returns>
-		/// A string containing all of the attribute names and values. 
+		/// True if the children of the node may be serialized apart from it, false otherwise.
 		/// </returns>
-		static std::string BuildAttributes(const GumboAttribute* at);
+		static const bool CanSplit(const Node* node, const NodeMutationCollection* mutationCollection);
+
+		/// <summary>
+		/// Passes over the descendants of the element last looked up, when they're not going to
+		/// be serialized.
+		/// </summary>
+		/// <param name="mutations">
+		/// The search for the nodes of the user collection.
+		/// </param>
+		static void SkipMutationsWithin(Mutations& mutations);
+
+		/// <summary>
+		/// Writes the children of the node on top of the stack, one at a time, pushing a frame
+		/// for every child element whose contents must be written in turn, and finishing off
+		/// every node whose children have all been written, until the stack is empty.
+		/// </summary>
+		/// <param name="stack">
+		/// The stack of nodes being serialized.
+		/// </param>
+		/// <param name="mutations">
+		/// The search for the nodes of the user collection.
+		/// </param>
+		static void Run(std::vector<Frame>& stack, Mutations& mutations);
+
+		/// <summary>
+		/// Writes everything that precedes the contents of the supplied node, and pushes a frame
+		/// for the node if its contents are to be written. Elements that can be copied whole from
+		/// the source, or that the user has opted not to serialize, are dealt with entirely.
+		/// </summary>
+		/// <param name="node">
+		/// The node to begin writing.
+		/// </param>
+		/// <param name="sink">
+		/// The sink to write the node to.
+		/// </param>
+		/// <param name="mutations">
+		/// The search for the nodes of the user collection.
+		/// </param>
+		/// <param name="stack">
+		/// The stack of nodes being serialized.
+		/// </param>
+		static void BeginNode(const GumboNode* node, OutputSink& sink, Mutations& mutations, std::vector<Frame>& stack);
+
+		/// <summary>
+		/// Writes everything that follows the contents of the node in the supplied frame.
+		/// </summary>
+		/// <param name="frame">
+		/// The frame of the node to finish writing.
+		/// </param>
+		/// <param name="mutationCollection">
+		/// User defined collection of nodes that the user has requested to have control of the
+		/// serialization process for.
+		/// </param>
+		static void EndNode(Frame& frame, const NodeMutationCollection* mutationCollection);
+
+		/// <summary>
+		/// Finds the action, among those declared on a node, that decides what becomes of the
+		/// named attribute. That is the last action removing or setting the attribute.
+		/// </summary>
+		/// <param name="firstAction">
+		/// The first action declared on the node.
+		/// </param>
+		/// <param name="attributeName">
+		/// The name of the attribute.
+		/// </param>
+		/// <param name="mutationCollection">
+		/// The collection holding the actions.
+		/// </param>
+		/// <returns>
+		/// The action deciding what becomes of the attribute, or nullptr if there is none.
+		/// </returns>
+		static const NodeMutationCollection::Action* FindAttributeAction(const uint32_t firstAction, boost::string_ref attributeName, const NodeMutationCollection* mutationCollection);
+
+		/// <summary>
+		/// Writes the HTML declared to be inserted after a node.
+		/// </summary>
+		/// <param name="firstAction">
+		/// The first action declared on the node.
+		/// </param>
+		/// <param name="sink">
+		/// The sink to write the HTML to.
+		/// </param>
+		/// <param name="mutationCollection">
+		/// The collection holding the actions.
+		/// </param>
+		static void WriteInsertedAfter(const uint32_t firstAction, OutputSink& sink, const NodeMutationCollection* mutationCollection);
 	};
 
 } /* namespace gq */
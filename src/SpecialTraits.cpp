@@ -44,6 +44,13 @@ namespace gq
 		return PseudoKey.Get();
 	}
 
+	const std::string SpecialTraits::GetFoldedValueKey(boost::string_ref attributeName)
+	{
+		auto key = FoldedValueKey.Get().to_string();
+		key.append(attributeName.begin(), attributeName.end());
+		return key;
+	}
+
 	const boost::string_ref SpecialTraits::GetAnyValue()
 	{
 		// For values, we're actually safe to return static non-random values, because they are
@@ -92,4 +99,6 @@ namespace gq
 
 	const SpecialTraits::RandomKey SpecialTraits::PseudoKey{};
 
+	const SpecialTraits::RandomKey SpecialTraits::FoldedValueKey{};
+
 } /* namespace gq */
\ No newline at end of file
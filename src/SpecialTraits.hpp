@@ -22,6 +22,7 @@
 
 #pragma once
 
+#include <string>
 #include <boost/utility/string_ref.hpp>
 
 namespace gq
@@ -89,6 +90,21 @@ namespace gq
 		/// </returns>
 		static const boost::string_ref GetPseudoKey();
 
+		/// <summary>
+		/// Gets the key used for indexing the ASCII lower case form of the values of the supplied
+		/// attribute. Only values that hold upper case letters are indexed under this key, since
+		/// every other value is already indexed in its lower case form under the attribute name
+		/// itself. Case insensitive attribute selectors therefore look up their lower case value
+		/// under both keys.
+		/// </summary>
+		/// <param name="attributeName">
+		/// The name of the attribute whose values are indexed.
+		/// </param>
+		/// <returns>
+		/// The unique key used for indexing the lower case values of the supplied attribute.
+		/// </returns>
+		static const std::string GetFoldedValueKey(boost::string_ref attributeName);
+
 		/// <summary>
 		/// Gets the value used for indexing a node as having a specified attribute key, but without
 		/// explicitly declaring the value of the attribute and thus requiring an exact match when
@@ -150,6 +166,8 @@ namespace gq
 		static const RandomKey TagKey;
 
 		static const RandomKey PseudoKey;
+
+		static const RandomKey FoldedValueKey;
 	};
 
 } /* namespace gq */
\ No newline at end of file
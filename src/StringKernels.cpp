@@ -0,0 +1,552 @@
+/*
+* Copyright (c) 2015 Jesse Nicholson
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+
+#include "StringKernels.hpp"
+#include "CharClass.hpp"
+#include <cstdint>
+#include <cstring>
+
+#if !defined(GQ_NO_SIMD) && (defined(_M_X64) || defined(__x86_64__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || (defined(__i386__) && defined(__SSE2__)))
+	#define GQ_STRING_KERNELS_X86
+	#include <immintrin.h>
+	#ifdef _MSC_VER
+		#include <intrin.h>
+	#endif
+#endif
+
+#ifdef GQ_STRING_KERNELS_X86
+	// SSE2 is part of the baseline on every target above, but AVX2 isn't, so only the functions
+	// that use it are compiled for it. MSVC needs no such annotation to emit AVX2 instructions.
+	#if defined(_MSC_VER) && !defined(__clang__)
+		#define GQ_TARGET_AVX2
+	#else
+		#define GQ_TARGET_AVX2 __attribute__((target("avx2")))
+	#endif
+#endif
+
+namespace gq
+{
+
+	namespace
+	{
+
+		/// <summary>
+		/// Searches for a needle of at least two bytes that is no longer than the haystack.
+		/// </summary>
+		typedef size_t (*FindKernel)(const char* haystack, const size_t haystackSize, const char* needle, const size_t needleSize);
+
+		/// <summary>
+		/// Compares two strings of the same, non zero, size.
+		/// </summary>
+		typedef bool (*EqualsKernel)(const char* first, const char* second, const size_t size);
+
+		struct KernelTable
+		{
+			FindKernel find;
+			FindKernel findIgnoreCase;
+			EqualsKernel equals;
+			EqualsKernel equalsIgnoreCase;
+			const char* name;
+		};
+
+		size_t FindScalar(const char* haystack, const size_t haystackSize, const char* needle, const size_t needleSize)
+		{
+			const char* position = haystack;
+			const char* lastStart = haystack + (haystackSize - needleSize);
+
+			while (position <= lastStart)
+			{
+				position = static_cast<const char*>(std::memchr(position, needle[0], static_cast<size_t>(lastStart - position) + 1));
+
+				if (position == nullptr)
+				{
+					break;
+				}
+
+				if (std::memcmp(position + 1, needle + 1, needleSize - 1) == 0)
+				{
+					return static_cast<size_t>(position - haystack);
+				}
+
+				++position;
+			}
+
+			return boost::string_ref::npos;
+		}
+
+		bool EqualsScalar(const char* first, const char* second, const size_t size)
+		{
+			return std::memcmp(first, second, size) == 0;
+		}
+
+		bool EqualsIgnoreCaseScalar(const char* first, const char* second, const size_t size)
+		{
+			for (size_t i = 0; i < size; ++i)
+			{
+				if (CharClass::ToLower(first[i]) != CharClass::ToLower(second[i]))
+				{
+					return false;
+				}
+			}
+
+			return true;
+		}
+
+		size_t FindIgnoreCaseScalar(const char* haystack, const size_t haystackSize, const char* needle, const size_t needleSize)
+		{
+			const char first = CharClass::ToLower(needle[0]);
+
+			for (size_t position = 0; position + needleSize <= haystackSize; ++position)
+			{
+				if (CharClass::ToLower(haystack[position]) == first && EqualsIgnoreCaseScalar(haystack + position + 1, needle + 1, needleSize - 1))
+				{
+					return position;
+				}
+			}
+
+			return boost::string_ref::npos;
+		}
+
+		#ifdef GQ_STRING_KERNELS_X86
+
+		inline unsigned int CountTrailingZeros(const uint32_t mask)
+		{
+			#ifdef _MSC_VER
+				unsigned long index;
+				_BitScanForward(&index, mask);
+				return static_cast<unsigned int>(index);
+			#else
+				return static_cast<unsigned int>(__builtin_ctz(mask));
+			#endif
+		}
+
+		bool SupportsAvx2()
+		{
+			#ifdef _MSC_VER
+				int registers[4];
+
+				__cpuid(registers, 0);
+
+				if (registers[0] < 7)
+				{
+					return false;
+				}
+
+				// The processor must support AVX, and the OS must save the upper halves of the
+				// vector registers on a context switch, before AVX2 can be used.
+				__cpuid(registers, 1);
+
+				const int osxsaveAndAvx = (1 << 27) | (1 << 28);
+
+				if ((registers[2] & osxsaveAndAvx) != osxsaveAndAvx || (_xgetbv(0) & 0x6) != 0x6)
+				{
+					return false;
+				}
+
+				__cpuidex(registers, 7, 0);
+
+				return (registers[1] & (1 << 5)) != 0;
+			#else
+				__builtin_cpu_init();
+				return __builtin_cpu_supports("avx2") != 0;
+			#endif
+		}
+
+		/// <summary>
+		/// Folds the ASCII upper case letters within the supplied bytes to lower case. Adding
+		/// 0x80 - 'A' moves 'A' through 'Z' to the very bottom of the signed range, so a single
+		/// signed comparison picks them out.
+		/// </summary>
+		inline __m128i FoldCaseSse2(const __m128i bytes)
+		{
+			const __m128i shifted = _mm_add_epi8(bytes, _mm_set1_epi8(static_cast<char>(0x80 - 'A')));
+			const __m128i isUpper = _mm_cmplt_epi8(shifted, _mm_set1_epi8(static_cast<char>(-128 + 26)));
+			return _mm_or_si128(bytes, _mm_and_si128(isUpper, _mm_set1_epi8(0x20)));
+		}
+
+		size_t FindSse2(const char* haystack, const size_t haystackSize, const char* needle, const size_t needleSize)
+		{
+			const __m128i first = _mm_set1_epi8(needle[0]);
+			const __m128i last = _mm_set1_epi8(needle[needleSize - 1]);
+
+			size_t offset = 0;
+
+			// Each pass tests sixteen possible starting positions at once, by comparing both the
+			// first and the last byte of the needle. Only positions where both match are
+			// compared in full.
+			for (; offset + 16 + needleSize - 1 <= haystackSize; offset += 16)
+			{
+				const __m128i blockFirst = _mm_loadu_si128(reinterpret_cast<const __m128i*>(haystack + offset));
+				const __m128i blockLast = _mm_loadu_si128(reinterpret_cast<const __m128i*>(haystack + offset + needleSize - 1));
+
+				uint32_t candidates = static_cast<uint32_t>(_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(first, blockFirst), _mm_cmpeq_epi8(last, blockLast))));
+
+				while (candidates != 0)
+				{
+					const size_t position = offset + CountTrailingZeros(candidates);
+
+					if (needleSize <= 2 || std::memcmp(haystack + position + 1, needle + 1, needleSize - 2) == 0)
+					{
+						return position;
+					}
+
+					candidates &= candidates - 1;
+				}
+			}
+
+			if (offset + needleSize <= haystackSize)
+			{
+				const size_t position = FindScalar(haystack + offset, haystackSize - offset, needle, needleSize);
+
+				if (position != boost::string_ref::npos)
+				{
+					return offset + position;
+				}
+			}
+
+			return boost::string_ref::npos;
+		}
+
+		size_t FindIgnoreCaseSse2(const char* haystack, const size_t haystackSize, const char* needle, const size_t needleSize)
+		{
+			// The same as FindSse2(...), except that the haystack is folded as it's loaded and
+			// compared against the folded first and last bytes of the needle.
+			const __m128i first = _mm_set1_epi8(CharClass::ToLower(needle[0]));
+			const __m128i last = _mm_set1_epi8(CharClass::ToLower(needle[needleSize - 1]));
+
+			size_t offset = 0;
+
+			for (; offset + 16 + needleSize - 1 <= haystackSize; offset += 16)
+			{
+				const __m128i blockFirst = FoldCaseSse2(_mm_loadu_si128(reinterpret_cast<const __m128i*>(haystack + offset)));
+				const __m128i blockLast = FoldCaseSse2(_mm_loadu_si128(reinterpret_cast<const __m128i*>(haystack + offset + needleSize - 1)));
+
+				uint32_t candidates = static_cast<uint32_t>(_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(first, blockFirst), _mm_cmpeq_epi8(last, blockLast))));
+
+				while (candidates != 0)
+				{
+					const size_t position = offset + CountTrailingZeros(candidates);
+
+					if (needleSize <= 2 || EqualsIgnoreCaseScalar(haystack + position + 1, needle + 1, needleSize - 2))
+					{
+						return position;
+					}
+
+					candidates &= candidates - 1;
+				}
+			}
+
+			if (offset + needleSize <= haystackSize)
+			{
+				const size_t position = FindIgnoreCaseScalar(haystack + offset, haystackSize - offset, needle, needleSize);
+
+				if (position != boost::string_ref::npos)
+				{
+					return offset + position;
+				}
+			}
+
+			return boost::string_ref::npos;
+		}
+
+		bool EqualsSse2(const char* first, const char* second, const size_t size)
+		{
+			if (size < 16)
+			{
+				return EqualsScalar(first, second, size);
+			}
+
+			for (size_t offset = 0; offset + 16 <= size; offset += 16)
+			{
+				const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first + offset));
+				const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(second + offset));
+
+				if (_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) != 0xFFFF)
+				{
+					return false;
+				}
+			}
+
+			// The last block overlaps the one before it, rather than falling back to bytes.
+			const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first + size - 16));
+			const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(second + size - 16));
+
+			return _mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) == 0xFFFF;
+		}
+
+		bool EqualsIgnoreCaseSse2(const char* first, const char* second, const size_t size)
+		{
+			if (size < 16)
+			{
+				return EqualsIgnoreCaseScalar(first, second, size);
+			}
+
+			for (size_t offset = 0; offset + 16 <= size; offset += 16)
+			{
+				const __m128i a = FoldCaseSse2(_mm_loadu_si128(reinterpret_cast<const __m128i*>(first + offset)));
+				const __m128i b = FoldCaseSse2(_mm_loadu_si128(reinterpret_cast<const __m128i*>(second + offset)));
+
+				if (_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) != 0xFFFF)
+				{
+					return false;
+				}
+			}
+
+			const __m128i a = FoldCaseSse2(_mm_loadu_si128(reinterpret_cast<const __m128i*>(first + size - 16)));
+			const __m128i b = FoldCaseSse2(_mm_loadu_si128(reinterpret_cast<const __m128i*>(second + size - 16)));
+
+			return _mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) == 0xFFFF;
+		}
+
+		GQ_TARGET_AVX2 inline __m256i FoldCaseAvx2(const __m256i bytes)
+		{
+			const __m256i shifted = _mm256_add_epi8(bytes, _mm256_set1_epi8(static_cast<char>(0x80 - 'A')));
+			const __m256i isUpper = _mm256_cmpgt_epi8(_mm256_set1_epi8(static_cast<char>(-128 + 26)), shifted);
+			return _mm256_or_si256(bytes, _mm256_and_si256(isUpper, _mm256_set1_epi8(0x20)));
+		}
+
+		GQ_TARGET_AVX2 size_t FindAvx2(const char* haystack, const size_t haystackSize, const char* needle, const size_t needleSize)
+		{
+			const __m256i first = _mm256_set1_epi8(needle[0]);
+			const __m256i last = _mm256_set1_epi8(needle[needleSize - 1]);
+
+			size_t offset = 0;
+
+			for (; offset + 32 + needleSize - 1 <= haystackSize; offset += 32)
+			{
+				const __m256i blockFirst = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(haystack + offset));
+				const __m256i blockLast = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(haystack + offset + needleSize - 1));
+
+				uint32_t candidates = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(first, blockFirst), _mm256_cmpeq_epi8(last, blockLast))));
+
+				while (candidates != 0)
+				{
+					const size_t position = offset + CountTrailingZeros(candidates);
+
+					if (needleSize <= 2 || std::memcmp(haystack + position + 1, needle + 1, needleSize - 2) == 0)
+					{
+						return position;
+					}
+
+					candidates &= candidates - 1;
+				}
+			}
+
+			// Whatever is left is shorter than a full block, which SSE2 may still cover.
+			if (offset + needleSize <= haystackSize)
+			{
+				const size_t position = FindSse2(haystack + offset, haystackSize - offset, needle, needleSize);
+
+				if (position != boost::string_ref::npos)
+				{
+					return offset + position;
+				}
+			}
+
+			return boost::string_ref::npos;
+		}
+
+		GQ_TARGET_AVX2 size_t FindIgnoreCaseAvx2(const char* haystack, const size_t haystackSize, const char* needle, const size_t needleSize)
+		{
+			const __m256i first = _mm256_set1_epi8(CharClass::ToLower(needle[0]));
+			const __m256i last = _mm256_set1_epi8(CharClass::ToLower(needle[needleSize - 1]));
+
+			size_t offset = 0;
+
+			for (; offset + 32 + needleSize - 1 <= haystackSize; offset += 32)
+			{
+				const __m256i blockFirst = FoldCaseAvx2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(haystack + offset)));
+				const __m256i blockLast = FoldCaseAvx2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(haystack + offset + needleSize - 1)));
+
+				uint32_t candidates = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(first, blockFirst), _mm256_cmpeq_epi8(last, blockLast))));
+
+				while (candidates != 0)
+				{
+					const size_t position = offset + CountTrailingZeros(candidates);
+
+					if (needleSize <= 2 || EqualsIgnoreCaseScalar(haystack + position + 1, needle + 1, needleSize - 2))
+					{
+						return position;
+					}
+
+					candidates &= candidates - 1;
+				}
+			}
+
+			if (offset + needleSize <= haystackSize)
+			{
+				const size_t position = FindIgnoreCaseSse2(haystack + offset, haystackSize - offset, needle, needleSize);
+
+				if (position != boost::string_ref::npos)
+				{
+					return offset + position;
+				}
+			}
+
+			return boost::string_ref::npos;
+		}
+
+		GQ_TARGET_AVX2 bool EqualsAvx2(const char* first, const char* second, const size_t size)
+		{
+			if (size < 32)
+			{
+				return EqualsSse2(first, second, size);
+			}
+
+			for (size_t offset = 0; offset + 32 <= size; offset += 32)
+			{
+				const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(first + offset));
+				const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(second + offset));
+
+				if (static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b))) != 0xFFFFFFFFu)
+				{
+					return false;
+				}
+			}
+
+			const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(first + size - 32));
+			const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(second + size - 32));
+
+			return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b))) == 0xFFFFFFFFu;
+		}
+
+		GQ_TARGET_AVX2 bool EqualsIgnoreCaseAvx2(const char* first, const char* second, const size_t size)
+		{
+			if (size < 32)
+			{
+				return EqualsIgnoreCaseSse2(first, second, size);
+			}
+
+			for (size_t offset = 0; offset + 32 <= size; offset += 32)
+			{
+				const __m256i a = FoldCaseAvx2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(first + offset)));
+				const __m256i b = FoldCaseAvx2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(second + offset)));
+
+				if (static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b))) != 0xFFFFFFFFu)
+				{
+					return false;
+				}
+			}
+
+			const __m256i a = FoldCaseAvx2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(first + size - 32)));
+			const __m256i b = FoldCaseAvx2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(second + size - 32)));
+
+			return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b))) == 0xFFFFFFFFu;
+		}
+
+		#endif
+
+		KernelTable SelectKernels()
+		{
+			#ifdef GQ_STRING_KERNELS_X86
+				if (SupportsAvx2())
+				{
+					return { FindAvx2, FindIgnoreCaseAvx2, EqualsAvx2, EqualsIgnoreCaseAvx2, u8"avx2" };
+				}
+
+				return { FindSse2, FindIgnoreCaseSse2, EqualsSse2, EqualsIgnoreCaseSse2, u8"sse2" };
+			#else
+				return { FindScalar, FindIgnoreCaseScalar, EqualsScalar, EqualsIgnoreCaseScalar, u8"scalar" };
+			#endif
+		}
+
+		const KernelTable& GetKernels()
+		{
+			static const KernelTable kernels = SelectKernels();
+			return kernels;
+		}
+
+	}
+
+	StringKernels::StringKernels()
+	{
+
+	}
+
+	StringKernels::~StringKernels()
+	{
+
+	}
+
+	const size_t StringKernels::Find(boost::string_ref haystack, boost::string_ref needle)
+	{
+		if (needle.size() == 0)
+		{
+			return 0;
+		}
+
+		if (needle.size() > haystack.size())
+		{
+			return boost::string_ref::npos;
+		}
+
+		if (needle.size() == 1)
+		{
+			auto position = static_cast<const char*>(std::memchr(haystack.data(), needle[0], haystack.size()));
+			return position == nullptr ? boost::string_ref::npos : static_cast<size_t>(position - haystack.data());
+		}
+
+		return GetKernels().find(haystack.data(), haystack.size(), needle.data(), needle.size());
+	}
+
+	const size_t StringKernels::FindIgnoreCase(boost::string_ref haystack, boost::string_ref needle)
+	{
+		if (needle.size() == 0)
+		{
+			return 0;
+		}
+
+		if (needle.size() > haystack.size())
+		{
+			return boost::string_ref::npos;
+		}
+
+		return GetKernels().findIgnoreCase(haystack.data(), haystack.size(), needle.data(), needle.size());
+	}
+
+	const bool StringKernels::Equals(boost::string_ref first, boost::string_ref second)
+	{
+		if (first.size() != second.size())
+		{
+			return false;
+		}
+
+		return first.size() == 0 || GetKernels().equals(first.data(), second.data(), first.size());
+	}
+
+	const bool StringKernels::EqualsIgnoreCase(boost::string_ref first, boost::string_ref second)
+	{
+		if (first.size() != second.size())
+		{
+			return false;
+		}
+
+		return first.size() == 0 || GetKernels().equalsIgnoreCase(first.data(), second.data(), first.size());
+	}
+
+	const char* StringKernels::GetImplementationName()
+	{
+		return GetKernels().name;
+	}
+
+} /* namespace gq */
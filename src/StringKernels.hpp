@@ -0,0 +1,121 @@
+/*
+* Copyright (c) 2015 Jesse Nicholson
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+
+#pragma once
+
+#include <cstddef>
+#include <boost/utility/string_ref.hpp>
+
+namespace gq
+{
+
+	/// <summary>
+	/// StringKernels provides the byte string primitives that attribute and text selectors match
+	/// with: substring search and equality, each also with an ASCII case insensitive variant. Each
+	/// has an SSE2 and an AVX2 implementation on x86, which compare 16 or 32 bytes at a time, as
+	/// well as a scalar implementation for every other target. The widest implementation the processor supports is
+	/// picked once, the first time any kernel is called, and used from then on.
+	/// <para>&#160;</para>
+	/// Defining GQ_NO_SIMD when building removes the vector implementations entirely.
+	/// </summary>
+	class StringKernels
+	{
+
+	public:
+
+		/// <summary>
+		/// Finds the first occurrence of the needle within the haystack.
+		/// </summary>
+		/// <param name="haystack">
+		/// The string to search within.
+		/// </param>
+		/// <param name="needle">
+		/// The string to search for.
+		/// </param>
+		/// <returns>
+		/// The position of the first occurrence of the needle, or boost::string_ref::npos if the
+		/// needle does not occur. An empty needle is found at position zero.
+		/// </returns>
+		static const size_t Find(boost::string_ref haystack, boost::string_ref needle);
+
+		/// <summary>
+		/// Finds the first occurrence of the needle within the haystack, comparing ASCII letters
+		/// without regard to case. Bytes outside of ASCII must be equal exactly.
+		/// </summary>
+		/// <param name="haystack">
+		/// The string to search within.
+		/// </param>
+		/// <param name="needle">
+		/// The string to search for.
+		/// </param>
+		/// <returns>
+		/// The position of the first occurrence of the needle, or boost::string_ref::npos if the
+		/// needle does not occur. An empty needle is found at position zero.
+		/// </returns>
+		static const size_t FindIgnoreCase(boost::string_ref haystack, boost::string_ref needle);
+
+		/// <summary>
+		/// Checks if the supplied strings are equal, byte for byte.
+		/// </summary>
+		/// <param name="first">
+		/// The first string to compare.
+		/// </param>
+		/// <param name="second">
+		/// The second string to compare.
+		/// </param>
+		/// <returns>
+		/// True if the strings are equal, false otherwise.
+		/// </returns>
+		static const bool Equals(boost::string_ref first, boost::string_ref second);
+
+		/// <summary>
+		/// Checks if the supplied strings are equal when ASCII letters are compared without regard
+		/// to case. Bytes outside of ASCII must be equal exactly.
+		/// </summary>
+		/// <param name="first">
+		/// The first string to compare.
+		/// </param>
+		/// <param name="second">
+		/// The second string to compare.
+		/// </param>
+		/// <returns>
+		/// True if the strings are equal ignoring ASCII case, false otherwise.
+		/// </returns>
+		static const bool EqualsIgnoreCase(boost::string_ref first, boost::string_ref second);
+
+		/// <summary>
+		/// Gets the name of the implementation in use, which is one of "avx2", "sse2" or "scalar".
+		/// </summary>
+		/// <returns>
+		/// The name of the implementation in use.
+		/// </returns>
+		static const char* GetImplementationName();
+
+	private:
+
+		StringKernels();
+		~StringKernels();
+
+	};
+
+} /* namespace gq */
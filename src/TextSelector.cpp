@@ -28,59 +28,61 @@
 */
 
 #include "TextSelector.hpp"
+#include "ContainsMatcher.hpp"
 #include "Util.hpp"
 #include <boost/algorithm/string.hpp>
 #include "Node.hpp"
+#include "StringKernels.hpp"
 
 namespace gq
 {
 
 	TextSelector::TextSelector(const SelectorOperator op, const boost::string_ref value) :
-		m_operator(op), m_textToMatch(value.to_string()), m_textToMatchStrRef(m_textToMatch)
+		m_operator(op), m_textToMatchStrRef(InternString(value))
 	{
-		if (m_textToMatch.size() == 0)
+		if (m_textToMatchStrRef.size() == 0)
 		{
 			throw std::runtime_error(u8"In AttributeSelector::AttributeSelector(SelectorOperator, const boost::string_ref) - Supplied text to match has zero length.");
 		}
 
 		if (m_operator == SelectorOperator::Matches || m_operator == SelectorOperator::MatchesOwn)
 		{
-			m_expression.reset(new std::regex(m_textToMatch.c_str(), std::regex_constants::ECMAScript | std::regex_constants::optimize | std::regex_constants::nosubs));
+			m_expression = Regex::Get(m_textToMatchStrRef);
 
 			if (m_expression == nullptr)
 			{
-				throw std::runtime_error(u8"In AttributeSelector::AttributeSelector(SelectorOperator, const boost::string_ref) - Failed to allocate new std::regex for regex based TextSelector.");
+				throw std::runtime_error(u8"In TextSelector::TextSelector(SelectorOperator, const boost::string_ref) - Supplied regular expression is invalid or unsupported.");
 			}
 		}
 
 		#ifndef NDEBUG
 			#ifdef GQ_VERBOSE_DEBUG_NFO
-				std::cout << "Built TextSelector with operator " << static_cast<size_t>(m_operator) << " with text to match " << m_textToMatch << u8"." << std::endl;
+				std::cout << "Built TextSelector with operator " << static_cast<size_t>(m_operator) << " with text to match " << m_textToMatchStrRef << u8"." << std::endl;
 			#endif
 		#endif
 	}
 
 	TextSelector::TextSelector(const SelectorOperator op, std::string value) :
-		m_operator(op), m_textToMatch(std::move(value)), m_textToMatchStrRef(m_textToMatch)
+		m_operator(op), m_textToMatchStrRef(InternString(value))
 	{
-		if (m_textToMatch.size() == 0)
+		if (m_textToMatchStrRef.size() == 0)
 		{
 			throw std::runtime_error(u8"In AttributeSelector::AttributeSelector(SelectorOperator, std::string) - Supplied text to match has zero length.");
 		}
 
 		if (m_operator == SelectorOperator::Matches || m_operator == SelectorOperator::MatchesOwn)
 		{
-			m_expression.reset(new std::regex(m_textToMatch.c_str(), std::regex_constants::ECMAScript | std::regex_constants::optimize | std::regex_constants::nosubs));
+			m_expression = Regex::Get(m_textToMatchStrRef);
 
 			if (m_expression == nullptr)
 			{
-				throw std::runtime_error(u8"In AttributeSelector::AttributeSelector(SelectorOperator, const boost::string_ref) - Failed to allocate new std::regex for regex based TextSelector.");
+				throw std::runtime_error(u8"In TextSelector::TextSelector(SelectorOperator, std::string) - Supplied regular expression is invalid or unsupported.");
 			}
 		}
 
 		#ifndef NDEBUG
 			#ifdef GQ_VERBOSE_DEBUG_NFO
-				std::cout << "Built TextSelector with operator " << static_cast<size_t>(m_operator) << " with text to match " << m_textToMatch << u8"." << std::endl;
+				std::cout << "Built TextSelector with operator " << static_cast<size_t>(m_operator) << " with text to match " << m_textToMatchStrRef << u8"." << std::endl;
 			#endif
 		#endif
 	}
@@ -96,12 +98,27 @@ namespace gq
 		{
 			case SelectorOperator::Contains:
 			{
+				// When a whole set of selectors is being searched, the needle may already have
+				// been looked for, along with every other needle in the set.
+				bool found = false;
+				if (ContainsMatcher::Lookup(this, node, false, found))
+				{
+					return MatchResult(found ? node : nullptr);
+				}
+
+				// When the document was parsed with a text index, nodes whose text cannot hold
+				// the needle are dismissed without building their text.
+				if (!node->MayContainText(m_textToMatchStrRef))
+				{
+					return nullptr;
+				}
+
 				// In jQuery, contains is case sensitive. As such, we use find, rather than
 				// ifind_first.
 				auto text = Util::NodeText(node);
 				boost::string_ref textStrRef(text);
 
-				if (textStrRef.find(m_textToMatchStrRef) != boost::string_ref::npos)
+				if (StringKernels::Find(textStrRef, m_textToMatchStrRef) != boost::string_ref::npos)
 				{
 					return MatchResult(node);
 				}
@@ -112,12 +129,20 @@ namespace gq
 
 			case SelectorOperator::ContainsOwn:
 			{
+				// When a whole set of selectors is being searched, the needle may already have
+				// been looked for, along with every other needle in the set.
+				bool found = false;
+				if (ContainsMatcher::Lookup(this, node, true, found))
+				{
+					return MatchResult(found ? node : nullptr);
+				}
+
 				// In jQuery, contains is case sensitive. As such, we use find, rather than
 				// ifind_first.
 				auto text = Util::NodeOwnText(node);
 				boost::string_ref textStrRef(text);
 
-				if (textStrRef.find(m_textToMatchStrRef) != boost::string_ref::npos)
+				if (StringKernels::Find(textStrRef, m_textToMatchStrRef) != boost::string_ref::npos)
 				{
 					return MatchResult(node);
 				}
@@ -128,8 +153,7 @@ namespace gq
 
 			case SelectorOperator::Matches:
 			{
-				auto text = Util::NodeText(node);
-				if (std::regex_search(text, *(m_expression.get())))
+				if (Util::NodeTextMatches(node, *m_expression))
 				{
 					return MatchResult(node);
 				}
@@ -140,8 +164,7 @@ namespace gq
 
 			case SelectorOperator::MatchesOwn:
 			{
-				auto text = Util::NodeOwnText(node);
-				if (std::regex_search(text, *(m_expression.get())))
+				if (Util::NodeOwnTextMatches(node, *m_expression))
 				{
 					return MatchResult(node);
 				}
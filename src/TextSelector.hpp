@@ -30,8 +30,8 @@
 #pragma once
 
 #include "Selector.hpp"
+#include "Regex.hpp"
 #include <boost/utility/string_ref.hpp>
-#include <regex>
 
 namespace gq
 {
@@ -46,18 +46,24 @@ namespace gq
 	/// matched against by a regular expression. Match against a node where itself or any of its
 	/// direct children contain text that is positively matched against by a regular expression.
 	/// <para>&#160;</para>
-	/// Currently the regex implementation is rigid in some regards. Regular expressions such as
-	/// "/some.*stuff/gi" are not supported, because this would involve parsing the expression from
-	/// the options and converting options to implementation specific flags, maybe. I say maybe
-	/// because I didn't even bother investigating really, as I have not read the w3 standard on the
-	/// matter. For time constraints some things such as this are presently left on the to do list.
-	/// <para>&#160;</para>
-	/// The grammar is specified to be ECMAScript which is supposed to be implemented as defined in
-	/// ECMA-262 section [28.13].
+	/// Regular expressions are run by the in tree Regex engine, which searches in time linear in
+	/// the length of the text whatever the pattern, so that no single rule can stall matching.
+	/// The grammar is ECMAScript, as defined in ECMA-262, minus back references and look around
+	/// assertions, which can't be matched without backtracking. Options such as "/some.*stuff/gi"
+	/// are not supported. Selectors with the same pattern share a single compiled expression.
 	/// </summary>
 	class TextSelector final : public Selector
 	{
 
+		// So that compiled selectors can be written to and read back from the binary format.
+		friend class SelectorCodec;
+
+		// So that equivalent compiled selectors can be recognized and merged.
+		friend class SelectorCanonicalizer;
+
+		// So that the needles of text selectors can be gathered into a single automaton.
+		friend class ContainsMatcher;
+
 	public:
 
 		enum class SelectorOperator
@@ -144,23 +150,15 @@ namespace gq
 		SelectorOperator m_operator;
 
 		/// <summary>
-		/// The text to match.
-		/// </summary>
-		std::string m_textToMatch;
-
-		/// <summary>
-		/// A boost::string_ref wrapper for the text to be matched.
+		/// The text to match, stored in the arena of this selector.
 		/// </summary>
 		boost::string_ref m_textToMatchStrRef;
 
 		/// <summary>
-		/// If this text selector is regex based selector, we'll need a regex object to work with.
-		/// If it's not, then we certainly don't want to incur the overhead of default constructed
-		/// regexes needlessly. As such, this object will hold a unique_ptr to a regex which may or
-		/// may not be constructed depending on the desired composition of this object, extrapolated
-		/// from the operator(s) supplied to the constructors.
+		/// The compiled expression, if this is a regex based selector. It is shared with every
+		/// other selector that uses the same pattern.
 		/// </summary>
-		std::unique_ptr<std::regex> m_expression;
+		std::shared_ptr<const Regex> m_expression;
 
 	};
 
@@ -21,13 +21,17 @@
 */
 
 #include <stdexcept>
+#include <algorithm>
 #include "TreeMap.hpp"
 #include "Node.hpp"
 #include "SpecialTraits.hpp"
+#include "CharClass.hpp"
 
 namespace gq
 {
 
+	constexpr uint32_t TreeMap::UnindexedText;
+
 	TreeMap::TreeMap()
 	{
 
@@ -205,9 +209,182 @@ namespace gq
 		return nullptr;
 	}
 
+	void TreeMap::AddFoldedValue(AttributeMap& nodeAttributeMap, boost::string_ref attributeName, boost::string_ref attributeValue)
+	{
+		auto firstUpper = std::find_if(attributeValue.begin(), attributeValue.end(), [](const char c)
+		{
+			return CharClass::ToLower(c) != c;
+		});
+
+		if (firstUpper == attributeValue.end())
+		{
+			return;
+		}
+
+		std::string folded(attributeValue.begin(), attributeValue.end());
+
+		for (auto& c : folded)
+		{
+			c = CharClass::ToLower(c);
+		}
+
+		const auto& key = *m_foldedStrings.insert(SpecialTraits::GetFoldedValueKey(attributeName)).first;
+		const auto& value = *m_foldedStrings.insert(std::move(folded)).first;
+
+		nodeAttributeMap.insert({ boost::string_ref(key), boost::string_ref(value) });
+	}
+
 	void TreeMap::Clear()
 	{
 		m_scopedAttributes.clear();
+		m_nodeCount = 0;
+		m_subtreeEnds.clear();
+		m_foldedStrings.clear();
+
+		m_textIndexed = false;
+		m_indexedTextLength = 0;
+		m_lastIndexedBytes = 0;
+		m_textTrigrams.clear();
+		m_nodeTextRanges.clear();
+	}
+
+	const size_t TreeMap::NextNodeIndex()
+	{
+		m_subtreeEnds.push_back(m_nodeCount + 1);
+		return m_nodeCount++;
+	}
+
+	const size_t TreeMap::GetNodeCount() const
+	{
+		return m_nodeCount;
+	}
+
+	void TreeMap::EndSubtree(const size_t nodeIndex)
+	{
+		m_subtreeEnds[nodeIndex] = m_nodeCount;
+	}
+
+	const size_t TreeMap::GetSubtreeEnd(const size_t nodeIndex) const
+	{
+		return m_subtreeEnds[nodeIndex];
+	}
+
+	void TreeMap::BeginTextIndex()
+	{
+		m_textIndexed = true;
+		m_indexedTextLength = 0;
+		m_lastIndexedBytes = 0;
+		m_textTrigrams.clear();
+		m_nodeTextRanges.assign(m_nodeCount, std::make_pair(UnindexedText, UnindexedText));
+	}
+
+	void TreeMap::AppendIndexedText(boost::string_ref text)
+	{
+		if (!m_textIndexed)
+		{
+			return;
+		}
+
+		if (text.size() >= static_cast<size_t>(UnindexedText - m_indexedTextLength))
+		{
+			// Offsets are kept at 32 bits to keep the postings small. Documents with more
+			// text than that simply go without an index, which only costs speed.
+			m_textIndexed = false;
+			m_textTrigrams.clear();
+			m_nodeTextRanges.clear();
+			return;
+		}
+
+		for (auto c : text)
+		{
+			m_lastIndexedBytes = ((m_lastIndexedBytes << 8) | static_cast<unsigned char>(c)) & 0xFFFFFF;
+
+			++m_indexedTextLength;
+
+			if (m_indexedTextLength >= 3)
+			{
+				m_textTrigrams[m_lastIndexedBytes].push_back(m_indexedTextLength - 3);
+			}
+		}
+	}
+
+	const uint32_t TreeMap::GetIndexedTextLength() const
+	{
+		return m_indexedTextLength;
+	}
+
+	void TreeMap::SetIndexedTextRange(const size_t nodeIndex, const uint32_t start, const uint32_t end)
+	{
+		if (!m_textIndexed)
+		{
+			return;
+		}
+
+		#ifndef NDEBUG
+			assert(nodeIndex < m_nodeTextRanges.size() && start <= end && u8"In TreeMap::SetIndexedTextRange(const size_t, const uint32_t, const uint32_t) - The supplied node index or text range is invalid.");
+		#else
+			if (nodeIndex >= m_nodeTextRanges.size() || start > end) { throw std::runtime_error(u8"In TreeMap::SetIndexedTextRange(const size_t, const uint32_t, const uint32_t) - The supplied node index or text range is invalid."); }
+		#endif
+
+		m_nodeTextRanges[nodeIndex] = std::make_pair(start, end);
+	}
+
+	const bool TreeMap::MayContainText(const size_t nodeIndex, boost::string_ref text) const
+	{
+		if (!m_textIndexed || nodeIndex >= m_nodeTextRanges.size() || m_nodeTextRanges[nodeIndex].first == UnindexedText)
+		{
+			return true;
+		}
+
+		const auto start = m_nodeTextRanges[nodeIndex].first;
+		const auto end = m_nodeTextRanges[nodeIndex].second;
+
+		if (text.size() > static_cast<size_t>(end - start))
+		{
+			return false;
+		}
+
+		if (text.size() < 3)
+		{
+			return true;
+		}
+
+		// Any occurrence of the text within the node contains every one of its trigrams, so it's
+		// enough to look for the rarest of them, shifted by its offset within the text, inside
+		// the range of the node.
+		const std::vector<uint32_t>* rarest = nullptr;
+		uint32_t rarestOffset = 0;
+		uint32_t trigram = 0;
+
+		for (size_t i = 0; i < text.size(); ++i)
+		{
+			trigram = ((trigram << 8) | static_cast<unsigned char>(text[i])) & 0xFFFFFF;
+
+			if (i < 2)
+			{
+				continue;
+			}
+
+			const auto postings = m_textTrigrams.find(trigram);
+
+			if (postings == m_textTrigrams.end())
+			{
+				return false;
+			}
+
+			if (rarest == nullptr || postings->second.size() < rarest->size())
+			{
+				rarest = &postings->second;
+				rarestOffset = static_cast<uint32_t>(i - 2);
+			}
+		}
+
+		const auto first = start + rarestOffset;
+		const auto last = end - static_cast<uint32_t>(text.size()) + rarestOffset;
+
+		const auto posting = std::lower_bound(rarest->begin(), rarest->end(), first);
+
+		return posting != rarest->end() && *posting <= last;
 	}
 
 } /* namespace gq */
@@ -26,6 +26,9 @@
 #include <unordered_map>
 #include <unordered_set>
 #include <map>
+#include <vector>
+#include <cstdint>
+#include <limits>
 #include "StrRefHash.hpp"
 
 /*
@@ -75,10 +78,11 @@ namespace gq
 
 		/// <summary>
 		/// Node and its descendants are the only ones who actually need to access this object and
-		/// its static members.
+		/// its static members. The Serializer only reads the extent of subtrees.
 		/// </summary>
 		friend class Node;
 		friend class Document;
+		friend class Serializer;
 
 	public:
 
@@ -149,11 +153,132 @@ namespace gq
 		/// </returns>
 		const std::vector< const Node* >* Get(boost::string_ref scope, boost::string_ref attribute, boost::string_ref attributeValue) const;
 
+		/// <summary>
+		/// Adds the ASCII lower case form of the supplied attribute value to the supplied map,
+		/// under the key from SpecialTraits::GetFoldedValueKey(...), if the value holds any upper
+		/// case letters. Values without upper case letters are left alone, because they are their
+		/// own lower case form. The key and the lower case value are kept by this map, since
+		/// unlike everything else it indexes, they don't exist anywhere within the document.
+		/// </summary>
+		/// <param name="nodeAttributeMap">
+		/// The attribute map of the node being indexed.
+		/// </param>
+		/// <param name="attributeName">
+		/// The name of the attribute. 
+		/// </param>
+		/// <param name="attributeValue">
+		/// The value, or a single entry of a whitespace separated value, of the attribute.
+		/// </param>
+		void AddFoldedValue(AttributeMap& nodeAttributeMap, boost::string_ref attributeName, boost::string_ref attributeValue);
+
 		/// <summary>
 		/// Empties the map.
 		/// </summary>
 		void Clear();
 
+		/// <summary>
+		/// Hands out the next index in document order. Nodes are built depth first, in the order
+		/// they appear in the document, so every node calls this once as it is created and uses
+		/// the result as its index within the document.
+		/// </summary>
+		/// <returns>
+		/// The index within the document for the next node.
+		/// </returns>
+		const size_t NextNodeIndex();
+
+		/// <summary>
+		/// Gets the total number of nodes that have been handed an index within the document. All
+		/// indices returned by ::NextNodeIndex() are less than this value.
+		/// </summary>
+		/// <returns>
+		/// The total number of indexed nodes.
+		/// </returns>
+		const size_t GetNodeCount() const;
+
+		/// <summary>
+		/// Records that the node with the supplied index within the document, and all of its
+		/// descendants, have been handed their indices. Every node calls this once its children
+		/// have been built.
+		/// </summary>
+		/// <param name="nodeIndex">
+		/// The index within the document of the node.
+		/// </param>
+		void EndSubtree(const size_t nodeIndex);
+
+		/// <summary>
+		/// Gets the end of the range of indices within the document held by the node with the
+		/// supplied index and its descendants. The range begins at the index of the node itself,
+		/// and the end is one past the index of its last descendant.
+		/// </summary>
+		/// <param name="nodeIndex">
+		/// The index within the document of the node.
+		/// </param>
+		/// <returns>
+		/// The end of the range of indices held by the subtree of the node.
+		/// </returns>
+		const size_t GetSubtreeEnd(const size_t nodeIndex) const;
+
+		/// <summary>
+		/// Prepares the optional text index for the nodes that have been handed an index within
+		/// the document so far. The text index is an inverted index of every byte trigram within
+		/// the text of the document, as Util::NodeText(...) would produce it for the root node,
+		/// mapped to every offset where the trigram occurs. Each node then records the range of
+		/// that text which belongs to itself and its descendants. Text is supplied in document
+		/// order through ::AppendIndexedText(...).
+		/// </summary>
+		void BeginTextIndex();
+
+		/// <summary>
+		/// Appends the supplied text to the indexed text of the document, recording every trigram
+		/// that ends within it. Trigrams that span consecutive calls are recorded as well, since
+		/// the text of adjacent text nodes is concatenated when the text of an element is built.
+		/// </summary>
+		/// <param name="text">
+		/// The text to append.
+		/// </param>
+		void AppendIndexedText(boost::string_ref text);
+
+		/// <summary>
+		/// Gets the number of bytes of text that have been appended to the text index so far.
+		/// </summary>
+		/// <returns>
+		/// The length of the indexed text.
+		/// </returns>
+		const uint32_t GetIndexedTextLength() const;
+
+		/// <summary>
+		/// Records the range of the indexed text that makes up the text of the node with the
+		/// supplied index within the document.
+		/// </summary>
+		/// <param name="nodeIndex">
+		/// The index within the document of the node.
+		/// </param>
+		/// <param name="start">
+		/// The offset within the indexed text where the text of the node begins.
+		/// </param>
+		/// <param name="end">
+		/// The offset within the indexed text where the text of the node ends.
+		/// </param>
+		void SetIndexedTextRange(const size_t nodeIndex, const uint32_t start, const uint32_t end);
+
+		/// <summary>
+		/// Uses the text index to determine whether or not the text of the node with the supplied
+		/// index within the document may contain the supplied string. A return value of false is
+		/// definite, while a return value of true only means that the text of the node must be
+		/// searched to be sure. When there is no text index, or the node was not indexed, this
+		/// always returns true.
+		/// </summary>
+		/// <param name="nodeIndex">
+		/// The index within the document of the node.
+		/// </param>
+		/// <param name="text">
+		/// The string to look for.
+		/// </param>
+		/// <returns>
+		/// False if the text of the node cannot contain the supplied string, true otherwise.
+		/// </returns>
+		const bool MayContainText(const size_t nodeIndex, boost::string_ref text) const;
+
 		/// <summary>
 		/// For readability. This holds a collection of nodes with a certain attribute value. This
 		/// object is the second element in the key/value pair for an unordered_map. The first
@@ -205,6 +330,58 @@ namespace gq
 		/// </summary>
 		ScopedAttributeMap m_scopedAttributes;		
 
+		/// <summary>
+		/// The number of nodes that have been handed an index within the document. 
+		/// </summary>
+		size_t m_nodeCount = 0;
+
+		/// <summary>
+		/// The end of the range of indices held by the subtree of every indexed node, by index.
+		/// </summary>
+		std::vector<size_t> m_subtreeEnds;
+
+		/// <summary>
+		/// Storage for the folded value keys and lower case attribute values added through
+		/// ::AddFoldedValue(...). Elements of an unordered_set never move, so the string_refs
+		/// held by the map stay valid until ::Clear() is called.
+		/// </summary>
+		std::unordered_set<std::string> m_foldedStrings;
+
+		/// <summary>
+		/// Whether or not the text index has been built for the current document.
+		/// </summary>
+		bool m_textIndexed = false;
+
+		/// <summary>
+		/// The number of bytes of text that have been appended to the text index.
+		/// </summary>
+		uint32_t m_indexedTextLength = 0;
+
+		/// <summary>
+		/// The last two bytes appended to the text index, so that trigrams spanning text nodes
+		/// can be recorded.
+		/// </summary>
+		uint32_t m_lastIndexedBytes = 0;
+
+		/// <summary>
+		/// Maps every trigram in the indexed text, packed into the low three bytes of the key, to
+		/// the ascending offsets where it begins.
+		/// </summary>
+		std::unordered_map<uint32_t, std::vector<uint32_t>> m_textTrigrams;
+
+		/// <summary>
+		/// The range of the indexed text belonging to each node, indexed by the index of the node
+		/// within the document. Nodes that were not indexed hold an empty range starting at
+		/// ::UnindexedText.
+		/// </summary>
+		std::vector< std::pair<uint32_t, uint32_t> > m_nodeTextRanges;
+
+		/// <summary>
+		/// The starting offset held by nodes whose text is not part of the indexed text, such as
+		/// the content of templates.
+		/// </summary>
+		static constexpr uint32_t UnindexedText = std::numeric_limits<uint32_t>::max();
+
 	};
 
 	typedef std::unique_ptr<TreeMap> UniqueTreeMap;
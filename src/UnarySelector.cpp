@@ -29,6 +29,7 @@
 
 #include "UnarySelector.hpp"
 #include "Node.hpp"
+#include "SpecialTraits.hpp"
 
 namespace gq
 {
@@ -47,11 +48,18 @@ namespace gq
 			#endif
 		#endif
 
-		// Take on the traits of the selector.
-		auto& t = m_selector->GetMatchTraits();
-		for (auto& tp : t)
+		// The traits of the inner selector describe the nodes that the inner selector matches,
+		// and none of our operators match those same nodes. A not selector matches everything
+		// else, and the has selectors match ancestors of those nodes. So any element in scope is
+		// a candidate. When this selector is intersected with other selectors, their traits
+		// narrow the candidates down.
+		AddMatchTraits(GetAnyElementTraits());
+
+		if (m_operator == SelectorOperator::Not && m_selector->HasExactMatchTraits())
 		{
-			AddMatchTrait(tp.first, tp.second);
+			// Everything found through exact inner traits is guaranteed to fail, so it can be
+			// subtracted from the candidates without ever being tested.
+			AddExclusionTraits(m_selector->GetMatchTraits());
 		}
 	}
 
@@ -78,10 +86,8 @@ namespace gq
 				{
 					return MatchResult(node);
 				}
-				else
-				{
-					return result;
-				}
+
+				return nullptr;
 			}
 			break;
 
@@ -41,6 +41,15 @@ namespace gq
 	class UnarySelector final : public Selector
 	{
 
+		// So that compiled selectors can be written to and read back from the binary format.
+		friend class SelectorCodec;
+
+		// So that equivalent compiled selectors can be recognized and merged.
+		friend class SelectorCanonicalizer;
+
+		// So that the text selectors within can be found.
+		friend class ContainsMatcher;
+
 	public:
 
 		enum class SelectorOperator
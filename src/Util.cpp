@@ -29,7 +29,9 @@
 
 #include "Util.hpp"
 #include "Node.hpp"
-#include <locale>
+#include "CharClass.hpp"
+#include <future>
+#include <system_error>
 
 namespace gq
 {
@@ -73,6 +75,33 @@ namespace gq
 		return text;
 	}
 
+	const bool Util::NodeTextMatches(const Node* node, const Regex& expression)
+	{
+		Regex::Searcher searcher(expression);
+		SearchNodeText(node->m_node, searcher);
+		return searcher.Finish();
+	}
+
+	const bool Util::NodeOwnTextMatches(const Node* node, const Regex& expression)
+	{
+		Regex::Searcher searcher(expression);
+
+		if (node->m_node != nullptr && node->m_node->type == GUMBO_NODE_ELEMENT)
+		{
+			const GumboVector* children = &node->m_node->v.element.children;
+			for (unsigned int i = 0; i < children->length && !searcher.IsDone(); i++)
+			{
+				GumboNode* child = static_cast<GumboNode*>(children->data[i]);
+				if (child->type == GUMBO_NODE_TEXT)
+				{
+					searcher.Feed(child->v.text.text);
+				}
+			}
+		}
+
+		return searcher.Finish();
+	}
+
 	bool Util::NodeExists(const std::vector< const Node* >& nodeCollection, const GumboNode* search)
 	{
 		if (search == nullptr)
@@ -147,19 +176,11 @@ namespace gq
 
 	boost::string_ref Util::Trim(boost::string_ref str)
 	{
-		#ifdef _MSC_VER
-		std::locale loc("");
-		#endif
-
 		size_t si = 0;
 
 		for (size_t si = 0; si < str.size(); ++si)
 		{
-			#ifdef _MSC_VER
-			if (std::isspace(str[0], loc))
-			#else
-			if (std::isspace(str[0]))
-			#endif
+			if (CharClass::IsWhitespace(str[0]))
 			{
 				continue;
 			}
@@ -179,11 +200,7 @@ namespace gq
 			size_t ei = str.size() - 1;
 			for (ei = str.size() - 1; ei > 0; --ei)
 			{
-				#ifdef _MSC_VER
-				if (std::isspace(str[0], loc))
-				#else
-				if (std::isspace(str[0]))
-				#endif
+				if (CharClass::IsWhitespace(str[0]))
 				{
 					continue;
 				}
@@ -245,6 +262,47 @@ namespace gq
 		return tagName;
 	}
 
+	void Util::ForEachRange(const size_t rangeCount, const std::function<void(const size_t)>& runRange)
+	{
+		std::vector< std::future<void> > workers;
+		workers.reserve(rangeCount > 0 ? rangeCount - 1 : 0);
+
+		for (size_t r = 1; r < rangeCount; ++r)
+		{
+			std::future<void> worker;
+
+			try
+			{
+				worker = std::async(std::launch::async, [&runRange, r]() -> void { runRange(r); });
+			}
+			catch (std::system_error&)
+			{
+				// No thread could be started. The range is run on this thread instead, once the
+				// workers have been joined.
+			}
+
+			workers.push_back(std::move(worker));
+		}
+
+		// The calling thread takes the first range rather than sitting idle.
+		if (rangeCount > 0)
+		{
+			runRange(0);
+		}
+
+		for (size_t r = 1; r < rangeCount; ++r)
+		{
+			if (workers[r - 1].valid())
+			{
+				workers[r - 1].get();
+			}
+			else
+			{
+				runRange(r);
+			}
+		}
+	}
+
 	void Util::WriteNodeText(const GumboNode* node, std::string& stringContainer)
 	{
 		if (node == nullptr)
@@ -277,4 +335,35 @@ namespace gq
 		}
 	}
 
+	void Util::SearchNodeText(const GumboNode* node, Regex::Searcher& searcher)
+	{
+		if (node == nullptr || searcher.IsDone())
+		{
+			return;
+		}
+
+		switch (node->type)
+		{
+			case GUMBO_NODE_TEXT:
+			{
+				searcher.Feed(node->v.text.text);
+			}
+			break;
+
+			case GUMBO_NODE_ELEMENT:
+			{
+				const GumboVector* children = &node->v.element.children;
+				for (unsigned int i = 0; i < children->length && !searcher.IsDone(); i++)
+				{
+					GumboNode* child = static_cast<GumboNode*>(children->data[i]);
+					SearchNodeText(child, searcher);
+				}
+			}
+			break;
+
+			default:
+				break;
+		}
+	}
+
 } /* namespace gq */
\ No newline at end of file
@@ -34,7 +34,9 @@
 #include <vector>
 #include <memory>
 #include <algorithm>
+#include <functional>
 #include <boost/utility/string_ref.hpp>
+#include "Regex.hpp"
 
 namespace gq
 {	
@@ -72,6 +74,38 @@ namespace gq
 		/// </returns>
 		static std::string NodeOwnText(const Node* node);
 
+		/// <summary>
+		/// Searches the text of the supplied node and all of its descendants with the supplied
+		/// expression. Gives the same outcome as searching the output of ::NodeText(...), but the
+		/// text is never copied, and the search stops as soon as the outcome is known.
+		/// </summary>
+		/// <param name="node">
+		/// The node whose text, and the text of all of its descendants, is to be searched.
+		/// </param>
+		/// <param name="expression">
+		/// The expression to search for.
+		/// </param>
+		/// <returns>
+		/// True if the expression matched the text, false otherwise.
+		/// </returns>
+		static const bool NodeTextMatches(const Node* node, const Regex& expression);
+
+		/// <summary>
+		/// Searches the text of only the children of the supplied node with the supplied
+		/// expression. Gives the same outcome as searching the output of ::NodeOwnText(...), but
+		/// the text is never copied.
+		/// </summary>
+		/// <param name="node">
+		/// The node whose children's text is to be searched.
+		/// </param>
+		/// <param name="expression">
+		/// The expression to search for.
+		/// </param>
+		/// <returns>
+		/// True if the expression matched the text, false otherwise.
+		/// </returns>
+		static const bool NodeOwnTextMatches(const Node* node, const Regex& expression);
+
 		/// <summary>
 		/// Checks if the supplied node to search for already exists inside the supplied collection
 		/// of nodes.
@@ -153,6 +187,23 @@ namespace gq
 		/// </returns>
 		static std::string GetNodeTagName(const GumboNode* node);
 
+		/// <summary>
+		/// Runs the supplied function once for each of the supplied number of ranges, starting a
+		/// thread for every range but the first, which the calling thread runs itself rather than
+		/// sitting idle. Returns once every range has been run. When a thread cannot be started,
+		/// its range is run on the calling thread instead, once the started threads have been
+		/// joined, so every range is always run exactly once.
+		/// </summary>
+		/// <param name="rangeCount">
+		/// The number of ranges to run.
+		/// </param>
+		/// <param name="runRange">
+		/// The function to run for each range, which receives the index of the range. It is
+		/// called concurrently from several threads, so whatever it writes per range must be kept
+		/// apart from what every other range writes.
+		/// </param>
+		static void ForEachRange(const size_t rangeCount, const std::function<void(const size_t)>& runRange);
+
 	private:
 
 		/// <summary>
@@ -162,6 +213,18 @@ namespace gq
 		/// <param name="stringContainer"></param>
 		static void WriteNodeText(const GumboNode* node, std::string& stringContainer);
 
+		/// <summary>
+		/// Feeds the text of the supplied node and all of its descendants to the supplied
+		/// searcher, in the same order as ::WriteNodeText(...) writes it.
+		/// </summary>
+		/// <param name="node">
+		/// The node whose text is to be searched.
+		/// </param>
+		/// <param name="searcher">
+		/// The search to feed the text to.
+		/// </param>
+		static void SearchNodeText(const GumboNode* node, Regex::Searcher& searcher);
+
 		Util();
 		~Util();
 